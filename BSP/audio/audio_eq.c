@@ -0,0 +1,429 @@
+#include "audio_eq.h"
+#include "audio_telemetry.h"
+#include "perf_counter.h"
+#include "arm_math.h"
+#include <string.h>
+#include <math.h>
+
+#define EQ_ONE                  (1L << (31 - AUDIO_EQ_POST_SHIFT))  /* 系数1.0 */
+#define EQ_COEFFS_PER_STAGE     5       /* b0, b1, b2, a1, a2 */
+#define EQ_STATE_PER_STAGE      4       /* x[n-1], x[n-2], y[n-1], y[n-2] */
+#define EQ_WORK_FRAMES          256     /* 每次取出滤波的单声道采样数 */
+#define EQ_MAX_BAND_RATIO       0.45f   /* 中心频率高于采样率的这个比例时该频段不起作用 */
+#define EQ_HEADROOM_BITS        4       /* q31输入留出的位数: CMSIS要求的2位 + 最大增益12dB(4倍)的2位 */
+#define EQ_IN_SHIFT             (16 - EQ_HEADROOM_BITS)     /* 16位采样左移到q31的位数 */
+
+#define WAV_FORMAT_PCM          0x0001
+#define WAV_FORMAT_EXTENSIBLE   0xFFFE
+
+/* 当前曲目的处理状态 */
+typedef enum {
+    EQ_OFF = 0,                 /* 不是16位PCM WAV, 不处理 */
+    EQ_WAIT_HEADER,             /* 新曲目, 等待第一次读入的数据 */
+    EQ_ACTIVE                   /* 正在处理data块 */
+} EqState_t;
+
+/* 私有变量 */
+static const uint16_t s_band_hz[AUDIO_EQ_BANDS] = { 125, 500, 1500, 4000, 10000 };
+static int8_t s_gain[AUDIO_EQ_BANDS];       /* 各频段增益(dB) */
+static bool s_enabled = false;
+static EqState_t s_state = EQ_OFF;
+static uint32_t s_data_start = 0;           /* data块在文件中的范围 */
+static uint32_t s_data_end = 0;
+static uint8_t s_block_align = 0;           /* 一个采样帧的字节数 */
+static uint32_t s_wav_start = 0;            /* 任意格式WAV的data块起点和fmt块的nBlockAlign, */
+static uint16_t s_wav_align = 0;            /* 供定位对齐, 0表示不是WAV */
+static uint32_t s_design_rate = 0;          /* 系数对应的采样率, 0表示未计算 */
+static q31_t s_coeffs[AUDIO_EQ_BANDS * EQ_COEFFS_PER_STAGE];   /* 各声道共用 */
+static q31_t s_state_buf[AUDIO_EQ_MAX_CHANNELS][AUDIO_EQ_BANDS * EQ_STATE_PER_STAGE];
+static arm_biquad_casd_df1_inst_q31 s_inst[AUDIO_EQ_MAX_CHANNELS];
+static q31_t s_work[EQ_WORK_FRAMES];        /* 一个声道的一段采样 */
+static AudioEqStats_t s_stats;
+
+/* ============================================================================
+ * 滤波器设计
+ * ============================================================================ */
+
+/**
+ * @brief       浮点系数转换为Q30
+ * @param       x: 系数, 峰值滤波器各系数都在(-2, 2)内
+ * @retval      Q30系数
+ */
+static q31_t eq_coeff(float x)
+{
+    return (q31_t)lrintf(x * (float)EQ_ONE);
+}
+
+/**
+ * @brief       按采样率和各频段增益计算峰值滤波器系数 (RBJ Audio EQ Cookbook)
+ * @note        增益为0或中心频率接近奈奎斯特频率的频段为直通。
+ *              CMSIS的反馈系数与教科书符号相反(y = b*x + a1*y[n-1] + a2*y[n-2])。
+ *              量化后再调整b2使b0+b1+b2 = 1-a1-a2, 直流增益保持为1
+ * @param       rate: 采样率
+ * @retval      无
+ */
+static void eq_design(uint32_t rate)
+{
+    q31_t *c;
+    float a, w, cs, alpha, a0;
+    uint8_t band;
+
+    for (band = 0; band < AUDIO_EQ_BANDS; band++) {
+        c = &s_coeffs[band * EQ_COEFFS_PER_STAGE];
+        memset(c, 0, EQ_COEFFS_PER_STAGE * sizeof(q31_t));
+
+        if (s_gain[band] == 0 || s_band_hz[band] >= (float)rate * EQ_MAX_BAND_RATIO) {
+            c[0] = EQ_ONE;
+            continue;
+        }
+
+        a = powf(10.0f, (float)s_gain[band] / 40.0f);
+        w = 2.0f * PI * (float)s_band_hz[band] / (float)rate;
+        cs = cosf(w);
+        alpha = sinf(w) / (2.0f * AUDIO_EQ_Q);
+        a0 = 1.0f + alpha / a;
+
+        c[0] = eq_coeff((1.0f + alpha * a) / a0);           /* b0 */
+        c[1] = eq_coeff(-2.0f * cs / a0);                   /* b1 */
+        c[3] = eq_coeff(2.0f * cs / a0);                    /* -a1 */
+        c[4] = eq_coeff(-(1.0f - alpha / a) / a0);          /* -a2 */
+        c[2] = (q31_t)(EQ_ONE - c[3] - c[4] - c[0] - c[1]); /* b2 */
+    }
+
+    s_design_rate = rate;
+}
+
+/* ============================================================================
+ * RIFF头
+ * ============================================================================ */
+
+/**
+ * @brief       读小端16位数
+ * @param       p: 数据
+ * @retval      值
+ */
+static uint16_t eq_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+/**
+ * @brief       读小端32位数
+ * @param       p: 数据
+ * @retval      值
+ */
+static uint32_t eq_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief       解析RIFF头, 找到16位PCM的fmt块和data块
+ * @note        其他格式的WAV也记下data块起点和nBlockAlign (audio_eq_wav_layout)
+ * @param       buf: 文件开头
+ * @param       len: 字节数, fmt块和data块头必须都在其中
+ * @retval      true: 可以处理, 已设置格式和data块范围
+ */
+static bool eq_parse_header(const uint8_t *buf, uint32_t len)
+{
+    uint32_t pos = 12;
+    uint32_t size;
+    uint16_t format;
+    uint16_t channels = 0;
+    uint16_t bits;
+    uint32_t rate = 0;
+    uint16_t align = 0;
+    bool pcm16 = false;
+    const uint8_t *fmt;
+
+    if (len < 12 || memcmp(buf, "RIFF", 4) != 0 || memcmp(buf + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    while (pos + 8 <= len) {
+        size = eq_le32(buf + pos + 4);
+
+        if (memcmp(buf + pos, "fmt ", 4) == 0) {
+            if (size < 16 || pos + 8 + 16 > len) {
+                return false;
+            }
+            fmt = buf + pos + 8;
+            format = eq_le16(fmt);
+            channels = eq_le16(fmt + 2);
+            rate = eq_le32(fmt + 4);
+            align = eq_le16(fmt + 12);
+            bits = eq_le16(fmt + 14);
+            if (format == WAV_FORMAT_EXTENSIBLE && size >= 40 && pos + 8 + 40 <= len) {
+                format = eq_le16(fmt + 24);     /* 子格式GUID的前两个字节 */
+            }
+            pcm16 = (format == WAV_FORMAT_PCM && bits == 16 &&
+                     channels != 0 && channels <= AUDIO_EQ_MAX_CHANNELS && rate >= 8000 && rate <= 48000);
+        } else if (memcmp(buf + pos, "data", 4) == 0) {
+            if (align == 0) {
+                return false;       /* fmt块必须在data块之前 */
+            }
+            s_wav_start = pos + 8;
+            s_wav_align = align;
+            if (!pcm16) {
+                return false;
+            }
+            s_block_align = (uint8_t)(channels * 2);
+            s_data_start = pos + 8;
+            s_data_end = (size > 0xFFFFFFFFU - s_data_start) ? 0xFFFFFFFFU : s_data_start + size;
+            if (s_data_start % s_block_align != 0) {
+                return false;       /* 扇区边界不在采样帧边界上 */
+            }
+
+            s_stats.sample_rate = rate;
+            s_stats.channels = (uint8_t)channels;
+            s_stats.budget_cycles = (uint32_t)((uint64_t)SystemCoreClock * AUDIO_EQ_BLOCK / (rate * channels));
+            return true;
+        }
+
+        if (size > len) {
+            return false;           /* 块超出已读入的数据 */
+        }
+        pos += 8 + size + (size & 1);
+    }
+
+    return false;
+}
+
+/* ============================================================================
+ * 处理
+ * ============================================================================ */
+
+/**
+ * @brief       滤波一块PCM (就地)
+ * @note        各声道依次每EQ_WORK_FRAMES个采样取出扩展为q31, 滤波后舍入回16位并饱和。
+ *              arm_biquad_cascade_df1_q31的累加结果溢出时回绕而不是饱和, 输入按
+ *              EQ_HEADROOM_BITS缩小, 提升的频段在大音量时也不会翻转符号
+ * @param       pcm: 交织的采样
+ * @param       count: 采样数(各声道合计), 不超过AUDIO_EQ_BLOCK
+ * @retval      无
+ */
+static void eq_run(q15_t *pcm, uint32_t count)
+{
+    uint8_t channels = s_stats.channels;
+    uint32_t frames = count / channels;
+    uint32_t done;
+    uint32_t n;
+    uint32_t i;
+    uint8_t ch;
+    q15_t *p;
+    q31_t v;
+
+    for (ch = 0; ch < channels; ch++) {
+        for (done = 0; done < frames; done += n) {
+            n = frames - done;
+            if (n > EQ_WORK_FRAMES) {
+                n = EQ_WORK_FRAMES;
+            }
+            p = pcm + done * channels + ch;
+
+            for (i = 0; i < n; i++) {
+                s_work[i] = (q31_t)p[i * channels] << EQ_IN_SHIFT;
+            }
+
+            arm_biquad_cascade_df1_q31(&s_inst[ch], s_work, s_work, n);
+
+            for (i = 0; i < n; i++) {
+                v = (s_work[i] >> EQ_IN_SHIFT) + ((s_work[i] >> (EQ_IN_SHIFT - 1)) & 1);
+                p[i * channels] = (q15_t)__SSAT(v, 16);
+            }
+        }
+    }
+}
+
+/* ============================================================================
+ * 接口
+ * ============================================================================ */
+
+/**
+ * @brief       初始化均衡器, 各频段增益为0
+ * @param       无
+ * @retval      无
+ */
+void audio_eq_init(void)
+{
+    memset(s_gain, 0, sizeof(s_gain));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_design_rate = 0;
+    s_state = EQ_OFF;
+    audio_eq_enable(AUDIO_EQ_DEFAULT_ON);
+}
+
+/**
+ * @brief       启用/关闭均衡器, 播放中切换从下一次读卡开始生效
+ * @param       enable: true启用
+ * @retval      无
+ */
+void audio_eq_enable(bool enable)
+{
+    s_enabled = enable;
+}
+
+/**
+ * @brief       均衡器是否启用
+ * @param       无
+ * @retval      true: 已启用
+ */
+bool audio_eq_enabled(void)
+{
+    return s_enabled;
+}
+
+/**
+ * @brief       设置频段增益, 播放中从下一次读卡开始生效
+ * @param       band: 频段
+ * @param       db: 增益(dB), 限制在±AUDIO_EQ_GAIN_MAX
+ * @retval      true: 成功, false: 频段不存在
+ */
+bool audio_eq_set_gain(uint8_t band, int8_t db)
+{
+    if (band >= AUDIO_EQ_BANDS) {
+        return false;
+    }
+
+    if (db > AUDIO_EQ_GAIN_MAX) {
+        db = AUDIO_EQ_GAIN_MAX;
+    } else if (db < -AUDIO_EQ_GAIN_MAX) {
+        db = -AUDIO_EQ_GAIN_MAX;
+    }
+
+    if (s_gain[band] != db) {
+        s_gain[band] = db;
+        s_design_rate = 0;      /* 下一次处理时重新计算系数 */
+    }
+    return true;
+}
+
+/**
+ * @brief       读取频段增益
+ * @param       band: 频段
+ * @retval      增益(dB), 频段不存在时返回0
+ */
+int8_t audio_eq_get_gain(uint8_t band)
+{
+    return (band < AUDIO_EQ_BANDS) ? s_gain[band] : 0;
+}
+
+/**
+ * @brief       频段中心频率
+ * @param       band: 频段
+ * @retval      Hz, 频段不存在时返回0
+ */
+uint16_t audio_eq_band_hz(uint8_t band)
+{
+    return (band < AUDIO_EQ_BANDS) ? s_band_hz[band] : 0;
+}
+
+/**
+ * @brief       新曲目: 清零滤波器状态, 等待第一次读入的数据中的RIFF头
+ * @param       无
+ * @retval      无
+ */
+void audio_eq_open(void)
+{
+    uint8_t ch;
+
+    for (ch = 0; ch < AUDIO_EQ_MAX_CHANNELS; ch++) {
+        arm_biquad_cascade_df1_init_q31(&s_inst[ch], AUDIO_EQ_BANDS, s_coeffs,
+                                        s_state_buf[ch], AUDIO_EQ_POST_SHIFT);
+    }
+
+    s_state = EQ_WAIT_HEADER;
+    s_wav_align = 0;
+    s_stats.active = false;
+    s_stats.last_cycles = 0;
+}
+
+/**
+ * @brief       读卡后、放进环形缓冲区之前就地处理一段数据
+ * @note        只处理其中属于data块的整采样帧, 每AUDIO_EQ_BLOCK个采样一块;
+ *              buf与文件偏移对2字节同余(环形缓冲区与文件对扇区同余), 可按q15访问
+ * @param       offset: buf[0]的文件偏移
+ * @param       buf: 数据
+ * @param       len: 字节数
+ * @retval      无
+ */
+void audio_eq_process(uint32_t offset, uint8_t *buf, uint32_t len)
+{
+    uint32_t start;
+    uint32_t end;
+    uint32_t count;
+    uint32_t n;
+    uint32_t t0;
+    q15_t *pcm;
+
+    if (s_state == EQ_WAIT_HEADER) {
+        s_state = (offset == 0 && eq_parse_header(buf, len)) ? EQ_ACTIVE : EQ_OFF;
+        s_stats.active = (s_state == EQ_ACTIVE);
+    }
+
+    if (s_state != EQ_ACTIVE || !s_enabled) {
+        return;
+    }
+
+    if (s_design_rate != s_stats.sample_rate) {
+        eq_design(s_stats.sample_rate);
+    }
+
+    /* 与data块的交集, 去掉两端不完整的采样帧 */
+    if (offset >= s_data_end) {
+        return;
+    }
+    start = (offset > s_data_start) ? offset : s_data_start;
+    end = (len > s_data_end - offset) ? s_data_end : offset + len;
+    if (start >= end) {
+        return;
+    }
+    start += (s_block_align - (start - s_data_start) % s_block_align) % s_block_align;
+    end -= (end - s_data_start) % s_block_align;
+    if (start >= end) {
+        return;
+    }
+
+    pcm = (q15_t *)(void *)(buf + (start - offset));
+    count = (end - start) / 2;
+
+    while (count > 0) {
+        n = (count > AUDIO_EQ_BLOCK) ? AUDIO_EQ_BLOCK : count;
+
+        t0 = perf_counter_now();
+        eq_run(pcm, n);
+        if (n == AUDIO_EQ_BLOCK) {
+            s_stats.last_cycles = perf_counter_now() - t0;
+            audio_telemetry_hist(TELEM_HIST_EQ, s_stats.last_cycles);
+        }
+
+        pcm += n;
+        count -= n;
+    }
+}
+
+/**
+ * @brief       当前曲目的WAV数据布局 (定位时按采样帧/ADPCM块对齐)
+ * @param       data_start: 输出, data块在文件中的起点
+ * @param       block_align: 输出, fmt块的nBlockAlign
+ * @retval      true: 当前曲目是WAV, false: 不是或RIFF头还没读到
+ */
+bool audio_eq_wav_layout(uint32_t *data_start, uint16_t *block_align)
+{
+    if (s_wav_align == 0) {
+        return false;
+    }
+    *data_start = s_wav_start;
+    *block_align = s_wav_align;
+    return true;
+}
+
+/**
+ * @brief       读取当前曲目的处理情况
+ * @param       stats: 输出
+ * @retval      无
+ */
+void audio_eq_get_stats(AudioEqStats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,59 @@
+#ifndef AUDIO_EQ_H
+#define AUDIO_EQ_H
+
+#include "main.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * WAV均衡器 (5段双二阶滤波级联)
+ * WAV文件的PCM数据在送入VS1053之前经过MCU: 读卡之后、放进环形缓冲区之前就地处理,
+ * VS1053仍按WAV解码, 送数路径和缓冲区不变。曲目开头解析RIFF头的fmt/data块,
+ * 只处理16位PCM(单/双声道); 其他格式、RIFF头超出第一次读入的数据或data块
+ * 不按采样对齐时整首不处理。
+ * PCM按AUDIO_EQ_BLOCK个采样一块, 各声道分别用CMSIS-DSP arm_biquad_cascade_df1_q31
+ * 跑5级峰值滤波(系数两个声道共用)。Cortex-M3没有双16位乘加指令, q15滤波器
+ * 同样是逐个采样64位累加, 速度与q31相当, 但16位的系数和状态使125Hz/250Hz频段
+ * 的输出截断误差被极点放大成上千LSB的直流偏移, 所以状态用q31, 采样仍为16位。
+ * 每块耗时记入遥测直方图"EQ block", 报告中给出与该块播放时长(实时预算)的比例。
+ */
+
+#define AUDIO_EQ_BANDS          5       /* 频段数 */
+#define AUDIO_EQ_BLOCK          1024    /* 每块采样数(各声道合计) */
+#define AUDIO_EQ_GAIN_MAX       12      /* 增益范围±dB */
+#define AUDIO_EQ_Q              1.0f    /* 各频段的品质因数 */
+#define AUDIO_EQ_POST_SHIFT     1       /* 系数为Q30, 范围[-2, 2) */
+#define AUDIO_EQ_MAX_CHANNELS   2
+
+#ifndef AUDIO_EQ_DEFAULT_ON
+#define AUDIO_EQ_DEFAULT_ON     1       /* 上电即启用 (增益全为0时输出不变, 但照常计算) */
+#endif
+
+/* 当前曲目的处理情况 */
+typedef struct {
+    bool active;                /* 当前曲目是16位PCM WAV, 正在处理 */
+    uint32_t sample_rate;       /* 采样率 */
+    uint8_t channels;           /* 声道数 */
+    uint32_t budget_cycles;     /* 一块的播放时长(CPU周期), 处理耗时须远小于此 */
+    uint32_t last_cycles;       /* 最近一整块的耗时 */
+} AudioEqStats_t;
+
+void audio_eq_init(void);
+void audio_eq_enable(bool enable);
+bool audio_eq_enabled(void);
+bool audio_eq_set_gain(uint8_t band, int8_t db);                    /* 超出范围时限幅 */
+int8_t audio_eq_get_gain(uint8_t band);
+uint16_t audio_eq_band_hz(uint8_t band);                            /* 频段中心频率 */
+void audio_eq_open(void);                                           /* 新曲目, 等待RIFF头 */
+void audio_eq_process(uint32_t offset, uint8_t *buf, uint32_t len);  /* 读卡后就地处理, offset为buf的文件偏移 */
+void audio_eq_get_stats(AudioEqStats_t *stats);
+bool audio_eq_wav_layout(uint32_t *data_start, uint16_t *block_align);  /* 当前曲目的WAV data块起点和nBlockAlign */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_EQ_H
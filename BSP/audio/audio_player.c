@@ -1,14 +1,1132 @@
 #include "audio_player.h"
+#include "vs1053_feeder.h"
+#include "audio_ringbuf.h"
 #include "nt35310_alientek.h"
+#include "perf_counter.h"
+#include "mp3_frame.h"
+#include "seek_index.h"
+#include "audio_telemetry.h"
+#include "audio_eq.h"
+#include "sdio_sdcard.h"
 #include <string.h>
 
+#define AUDIO_STATUS_INTERVAL_MS    1000    /* 播放时间刷新间隔 */
+#define AUDIO_TASK_POLL_BURSTS      16      /* 轮询送数时每次任务最多送的32字节块数 */
+#define AUDIO_CLMT_SIZE             64      /* 快速定位簇链表长度(DWORD), 最多容纳31个碎片 */
+#define AUDIO_TRACK_CACHE_SIZE      4       /* 曲目信息缓存条数 */
+
+/* 曲目信息 (第一帧的VBR信息头), 按文件起始簇和大小缓存 */
+typedef struct {
+    DWORD sclust;               /* 文件起始簇, 0表示空 */
+    DWORD size;                 /* 文件大小 */
+    uint32_t start;             /* 第一帧的文件偏移 */
+    uint32_t duration_ms;       /* 时长, 0表示未知 */
+    Mp3VbrInfo_t vbr;
+} AudioTrackInfo_t;
+
 /* 全局变量定义 */
 AudioPlayer_t g_audio_player;
 
 /* 私有变量 */
-static FIL audio_file;
-static uint8_t audio_buffer[512];  /* 音频数据缓冲区 */
+static FIL *audio_fp = NULL;               /* 当前曲目(文件池) */
+static FIL *next_fp = NULL;                /* 预读的下一曲目(文件池) */
+static DWORD audio_clmt[AUDIO_CLMT_SIZE];  /* 当前曲目的簇链表, 下一曲目成为当前曲目后再建 */
+static bool clmt_tried = false;            /* 当前曲目已尝试建立簇链表 */
+static uint32_t direct_sector = 0;         /* 当前曲目连续存放时的第一个扇区, 0表示经FatFs读 */
+static uint32_t data_start = 0;            /* 当前曲目音频数据起点(ID3之后) */
+static uint32_t seek_cycles = 0;           /* 最近一次定位耗时 */
+static AudioTrackInfo_t cur_track;         /* 当前曲目信息 */
+static AudioTrackInfo_t next_track;        /* 预读的下一曲目信息 */
+static AudioTrackInfo_t track_cache[AUDIO_TRACK_CACHE_SIZE];  /* 重新打开同一文件时不再解析 */
+static uint8_t track_cache_next = 0;       /* 下一个替换的缓存项 */
+static uint8_t audio_buffer[AUDIO_RINGBUF_SIZE] __attribute__((aligned(4)));  /* 预读环形缓冲区存储 */
+static AudioRingBuf_t audio_ring;
 static bool file_opened = false;
+static bool file_eof = false;
+static uint8_t engine_result = 0;          /* 1: 播放完成, 0xFF: 错误 */
+static uint32_t task_max_cycles = 0;       /* audio_player_task单次最长耗时 */
+static uint32_t task_last_cycles = 0;      /* audio_player_task最近一次耗时 */
+static volatile uint16_t decode_time_sec = 0;   /* 排队读取的SPI_DECODE_TIME */
+static bool open_pending = false;          /* 取消流程结束后打开current_file */
+static bool decoder_ready = false;         /* 上一首已按取消流程结束, 打开时不必复位解码器 */
+static bool switch_timing = false;         /* 正在测量换曲耗时 */
+static uint32_t switch_start = 0;          /* 换曲请求时刻(周期计数) */
+static uint32_t switch_cancel_cycles = 0;  /* 请求 -> 解码器空闲 */
+static uint32_t switch_total_cycles = 0;   /* 请求 -> 新文件开始送数 */
+
+/* 下一曲目预读 (播完自动衔接) */
+static bool playlist_active = false;       /* 按g_file_list播放, 播完自动接下一首 */
+static bool next_opened = false;           /* 下一曲目已打开并跳过ID3 */
+static bool next_failed = false;           /* 本曲目期间预读已失败, 不再重试 */
+static bool next_eof = false;              /* 下一曲目不足一个扇区 */
+static uint16_t next_index = 0;            /* 下一曲目在g_file_list中的索引 */
+static uint8_t next_head[AUDIO_RINGBUF_SECTOR] __attribute__((aligned(4)));  /* 下一曲目第一个扇区的剩余部分 */
+static uint32_t next_head_off = 0;         /* 下一曲目数据起点在扇区内的偏移 */
+static uint32_t next_head_len = 0;         /* next_head中的字节数 */
+static uint32_t next_data_start = 0;       /* 下一曲目音频数据起点 */
+static uint32_t cur_frame_hdr = 0;         /* 当前曲目的MP3帧头(mp3_frame_compat), 0表示非MP3 */
+static uint32_t next_frame_hdr = 0;        /* 下一曲目的MP3帧头 */
+static bool boundary_pending = false;      /* 已衔接到缓冲区, 下一曲目还没开始送出 */
+static bool track_end_seen = false;        /* 上一曲目的数据已全部送出 */
+static uint32_t track_end = 0;             /* 上一曲目数据结束处(环形缓冲区计数) */
+static uint32_t track_start = 0;           /* 下一曲目数据起始处(环形缓冲区计数) */
+static uint32_t track_end_time = 0;        /* 上一曲目数据送完的时刻(周期计数) */
+static bool advance_timing = false;        /* 自动切换走了取消流程, 开始送数时记录间隙 */
+static AudioTransition_t transition;       /* 曲目衔接统计 */
+
+/* 起播耗时测试 */
+static bool bench_armed = false;           /* 已记录起点, 等待出声 */
+static uint32_t bench_start_cycles = 0;
+static volatile uint32_t bench_cycles[AUDIO_PHASE_COUNT];  /* 起点到各阶段结束, 0表示未到达 */
+static volatile bool bench_hdat_posted = false;            /* 已排队读HDAT1, 尚未返回 */
+
+/* ============================================================================
+ * 预读缓冲区
+ * ============================================================================ */
+
+/**
+ * @brief       连续存放的曲目: 按起始扇区+文件偏移直接读卡, 不经FatFs
+ * @note        一条多块读命令读入环形缓冲区, 不查FAT链也不经FIL扇区缓存;
+ *              读完用快速定位表移动文件指针, FIL与f_read之后的状态相同.
+ *              文件尾不足一个扇区时整扇区读入, 只提交文件内的部分
+ * @param       dst: 目标(4字节对齐)
+ * @param       len: 字节数(整扇区)
+ * @param       bytes_read: 输出, 读到的字节数
+ * @retval      FR_OK: 成功, 其他: 错误
+ */
+static FRESULT audio_read_direct(uint8_t *dst, uint32_t len, UINT *bytes_read)
+{
+    uint32_t pos = (uint32_t)f_tell(audio_fp);
+    uint32_t remain = (uint32_t)f_size(audio_fp) - pos;
+
+    *bytes_read = 0;
+    if (len > remain) {
+        len = remain;
+    }
+    if (len == 0) {
+        return FR_OK;
+    }
+
+    if (sd_read_disk(dst, direct_sector + pos / AUDIO_RINGBUF_SECTOR,
+                     (len + AUDIO_RINGBUF_SECTOR - 1) / AUDIO_RINGBUF_SECTOR) != HAL_OK) {
+        return FR_DISK_ERR;
+    }
+    *bytes_read = len;
+    audio_telemetry_inc(TELEM_SD_DIRECT);
+
+    return f_lseek(audio_fp, pos + len);
+}
+
+/**
+ * @brief       从文件预读数据到环形缓冲区 (生产者)
+ * @note        每次f_read为整数个扇区, 最长AUDIO_RINGBUF_CHUNK, 文件指针保持扇区对齐时
+ *              FatFs直接把多个扇区读入缓冲区, 不经过FIL内部扇区缓存;
+ *              文件连续存放时直接读卡(audio_read_direct)
+ * @param       max_chunks: 本次最多读几次, 0表示按水位一直读到高水位
+ * @retval      FR_OK: 成功(含读到文件尾), 其他: FatFs错误
+ */
+static FRESULT audio_fill_ringbuf(uint8_t max_chunks)
+{
+    FRESULT res;
+    UINT bytes_read;
+    uint32_t len;
+    uint8_t *dst;
+    uint8_t chunks = 0;
+    uint32_t t0;
+    uint32_t pos;
+
+    while (!file_eof && audio_ringbuf_need_fill(&audio_ring)) {
+        dst = audio_ringbuf_write_ptr(&audio_ring, &len);
+        if (len > AUDIO_RINGBUF_CHUNK) {
+            len = AUDIO_RINGBUF_CHUNK;
+        }
+        len -= len % AUDIO_RINGBUF_SECTOR;
+        if (len == 0) {
+            break;
+        }
+
+        pos = (uint32_t)f_tell(audio_fp);
+        t0 = perf_counter_now();
+        if (direct_sector != 0 && (pos % AUDIO_RINGBUF_SECTOR) == 0 && ((uint32_t)dst & 3U) == 0) {
+            res = audio_read_direct(dst, len, &bytes_read);
+        } else {
+            res = f_read(audio_fp, dst, len, &bytes_read);
+        }
+        if (res != FR_OK) {
+            audio_telemetry_inc(TELEM_SD_ERRORS);
+            return res;
+        }
+        audio_telemetry_hist(TELEM_HIST_SD_READ, perf_counter_now() - t0);
+        audio_telemetry_inc(TELEM_SD_READS);
+        audio_telemetry_add(TELEM_SD_BYTES, bytes_read);
+
+        if (bytes_read < len) {
+            file_eof = true;
+        }
+
+        if (bytes_read > 0) {
+            audio_eq_process(pos, dst, bytes_read);     /* WAV: 放进缓冲区之前均衡 */
+            audio_ringbuf_commit(&audio_ring, bytes_read);
+            vs1053_feeder_notify();
+        }
+
+        if (max_chunks != 0 && ++chunks >= max_chunks) {
+            break;
+        }
+    }
+
+    return FR_OK;
+}
+
+/**
+ * @brief       初始化预读缓冲区
+ * @note        ID3跳过后文件指针通常不在扇区边界, 先读一小段补齐, 之后每次f_read都是整扇区
+ * @param       无
+ * @retval      FR_OK: 成功, 其他: FatFs错误
+ */
+static FRESULT audio_ringbuf_start(void)
+{
+    FRESULT res;
+    UINT bytes_read;
+    uint32_t len;
+    uint8_t *dst;
+    uint32_t head = (uint32_t)(f_tell(audio_fp) % AUDIO_RINGBUF_SECTOR);
+
+    audio_ringbuf_init(&audio_ring, audio_buffer, sizeof(audio_buffer));
+    audio_ringbuf_reset_at(&audio_ring, head);
+    file_eof = false;
+
+    if (head != 0) {
+        dst = audio_ringbuf_write_ptr(&audio_ring, &len);
+        len = AUDIO_RINGBUF_SECTOR - head;
+
+        res = f_read(audio_fp, dst, len, &bytes_read);
+        if (res != FR_OK) {
+            return res;
+        }
+        if (bytes_read < len) {
+            file_eof = true;
+        }
+        audio_eq_process((uint32_t)f_tell(audio_fp) - bytes_read, dst, bytes_read);
+        audio_ringbuf_commit(&audio_ring, bytes_read);
+    }
+
+    return FR_OK;
+}
+
+/**
+ * @brief       轮询方式从环形缓冲区送一次32字节 (VS1053_FEED_USE_DMA=0时使用)
+ * @param       无
+ * @retval      0: 成功, 1: VS1053忙碌
+ */
+static uint8_t audio_feed_polled(void)
+{
+    uint8_t tmp[32];
+    uint32_t len;
+    uint32_t n;
+    const uint8_t *src = audio_ringbuf_read_ptr(&audio_ring, &len);
+
+    n = audio_ringbuf_fill(&audio_ring);
+    if (n > 32) n = 32;
+
+    if (len < n) {
+        /* 跨越存储区末尾, 拼成连续的32字节 */
+        memcpy(tmp, src, len);
+        memcpy(tmp + len, audio_buffer, n - len);
+        src = tmp;
+    }
+    if (n < 32) {
+        /* 文件末尾不足32字节, 补零 */
+        if (src != tmp) {
+            memcpy(tmp, src, n);
+            src = tmp;
+        }
+        memset(tmp + n, 0, 32 - n);
+    }
+
+    if (vs1053_send_music_data((uint8_t *)src) != 0) {
+        return 1;
+    }
+
+    audio_ringbuf_consume(&audio_ring, n);
+    return 0;
+}
+
+/**
+ * @brief       向环形缓冲区写入一段数据 (处理存储区末尾回绕)
+ * @param       src: 数据, NULL表示写入0
+ * @param       len: 字节数, 调用者保证空间足够
+ * @retval      无
+ */
+static void audio_ring_put(const uint8_t *src, uint32_t len)
+{
+    uint32_t n;
+    uint8_t *dst;
+
+    while (len > 0) {
+        dst = audio_ringbuf_write_ptr(&audio_ring, &n);
+        if (n > len) {
+            n = len;
+        }
+        if (src != NULL) {
+            memcpy(dst, src, n);
+            src += n;
+        } else {
+            memset(dst, 0, n);
+        }
+        audio_ringbuf_commit(&audio_ring, n);
+        len -= n;
+    }
+}
+
+/* ============================================================================
+ * 起播耗时测试
+ * ============================================================================ */
+
+/**
+ * @brief       记录一个阶段结束 (每次测试每个阶段只记一次)
+ * @param       phase: 阶段
+ * @retval      无
+ */
+static void audio_bench_mark(AudioPhase_t phase)
+{
+    if (bench_armed && bench_cycles[phase] == 0) {
+        bench_cycles[phase] = (perf_counter_now() - bench_start_cycles) | 1U;  /* 保证非0 */
+    }
+}
+
+/**
+ * @brief       SPI_HDAT1排队读取完成回调 (送数器中断中执行)
+ * @param       addr: 寄存器地址
+ * @param       value: 寄存器值, 非0表示已识别出流格式
+ * @retval      无
+ */
+static void audio_bench_hdat_cb(uint8_t addr, uint16_t value)
+{
+    (void)addr;
+    if (value != 0) {
+        audio_bench_mark(AUDIO_PHASE_SOUND);
+    }
+    bench_hdat_posted = false;
+}
+
+/**
+ * @brief       送数开始后检查是否已出声, 出声后结束本次测试 (各阶段耗时在遥测报告中读出)
+ * @param       无
+ * @retval      无
+ */
+static void audio_bench_poll(void)
+{
+    if (!bench_armed || bench_cycles[AUDIO_PHASE_FEED] == 0) {
+        return;
+    }
+
+    if (bench_cycles[AUDIO_PHASE_SOUND] == 0) {
+        if (!bench_hdat_posted) {
+            bench_hdat_posted = vs1053_sci_post_read(SPI_HDAT1, audio_bench_hdat_cb);
+        }
+        return;
+    }
+
+    bench_armed = false;
+}
+
+/* ============================================================================
+ * 下一曲目预读
+ * ============================================================================ */
+
+/**
+ * @brief       查找第一个有效的MP3帧头
+ * @param       buf: 数据
+ * @param       len: 字节数
+ * @retval      帧头中的版本/层/采样率部分(mp3_frame_compat), 0表示没有找到
+ */
+static uint32_t audio_mp3_frame_header(const uint8_t *buf, uint32_t len)
+{
+    Mp3FrameInfo_t info;
+
+    if (mp3_frame_find(buf, len, &info) < 0) {
+        return 0;
+    }
+    return mp3_frame_compat(info.header);
+}
+
+/**
+ * @brief       跳过ID3v2标签
+ * @param       fp: 文件, 文件指针在开头
+ * @param       skipped: 输出, 跳过的字节数(0表示没有标签)
+ * @retval      FR_OK: 成功, 其他: FatFs错误
+ */
+static FRESULT audio_skip_id3(FIL *fp, uint32_t *skipped)
+{
+    FRESULT res;
+    uint8_t header[10];
+    UINT bytes_read;
+
+    *skipped = 0;
+
+    res = f_read(fp, header, 10, &bytes_read);
+    if (res != FR_OK) {
+        return res;
+    }
+
+    if (bytes_read == 10 && header[0] == 'I' && header[1] == 'D' && header[2] == '3') {
+        /* ID3v2标签，计算标签大小并跳过 */
+        *skipped = (((uint32_t)header[6] << 21) |
+                    ((uint32_t)header[7] << 14) |
+                    ((uint32_t)header[8] << 7) |
+                    ((uint32_t)header[9])) + 10;
+    }
+
+    return f_lseek(fp, *skipped);
+}
+
+/**
+ * @brief       取得曲目信息: 时长/TOC等, 先查缓存, 没有再解析第一帧
+ * @param       fp: 文件
+ * @param       start: buf对应的文件偏移
+ * @param       buf: 音频数据开头(ID3之后)
+ * @param       len: 字节数
+ * @param       info: 输出
+ * @retval      无
+ */
+static void audio_track_info(FIL *fp, uint32_t start, const uint8_t *buf, uint32_t len, AudioTrackInfo_t *info)
+{
+    int32_t pos;
+    uint8_t i;
+
+    for (i = 0; i < AUDIO_TRACK_CACHE_SIZE; i++) {
+        if (track_cache[i].sclust != 0 && track_cache[i].sclust == fp->sclust &&
+            track_cache[i].size == f_size(fp)) {
+            *info = track_cache[i];
+            return;
+        }
+    }
+
+    memset(info, 0, sizeof(*info));
+    pos = mp3_frame_find(buf, len, NULL);
+    if (pos < 0 || !mp3_vbr_parse(buf + pos, len - (uint32_t)pos, &info->vbr)) {
+        return;     /* 不是MP3或数据不够, 不缓存 */
+    }
+
+    info->sclust = fp->sclust;
+    info->size = f_size(fp);
+    info->start = start + (uint32_t)pos;
+    info->duration_ms = mp3_vbr_duration_ms(&info->vbr, (uint32_t)(info->size - info->start));
+
+    track_cache[track_cache_next] = *info;
+    track_cache_next = (track_cache_next + 1) % AUDIO_TRACK_CACHE_SIZE;
+}
+
+/**
+ * @brief       当前曲目是没有TOC的MP3时, 请求在空闲时建立定位索引
+ * @param       无
+ * @retval      无
+ */
+static void audio_index_request(void)
+{
+    if (cur_track.sclust != 0 && !cur_track.vbr.has_toc) {
+        seek_index_request(g_audio_player.current_file);
+    }
+}
+
+/**
+ * @brief       按播放模式计算下一首的索引 (不重新扫描目录)
+ * @param       cur: 当前索引
+ * @param       idx: 输出, 下一首索引
+ * @retval      true: 有下一首, false: 单曲模式已是最后一首
+ */
+static bool audio_next_index(uint16_t cur, uint16_t *idx)
+{
+    if (g_file_list.count == 0) {
+        return false;
+    }
+
+    *idx = cur;
+
+    switch (g_audio_player.play_mode) {
+        case PLAY_MODE_SINGLE:
+        case PLAY_MODE_REPEAT_ALL:
+            (*idx)++;
+            if (*idx >= g_file_list.count) {
+                if (g_audio_player.play_mode == PLAY_MODE_REPEAT_ALL) {
+                    *idx = 0;           /* 循环到第一首 */
+                } else {
+                    return false;       /* 单曲模式，已是最后一首 */
+                }
+            }
+            break;
+
+        case PLAY_MODE_REPEAT_ONE:
+            /* 单曲循环，不切换 */
+            break;
+
+        case PLAY_MODE_RANDOM:
+            /* 随机播放 */
+            if (g_file_list.count > 1) {
+                do {
+                    *idx = HAL_GetTick() % g_file_list.count;
+                } while (*idx == cur);
+            }
+            break;
+    }
+
+    return true;
+}
+
+/**
+ * @brief       关闭已预读的下一曲目
+ * @param       无
+ * @retval      无
+ */
+static void audio_next_discard(void)
+{
+    if (next_opened) {
+        fs_close_file(&next_fp);
+        next_opened = false;
+    }
+    boundary_pending = false;
+}
+
+/**
+ * @brief       打开下一曲目, 跳过ID3, 读入第一个扇区的剩余部分并取MP3帧头
+ * @note        当前曲目读到文件尾后调用一次, 之后缓冲区里的数据还能播放一段时间
+ * @param       无
+ * @retval      无
+ */
+static void audio_next_prefetch(void)
+{
+    FIL *fp;
+    uint32_t skipped;
+    uint32_t want;
+    UINT bytes_read;
+    uint16_t idx;
+
+    if (!playlist_active || next_opened || next_failed) {
+        return;
+    }
+    next_failed = true;     /* 以下任何一步失败, 本曲目都不再重试 */
+
+    if (!audio_next_index(g_audio_player.current_index, &idx)) {
+        return;
+    }
+
+    if (fs_open_file(g_file_list.files[idx].path, FA_READ, &next_fp) != FS_STATUS_OK) {
+        return;
+    }
+    fp = next_fp;
+
+    if (audio_skip_id3(fp, &skipped) != FR_OK) {
+        fs_close_file(&next_fp);
+        return;
+    }
+
+    /* 读到扇区边界为止, 之后的f_read都是整扇区 */
+    next_data_start = skipped;
+    next_head_off = (uint32_t)(f_tell(fp) % AUDIO_RINGBUF_SECTOR);
+    want = AUDIO_RINGBUF_SECTOR - next_head_off;
+    if (f_read(fp, next_head, want, &bytes_read) != FR_OK) {
+        fs_close_file(&next_fp);
+        return;
+    }
+
+    next_head_len = bytes_read;
+    next_eof = (bytes_read < want);
+    next_frame_hdr = audio_mp3_frame_header(next_head, next_head_len);
+    audio_track_info(fp, skipped, next_head, next_head_len, &next_track);
+    next_index = idx;
+    next_opened = true;
+    next_failed = false;
+}
+
+/**
+ * @brief       下一曲目能否直接接在当前曲目后面送 (同为MP3且版本/层/采样率相同)
+ * @param       无
+ * @retval      true: 可以
+ */
+static bool audio_next_gapless(void)
+{
+    return next_opened && cur_frame_hdr != 0 && cur_frame_hdr == next_frame_hdr;
+}
+
+/**
+ * @brief       把下一曲目接到环形缓冲区中当前曲目数据之后, 不取消也不复位解码器
+ * @note        先补若干个0让环形缓冲区位置与文件位置对扇区同余(解码器会跳过帧之间的0),
+ *              之后仍然是整扇区f_read
+ * @param       无
+ * @retval      true: 已衔接, false: 缓冲区空间不够, 稍后再试
+ */
+static bool audio_next_append(void)
+{
+    uint32_t pad = (next_head_off - audio_ring.head) % AUDIO_RINGBUF_SECTOR;
+
+    if (audio_ringbuf_space(&audio_ring) < pad + next_head_len) {
+        return false;
+    }
+
+    track_end = audio_ring.head;
+    audio_ring_put(NULL, pad);
+    track_start = audio_ring.head;
+    audio_eq_open();
+    audio_eq_process(next_data_start, next_head, next_head_len);
+    audio_ring_put(next_head, next_head_len);
+
+    /* 切换到下一曲目的文件继续读 */
+    fs_close_file(&audio_fp);
+    audio_fp = next_fp;
+    next_fp = NULL;
+    clmt_tried = false;
+    direct_sector = 0;
+    data_start = next_data_start;
+    file_eof = next_eof;
+    cur_frame_hdr = next_frame_hdr;
+    cur_track = next_track;
+    next_opened = false;
+
+    transition.last_pad = (uint16_t)pad;
+    audio_ring.min_fill = audio_ringbuf_fill(&audio_ring);  /* 统计衔接期间的最低水位 */
+    track_end_seen = false;
+    boundary_pending = true;
+
+    vs1053_feeder_notify();
+    return true;
+}
+
+/**
+ * @brief       更新当前曲目 (索引/文件名/显示/解码时间)
+ * @param       idx: g_file_list中的索引
+ * @retval      无
+ */
+static void audio_track_changed(uint16_t idx)
+{
+    char song_info[60];
+
+    g_audio_player.current_index = idx;
+    strncpy(g_audio_player.current_file, g_file_list.files[idx].path, sizeof(g_audio_player.current_file) - 1);
+    g_audio_player.current_file[sizeof(g_audio_player.current_file) - 1] = '\0';
+    g_audio_player.play_time = 0;
+    g_audio_player.total_time = 0;      /* 开始送数或衔接完成时填写 */
+
+    snprintf(song_info, sizeof(song_info), "Playing: %.40s", g_file_list.files[idx].name);
+    lcd_fill(10, 320, 310, 336, WHITE);
+    lcd_show_string(10, 320, 300, 16, 12, song_info, BLACK);
+}
+
+/**
+ * @brief       检查已衔接的下一曲目是否开始送出, 是则记录间隙并切换当前曲目
+ * @param       无
+ * @retval      无
+ */
+static void audio_next_boundary(void)
+{
+    uint32_t now;
+    uint32_t tail = audio_ring.tail;
+
+    if (!boundary_pending) {
+        return;
+    }
+
+    now = perf_counter_now();
+    if (!track_end_seen && (int32_t)(tail - track_end) >= 0) {
+        track_end_seen = true;
+        track_end_time = now;
+    }
+
+    if (!track_end_seen || (int32_t)(tail - track_start) <= 0) {
+        return;
+    }
+
+    /* 下一曲目的第一批数据已送出 */
+    boundary_pending = false;
+    transition.gapless++;
+    transition.last_gap_us = perf_cycles_to_us(now - track_end_time);
+    transition.last_underrun = (audio_ring.min_fill == 0);
+
+    audio_track_changed(next_index);
+    g_audio_player.total_time = cur_track.duration_ms / 1000;
+    audio_index_request();
+
+    /* 解码时间从新曲目开始计, 排队写入不等DREQ */
+    vs1053_sci_post_write(SPI_DECODE_TIME, 0x0000);
+    vs1053_sci_post_write(SPI_DECODE_TIME, 0x0000);
+    decode_time_sec = 0;
+}
+
+/* ============================================================================
+ * 快速定位
+ * ============================================================================ */
+
+/**
+ * @brief       为当前曲目建立簇链表(CLMT), 之后f_lseek/f_read不再沿FAT链查找
+ * @note        只需遍历一次FAT链; 碎片超过表长时退回普通定位.
+ *              表中只有一段时文件是连续存放的, 之后预读直接按扇区读卡
+ * @param       无
+ * @retval      无
+ */
+static void audio_build_clmt(void)
+{
+    DWORD *tbl = audio_clmt;
+    FATFS *fs;
+
+    if (clmt_tried || !file_opened) {
+        return;
+    }
+    clmt_tried = true;
+    fs = audio_fp->fs;
+
+    tbl[0] = AUDIO_CLMT_SIZE;
+    audio_fp->cltbl = tbl;
+    if (f_lseek(audio_fp, CREATE_LINKMAP) != FR_OK) {
+        audio_fp->cltbl = NULL;     /* 表不够长(碎片太多), 不能使用不完整的表 */
+    } else if (tbl[0] == 4) {
+        /* 表长 + 一段(簇数, 起始簇) + 结束标志 */
+        direct_sector = fs->database + (tbl[2] - 2) * fs->csize;
+    }
+}
+
+/* ============================================================================
+ * 播放引擎
+ * ============================================================================ */
+
+/**
+ * @brief       切换引擎状态
+ * @param       state: 新状态
+ * @retval      无
+ */
+static void audio_engine_enter(AudioState_t state)
+{
+    g_audio_player.state = state;
+}
+
+/**
+ * @brief       停止解码并关闭文件, 回到空闲状态
+ * @param       无
+ * @retval      无
+ */
+static void audio_engine_close(void)
+{
+    vs1053_play_stop();             /* 同时停止送数器并解除环形缓冲区 */
+    
+    if (file_opened) {
+        fs_close_file(&audio_fp);
+        file_opened = false;
+    }
+    audio_next_discard();
+    
+    open_pending = false;
+    switch_timing = false;
+    advance_timing = false;
+    g_audio_player.playing = false;
+    g_audio_player.paused = false;
+    g_audio_player.play_time = 0;
+    g_audio_player.total_time = 0;
+    audio_engine_enter(AUDIO_STATE_IDLE);
+}
+
+/**
+ * @brief       跳到文件指定位置继续播放
+ * @note        已经送入VS1053的数据照常播放完; MP3从新位置后第一个完整的帧开始送,
+ *              解码器按帧头重新同步, 不需要取消或复位
+ * @param       offset: 文件偏移
+ * @param       sec: 该位置对应的播放时间(秒)
+ * @retval      FR_OK: 成功, 其他: FatFs错误
+ */
+static FRESULT audio_engine_seek(uint32_t offset, uint32_t sec)
+{
+    FRESULT res;
+    int32_t pos;
+    uint32_t len;
+    const uint8_t *buf;
+    uint32_t t0 = perf_counter_now();
+
+#if VS1053_FEED_USE_DMA
+    vs1053_feeder_attach(NULL);     /* 停止从缓冲区取数, 之后缓冲区由这里重新填充 */
+#endif
+
+    audio_build_clmt();
+
+    res = f_lseek(audio_fp, offset);
+    if (res == FR_OK) {
+        res = audio_ringbuf_start();
+    }
+    if (res == FR_OK) {
+        res = audio_fill_ringbuf(1);
+    }
+    if (res != FR_OK) {
+        return res;
+    }
+
+    /* MP3跳过新位置前面的半帧; 其他格式由调用者对齐, PCM里像帧头的数据不能丢 */
+    if (cur_frame_hdr != 0) {
+        buf = audio_ringbuf_read_ptr(&audio_ring, &len);
+        pos = mp3_frame_find(buf, len, NULL);
+        if (pos > 0) {
+            audio_ringbuf_consume(&audio_ring, (uint32_t)pos);
+        }
+    }
+
+    /* 解码时间改为新位置, 排队写入 */
+    vs1053_sci_post_write(SPI_DECODE_TIME, (uint16_t)sec);
+    vs1053_sci_post_write(SPI_DECODE_TIME, (uint16_t)sec);
+    decode_time_sec = (uint16_t)sec;
+    g_audio_player.play_time = sec;
+
+    audio_engine_enter(AUDIO_STATE_PLAYING);    /* 从DRAINING往回跳时继续读文件 */
+#if VS1053_FEED_USE_DMA
+    vs1053_feeder_attach(&audio_ring);
+#endif
+
+    seek_cycles = perf_counter_now() - t0;
+    audio_telemetry_hist(TELEM_HIST_SEEK, seek_cycles);
+    return FR_OK;
+}
+
+/**
+ * @brief       OPENING: 打开文件, 跳过ID3标签, 复位解码器
+ * @param       无
+ * @retval      true: 成功, false: 失败
+ */
+static bool audio_engine_open(void)
+{
+    FRESULT res;
+    FS_Status_t status;
+    bool prefetched = next_opened;
+    
+    next_failed = false;
+    clmt_tried = false;
+    direct_sector = 0;
+    
+    if (prefetched) {
+        /* 下一曲目已在上一首播放时打开并跳过ID3 */
+        if (file_opened) {
+            fs_close_file(&audio_fp);
+        }
+        audio_fp = next_fp;
+        next_fp = NULL;
+        next_opened = false;
+        file_opened = true;
+        data_start = next_data_start;
+    } else {
+        /* 打开文件 */
+        if (file_opened) {
+            fs_close_file(&audio_fp);
+            file_opened = false;
+        }
+        status = fs_open_file(g_audio_player.current_file, FA_READ, &audio_fp);
+        if (status != FS_STATUS_OK) {
+            char error_msg[60];
+            snprintf(error_msg, sizeof(error_msg), "File open failed! %s", fs_get_status_string(status));
+            lcd_show_string(10, 220, 300, 16, 12, error_msg, RED);
+            return false;
+        }
+        
+        file_opened = true;
+        
+        /* 跳过ID3标签 - 查找真正的MP3音频数据 */
+        uint32_t tag_size;
+        res = audio_skip_id3(audio_fp, &tag_size);
+        if (res != FR_OK) {
+            return false;
+        }
+        data_start = tag_size;
+    }
+    audio_bench_mark(AUDIO_PHASE_OPEN);
+    
+    /* 上电复位或取消流程结束后解码器是空闲的, 只有可能还在解码时才需要取消 */
+    if (!vs1053_decoder_idle()) {
+        vs1053_restart_play();          /* 重启播放 */
+    }
+    
+    if (decoder_ready) {
+        /* 上一首已按取消流程结束, 设置未变, 直接送新文件 */
+        decoder_ready = false;
+    } else {
+        vs1053_set_all();               /* 设置音量等信息(影子中未变的寄存器不重写), 同时开启板载喇叭 */
+    }
+    decode_time_sec = 0;                /* SPI_DECODE_TIME在vs1053_play_start中清零 */
+    
+    /* 开始播放 */
+    if (!vs1053_play_start()) {
+        lcd_show_string(10, 260, 300, 16, 12, "VS1053 start failed!", RED);
+        return false;
+    }
+    audio_bench_mark(AUDIO_PHASE_DECODER);
+    
+    audio_eq_open();                    /* WAV均衡器等待RIFF头 */
+    
+    if (prefetched) {
+        /* 预读的第一个扇区剩余部分直接放进缓冲区 */
+        audio_ringbuf_init(&audio_ring, audio_buffer, sizeof(audio_buffer));
+        audio_ringbuf_reset_at(&audio_ring, next_head_off);
+        audio_eq_process(data_start, next_head, next_head_len);
+        audio_ring_put(next_head, next_head_len);
+        file_eof = next_eof;
+        return true;
+    }
+    
+    return audio_ringbuf_start() == FR_OK;
+}
+
+/**
+ * @brief       预读完成, 开始送数
+ * @param       无
+ * @retval      无
+ */
+static void audio_engine_start_feed(void)
+{
+    uint32_t len;
+    const uint8_t *buf = audio_ringbuf_read_ptr(&audio_ring, &len);
+    uint32_t cycles;
+    
+    audio_bench_mark(AUDIO_PHASE_PREBUFFER);
+    
+    vs1053_feeder_reset_stats();
+#if VS1053_FEED_USE_DMA
+    vs1053_feeder_attach(&audio_ring);
+#endif
+    audio_bench_mark(AUDIO_PHASE_FEED);
+    
+    /* 以下在开始送数之后进行, 不计入起播时间 */
+    audio_telemetry_track(buf, len);
+    
+    /* 记下帧头, 用于判断下一曲目能否无缝衔接 */
+    cur_frame_hdr = audio_mp3_frame_header(buf, (len > AUDIO_RINGBUF_SECTOR) ? AUDIO_RINGBUF_SECTOR : len);
+    
+    /* 第一帧的VBR信息头: 时长和定位用的TOC */
+    audio_track_info(audio_fp, data_start, buf, len, &cur_track);
+    g_audio_player.total_time = cur_track.duration_ms / 1000;
+    audio_index_request();
+    
+    lcd_show_string(10, 260, 300, 16, 12, "Playing...", GREEN);
+    
+    if (switch_timing) {
+        /* 换曲耗时: 请求 -> 解码器空闲 -> 新文件第一次送数 */
+        switch_timing = false;
+        switch_total_cycles = perf_counter_now() - switch_start;
+        audio_telemetry_hist(TELEM_HIST_SWITCH, switch_total_cycles);
+    }
+    
+    if (advance_timing) {
+        /* 自动切换但格式不同, 走了取消流程: 上一首送完 -> 这一首开始送 */
+        advance_timing = false;
+        cycles = perf_counter_now() - track_end_time;
+        audio_telemetry_hist(TELEM_HIST_SWITCH, cycles);
+        transition.cancelled++;
+        transition.last_gap_us = perf_cycles_to_us(cycles);
+        transition.last_pad = 0;
+        transition.last_underrun = false;
+    }
+}
+
+/**
+ * @brief       轮询送数 (VS1053_FEED_USE_DMA=0时), 送到VS1053忙碌或缓冲区空为止
+ * @param       无
+ * @retval      无
+ */
+static void audio_engine_feed(void)
+{
+#if !VS1053_FEED_USE_DMA
+    uint8_t n;
+    
+    for (n = 0; n < AUDIO_TASK_POLL_BURSTS; n++) {
+        uint32_t fill = audio_ringbuf_fill(&audio_ring);
+        
+        if (fill == 0 || (fill < 32 && !file_eof)) {
+            break;
+        }
+        if (audio_feed_polled() != 0) {
+            break;  /* VS1053忙碌 */
+        }
+    }
+#endif
+}
+
+/**
+ * @brief       SPI_DECODE_TIME排队读取完成回调 (送数器中断中执行)
+ * @param       addr: 寄存器地址
+ * @param       value: 寄存器值
+ * @retval      无
+ */
+static void audio_decode_time_cb(uint8_t addr, uint16_t value)
+{
+    (void)addr;
+    decode_time_sec = value;
+}
+
+/**
+ * @brief       显示播放时间 (缓冲区/送数/任务耗时等调试信息见audio_telemetry)
+ * @param       无
+ * @retval      无
+ */
+static void audio_engine_show_status(void)
+{
+    static uint32_t last_update = 0;
+    static uint32_t last_decode_time = 0;
+    uint32_t current_tick = HAL_GetTick();
+    uint32_t play_time;
+    char str[80];
+    
+    if (current_tick - last_update < AUDIO_STATUS_INTERVAL_MS) {
+        return;
+    }
+    last_update = current_tick;
+    
+    /* 显示上一次读到的解码时间, 同时排队读下一次, 不在这里等DREQ */
+    play_time = decode_time_sec;
+    vs1053_sci_post_read(SPI_DECODE_TIME, audio_decode_time_cb);
+    
+    /* 检查解码时间是否在增加 */
+    if (play_time != last_decode_time || g_audio_player.paused) {
+        sprintf(str, "Time: %02d:%02d/%02d:%02d (DECODING OK!) ", play_time / 60, play_time % 60,
+                g_audio_player.total_time / 60, g_audio_player.total_time % 60);
+        lcd_show_string(10, 480, 300, 16, 12, str, GREEN);
+        last_decode_time = play_time;
+    } else {
+        sprintf(str, "Time: %02d:%02d/%02d:%02d (NOT DECODING!)", play_time / 60, play_time % 60,
+                g_audio_player.total_time / 60, g_audio_player.total_time % 60);
+        lcd_show_string(10, 480, 300, 16, 12, str, RED);
+    }
+    g_audio_player.play_time = play_time;
+}
+
+/**
+ * @brief       PLAYING中处理曲目衔接: 检查衔接点, 读到文件尾时预读并衔接下一曲目
+ * @param       无
+ * @retval      无
+ */
+static void audio_engine_next_step(void)
+{
+    audio_next_boundary();
+    
+    if (!file_eof || boundary_pending) {
+        return;
+    }
+    
+    audio_next_prefetch();
+    
+    if (!audio_next_gapless()) {
+        audio_engine_enter(AUDIO_STATE_DRAINING);   /* 没有下一首或格式不同 */
+    } else {
+        audio_next_append();                        /* 空间不够时下次再试 */
+    }
+}
+
+/**
+ * @brief       推进一次播放引擎, 每个状态只做有限的工作
+ * @param       无
+ * @retval      无
+ */
+static void audio_engine_step(void)
+{
+    FRESULT res;
+    
+    switch (g_audio_player.state) {
+        case AUDIO_STATE_IDLE:
+            break;
+        
+        case AUDIO_STATE_OPENING:
+            if (audio_engine_open()) {
+                audio_engine_enter(AUDIO_STATE_PREBUFFERING);
+            } else {
+                engine_result = 0xFF;
+                audio_engine_enter(AUDIO_STATE_STOPPING);
+            }
+            break;
+        
+        case AUDIO_STATE_PREBUFFERING:
+            /* 每次读一块, 直到高水位或文件尾 */
+            res = audio_fill_ringbuf(1);
+            if (res != FR_OK) {
+                engine_result = 0xFF;
+                audio_engine_enter(AUDIO_STATE_STOPPING);
+                break;
+            }
+            
+            if (file_eof || audio_ringbuf_fill(&audio_ring) >= audio_ring.high_mark) {
+                if (audio_ringbuf_fill(&audio_ring) == 0) {
+                    lcd_show_string(10, 360, 300, 16, 12, "Empty file!", RED);
+                    engine_result = 0xFF;
+                    audio_engine_enter(AUDIO_STATE_STOPPING);
+                    break;
+                }
+                audio_engine_start_feed();
+                audio_engine_enter(AUDIO_STATE_PLAYING);    /* 文件尾在PLAYING中处理 */
+            }
+            break;
+        
+        case AUDIO_STATE_PLAYING:
+            /* 按水位补充数据, 一次最多读一块 */
+            res = audio_fill_ringbuf(1);
+            if (res != FR_OK) {
+                char end_str[60];
+                sprintf(end_str, "Read error: res=%d", (int)res);
+                lcd_show_string(10, 360, 300, 16, 12, end_str, RED);
+                engine_result = 0xFF;
+                audio_engine_enter(AUDIO_STATE_STOPPING);
+                break;
+            }
+            
+            if (!g_audio_player.paused) {
+                audio_engine_feed();
+            }
+            audio_telemetry_fill(audio_ringbuf_fill(&audio_ring), !file_eof && !g_audio_player.paused);
+            if (!clmt_tried && !audio_ring.filling) {
+                audio_build_clmt();     /* 缓冲区充足时再遍历FAT链, 不影响起播 */
+            }
+            audio_engine_next_step();
+            audio_bench_poll();
+            audio_engine_show_status();
+            break;
+        
+        case AUDIO_STATE_DRAINING:
+            /* 文件已读完, 等缓冲区送空 */
+            if (!g_audio_player.paused) {
+                audio_engine_feed();
+            }
+            audio_engine_show_status();
+            
+            if (audio_ringbuf_fill(&audio_ring) == 0 && vs1053_feeder_idle()) {
+                if (next_opened) {
+                    /* 下一曲目格式不同, 结束当前解码后打开预读好的文件 */
+                    track_end_time = perf_counter_now();
+                    advance_timing = true;
+                    open_pending = true;
+                    audio_track_changed(next_index);
+                } else {
+                    engine_result = 1;
+                }
+                vs1053_cancel_begin(true);      /* 送endFillByte让最后一帧解完, 再取消 */
+                audio_engine_enter(AUDIO_STATE_CANCELLING);
+            }
+            break;
+        
+        case AUDIO_STATE_CANCELLING:
+            /* 填充数据由送数器中断送出, 这里只检查进度 */
+            if (vs1053_cancel_poll() != VS1053_CANCEL_DONE) {
+                break;
+            }
+            
+            decoder_ready = true;
+            if (switch_timing) {
+                switch_cancel_cycles = perf_counter_now() - switch_start;
+            }
+            
+            if (open_pending) {
+                open_pending = false;
+                audio_engine_enter(AUDIO_STATE_OPENING);
+            } else {
+                audio_engine_enter(AUDIO_STATE_STOPPING);
+            }
+            break;
+        
+        case AUDIO_STATE_STOPPING:
+            audio_engine_close();
+            if (engine_result == 1) {
+                lcd_show_string(10, 360, 300, 16, 12, "Playback finished", BLUE);
+            }
+            break;
+    }
+}
 
 /* ============================================================================
  * 初始化和配置函数
@@ -37,6 +1155,9 @@ bool audio_player_init(void)
     /* 应用默认音量 */
     audio_player_set_volume(g_audio_player.volume);
     
+    /* WAV均衡器 */
+    audio_eq_init();
+    
     return true;
 }
 
@@ -61,133 +1182,61 @@ bool audio_player_is_ready(void)
     return g_audio_player.initialized && (vs1053_get_state() != VS1053_STATE_ERROR);
 }
 
+
 /* ============================================================================
  * 播放控制函数
  * ============================================================================ */
 
 /**
- * @brief       播放指定文件
+ * @brief       播放指定文件 (非阻塞)
+ * @note        只提交播放请求, 打开文件/预读/送数都由audio_player_task分步完成,
+ *              打开失败等错误在任务中显示, 状态回到AUDIO_STATE_IDLE
  * @param       filename: 文件名
- * @retval      true: 开始播放, false: 失败
+ * @retval      true: 已开始, false: 播放器未就绪或文件名无效
  */
 bool audio_player_play_file(const char* filename)
 {
-    FRESULT res;
+    AudioState_t state = g_audio_player.state;
     
-    if (!audio_player_is_ready()) {
+    if (!audio_player_is_ready() || filename == NULL || filename[0] == '\0') {
         return false;
     }
     
-    /* 停止当前播放 */
-    audio_player_stop();
-    
-    /* 显示尝试打开的文件路径 */
-    char path_debug[80];
-    snprintf(path_debug, sizeof(path_debug), "Opening: %.50s", filename);
-    lcd_show_string(10, 200, 300, 16, 12, path_debug, BLUE);
+    audio_next_discard();
+    playlist_active = false;        /* 按列表播放时由调用者重新置位 */
+    advance_timing = false;
     
-    /* 打开文件 */
-    res = f_open(&audio_file, filename, FA_READ);
-    if (res != FR_OK) {
-        char error_msg[60];
-        snprintf(error_msg, sizeof(error_msg), "File open failed! Error: %d", (int)res);
-        lcd_show_string(10, 220, 300, 16, 12, error_msg, RED);
-        
-        /* 显示具体的FatFS错误信息 */
-        const char* error_desc = "Unknown";
-        switch(res) {
-            case FR_NO_FILE: error_desc = "No file"; break;
-            case FR_NO_PATH: error_desc = "No path"; break;
-            case FR_INVALID_NAME: error_desc = "Invalid name"; break;
-            case FR_DENIED: error_desc = "Access denied"; break;
-            case FR_NOT_READY: error_desc = "Not ready"; break;
-            case FR_WRITE_PROTECTED: error_desc = "Write protected"; break;
-            case FR_DISK_ERR: error_desc = "Disk error"; break;
-            case FR_INT_ERR: error_desc = "Internal error"; break;
-            case FR_NOT_ENABLED: error_desc = "Not enabled"; break;
-            case FR_NO_FILESYSTEM: error_desc = "No filesystem"; break;
+    if (state == AUDIO_STATE_PLAYING || state == AUDIO_STATE_DRAINING || state == AUDIO_STATE_CANCELLING) {
+        /* 正在送数: 按SM_CANCEL流程结束当前解码, 不复位芯片, 结束后再打开新文件 */
+        if (file_opened) {
+            fs_close_file(&audio_fp);
+            file_opened = false;
         }
-        
-        char detailed_error[80];
-        snprintf(detailed_error, sizeof(detailed_error), "FatFS: %.30s", error_desc);
-        lcd_show_string(10, 240, 300, 16, 12, detailed_error, RED);
-        
-        return false;
-    }
-    
-    file_opened = true;
-    
-    /* 跳过ID3标签 - 查找真正的MP3音频数据 */
-    uint8_t header[10];
-    UINT bytes_read_header;
-    res = f_read(&audio_file, header, 10, &bytes_read_header);
-    
-    if (res == FR_OK && bytes_read_header == 10) {
-        /* 检查是否为ID3v2标签 */
-        if (header[0] == 'I' && header[1] == 'D' && header[2] == '3') {
-            /* ID3v2标签，计算标签大小并跳过 */
-            uint32_t tag_size = ((uint32_t)header[6] << 21) | 
-                               ((uint32_t)header[7] << 14) | 
-                               ((uint32_t)header[8] << 7) | 
-                               ((uint32_t)header[9]);
-            
-            /* 跳过ID3标签 */
-            f_lseek(&audio_file, tag_size + 10);
-            
-            char debug_str[60];
-            sprintf(debug_str, "Skipped ID3 tag: %lu bytes", tag_size + 10);
-            lcd_show_string(10, 260, 300, 16, 12, debug_str, YELLOW);
-        } else {
-            /* 不是ID3标签，回到文件开头 */
-            f_lseek(&audio_file, 0);
+        if (!switch_timing) {
+            switch_start = perf_counter_now();
+            switch_timing = true;
         }
+        if (state != AUDIO_STATE_CANCELLING) {
+            vs1053_play_resume();
+            vs1053_cancel_begin(false);     /* 同时解除暂停 */
+        }
+        open_pending = true;
+    } else {
+        /* 还没开始送数, 直接停止 */
+        audio_player_stop();
     }
     
     /* 更新播放器状态 */
-    strncpy(g_audio_player.current_file, filename, sizeof(g_audio_player.current_file) - 1);
-    g_audio_player.current_file[sizeof(g_audio_player.current_file) - 1] = '\0';
+    if (filename != g_audio_player.current_file) {
+        strncpy(g_audio_player.current_file, filename, sizeof(g_audio_player.current_file) - 1);
+        g_audio_player.current_file[sizeof(g_audio_player.current_file) - 1] = '\0';
+    }
     g_audio_player.playing = true;
     g_audio_player.paused = false;
     g_audio_player.play_time = 0;
     
-    /* 设置音量 - VS1053音量寄存器：0x00最大，0xFE最小 */
-    vs1053_set_volume(80);  /* 设置较大音量 (80/100) */
-    
-    /* 设置高速SPI模式 */
-    vs1053_port_speed_high();
-    
-    /* 开始播放 */
-    if (!vs1053_play_start()) {
-        f_close(&audio_file);
-        file_opened = false;
-        g_audio_player.playing = false;
-        lcd_show_string(10, 180, 300, 16, 12, "VS1053 start failed!", RED);
-        return false;
-    }
-    
-    /* 显示播放信息和VS1053状态 */
-    char info_str[100];
-    sprintf(info_str, "Playing: %.30s", filename);
-    lcd_show_string(10, 180, 300, 16, 12, info_str, GREEN);
-    
-    /* 显示VS1053寄存器状态 */
-    uint16_t mode_reg = vs1053_read_cmd(SPI_MODE);
-    uint16_t status_reg = vs1053_read_cmd(SPI_STATUS);
-    uint16_t vol_reg = vs1053_read_cmd(SPI_VOL);
-    
-    char reg_str[80];
-    sprintf(reg_str, "MODE:0x%04X STATUS:0x%04X", mode_reg, status_reg);
-    lcd_show_string(10, 200, 300, 16, 12, reg_str, MAGENTA);
-    
-    char vol_str[60];
-    sprintf(vol_str, "VOL:0x%04X (L:%d R:%d)", vol_reg, (vol_reg >> 8) & 0xFF, vol_reg & 0xFF);
-    lcd_show_string(10, 220, 300, 16, 12, vol_str, CYAN);
-    
-    /* 显示AUDATA寄存器（音频信息） */
-    uint16_t audata_reg = vs1053_read_cmd(SPI_AUDATA);
-    char audata_str[60];
-    sprintf(audata_str, "AUDATA:0x%04X (SR:%dHz)", audata_reg, audata_reg & 0xFFFE);
-    lcd_show_string(10, 240, 300, 16, 12, audata_str, YELLOW);
+    engine_result = 0;
+    audio_engine_enter(open_pending ? AUDIO_STATE_CANCELLING : AUDIO_STATE_OPENING);
     
     return true;
 }
@@ -212,7 +1261,9 @@ bool audio_player_play_current(void)
  */
 void audio_player_pause(void)
 {
-    if (g_audio_player.playing && !g_audio_player.paused) {
+    if (g_audio_player.playing && !g_audio_player.paused &&
+        g_audio_player.state != AUDIO_STATE_CANCELLING) {
+        vs1053_feeder_pause(true);  /* 暂停送数, 缓冲区数据保留 */
         vs1053_play_pause();
         g_audio_player.paused = true;
         lcd_show_string(10, 200, 300, 16, 12, "Paused", YELLOW);
@@ -228,34 +1279,97 @@ void audio_player_resume(void)
 {
     if (g_audio_player.playing && g_audio_player.paused) {
         vs1053_play_resume();
+        vs1053_feeder_pause(false);
         g_audio_player.paused = false;
         lcd_show_string(10, 200, 300, 16, 12, "Playing", GREEN);
     }
 }
 
 /**
- * @brief       停止播放
+ * @brief       停止播放 (立即生效)
  * @param       无
  * @retval      无
  */
 void audio_player_stop(void)
 {
-    if (g_audio_player.playing) {
-        vs1053_play_stop();
-        
-        if (file_opened) {
-            f_close(&audio_file);
-            file_opened = false;
-        }
-        
-        g_audio_player.playing = false;
-        g_audio_player.paused = false;
-        g_audio_player.play_time = 0;
-        
+    if (g_audio_player.state != AUDIO_STATE_IDLE) {
+        audio_engine_close();
         lcd_show_string(10, 200, 300, 16, 12, "Stopped", RED);
     }
 }
 
+/**
+ * @brief       跳到指定时间播放
+ * @note        有TOC(Xing/VBRI)时按TOC查表; 其次用空闲时建立的定位索引(精确到帧,
+ *              时间按索引间隔取整); 都没有时按VS1053统计的平均字节率(参数byteRate)
+ *              换算为字节偏移, VBR文件会有偏差
+ * @param       seconds: 从曲目开头算起的秒数
+ * @retval      true: 成功, false: 不在播放/字节率未知/超出文件长度
+ */
+bool audio_player_seek(uint32_t seconds)
+{
+    AudioState_t state = g_audio_player.state;
+    uint32_t byte_rate;
+    uint32_t offset;
+    uint32_t wav_start;
+    uint16_t wav_align;
+    
+    if ((state != AUDIO_STATE_PLAYING && state != AUDIO_STATE_DRAINING) ||
+        !file_opened || boundary_pending) {
+        return false;   /* 正在衔接下一曲目时文件已经切换, 不定位 */
+    }
+    
+    if (cur_track.vbr.has_toc && cur_track.duration_ms != 0) {
+        if (seconds * 1000U >= cur_track.duration_ms) {
+            return false;
+        }
+        offset = cur_track.start + mp3_vbr_seek_offset(&cur_track.vbr, seconds * 1000U, cur_track.duration_ms);
+    } else if (seek_index_lookup(g_audio_player.current_file, f_size(audio_fp), seconds, &offset, &seconds)) {
+        /* 索引中的帧起点 */
+    } else {
+        byte_rate = vs1053_read_ram(VS1053_PARA_BYTE_RATE);
+        if (byte_rate == 0) {
+            return false;   /* 解码器还没有统计出字节率 */
+        }
+        offset = data_start + seconds * byte_rate;
+        if (audio_eq_wav_layout(&wav_start, &wav_align)) {
+            /* WAV落在data块内的采样帧(ADPCM块)起点上 */
+            offset = (offset > wav_start) ? offset - (offset - wav_start) % wav_align : wav_start;
+        }
+    }
+    
+    if (offset >= f_size(audio_fp)) {
+        return false;
+    }
+    
+    /* 预读的下一曲目作废, 再次读到文件尾时重新预读 */
+    audio_next_discard();
+    next_failed = false;
+    
+    if (audio_engine_seek(offset, seconds) != FR_OK) {
+        engine_result = 0xFF;
+        audio_engine_enter(AUDIO_STATE_STOPPING);
+        return false;
+    }
+    
+    return true;
+}
+
+/**
+ * @brief       相对当前位置快进/快退
+ * @param       seconds: 正数快进, 负数快退
+ * @retval      true: 成功, false: 失败
+ */
+bool audio_player_skip(int32_t seconds)
+{
+    int32_t target = (int32_t)decode_time_sec + seconds;
+    
+    if (target < 0) {
+        target = 0;
+    }
+    return audio_player_seek((uint32_t)target);
+}
+
 /* ============================================================================
  * 音量控制函数
  * ============================================================================ */
@@ -314,6 +1428,7 @@ void audio_player_volume_down(void)
     audio_player_set_volume(new_volume);
 }
 
+
 /* ============================================================================
  * 状态查询函数
  * ============================================================================ */
@@ -338,19 +1453,53 @@ bool audio_player_is_paused(void)
     return g_audio_player.paused;
 }
 
+/**
+ * @brief       播放器是否需要读卡 (其他模块此时不要占用SD卡)
+ * @note        打开/预读/取消阶段, 以及播放中缓冲区低于低水位或需要预读下一曲目时
+ * @param       无
+ * @retval      true: 需要读卡
+ */
+bool audio_player_io_busy(void)
+{
+    switch (g_audio_player.state) {
+        case AUDIO_STATE_OPENING:
+        case AUDIO_STATE_PREBUFFERING:
+        case AUDIO_STATE_CANCELLING:
+            return true;
+        
+        case AUDIO_STATE_PLAYING:
+            return audio_ring.filling || (file_eof && playlist_active && !next_opened && !next_failed);
+        
+        default:
+            return false;
+    }
+}
+
 /**
  * @brief       获取播放时间
+ * @note        返回播放器排队读取的SPI_DECODE_TIME, 不访问总线
  * @param       无
  * @retval      播放时间(秒)
  */
 uint32_t audio_player_get_play_time(void)
 {
     if (g_audio_player.playing) {
-        return vs1053_get_decode_time();
+        return decode_time_sec;
     }
     return 0;
 }
 
+/**
+ * @brief       获取曲目时长
+ * @note        由第一帧的Xing/Info/VBRI头计算, 没有时按第一帧码率估算
+ * @param       无
+ * @retval      秒, 0表示未知
+ */
+uint32_t audio_player_get_duration(void)
+{
+    return g_audio_player.total_time;
+}
+
 /**
  * @brief       获取当前播放文件名
  * @param       无
@@ -361,276 +1510,161 @@ const char* audio_player_get_current_file(void)
     return g_audio_player.current_file;
 }
 
+/**
+ * @brief       获取播放引擎状态
+ * @param       无
+ * @retval      当前状态
+ */
+AudioState_t audio_player_get_state(void)
+{
+    return g_audio_player.state;
+}
+
+/**
+ * @brief       获取audio_player_task单次调用的耗时统计
+ * @param       max_us: 输出, 最长一次耗时(微秒), 可为NULL
+ * @param       last_us: 输出, 最近一次耗时(微秒), 可为NULL
+ * @retval      无
+ */
+void audio_player_get_task_time(uint32_t *max_us, uint32_t *last_us)
+{
+    if (max_us != NULL) {
+        *max_us = perf_cycles_to_us(task_max_cycles);
+    }
+    if (last_us != NULL) {
+        *last_us = perf_cycles_to_us(task_last_cycles);
+    }
+}
+
+/**
+ * @brief       清零任务耗时统计
+ * @param       无
+ * @retval      无
+ */
+void audio_player_reset_task_time(void)
+{
+    task_max_cycles = 0;
+    task_last_cycles = 0;
+}
+
+/**
+ * @brief       获取曲目衔接统计
+ * @param       t: 输出
+ * @retval      无
+ */
+void audio_player_get_transition(AudioTransition_t *t)
+{
+    if (t != NULL) {
+        *t = transition;
+    }
+}
+
+/**
+ * @brief       开始一次起播耗时测试, 在按下播放键时调用
+ * @note        之后的audio_player_test_play/play_file各阶段依次打点,
+ *              解码器识别出流格式后在LCD上显示各阶段的累计耗时
+ * @param       无
+ * @retval      无
+ */
+void audio_player_bench_start(void)
+{
+    uint8_t i;
+    
+    for (i = 0; i < AUDIO_PHASE_COUNT; i++) {
+        bench_cycles[i] = 0;
+    }
+    bench_hdat_posted = false;
+    bench_start_cycles = perf_counter_now();
+    bench_armed = true;
+}
+
+/**
+ * @brief       获取起播测试中某阶段的累计耗时
+ * @param       phase: 阶段
+ * @retval      从按键到该阶段结束的微秒数, 0表示未到达
+ */
+uint32_t audio_player_bench_get(AudioPhase_t phase)
+{
+    if (phase >= AUDIO_PHASE_COUNT) {
+        return 0;
+    }
+    return perf_cycles_to_us(bench_cycles[phase]);
+}
+
+/**
+ * @brief       获取最近一次定位耗时
+ * @param       无
+ * @retval      微秒
+ */
+uint32_t audio_player_get_seek_time(void)
+{
+    return perf_cycles_to_us(seek_cycles);
+}
+
+/**
+ * @brief       获取最近一次换曲耗时
+ * @param       cancel_us: 输出, 换曲请求到解码器空闲(SM_CANCEL流程结束), 可为NULL
+ * @param       total_us: 输出, 换曲请求到新文件开始送数, 可为NULL
+ * @retval      无
+ */
+void audio_player_get_switch_time(uint32_t *cancel_us, uint32_t *total_us)
+{
+    if (cancel_us != NULL) {
+        *cancel_us = perf_cycles_to_us(switch_cancel_cycles);
+    }
+    if (total_us != NULL) {
+        *total_us = perf_cycles_to_us(switch_total_cycles);
+    }
+}
+
 /* ============================================================================
  * 播放任务函数
  * ============================================================================ */
 
 /**
- * @brief       播放指定的音乐文件 - 参考正点原子的实现方式
+ * @brief       播放指定的音乐文件, 阻塞直到播放结束 - 参考正点原子的实现方式
+ * @note        内部就是audio_player_play_file + 循环调用audio_player_task,
+ *              主循环中应直接使用非阻塞的audio_player_play_file
  * @param       filename: 文件路径
- * @retval      0: 播放完成, 其他: 按键码或错误
+ * @retval      1: 播放完成, 0: 被停止, 0xFF: 错误
  */
 uint8_t audio_player_play_song(const char* filename)
 {
-    UINT bytes_read;
-    FRESULT res;
-    uint8_t rval = 0;
-    uint16_t i = 0;
-    
-    if (!audio_player_is_ready()) {
-        return 0xFF;
-    }
-    
-    /* 停止当前播放 */
-    audio_player_stop();
-    
-    /* 显示尝试打开的文件路径 */
-    char path_debug[80];
-    snprintf(path_debug, sizeof(path_debug), "Opening: %.50s", filename);
-    lcd_show_string(10, 200, 300, 16, 12, path_debug, BLUE);
-    
-    /* 打开文件 */
-    res = f_open(&audio_file, filename, FA_READ);
-    if (res != FR_OK) {
-        char error_msg[60];
-        snprintf(error_msg, sizeof(error_msg), "File open failed! Error: %d", (int)res);
-        lcd_show_string(10, 220, 300, 16, 12, error_msg, RED);
-        return 0xFF;
-    }
-    
-    file_opened = true;
-    
-    /* 跳过ID3标签 - 查找真正的MP3音频数据 */
-    uint8_t header[10];
-    UINT bytes_read_header;
-    res = f_read(&audio_file, header, 10, &bytes_read_header);
-    
-    if (res == FR_OK && bytes_read_header == 10) {
-        /* 检查是否为ID3v2标签 */
-        if (header[0] == 'I' && header[1] == 'D' && header[2] == '3') {
-            /* ID3v2标签，计算标签大小并跳过 */
-            uint32_t tag_size = ((uint32_t)header[6] << 21) | 
-                               ((uint32_t)header[7] << 14) | 
-                               ((uint32_t)header[8] << 7) | 
-                               ((uint32_t)header[9]);
-            
-            /* 跳过ID3标签 */
-            f_lseek(&audio_file, tag_size + 10);
-            
-            char debug_str[60];
-            sprintf(debug_str, "Skipped ID3 tag: %lu bytes", tag_size + 10);
-            lcd_show_string(10, 240, 300, 16, 12, debug_str, YELLOW);
-        } else {
-            /* 不是ID3标签，回到文件开头 */
-            f_lseek(&audio_file, 0);
-        }
-    }
-    
-    /* 更新播放器状态 */
-    strncpy(g_audio_player.current_file, filename, sizeof(g_audio_player.current_file) - 1);
-    g_audio_player.current_file[sizeof(g_audio_player.current_file) - 1] = '\0';
-    g_audio_player.playing = true;
-    g_audio_player.paused = false;
-    g_audio_player.play_time = 0;
-    
-    /* 使用正点原子的初始化序列 */
-    vs1053_restart_play();          /* 重启播放 */
-    vs1053_set_all();               /* 设置音量等信息 */
-    vs1053_reset_decode_time();     /* 复位解码时间 */
-    vs1053_port_speed_high();       /* 高速SPI */
-    
-    /* 重要：重新启用板载喇叭 (因为restart_play可能重置了设置) */
-    vs1053_set_speaker(1);          /* 确保板载喇叭开启 */
-    
-    /* 开始播放 */
-    if (!vs1053_play_start()) {
-        f_close(&audio_file);
-        file_opened = false;
-        g_audio_player.playing = false;
-        lcd_show_string(10, 260, 300, 16, 12, "VS1053 start failed!", RED);
+    if (!audio_player_play_file(filename)) {
         return 0xFF;
     }
     
-    lcd_show_string(10, 260, 300, 16, 12, "Playing...", GREEN);
-    
-    /* 显示VS1053寄存器状态 - 调试信息 */
-    uint16_t mode_reg = vs1053_read_cmd(SPI_MODE);
-    uint16_t status_reg = vs1053_read_cmd(SPI_STATUS);
-    uint16_t vol_reg = vs1053_read_cmd(SPI_VOL);
-    char reg_str[80];
-    sprintf(reg_str, "M:0x%04X S:0x%04X V:0x%04X", mode_reg, status_reg, vol_reg);
-    lcd_show_string(10, 280, 300, 16, 12, reg_str, MAGENTA);
-    
-    /* 主播放循环 - 参考正点原子的方法 */
-    static uint32_t loop_count = 0;
-    while (rval == 0) {
-        res = f_read(&audio_file, audio_buffer, sizeof(audio_buffer), &bytes_read);
-        if (res != FR_OK || bytes_read == 0) {
-            /* 播放完成 */
-            char end_str[60];
-            sprintf(end_str, "End: res=%d bytes=%d loops=%lu", (int)res, (int)bytes_read, loop_count);
-            lcd_show_string(10, 360, 300, 16, 12, end_str, BLUE);
-            rval = 1;  /* 表示播放完成 */
-            break;
-        }
-        
-                 loop_count++;
-         
-         /* 检查第一块数据 */
-         if (loop_count == 1) {
-             char first_data[80];
-             sprintf(first_data, "1st: %02X %02X %02X %02X %02X %02X %02X %02X", 
-                    audio_buffer[0], audio_buffer[1], audio_buffer[2], audio_buffer[3],
-                    audio_buffer[4], audio_buffer[5], audio_buffer[6], audio_buffer[7]);
-             lcd_show_string(10, 400, 300, 16, 12, first_data, GREEN);
-             
-             /* 检查是否为MP3同步帧 */
-             if ((audio_buffer[0] == 0xFF) && ((audio_buffer[1] & 0xE0) == 0xE0)) {
-                 lcd_show_string(10, 420, 300, 16, 12, "MP3 frame found!", GREEN);
-             } else {
-                 lcd_show_string(10, 420, 300, 16, 12, "No MP3 frame!", RED);
-             }
-         }
-         
-         /* 每10次循环显示一次文件读取状态 */
-         if (loop_count % 10 == 0) {
-             char file_str[60];
-             sprintf(file_str, "Loop:%lu Read:%d bytes", loop_count, (int)bytes_read);
-             lcd_show_string(10, 380, 300, 16, 12, file_str, YELLOW);
-         }
-        
-        i = 0;
-        /* 发送数据循环 - 添加详细调试 */
-        static uint32_t total_sent = 0;
-        static uint32_t dreq_busy_count = 0;
-        
-        do {
-            /* 使用正点原子的方式发送数据 */
-            if (vs1053_send_music_data(audio_buffer + i) == 0) {
-                /* 发送成功，移动指针 */
-                i += 32;
-                total_sent += 32;
-                
-                /* 每发送1KB显示一次进度 */
-                if (total_sent % 1024 == 0) {
-                    char progress_str[60];
-                    sprintf(progress_str, "Sent: %luKB DREQ_busy: %lu", total_sent/1024, dreq_busy_count);
-                    lcd_show_string(10, 300, 300, 16, 12, progress_str, CYAN);
-                }
-            } else {
-                /* VS1053忙碌 - 正点原子方式处理 */
-                dreq_busy_count++;
-                
-                /* 这里可以处理按键，但我们先专注播放 */
-                HAL_Delay(1);  /* 短暂延时 */
-                
-                /* 如果DREQ长时间忙碌，显示警告 */
-                if (dreq_busy_count % 1000 == 0) {
-                    char dreq_str[60];
-                    sprintf(dreq_str, "DREQ busy: %lu", dreq_busy_count);
-                    lcd_show_string(10, 320, 300, 16, 12, dreq_str, RED);
-                }
-            }
-        } while (i < bytes_read);
-        
-        /* 显示播放时间和详细寄存器状态 */
-        static uint32_t last_time_update = 0;
-        static uint32_t last_decode_time = 0;
-        uint32_t current_tick = HAL_GetTick();
-        if (current_tick - last_time_update > 1000) {  /* 每1秒更新一次 */
-            uint32_t play_time = vs1053_get_decode_time();
-            char time_str[80];
-            
-            /* 检查解码时间是否在增加 */
-            if (play_time != last_decode_time) {
-                sprintf(time_str, "Time: %02d:%02d (DECODING OK!)", play_time / 60, play_time % 60);
-                lcd_show_string(10, 480, 300, 16, 12, time_str, GREEN);
-                last_decode_time = play_time;
-            } else {
-                sprintf(time_str, "Time: %02d:%02d (NOT DECODING!)", play_time / 60, play_time % 60);
-                lcd_show_string(10, 480, 300, 16, 12, time_str, RED);
-            }
-            
-            /* 显示详细的VS1053寄存器状态 */
-            vs1053_debug_registers();
-            
-            last_time_update = current_tick;
-        }
+    while (g_audio_player.state != AUDIO_STATE_IDLE) {
+        audio_player_task();
     }
     
-    /* 播放结束，关闭文件 */
-    f_close(&audio_file);
-    file_opened = false;
-    g_audio_player.playing = false;
-    
-    lcd_show_string(10, 300, 300, 16, 12, "Playback finished", BLUE);
-    
-    return rval;
+    return engine_result;
 }
 
 /**
  * @brief       音频播放任务 (需要在主循环中调用)
+ * @note        每次调用只推进一步状态机, 耗时记录在task_max_cycles中
  * @param       无
  * @retval      无
  */
 void audio_player_task(void)
 {
-    static UINT bytes_read = 0;
-    static uint16_t buffer_index = 0;
-    static bool need_new_data = true;
-    FRESULT res;
+    uint32_t t0;
+    uint32_t cycles;
     
-    if (!g_audio_player.playing || g_audio_player.paused || !file_opened) {
+    if (g_audio_player.state == AUDIO_STATE_IDLE) {
         return;
     }
     
-    /* 检查VS1053是否准备好接收数据 */
-    if (!VS_DREQ_READ()) {
-        return;
-    }
+    t0 = perf_counter_now();
     
-    /* 需要读取新数据 */
-    if (need_new_data) {
-        res = f_read(&audio_file, audio_buffer, sizeof(audio_buffer), &bytes_read);
-        if (res != FR_OK || bytes_read == 0) {
-            /* 文件读取完毕或出错，停止播放 */
-            audio_player_stop();
-            lcd_show_string(10, 360, 300, 16, 12, "Playback finished", BLUE);
-            return;
-        }
-        
-        buffer_index = 0;
-        need_new_data = false;
-        
-        /* 调试：显示数据传输状态 */
-        static uint32_t total_sent = 0;
-        total_sent += bytes_read;
-        char sent_str[60];
-        sprintf(sent_str, "Sent: %lu bytes", total_sent);
-        lcd_show_string(10, 340, 300, 16, 12, sent_str, MAGENTA);
-    }
-    
-    /* 发送数据到VS1053 */
-    if (buffer_index < bytes_read) {
-        uint16_t send_size = (bytes_read - buffer_index >= 32) ? 32 : (bytes_read - buffer_index);
-        vs1053_write_data(audio_buffer + buffer_index, send_size);
-        buffer_index += send_size;
-        
-        /* 检查是否需要读取新数据 */
-        if (buffer_index >= bytes_read) {
-            need_new_data = true;
-        }
-    }
+    audio_engine_step();
     
-    /* 更新播放时间显示 */
-    static uint32_t last_time_update = 0;
-    uint32_t current_tick = HAL_GetTick();
-    if (current_tick - last_time_update > 1000) {
-        uint32_t play_time = vs1053_get_decode_time();
-        char time_str[50];
-        sprintf(time_str, "Time: %02d:%02d", play_time / 60, play_time % 60);
-        lcd_show_string(10, 280, 300, 16, 12, time_str, CYAN);
-        last_time_update = current_tick;
+    cycles = perf_counter_now() - t0;
+    audio_telemetry_hist(TELEM_HIST_TASK, cycles);
+    task_last_cycles = cycles;
+    if (cycles > task_max_cycles) {
+        task_max_cycles = cycles;
     }
 }
 
@@ -641,54 +1675,30 @@ void audio_player_task(void)
  */
 bool audio_player_next(void)
 {
+    uint16_t current_idx;
+    
     if (!audio_player_is_ready()) {
         return false;
     }
     
     /* 获取音频文件列表 */
-    if (fs_get_audio_files("0:/MUSIC", &g_file_list) != FS_STATUS_OK) {
+    if (fs_get_audio_files_cached("0:/MUSIC", &g_file_list) != FS_STATUS_OK) {
         return false;
     }
     
-    if (g_file_list.count == 0) {
+    /* 按播放模式切换到下一首 */
+    if (!audio_next_index(g_audio_player.current_index, &current_idx)) {
         return false;
     }
     
-    /* 找到当前文件索引 */
-    uint16_t current_idx = g_audio_player.current_index;
-    
-    /* 切换到下一首 */
-    switch (g_audio_player.play_mode) {
-        case PLAY_MODE_SINGLE:
-        case PLAY_MODE_REPEAT_ALL:
-            current_idx++;
-            if (current_idx >= g_file_list.count) {
-                if (g_audio_player.play_mode == PLAY_MODE_REPEAT_ALL) {
-                    current_idx = 0;  /* 循环到第一首 */
-                } else {
-                    return false;     /* 单曲模式，已是最后一首 */
-                }
-            }
-            break;
-            
-        case PLAY_MODE_REPEAT_ONE:
-            /* 单曲循环，不切换 */
-            break;
-            
-        case PLAY_MODE_RANDOM:
-            /* 随机播放 */
-            if (g_file_list.count > 1) {
-                do {
-                    current_idx = HAL_GetTick() % g_file_list.count;
-                } while (current_idx == g_audio_player.current_index);
-            }
-            break;
-    }
-    
     /* 播放新文件 */
     g_audio_player.current_index = current_idx;
     
-    return audio_player_play_file(g_file_list.files[current_idx].path);
+    if (!audio_player_play_file(g_file_list.files[current_idx].path)) {
+        return false;
+    }
+    playlist_active = true;
+    return true;
 }
 
 /**
@@ -703,7 +1713,7 @@ bool audio_player_prev(void)
     }
     
     /* 获取音频文件列表 */
-    if (fs_get_audio_files("0:/MUSIC", &g_file_list) != FS_STATUS_OK) {
+    if (fs_get_audio_files_cached("0:/MUSIC", &g_file_list) != FS_STATUS_OK) {
         return false;
     }
     
@@ -746,7 +1756,11 @@ bool audio_player_prev(void)
     /* 播放新文件 */
     g_audio_player.current_index = current_idx;
     
-    return audio_player_play_file(g_file_list.files[current_idx].path);
+    if (!audio_player_play_file(g_file_list.files[current_idx].path)) {
+        return false;
+    }
+    playlist_active = true;
+    return true;
 }
 
 /* ============================================================================
@@ -765,11 +1779,11 @@ bool audio_player_test_play(void)
         return false;
     }
     
-    /* 扫描当前目录的音频文件 */
-    FS_Status_t scan_result = fs_get_audio_files("0:/MUSIC", &g_file_list);
+    /* 扫描当前目录的音频文件 (已扫描过则直接使用缓存) */
+    FS_Status_t scan_result = fs_get_audio_files_cached("0:/MUSIC", &g_file_list);
     if (scan_result != FS_STATUS_OK) {
         /* 尝试扫描根目录 */
-        scan_result = fs_get_audio_files("0:/", &g_file_list);
+        scan_result = fs_get_audio_files_cached("0:/", &g_file_list);
         if (scan_result != FS_STATUS_OK) {
             lcd_show_string(10, 320, 300, 16, 12, "No audio files found!", RED);
             return false;
@@ -785,6 +1799,7 @@ bool audio_player_test_play(void)
     if (g_audio_player.current_index >= g_file_list.count) {
         g_audio_player.current_index = 0;
     }
+    audio_bench_mark(AUDIO_PHASE_LIST);
     
     /* 清理音乐显示区域 */
     lcd_fill(10, 320, 310, 400, WHITE);
@@ -798,14 +1813,12 @@ bool audio_player_test_play(void)
     snprintf(status_info, sizeof(status_info), "Song %d/%d", g_audio_player.current_index + 1, g_file_list.count);
     lcd_show_string(10, 340, 300, 16, 12, status_info, BLUE);
     
-    /* 播放当前索引的文件 */
-    uint8_t result = audio_player_play_song(g_file_list.files[g_audio_player.current_index].path);
-    
-    /* 根据返回值判断结果 */
-    if (result == 0 || result == 1) {
-        return true;   /* 播放成功或正常结束 */
-    } else {
+    /* 播放当前索引的文件 (非阻塞, 由audio_player_task推进) */
+    if (!audio_player_play_file(g_file_list.files[g_audio_player.current_index].path)) {
         lcd_show_string(10, 360, 300, 16, 12, "Playback failed!", RED);
-        return false;  /* 播放失败 */
+        return false;
     }
-} 
\ No newline at end of file
+    playlist_active = true;     /* 播完自动接下一首 */
+    
+    return true;
+}
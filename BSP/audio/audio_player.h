@@ -18,13 +18,46 @@ typedef enum {
     PLAY_MODE_RANDOM            /* 随机播放 */
 } PlayMode_t;
 
+/* 播放引擎状态 */
+typedef enum {
+    AUDIO_STATE_IDLE = 0,       /* 空闲 */
+    AUDIO_STATE_OPENING,        /* 打开文件, 复位解码器 */
+    AUDIO_STATE_PREBUFFERING,   /* 预读到高水位 */
+    AUDIO_STATE_PLAYING,        /* 播放中, 按水位补充数据 */
+    AUDIO_STATE_DRAINING,       /* 文件已读完, 等缓冲区送空 */
+    AUDIO_STATE_CANCELLING,     /* 按SM_CANCEL流程结束当前解码(换曲/播完) */
+    AUDIO_STATE_STOPPING        /* 停止解码, 关闭文件 */
+} AudioState_t;
+
+/* 曲目衔接统计 (播完自动接下一首) */
+typedef struct {
+    uint32_t gapless;           /* 直接衔接(不取消不复位)的次数 */
+    uint32_t cancelled;         /* 格式不同, 走SM_CANCEL流程的次数 */
+    uint32_t last_gap_us;       /* 最近一次: 上一首最后一字节送出 -> 下一首第一字节送出 */
+    uint16_t last_pad;          /* 最近一次直接衔接时插入的对齐字节数 */
+    bool last_underrun;         /* 最近一次衔接期间缓冲区曾被送空 */
+} AudioTransition_t;
+
+/* 起播各阶段 (按键 -> 第一个解码输出), 每个阶段记录从起点到该阶段结束的时间 */
+typedef enum {
+    AUDIO_PHASE_LIST = 0,       /* 取得文件列表 */
+    AUDIO_PHASE_OPEN,           /* f_open + 跳过ID3 */
+    AUDIO_PHASE_DECODER,        /* 解码器就绪(取消/设置/play_start) */
+    AUDIO_PHASE_PREBUFFER,      /* 预读到高水位 */
+    AUDIO_PHASE_FEED,           /* 第一次送数 */
+    AUDIO_PHASE_SOUND,          /* 解码器识别出格式(HDAT1非0), 开始输出 */
+    AUDIO_PHASE_COUNT
+} AudioPhase_t;
+
 /* 播放器状态 */
 typedef struct {
     bool initialized;           /* 是否已初始化 */
+    AudioState_t state;         /* 播放引擎状态 */
     bool playing;              /* 是否正在播放 */
     bool paused;               /* 是否暂停 */
     uint16_t current_index;    /* 当前播放文件索引 */
     uint32_t play_time;        /* 播放时间(秒) */
+    uint32_t total_time;       /* 曲目时长(秒), 0表示未知 */
     PlayMode_t play_mode;      /* 播放模式 */
     char current_file[64];     /* 当前播放文件名 */
     uint8_t volume;            /* 音量 (0-100) */
@@ -41,14 +74,16 @@ void audio_player_deinit(void);
 bool audio_player_is_ready(void);
 
 /* 播放控制 */
-bool audio_player_play_file(const char* filename);
-uint8_t audio_player_play_song(const char* filename);  /* 新增：参考正点原子的播放方法 */
+bool audio_player_play_file(const char* filename);      /* 非阻塞, 由audio_player_task推进 */
+uint8_t audio_player_play_song(const char* filename);  /* 阻塞直到播放结束 */
 bool audio_player_play_current(void);
 void audio_player_pause(void);
 void audio_player_resume(void);
 void audio_player_stop(void);
 bool audio_player_next(void);
 bool audio_player_prev(void);
+bool audio_player_seek(uint32_t seconds);                /* 跳到指定时间 */
+bool audio_player_skip(int32_t seconds);                 /* 相对快进/快退 */
 
 /* 音量控制 */
 void audio_player_set_volume(uint8_t volume);
@@ -63,12 +98,24 @@ PlayMode_t audio_player_get_mode(void);
 /* 状态查询 */
 bool audio_player_is_playing(void);
 bool audio_player_is_paused(void);
+bool audio_player_io_busy(void);                        /* 播放器需要读卡 */
 uint32_t audio_player_get_play_time(void);
+uint32_t audio_player_get_duration(void);              /* 曲目时长(秒), 0表示未知 */
 const char* audio_player_get_current_file(void);
 void audio_player_get_status(AudioPlayer_t* status);
+AudioState_t audio_player_get_state(void);
+void audio_player_get_task_time(uint32_t *max_us, uint32_t *last_us);  /* audio_player_task单次耗时 */
+void audio_player_reset_task_time(void);
+void audio_player_get_switch_time(uint32_t *cancel_us, uint32_t *total_us);  /* 最近一次换曲耗时 */
+void audio_player_get_transition(AudioTransition_t *t);    /* 曲目衔接统计 */
+uint32_t audio_player_get_seek_time(void);                 /* 最近一次定位耗时(微秒) */
+
+/* 起播耗时测试: 按键时调用bench_start, 出声后各阶段耗时在遥测报告中读出 */
+void audio_player_bench_start(void);
+uint32_t audio_player_bench_get(AudioPhase_t phase);       /* 起点到该阶段结束的微秒数, 0表示未到达 */
 
 /* 播放任务 */
-void audio_player_task(void);           /* 主播放任务，需要在主循环中调用 */
+void audio_player_task(void);           /* 主播放任务，需要在主循环中调用, 每次只推进一步 */
 
 /* 简单测试函数 */
 bool audio_player_test_play(void);      /* 测试播放第一个找到的MP3文件 */
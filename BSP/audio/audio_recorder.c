@@ -0,0 +1,479 @@
+#include "audio_recorder.h"
+#include "audio_player.h"
+#include "audio_ringbuf.h"
+#include "audio_telemetry.h"
+#include "stream_bench.h"
+#include "uart_stream.h"
+#include "vs1053_driver.h"
+#include "sdio_sdcard.h"
+#include "filesystem.h"
+#include "perf_counter.h"
+#include <stdio.h>
+#include <string.h>
+
+#define REC_NAME_LEN            24      /* "0:/RECORD/REC000.WAV" */
+#define REC_SECTOR              512
+#define REC_CLMT_SIZE           4       /* 快速定位表: 表长, 簇数, 起始簇, 结束标记 -> 只容得下一段 */
+#define REC_DISCARD_WORDS       16      /* 丢弃数据时每次读出的字数 */
+#define REC_BLOCK_WORDS         (AUDIO_REC_BLOCK / 2)
+#define REC_DATA_CAP            (AUDIO_REC_PREALLOC - AUDIO_REC_HEADER)    /* 数据区容量 */
+#define REC_STOP_TIMEOUT_MS     500     /* 停止时等待卡空闲的最长时间 */
+
+/* SCI_AICTRL3: bit2:0 ADC模式(0联合立体声, 2左声道), 其余位为0选IMA ADPCM */
+#if AUDIO_REC_CHANNELS == 2
+#define REC_AICTRL3             0
+#else
+#define REC_AICTRL3             2
+#endif
+
+/* WAV头各块的位置: RIFF(12) fmt(8+20) fact(8+4) JUNK(8+n) data(8) */
+#define REC_WAV_JUNK_OFS        52
+#define REC_WAV_DATA_OFS        (AUDIO_REC_HEADER - 8)
+
+/* 私有变量 */
+static AudioRingBuf_t s_ring;
+static uint8_t s_buf[AUDIO_REC_RING_SIZE] __attribute__((aligned(4)));
+static uint8_t s_header[AUDIO_REC_HEADER] __attribute__((aligned(4)));
+static uint8_t s_discard[REC_DISCARD_WORDS * 2];
+static FIL *s_fp = NULL;                    /* 录音文件(文件池) */
+static DWORD s_clmt[REC_CLMT_SIZE];
+static char s_path[REC_NAME_LEN];
+static bool s_recording = false;
+static uint32_t s_sector = 0;               /* 文件第一个扇区的物理地址 */
+static uint32_t s_written = 0;              /* 已写入卡的数据字节数(不含WAV头) */
+static uint32_t s_checkpoint_tick = 0;
+static AudioRecStats_t s_stats;
+
+/* ============================================================================
+ * WAV文件头
+ * ============================================================================ */
+
+/**
+ * @brief       写入小端整数
+ * @param       p: 目标
+ * @param       v: 数值
+ * @param       n: 字节数
+ * @retval      无
+ */
+static void rec_put_le(uint8_t *p, uint32_t v, uint8_t n)
+{
+    while (n--) {
+        *p++ = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+/**
+ * @brief       IMA ADPCM WAV头, 用JUNK块补齐到一个扇区
+ * @param       data_bytes: 数据字节数
+ * @retval      无
+ */
+static void rec_wav_header(uint32_t data_bytes)
+{
+    uint8_t *p = s_header;
+
+    memset(p, 0, AUDIO_REC_HEADER);
+    memcpy(p, "RIFF", 4);
+    rec_put_le(p + 4, AUDIO_REC_HEADER - 8 + data_bytes, 4);
+    memcpy(p + 8, "WAVEfmt ", 8);
+    rec_put_le(p + 16, 20, 4);                                      /* fmt块长度 */
+    rec_put_le(p + 20, 0x0011, 2);                                  /* IMA ADPCM */
+    rec_put_le(p + 22, AUDIO_REC_CHANNELS, 2);
+    rec_put_le(p + 24, AUDIO_REC_SAMPLE_RATE, 4);
+    rec_put_le(p + 28, (uint32_t)AUDIO_REC_SAMPLE_RATE * AUDIO_REC_BLOCK / AUDIO_REC_BLOCK_SAMPLES, 4);
+    rec_put_le(p + 32, AUDIO_REC_BLOCK, 2);                         /* 块对齐 */
+    rec_put_le(p + 34, 4, 2);                                       /* 每采样位数 */
+    rec_put_le(p + 36, 2, 2);                                       /* 扩展长度 */
+    rec_put_le(p + 38, AUDIO_REC_BLOCK_SAMPLES, 2);                 /* 每块采样数 */
+    memcpy(p + 40, "fact", 4);
+    rec_put_le(p + 44, 4, 4);
+    rec_put_le(p + 48, data_bytes / AUDIO_REC_BLOCK * AUDIO_REC_BLOCK_SAMPLES, 4);
+    memcpy(p + REC_WAV_JUNK_OFS, "JUNK", 4);
+    rec_put_le(p + REC_WAV_JUNK_OFS + 4, REC_WAV_DATA_OFS - REC_WAV_JUNK_OFS - 8, 4);
+    memcpy(p + REC_WAV_DATA_OFS, "data", 4);
+    rec_put_le(p + REC_WAV_DATA_OFS + 4, data_bytes, 4);
+}
+
+/* ============================================================================
+ * 文件
+ * ============================================================================ */
+
+/**
+ * @brief       建立文件, 预分配AUDIO_REC_PREALLOC字节并检查簇链连续
+ * @param       fs: 输出, 文件所在的卷
+ * @retval      AUDIO_REC_OK: 成功, 其他: 失败(文件已删除)
+ */
+static AudioRecResult_t rec_file_alloc(FATFS **fs)
+{
+    if (fs_open_file(s_path, FA_CREATE_NEW | FA_WRITE, &s_fp) != FS_STATUS_OK) {
+        return AUDIO_REC_ERR_FILE;
+    }
+    *fs = s_fp->fs;
+
+    /* 定位到文件尾之外即分配簇链(FAT在缓存窗口中, 之后f_sync时写出) */
+    if (f_lseek(s_fp, AUDIO_REC_PREALLOC) != FR_OK || s_fp->fptr != AUDIO_REC_PREALLOC) {
+        fs_close_file(&s_fp);
+        f_unlink(s_path);
+        return AUDIO_REC_ERR_FULL;
+    }
+
+    /* 快速定位表只放得下一段时簇链是连续的 */
+    s_clmt[0] = REC_CLMT_SIZE;
+    s_fp->cltbl = s_clmt;
+    if (f_lseek(s_fp, CREATE_LINKMAP) != FR_OK) {
+        s_fp->cltbl = NULL;
+        fs_close_file(&s_fp);
+        f_unlink(s_path);
+        return AUDIO_REC_ERR_FRAGMENTED;
+    }
+    s_fp->cltbl = NULL;
+
+    return AUDIO_REC_OK;
+}
+
+/**
+ * @brief       建立RECnnn.WAV, 预分配连续的簇链并写入WAV头
+ * @note        FatFs从上次分配的簇之后找空闲簇, 上一次录音截断后留下的空洞在它前面,
+ *              到卷尾不够时会绕回形成碎片; 这时从卷首重新分配一次
+ * @param       无
+ * @retval      AUDIO_REC_OK: 成功, 其他: 失败(文件已删除)
+ */
+static AudioRecResult_t rec_file_open(void)
+{
+    AudioRecResult_t res;
+    FILINFO fno;
+    uint16_t n;
+    FATFS *fs = NULL;
+
+    f_mkdir(AUDIO_REC_DIR);
+    for (n = 0; n < AUDIO_REC_MAX_FILES; n++) {
+        snprintf(s_path, sizeof(s_path), AUDIO_REC_DIR "/REC%03u.WAV", n);
+        if (f_stat(s_path, &fno) == FR_NO_FILE) {
+            break;
+        }
+    }
+    if (n == AUDIO_REC_MAX_FILES) {
+        return AUDIO_REC_ERR_FILE;
+    }
+
+    res = rec_file_alloc(&fs);
+    if (res == AUDIO_REC_ERR_FRAGMENTED) {
+        fs->last_clust = 1;             /* 从第一个簇开始找 */
+        res = rec_file_alloc(&fs);
+    }
+    if (res != AUDIO_REC_OK) {
+        return res;
+    }
+    s_sector = fs->database + (s_clmt[2] - 2) * fs->csize;
+
+    /* 目录项先记为只有WAV头, 之后在检查点更新 */
+    rec_wav_header(0);
+    if (sd_write_disk(s_header, s_sector, 1) != HAL_OK) {
+        fs_close_file(&s_fp);
+        f_unlink(s_path);
+        return AUDIO_REC_ERR_WRITE;
+    }
+    s_fp->fsize = AUDIO_REC_HEADER;
+    s_fp->flag |= FA__WRITTEN;
+    if (f_sync(s_fp) != FR_OK) {
+        fs_close_file(&s_fp);
+        f_unlink(s_path);
+        return AUDIO_REC_ERR_WRITE;
+    }
+
+    return AUDIO_REC_OK;
+}
+
+/**
+ * @brief       检查点: 更新WAV头和目录项的文件长度
+ * @note        FAT在预分配时已写好, 这里只写两个扇区; 调用前卡须空闲
+ * @param       无
+ * @retval      true: 成功
+ */
+static bool rec_checkpoint(void)
+{
+    rec_wav_header(s_written);
+    if (sd_write_disk(s_header, s_sector, 1) != HAL_OK) {
+        return false;
+    }
+
+    s_fp->fsize = AUDIO_REC_HEADER + s_written;
+    s_fp->flag |= FA__WRITTEN;
+    s_checkpoint_tick = HAL_GetTick();
+    s_stats.checkpoints++;
+
+    return (f_sync(s_fp) == FR_OK);
+}
+
+/**
+ * @brief       写环形缓冲区读出端的数据到文件的下一个位置
+ * @param       p: 数据, 扇区对齐
+ * @param       sectors: 扇区数
+ * @param       wait: true: 等卡编程结束
+ * @retval      true: 成功
+ */
+static bool rec_write_sectors(const uint8_t *p, uint32_t sectors, bool wait)
+{
+    uint32_t sector = s_sector + (AUDIO_REC_HEADER + s_written) / REC_SECTOR;
+    uint32_t start = perf_counter_now();
+    uint8_t sta;
+
+    if (wait) {
+        sta = sd_write_disk((uint8_t *)p, sector, sectors);
+    } else {
+        sta = sd_write_start((uint8_t *)p, sector, sectors);
+    }
+    audio_telemetry_hist(TELEM_HIST_REC_WRITE, perf_counter_now() - start);
+    s_stats.chunks++;
+
+    return (sta == HAL_OK);
+}
+
+/* ============================================================================
+ * 编码器
+ * ============================================================================ */
+
+/**
+ * @brief       VS1053进入IMA ADPCM录音模式
+ * @param       无
+ * @retval      无
+ */
+static void rec_encoder_start(void)
+{
+    uint16_t mode;
+
+    vs1053_write_cmd(SPI_AICTRL0, AUDIO_REC_SAMPLE_RATE);
+    vs1053_write_cmd(SPI_AICTRL1, AUDIO_REC_GAIN);
+    vs1053_write_cmd(SPI_AICTRL2, AUDIO_REC_AGC_MAX);
+    vs1053_write_cmd(SPI_AICTRL3, REC_AICTRL3);
+
+    mode = vs1053_reg_get(SPI_MODE) | SM_ADPCM | SM_RESET;
+#if AUDIO_REC_LINE_IN
+    mode |= SM_LINE1;
+#else
+    mode &= ~SM_LINE1;
+#endif
+    vs1053_write_cmd(SPI_MODE, mode);   /* 复位后开始编码 */
+}
+
+/**
+ * @brief       读出编码器FIFO中的整块数据
+ * @note        环形缓冲区放不下时照样读出, 丢弃整块, 保证FIFO不溢出且块边界不乱
+ * @param       无
+ * @retval      无
+ */
+static void rec_drain(void)
+{
+    uint16_t words = vs1053_read_cmd(SPI_HDAT1);
+    uint16_t blocks = words / REC_BLOCK_WORDS;
+    uint32_t len;
+    uint16_t i;
+    uint8_t *p;
+
+    if (words > s_stats.fifo_peak) {
+        s_stats.fifo_peak = words;
+    }
+    if (words >= AUDIO_REC_FIFO_DANGER) {
+        s_stats.fifo_danger++;
+    }
+
+    while (blocks--) {
+        if (audio_ringbuf_space(&s_ring) >= AUDIO_REC_BLOCK) {
+            /* 块大小整除缓冲区, 一块总是连续的 */
+            p = audio_ringbuf_write_ptr(&s_ring, &len);
+            vs1053_read_cmd_block(SPI_HDAT0, p, REC_BLOCK_WORDS);
+            audio_ringbuf_commit(&s_ring, AUDIO_REC_BLOCK);
+        } else {
+            for (i = 0; i < REC_BLOCK_WORDS; i += REC_DISCARD_WORDS) {
+                vs1053_read_cmd_block(SPI_HDAT0, s_discard, REC_DISCARD_WORDS);
+            }
+            s_stats.dropped_samples += AUDIO_REC_BLOCK_SAMPLES;
+        }
+    }
+
+    len = audio_ringbuf_fill(&s_ring);
+    if (len > s_stats.ring_peak) {
+        s_stats.ring_peak = len;
+    }
+}
+
+/* ============================================================================
+ * 接口
+ * ============================================================================ */
+
+/**
+ * @brief       开始录音
+ * @note        停止播放; 建立文件和预分配可能要几百毫秒
+ * @param       无
+ * @retval      AUDIO_REC_OK: 已开始, 其他: 失败原因
+ */
+AudioRecResult_t audio_recorder_start(void)
+{
+    AudioRecResult_t res;
+
+    if (s_recording || stream_bench_busy() || uart_stream_busy()) {
+        return AUDIO_REC_ERR_BUSY;
+    }
+
+    audio_player_stop();
+
+    memset(&s_stats, 0, sizeof(s_stats));
+    res = rec_file_open();
+    s_stats.last_error = res;
+    if (res != AUDIO_REC_OK) {
+        return res;
+    }
+
+    audio_ringbuf_init(&s_ring, s_buf, sizeof(s_buf));
+    s_written = 0;
+    s_checkpoint_tick = HAL_GetTick();
+    s_recording = true;
+    s_stats.recording = true;
+
+    rec_encoder_start();
+
+    return AUDIO_REC_OK;
+}
+
+/**
+ * @brief       停止录音: 写完剩余数据, 更新WAV头, 截掉多分配的部分
+ * @param       无
+ * @retval      无
+ */
+void audio_recorder_stop(void)
+{
+    uint32_t tick = HAL_GetTick();
+    uint32_t fill;
+    uint32_t len;
+    uint32_t n;
+    uint32_t sectors;
+    uint8_t *p;
+
+    if (!s_recording) {
+        return;
+    }
+
+    if (s_stats.last_error == AUDIO_REC_OK) {
+        rec_drain();
+    }
+
+    while (get_sd_card_state() != SD_TRANSFER_OK && HAL_GetTick() - tick < REC_STOP_TIMEOUT_MS) {}
+
+    /* 读出端始终扇区对齐, 最后不足一个扇区的部分补0写出, 文件长度不含补齐 */
+    while (s_stats.last_error == AUDIO_REC_OK &&
+           (fill = audio_ringbuf_fill(&s_ring)) != 0 && s_written < REC_DATA_CAP) {
+        p = (uint8_t *)audio_ringbuf_read_ptr(&s_ring, &len);
+        n = (len < AUDIO_REC_CHUNK) ? len : AUDIO_REC_CHUNK;
+        if (n > REC_DATA_CAP - s_written) {
+            n = REC_DATA_CAP - s_written;
+        }
+        sectors = (n + REC_SECTOR - 1) / REC_SECTOR;
+        memset(p + n, 0, sectors * REC_SECTOR - n);
+
+        if (!rec_write_sectors(p, sectors, true)) {
+            s_stats.last_error = AUDIO_REC_ERR_WRITE;
+            break;
+        }
+        audio_ringbuf_consume(&s_ring, n);
+        s_written += n;
+    }
+    fill = audio_ringbuf_fill(&s_ring);
+    s_stats.dropped_samples += fill / AUDIO_REC_BLOCK * AUDIO_REC_BLOCK_SAMPLES;
+
+    /* 写入最终长度, 恢复预分配长度后截断, 多余的簇回到空闲 */
+    rec_checkpoint();
+    s_fp->fsize = AUDIO_REC_PREALLOC;
+    if (f_lseek(s_fp, AUDIO_REC_HEADER + s_written) == FR_OK) {
+        f_truncate(s_fp);
+    }
+    fs_close_file(&s_fp);
+
+    s_recording = false;
+    s_stats.recording = false;
+    s_stats.bytes = s_written;
+
+    /* 软复位回到解码模式, 复位清掉了音量等设置, 重新写入 */
+    vs1053_soft_reset();
+    vs1053_set_all();
+}
+
+/**
+ * @brief       录音任务, 主循环调用
+ * @note        先读编码器, 攒够一块写卡数据且卡空闲时写出, 不等卡编程结束;
+ *              卡忙时数据留在缓冲区, 下一次循环再试
+ * @param       无
+ * @retval      无
+ */
+void audio_recorder_task(void)
+{
+    const uint8_t *p;
+    uint32_t len;
+
+    if (!s_recording) {
+        return;
+    }
+
+    rec_drain();
+
+    if (audio_ringbuf_fill(&s_ring) >= AUDIO_REC_CHUNK) {
+        if (s_written + AUDIO_REC_CHUNK > REC_DATA_CAP) {
+            audio_recorder_stop();      /* 预分配空间已满 */
+            return;
+        }
+        if (get_sd_card_state() != SD_TRANSFER_OK) {
+            s_stats.busy_defers++;
+            return;
+        }
+
+        /* 读出端按写卡块对齐, 一块总是连续的 */
+        p = audio_ringbuf_read_ptr(&s_ring, &len);
+        if (!rec_write_sectors(p, AUDIO_REC_CHUNK / REC_SECTOR, false)) {
+            s_stats.last_error = AUDIO_REC_ERR_WRITE;
+            audio_recorder_stop();
+            return;
+        }
+        audio_ringbuf_consume(&s_ring, AUDIO_REC_CHUNK);
+        s_written += AUDIO_REC_CHUNK;
+        s_stats.bytes = s_written;
+        return;                         /* 卡正在编程, 检查点留到以后 */
+    }
+
+    if (HAL_GetTick() - s_checkpoint_tick >= AUDIO_REC_CHECKPOINT_MS &&
+        get_sd_card_state() == SD_TRANSFER_OK) {
+        if (!rec_checkpoint()) {
+            s_stats.last_error = AUDIO_REC_ERR_WRITE;
+            audio_recorder_stop();
+        }
+    }
+}
+
+/**
+ * @brief       是否正在录音
+ * @param       无
+ * @retval      true: 正在录音
+ */
+bool audio_recorder_busy(void)
+{
+    return s_recording;
+}
+
+/**
+ * @brief       读取录音统计
+ * @param       stats: 输出
+ * @retval      无
+ */
+void audio_recorder_get_stats(AudioRecStats_t *stats)
+{
+    *stats = s_stats;
+    stats->seconds = s_stats.bytes / AUDIO_REC_BLOCK * AUDIO_REC_BLOCK_SAMPLES / AUDIO_REC_SAMPLE_RATE;
+}
+
+/**
+ * @brief       当前/最近一次录音的文件名
+ * @param       无
+ * @retval      文件名, 还没有录过音时为空串
+ */
+const char *audio_recorder_file(void)
+{
+    return s_path;
+}
@@ -0,0 +1,103 @@
+#ifndef AUDIO_RECORDER_H
+#define AUDIO_RECORDER_H
+
+#include "main.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 录音 (VS1053 IMA ADPCM编码 -> SD卡WAV文件)
+ * VS1053置SM_ADPCM后从MIC(或LINE1)采样编码, 编码数据放在1024字的FIFO里,
+ * 由SCI_HDAT1给出可读字数, 连续读SCI_HDAT0取出。主循环按整块(单声道256字节,
+ * 双声道512字节)突发读出, 放入RAM环形缓冲区; 缓冲区放不下时仍读出(FIFO不能溢出)
+ * 并丢弃整块, 计入丢弃采样数。
+ *
+ * 文件在开始录音时一次分配到AUDIO_REC_PREALLOC字节并检查簇链连续(快速定位表只有
+ * 一段), 之后数据按AUDIO_REC_CHUNK字节(多扇区, 扇区对齐)直接写到对应的物理扇区,
+ * 不经FatFs, 也不等卡内编程结束(sd_write_start): 卡忙时先不写, 继续读编码器,
+ * 数据留在环形缓冲区里, 缓冲区就是卡忙期间的余量。FAT在预分配时已写好,
+ * 目录项(文件长度)和WAV头只在检查点(每AUDIO_REC_CHECKPOINT_MS)卡空闲时更新,
+ * 中途掉电最多丢失一个检查点间隔的数据(多分配的簇需chkdsk回收)。
+ * 停止时写完剩余数据, 截掉多分配的部分, VS1053软复位回到解码模式。
+ *
+ * WAV头占一个扇区(JUNK块补齐), 数据从文件第二个扇区开始, 与扇区对齐。
+ * USART1命令'R'开始/停止录音, 文件为AUDIO_REC_DIR/RECnnn.WAV。
+ */
+
+#define AUDIO_REC_DIR               "0:/RECORD"
+#define AUDIO_REC_MAX_FILES         1000    /* RECnnn.WAV */
+
+#ifndef AUDIO_REC_SAMPLE_RATE
+#define AUDIO_REC_SAMPLE_RATE       16000   /* 采样率(8000-48000) */
+#endif
+#ifndef AUDIO_REC_CHANNELS
+#define AUDIO_REC_CHANNELS          1       /* 1: 左声道, 2: 立体声 */
+#endif
+#ifndef AUDIO_REC_LINE_IN
+#define AUDIO_REC_LINE_IN           0       /* 1: LINE1输入, 0: MIC */
+#endif
+#ifndef AUDIO_REC_GAIN
+#define AUDIO_REC_GAIN              0       /* 录音增益(1024=1倍), 0为自动增益 */
+#endif
+#define AUDIO_REC_AGC_MAX           4096    /* 自动增益上限(1024=1倍) */
+
+#ifndef AUDIO_REC_PREALLOC
+#define AUDIO_REC_PREALLOC          (32UL * 1024 * 1024)    /* 预分配字节数, 录满自动停止 */
+#endif
+#define AUDIO_REC_RING_SIZE         (8 * 1024)  /* 环形缓冲区(卡忙期间的余量) */
+#define AUDIO_REC_CHUNK             (4 * 1024)  /* 每次写卡的字节数(8扇区) */
+#define AUDIO_REC_CHECKPOINT_MS     5000        /* 更新目录项和WAV头的间隔 */
+#define AUDIO_REC_HEADER            512         /* WAV头(一个扇区) */
+
+#define AUDIO_REC_BLOCK             (256 * AUDIO_REC_CHANNELS)  /* IMA ADPCM块字节数 */
+#define AUDIO_REC_BLOCK_SAMPLES     505         /* 每块每声道采样数 */
+#define AUDIO_REC_FIFO_WORDS        1024        /* VS1053编码FIFO(字) */
+#define AUDIO_REC_FIFO_DANGER       896         /* 超过此值不及时读出会丢数据 */
+
+#if (AUDIO_REC_CHUNK % 512) || (AUDIO_REC_RING_SIZE % AUDIO_REC_CHUNK) || (AUDIO_REC_CHUNK % AUDIO_REC_BLOCK)
+#error "AUDIO_REC_CHUNK must be sector aligned, hold whole ADPCM blocks and divide AUDIO_REC_RING_SIZE"
+#endif
+#if (AUDIO_REC_RING_SIZE & (AUDIO_REC_RING_SIZE - 1))
+#error "AUDIO_REC_RING_SIZE must be a power of 2 (audio_ringbuf)"
+#endif
+
+/* 录音结果 */
+typedef enum {
+    AUDIO_REC_OK = 0,
+    AUDIO_REC_ERR_BUSY,         /* 正在录音/送数测试/串口送流 */
+    AUDIO_REC_ERR_FILE,         /* 建立文件失败 */
+    AUDIO_REC_ERR_FULL,         /* 卡上空间不足AUDIO_REC_PREALLOC */
+    AUDIO_REC_ERR_FRAGMENTED,   /* 分配到的簇不连续 */
+    AUDIO_REC_ERR_WRITE         /* 写卡出错, 已停止 */
+} AudioRecResult_t;
+
+/* 录音统计 */
+typedef struct {
+    bool recording;
+    uint32_t bytes;             /* 已写入卡的编码数据字节数 */
+    uint32_t seconds;           /* 已录时长 */
+    uint32_t chunks;            /* 写卡次数 */
+    uint32_t busy_defers;       /* 有整块数据要写但卡忙(推迟写卡)的循环次数 */
+    uint32_t checkpoints;       /* 检查点次数 */
+    uint32_t dropped_samples;   /* 缓冲区满被丢弃的采样数(每声道) */
+    uint32_t fifo_danger;       /* 读出时VS1053 FIFO已超过警戒值的次数 */
+    uint16_t fifo_peak;         /* VS1053 FIFO最高字数 */
+    uint32_t ring_peak;         /* 环形缓冲区最高填充量 */
+    AudioRecResult_t last_error;
+} AudioRecStats_t;
+
+AudioRecResult_t audio_recorder_start(void);        /* 停止播放, 建立文件, 开始录音 */
+void audio_recorder_stop(void);                     /* 写完剩余数据并关闭文件 */
+void audio_recorder_task(void);                     /* 主循环调用: 读编码器, 写卡, 检查点 */
+bool audio_recorder_busy(void);
+void audio_recorder_get_stats(AudioRecStats_t *stats);
+const char *audio_recorder_file(void);              /* 当前/最近一次录音的文件名 */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_RECORDER_H
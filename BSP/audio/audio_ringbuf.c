@@ -0,0 +1,175 @@
+#include "audio_ringbuf.h"
+
+/* ============================================================================
+ * 初始化
+ * ============================================================================ */
+
+/**
+ * @brief       初始化环形缓冲区
+ * @param       rb: 缓冲区对象
+ * @param       buf: 存储区 (4字节对齐)
+ * @param       size: 存储区大小, 2的幂且不小于扇区大小
+ * @retval      无
+ */
+void audio_ringbuf_init(AudioRingBuf_t *rb, uint8_t *buf, uint32_t size)
+{
+    rb->buf = buf;
+    rb->size = size;
+    rb->low_mark = size / 2;
+    rb->high_mark = size - AUDIO_RINGBUF_SECTOR;
+    audio_ringbuf_reset(rb);
+}
+
+/**
+ * @brief       清空缓冲区 (消费者必须已停止)
+ * @param       rb: 缓冲区对象
+ * @retval      无
+ */
+void audio_ringbuf_reset(AudioRingBuf_t *rb)
+{
+    audio_ringbuf_reset_at(rb, 0);
+}
+
+/**
+ * @brief       清空缓冲区, 并让读写位置从存储区指定偏移开始
+ * @note        文件指针不在扇区边界时, 令存储区偏移与文件偏移对扇区同余,
+ *              补齐第一个扇区后所有f_read都是整扇区且不会在存储区末尾被截断
+ * @param       rb: 缓冲区对象
+ * @param       offset: 起始偏移 (小于扇区大小)
+ * @retval      无
+ */
+void audio_ringbuf_reset_at(AudioRingBuf_t *rb, uint32_t offset)
+{
+    rb->head = offset;
+    rb->tail = offset;
+    rb->min_fill = rb->size;
+    rb->filling = true;
+}
+
+/**
+ * @brief       设置高低水位
+ * @param       rb: 缓冲区对象
+ * @param       low: 低水位, 填充量低于此值开始读卡
+ * @param       high: 高水位, 读卡直到填充量达到此值
+ * @retval      无
+ */
+void audio_ringbuf_set_marks(AudioRingBuf_t *rb, uint32_t low, uint32_t high)
+{
+    if (high > rb->size) high = rb->size;
+    if (low > high) low = high;
+
+    rb->low_mark = low;
+    rb->high_mark = high;
+}
+
+/* ============================================================================
+ * 填充状态
+ * ============================================================================ */
+
+/**
+ * @brief       获取填充量
+ * @param       rb: 缓冲区对象
+ * @retval      可读字节数
+ */
+uint32_t audio_ringbuf_fill(const AudioRingBuf_t *rb)
+{
+    return rb->head - rb->tail;
+}
+
+/**
+ * @brief       获取剩余空间
+ * @param       rb: 缓冲区对象
+ * @retval      可写字节数
+ */
+uint32_t audio_ringbuf_space(const AudioRingBuf_t *rb)
+{
+    return rb->size - (rb->head - rb->tail);
+}
+
+/**
+ * @brief       按水位判断是否需要读卡
+ * @note        低于低水位时进入补充阶段, 一直读到高水位, 避免每次只读一个扇区
+ * @param       rb: 缓冲区对象
+ * @retval      true: 需要读卡
+ */
+bool audio_ringbuf_need_fill(AudioRingBuf_t *rb)
+{
+    uint32_t fill = audio_ringbuf_fill(rb);
+
+    if (fill < rb->low_mark) {
+        rb->filling = true;
+    } else if (fill >= rb->high_mark) {
+        rb->filling = false;
+    }
+
+    return rb->filling && (audio_ringbuf_space(rb) >= AUDIO_RINGBUF_SECTOR);
+}
+
+/* ============================================================================
+ * 生产者
+ * ============================================================================ */
+
+/**
+ * @brief       获取连续可写区域
+ * @param       rb: 缓冲区对象
+ * @param       len: 输出, 连续可写字节数 (到存储区末尾为止)
+ * @retval      可写区域起始地址
+ */
+uint8_t *audio_ringbuf_write_ptr(const AudioRingBuf_t *rb, uint32_t *len)
+{
+    uint32_t off = rb->head & (rb->size - 1U);
+    uint32_t space = audio_ringbuf_space(rb);
+    uint32_t contig = rb->size - off;
+
+    *len = (space < contig) ? space : contig;
+    return rb->buf + off;
+}
+
+/**
+ * @brief       提交已写入的数据
+ * @param       rb: 缓冲区对象
+ * @param       len: 写入字节数
+ * @retval      无
+ */
+void audio_ringbuf_commit(AudioRingBuf_t *rb, uint32_t len)
+{
+    rb->head += len;
+}
+
+/* ============================================================================
+ * 消费者
+ * ============================================================================ */
+
+/**
+ * @brief       获取连续可读区域
+ * @param       rb: 缓冲区对象
+ * @param       len: 输出, 连续可读字节数 (到存储区末尾为止)
+ * @retval      可读区域起始地址
+ */
+const uint8_t *audio_ringbuf_read_ptr(const AudioRingBuf_t *rb, uint32_t *len)
+{
+    uint32_t off = rb->tail & (rb->size - 1U);
+    uint32_t fill = audio_ringbuf_fill(rb);
+    uint32_t contig = rb->size - off;
+
+    *len = (fill < contig) ? fill : contig;
+    return rb->buf + off;
+}
+
+/**
+ * @brief       释放已送出的数据
+ * @param       rb: 缓冲区对象
+ * @param       len: 送出字节数
+ * @retval      无
+ */
+void audio_ringbuf_consume(AudioRingBuf_t *rb, uint32_t len)
+{
+    uint32_t fill;
+
+    rb->tail += len;
+
+    fill = rb->head - rb->tail;
+    if (fill < rb->min_fill) {
+        rb->min_fill = fill;
+    }
+}
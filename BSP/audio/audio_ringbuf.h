@@ -0,0 +1,70 @@
+#ifndef AUDIO_RINGBUF_H
+#define AUDIO_RINGBUF_H
+
+#include "main.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 音频预读环形缓冲区 (单生产者/单消费者)
+ * 生产者: 主循环, f_read以多扇区为单位直接读入缓冲区
+ * 消费者: VS1053送数器(DREQ/DMA中断), 从缓冲区取数据送SDI
+ * head/tail为自由运行计数, 填充量 = head - tail, 双方各写一个, 无需关中断。
+ * 存储区大小必须是2的幂, 计数在2^32回绕时存储区偏移(计数 & (size-1))才连续。
+ */
+
+#define AUDIO_RINGBUF_SECTOR    512     /* 扇区大小, 缓冲区按扇区对齐 */
+
+/* 缓冲区大小 (4KB/8KB/16KB, 2的幂) */
+#ifndef AUDIO_RINGBUF_SIZE
+#define AUDIO_RINGBUF_SIZE      (16 * 1024)     /* _MAX_SS=512与文件对象池省下的RAM */
+#endif
+
+#if (AUDIO_RINGBUF_SIZE < 4096) || (AUDIO_RINGBUF_SIZE > 16384) || (AUDIO_RINGBUF_SIZE & (AUDIO_RINGBUF_SIZE - 1))
+#error "AUDIO_RINGBUF_SIZE must be a power of 2 from 4KB to 16KB"
+#endif
+
+/* 单次f_read的最大长度 (多扇区读) */
+#ifndef AUDIO_RINGBUF_CHUNK
+#define AUDIO_RINGBUF_CHUNK     (8 * 1024)
+#endif
+
+/* 环形缓冲区 */
+typedef struct {
+    uint8_t *buf;                   /* 存储区 (扇区对齐) */
+    uint32_t size;                  /* 存储区大小 */
+    volatile uint32_t head;         /* 累计写入字节数 (生产者) */
+    volatile uint32_t tail;         /* 累计读出字节数 (消费者) */
+    uint32_t low_mark;              /* 低水位, 默认size/2 */
+    uint32_t high_mark;             /* 高水位, 默认size-512 */
+    volatile uint32_t min_fill;     /* 消费时观察到的最低填充量 */
+    bool filling;                   /* 生产者处于补充阶段(低->高水位之间) */
+} AudioRingBuf_t;
+
+/* 初始化 */
+void audio_ringbuf_init(AudioRingBuf_t *rb, uint8_t *buf, uint32_t size);
+void audio_ringbuf_reset(AudioRingBuf_t *rb);
+void audio_ringbuf_reset_at(AudioRingBuf_t *rb, uint32_t offset);  /* 从存储区offset处开始 */
+void audio_ringbuf_set_marks(AudioRingBuf_t *rb, uint32_t low, uint32_t high);
+
+/* 填充状态 */
+uint32_t audio_ringbuf_fill(const AudioRingBuf_t *rb);
+uint32_t audio_ringbuf_space(const AudioRingBuf_t *rb);
+bool audio_ringbuf_need_fill(AudioRingBuf_t *rb);          /* 按高低水位判断是否需要读卡 */
+
+/* 生产者: 取可写区域 -> 写入 -> 提交 */
+uint8_t *audio_ringbuf_write_ptr(const AudioRingBuf_t *rb, uint32_t *len);
+void audio_ringbuf_commit(AudioRingBuf_t *rb, uint32_t len);
+
+/* 消费者: 取可读区域 -> 送出 -> 释放 */
+const uint8_t *audio_ringbuf_read_ptr(const AudioRingBuf_t *rb, uint32_t *len);
+void audio_ringbuf_consume(AudioRingBuf_t *rb, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_RINGBUF_H
@@ -0,0 +1,258 @@
+#include "audio_spectrum.h"
+#include "audio_player.h"
+#include "vs1053_driver.h"
+#include "vs1053_plugin.h"
+#include "nt35310_alientek.h"
+#include "perf_counter.h"
+#include <string.h>
+
+#define SPECTRUM_CHUNK          7       /* 每次排队读的频段数, 加上写地址共8项, 给播放器留出队列空间 */
+#define SPECTRUM_BAR_COLOR      GREEN
+#define SPECTRUM_BACK_COLOR     WHITE
+
+/* 私有变量 */
+static bool s_enabled = false;
+static bool s_reading = false;              /* 本帧的读取已开始 */
+static uint8_t s_posted = 0;                /* 本帧已排队的频段数 */
+static volatile uint8_t s_received = 0;     /* 本帧已读回的频段数 (中断中写) */
+static volatile uint16_t s_raw[SPECTRUM_BANDS];
+static uint8_t s_drawn[SPECTRUM_BANDS];     /* 屏幕上每个频段柱的高度(像素) */
+static bool s_silent = true;                /* 屏幕上全部为0 */
+static uint32_t s_last_tick = 0;
+static uint32_t s_window_start = 0;         /* CPU占用统计窗口起点(周期) */
+static uint32_t s_window_busy = 0;          /* 窗口内任务耗时(周期) */
+static SpectrumStats_t s_stats;
+
+/* ============================================================================
+ * 读取
+ * ============================================================================ */
+
+/**
+ * @brief       SCI_WRAM读完成回调 (送数器中断中执行)
+ * @param       addr: 寄存器地址
+ * @param       value: 频段电平
+ * @retval      无
+ */
+static void spectrum_read_cb(uint8_t addr, uint16_t value)
+{
+    (void)addr;
+
+    if (s_received < SPECTRUM_BANDS) {
+        s_raw[s_received++] = value;
+    }
+}
+
+/**
+ * @brief       在命令队列有空间时排队读取下一批频段
+ * @note        每批先写SCI_WRAMADDR, 队列按顺序执行, 读回的值按频段顺序到达
+ * @param       无
+ * @retval      无
+ */
+static void spectrum_post(void)
+{
+    uint8_t n = SPECTRUM_BANDS - s_posted;
+    uint8_t i;
+
+    if (n > SPECTRUM_CHUNK) {
+        n = SPECTRUM_CHUNK;
+    }
+    if (n == 0) {
+        return;
+    }
+    if (vs1053_sci_queue_pending() + 1 + n > VS1053_SCI_QUEUE_SIZE) {
+        s_stats.skipped++;      /* 下次任务再试 */
+        return;
+    }
+
+    vs1053_sci_post_write(SPI_WRAMADDR, SPECTRUM_WRAM_DATA + s_posted);
+    for (i = 0; i < n; i++) {
+        vs1053_sci_post_read(SPI_WRAM, spectrum_read_cb);
+    }
+    s_posted += n;
+}
+
+/* ============================================================================
+ * 显示
+ * ============================================================================ */
+
+/**
+ * @brief       把一个频段柱改为新高度, 只重画变化的一段
+ * @param       band: 频段
+ * @param       height: 新高度(像素)
+ * @retval      无
+ */
+static void spectrum_draw_bar(uint8_t band, uint8_t height)
+{
+    uint16_t x = SPECTRUM_X + band * (SPECTRUM_BAR_W + SPECTRUM_BAR_GAP);
+    uint16_t bottom = SPECTRUM_Y + SPECTRUM_HEIGHT - 1;
+    uint8_t old = s_drawn[band];
+
+    if (height > old) {
+        lcd_fill_window(x, bottom - height + 1, x + SPECTRUM_BAR_W - 1, bottom - old, SPECTRUM_BAR_COLOR);
+        s_stats.pixels += (uint32_t)(height - old) * SPECTRUM_BAR_W;
+    } else if (height < old) {
+        lcd_fill_window(x, bottom - old + 1, x + SPECTRUM_BAR_W - 1, bottom - height, SPECTRUM_BACK_COLOR);
+        s_stats.pixels += (uint32_t)(old - height) * SPECTRUM_BAR_W;
+    }
+    s_drawn[band] = height;
+}
+
+/**
+ * @brief       按读回的电平更新全部频段柱
+ * @param       silent: true: 全部画为0 (停止/暂停)
+ * @retval      无
+ */
+static void spectrum_render(bool silent)
+{
+    uint8_t i;
+    uint16_t level;
+
+    for (i = 0; i < SPECTRUM_BANDS; i++) {
+        level = silent ? 0 : (s_raw[i] & SPECTRUM_LEVEL_MASK);
+        if (level > SPECTRUM_LEVEL_MAX) {
+            level = SPECTRUM_LEVEL_MAX;
+        }
+        spectrum_draw_bar(i, (uint8_t)(level * SPECTRUM_HEIGHT / SPECTRUM_LEVEL_MAX));
+    }
+    s_silent = silent;
+}
+
+/**
+ * @brief       统计CPU占用, 每秒更新一次 (在遥测报告中读出)
+ * @param       busy: 本次任务耗时(周期)
+ * @retval      无
+ */
+static void spectrum_account(uint32_t busy)
+{
+    uint32_t now = perf_counter_now();
+    uint32_t elapsed = now - s_window_start;
+    uint32_t us = perf_cycles_to_us(busy);
+
+    if (us > s_stats.max_us) {
+        s_stats.max_us = us;
+    }
+    s_window_busy += busy;
+
+    if (elapsed < SystemCoreClock) {
+        return;
+    }
+
+    s_stats.load_permille = (uint16_t)((uint64_t)s_window_busy * 1000 / elapsed);
+    s_window_start = now;
+    s_window_busy = 0;
+}
+
+/* ============================================================================
+ * 接口
+ * ============================================================================ */
+
+/**
+ * @brief       频谱插件已加载时启用频谱显示
+ * @param       无
+ * @retval      true: 已启用
+ */
+bool audio_spectrum_init(void)
+{
+    const VS1053_Plugin_t *plugin = vs1053_plugin_find(VS1053_PLUGIN_SPECTRUM);
+
+    audio_spectrum_enable(plugin != NULL && plugin->loaded);
+    return s_enabled;
+}
+
+/**
+ * @brief       启用/关闭频谱显示
+ * @note        启用时清空显示区域, 频段柱从0开始重画
+ * @param       enable: true启用
+ * @retval      无
+ */
+void audio_spectrum_enable(bool enable)
+{
+    if (!enable && s_enabled) {
+        spectrum_render(true);
+    } else if (enable && !s_enabled) {
+        lcd_fill(SPECTRUM_X, SPECTRUM_Y, SPECTRUM_X + SPECTRUM_BANDS * (SPECTRUM_BAR_W + SPECTRUM_BAR_GAP) - 1,
+                 SPECTRUM_Y + SPECTRUM_HEIGHT - 1, SPECTRUM_BACK_COLOR);
+        memset(s_drawn, 0, sizeof(s_drawn));
+        s_silent = true;
+    }
+
+    s_enabled = enable;
+    s_reading = false;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_window_start = perf_counter_now();
+    s_window_busy = 0;
+}
+
+/**
+ * @brief       频谱显示是否启用
+ * @param       无
+ * @retval      true: 已启用
+ */
+bool audio_spectrum_enabled(void)
+{
+    return s_enabled;
+}
+
+/**
+ * @brief       频谱任务: 按SPECTRUM_RATE_HZ排队读取电平, 读齐后重画
+ * @note        不直接访问VS1053, 读取由送数器中断在SDI突发之间完成
+ * @param       无
+ * @retval      无
+ */
+void audio_spectrum_task(void)
+{
+    uint32_t t0;
+    uint32_t tick;
+
+    if (!s_enabled) {
+        return;
+    }
+
+    t0 = perf_counter_now();
+
+    if (!audio_player_is_playing()) {
+        /* 停止/暂停时柱子归零, 放弃本帧 */
+        if (!s_silent) {
+            spectrum_render(true);
+        }
+        s_reading = false;
+        return;
+    }
+
+    if (s_reading) {
+        if (s_posted < SPECTRUM_BANDS) {
+            spectrum_post();
+        } else if (s_received == SPECTRUM_BANDS) {
+            spectrum_render(false);
+            s_stats.frames++;
+            s_reading = false;
+        }
+    } else {
+        tick = HAL_GetTick();
+        if (tick - s_last_tick < 1000 / SPECTRUM_RATE_HZ) {
+            return;
+        }
+        s_last_tick = tick;
+
+        if (s_received != s_posted) {
+            s_stats.skipped++;  /* 放弃的上一帧还有读取在队列中, 等它们返回 */
+            return;
+        }
+        s_reading = true;
+        s_posted = 0;
+        s_received = 0;
+        spectrum_post();
+    }
+
+    spectrum_account(perf_counter_now() - t0);
+}
+
+/**
+ * @brief       获取频谱统计
+ * @param       stats: 输出
+ * @retval      无
+ */
+void audio_spectrum_get_stats(SpectrumStats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,54 @@
+#ifndef AUDIO_SPECTRUM_H
+#define AUDIO_SPECTRUM_H
+
+#include "main.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 频谱显示 (VS1053频谱分析插件)
+ * 各频段电平在VS1053的X RAM中, 按固定频率排队读取: 写SCI_WRAMADDR后连续读
+ * SCI_WRAM, 由送数器中断在两次SDI突发之间执行, 主循环不等待总线。
+ * 显示时每个频段只重画柱顶变化的一段, 用窗口填充一次写完。
+ */
+
+/* 频谱分析插件的参数区 */
+#define SPECTRUM_WRAM_BANDS     0x1802  /* 频段数 */
+#define SPECTRUM_WRAM_DATA      0x1804  /* 各频段电平, bit5:0为当前值 */
+#define SPECTRUM_LEVEL_MASK     0x003F
+#define SPECTRUM_LEVEL_MAX      31      /* 满刻度 */
+
+#define SPECTRUM_BANDS          14      /* 插件默认频段数, 一次读取占15个SCI队列项 */
+#define SPECTRUM_RATE_HZ        25      /* 刷新频率 */
+
+/* 显示区域: 中间调试区的上半部分(y 140-195), 播放时没有别的内容写这里;
+ * 状态行从y=200开始, 曲目信息区(y 320-400)由播放器和按键处理清屏重写 */
+#define SPECTRUM_X              10
+#define SPECTRUM_Y              140
+#define SPECTRUM_HEIGHT         56
+#define SPECTRUM_BAR_W          19
+#define SPECTRUM_BAR_GAP        2
+
+/* 统计 */
+typedef struct {
+    uint32_t frames;            /* 已显示的帧数 */
+    uint32_t skipped;           /* 命令队列空间不够, 推迟读取的次数 */
+    uint32_t pixels;            /* 重画的像素数 */
+    uint16_t load_permille;     /* 最近1秒CPU占用(千分比) */
+    uint32_t max_us;            /* 单次任务最长耗时 */
+} SpectrumStats_t;
+
+bool audio_spectrum_init(void);                 /* 频谱插件已加载时启用 */
+void audio_spectrum_enable(bool enable);
+bool audio_spectrum_enabled(void);
+void audio_spectrum_task(void);                 /* 主循环调用 */
+void audio_spectrum_get_stats(SpectrumStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_SPECTRUM_H
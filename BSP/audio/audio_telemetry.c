@@ -0,0 +1,501 @@
+#include "audio_telemetry.h"
+#include "audio_player.h"
+#include "audio_ringbuf.h"
+#include "audio_spectrum.h"
+#include "audio_eq.h"
+#include "audio_recorder.h"
+#include "uart_stream.h"
+#include "stream_bench.h"
+#include "sdio_sdcard.h"
+#include "sd_cache.h"
+#include "vs1053_feeder.h"
+#include "nt35310_alientek.h"
+#include "perf_counter.h"
+#include "usart.h"
+#include <stdio.h>
+#include <string.h>
+
+/* 报告的固定行, 之后每个直方图一行 */
+typedef enum {
+    TELEM_LINE_BUF = 0,
+    TELEM_LINE_SD,
+    TELEM_LINE_FEED,
+    TELEM_LINE_TASK,
+    TELEM_LINE_TRANSITION,
+    TELEM_LINE_FEED_COST,
+    TELEM_LINE_SPECTRUM,
+    TELEM_LINE_EQ,
+    TELEM_LINE_REC,
+    TELEM_LINE_UART,
+    TELEM_LINE_SDIO,
+    TELEM_LINE_CACHE,
+    TELEM_LINE_FIRST,
+    TELEM_LINE_REGS,
+    TELEM_LINE_TTFS,
+    TELEM_LINE_HIST
+} TelemLine_t;
+
+/* 全局变量定义 */
+Telemetry_t g_telemetry;
+
+/* 私有变量 */
+static const char *const s_hist_names[TELEM_HISTS] = {
+    "SD read", "DREQ wait", "Task", "Seek", "Switch", "EQ block", "SD write"
+};
+static bool s_page = false;                 /* LCD状态页已打开 */
+static uint8_t s_page_line = 0;             /* 状态页下一次刷新的行 */
+static uint32_t s_page_tick = 0;
+static int16_t s_report_line = -1;          /* 正在输出的报告行, -1表示未输出 */
+static TelemFormat_t s_report_format = audio_telemetry_format;  /* 正在输出的报告 */
+static char s_tx[TELEM_LINE_LEN + 2];       /* 串口发送缓冲区, 中断发送期间保持有效 */
+
+/* ============================================================================
+ * 统计计算
+ * ============================================================================ */
+
+/**
+ * @brief       统计起点以来的平均速率
+ * @param       bytes: 字节数
+ * @retval      KB/s
+ */
+static uint32_t telem_kb_per_sec(uint32_t bytes)
+{
+    uint32_t ms = HAL_GetTick() - g_telemetry.start_tick;
+
+    if (ms == 0) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)bytes * 1000U / 1024U / ms);
+}
+
+/**
+ * @brief       直方图平均值
+ * @param       id: 直方图
+ * @retval      微秒
+ */
+static uint32_t telem_hist_avg_us(TelemHistId_t id)
+{
+    const TelemHist_t *h = &g_telemetry.hist[id];
+
+    if (h->count == 0) {
+        return 0;
+    }
+    return perf_cycles_to_us((uint32_t)(h->sum / h->count));
+}
+
+/**
+ * @brief       直方图百分位, 取所在档的上限
+ * @param       id: 直方图
+ * @param       percent: 百分位(1-100)
+ * @retval      微秒, 没有数据时返回0
+ */
+uint32_t audio_telemetry_hist_us(TelemHistId_t id, uint8_t percent)
+{
+    const TelemHist_t *h = &g_telemetry.hist[id];
+    uint32_t target = (uint32_t)(((uint64_t)h->count * percent + 99U) / 100U);
+    uint32_t seen = 0;
+    uint8_t bin;
+
+    if (h->count == 0) {
+        return 0;
+    }
+
+    for (bin = 0; bin < TELEM_HIST_BINS - 1; bin++) {
+        seen += h->bins[bin];
+        if (seen >= target) {
+            uint32_t upper = 1UL << (TELEM_HIST_SHIFT + bin);
+            return perf_cycles_to_us((upper < h->max) ? upper : h->max);
+        }
+    }
+    return perf_cycles_to_us(h->max);
+}
+
+/* ============================================================================
+ * 报告
+ * ============================================================================ */
+
+/**
+ * @brief       格式化报告的一行
+ * @note        前TELEM_PAGE_LINES行也用于LCD状态页, 不超过50个字符
+ * @param       line: 行号
+ * @param       buf: 输出
+ * @param       size: buf大小
+ * @retval      true: 已输出, false: 没有该行
+ */
+bool audio_telemetry_format(uint8_t line, char *buf, uint16_t size)
+{
+    switch (line) {
+        case TELEM_LINE_BUF: {
+            uint32_t avg = g_telemetry.fill_samples ?
+                           (uint32_t)(g_telemetry.fill_sum / g_telemetry.fill_samples) : 0;
+            uint32_t min = g_telemetry.fill_samples ? g_telemetry.fill_min : 0;
+            snprintf(buf, size, "Buf %uK: min %lu avg %lu underrun %lu",
+                     AUDIO_RINGBUF_SIZE / 1024, min, avg, g_telemetry.counters[TELEM_UNDERRUN]);
+            break;
+        }
+
+        case TELEM_LINE_SD:
+            snprintf(buf, size, "SD: %lu KB/s avg %lu max %lu us direct %lu/%lu err %lu",
+                     telem_kb_per_sec(g_telemetry.counters[TELEM_SD_BYTES]),
+                     telem_hist_avg_us(TELEM_HIST_SD_READ),
+                     perf_cycles_to_us(g_telemetry.hist[TELEM_HIST_SD_READ].max),
+                     g_telemetry.counters[TELEM_SD_DIRECT], g_telemetry.counters[TELEM_SD_READS],
+                     g_telemetry.counters[TELEM_SD_ERRORS]);
+            break;
+
+        case TELEM_LINE_FEED:
+            snprintf(buf, size, "Feed: %lu KB/s DREQ wait avg %lu max %lu us",
+                     telem_kb_per_sec(g_telemetry.counters[TELEM_FEED_BYTES]),
+                     telem_hist_avg_us(TELEM_HIST_DREQ_WAIT),
+                     perf_cycles_to_us(g_telemetry.hist[TELEM_HIST_DREQ_WAIT].max));
+            break;
+
+        case TELEM_LINE_TASK: {
+            uint32_t ms = HAL_GetTick() - g_telemetry.start_tick;
+            snprintf(buf, size, "Task: avg %lu max %lu us, %lu loop/s",
+                     telem_hist_avg_us(TELEM_HIST_TASK),
+                     perf_cycles_to_us(g_telemetry.hist[TELEM_HIST_TASK].max),
+                     ms ? (uint32_t)((uint64_t)g_telemetry.counters[TELEM_MAIN_LOOPS] * 1000U / ms) : 0);
+            break;
+        }
+
+        case TELEM_LINE_TRANSITION: {
+            AudioTransition_t t;
+            audio_player_get_transition(&t);
+            snprintf(buf, size, "Tracks %lu gapless %lu cancel %lu gap %lu us pad %u%s",
+                     g_telemetry.counters[TELEM_TRACKS], t.gapless, t.cancelled,
+                     t.last_gap_us, t.last_pad, t.last_underrun ? " UNDERRUN" : "");
+            break;
+        }
+
+        case TELEM_LINE_FEED_COST:
+            /* 送数开销: DMA送数器 vs 轮询送数 (每KB消耗的CPU周期) */
+            snprintf(buf, size, "Feed cost: DMA %lu cyc/KB, poll %lu cyc/KB",
+                     vs1053_feeder_cycles_per_kb(VS1053_FEED_DMA),
+                     vs1053_feeder_cycles_per_kb(VS1053_FEED_POLLED));
+            break;
+
+        case TELEM_LINE_SPECTRUM: {
+            SpectrumStats_t st;
+            audio_spectrum_get_stats(&st);
+            snprintf(buf, size, "Spectrum: %s %u.%u%% cpu max %lu us frames %lu",
+                     audio_spectrum_enabled() ? "on" : "off", st.load_permille / 10,
+                     st.load_permille % 10, st.max_us, st.frames);
+            break;
+        }
+
+        case TELEM_LINE_EQ: {
+            /* 每块平均/最长耗时与该块播放时长的比例 */
+            AudioEqStats_t st;
+            const TelemHist_t *h = &g_telemetry.hist[TELEM_HIST_EQ];
+            uint32_t avg = h->count ? (uint32_t)(h->sum / h->count) : 0;
+            uint32_t load;
+
+            audio_eq_get_stats(&st);
+            load = st.budget_cycles ? (uint32_t)((uint64_t)avg * 1000U / st.budget_cycles) : 0;
+            snprintf(buf, size, "EQ: %s %luHz %uch avg %lu max %lu/%lu us %lu.%lu%%",
+                     !audio_eq_enabled() ? "off" : (st.active ? "on" : "idle"),
+                     st.sample_rate, st.channels, perf_cycles_to_us(avg),
+                     perf_cycles_to_us(h->max), perf_cycles_to_us(st.budget_cycles),
+                     load / 10, load % 10);
+            break;
+        }
+
+        case TELEM_LINE_REC: {
+            /* 已录时长/字节, 卡忙推迟次数, 丢弃采样数, 编码器FIFO和缓冲区峰值 */
+            AudioRecStats_t st;
+            audio_recorder_get_stats(&st);
+            snprintf(buf, size, "Rec: %s %lus %luKB defer %lu drop %lu fifo %u/%lu ring %lu",
+                     st.recording ? "on" : (st.last_error ? "err" : "off"), st.seconds,
+                     st.bytes / 1024U, st.busy_defers, st.dropped_samples,
+                     st.fifo_peak, st.fifo_danger, st.ring_peak);
+            break;
+        }
+
+        case TELEM_LINE_UART: {
+            /* 串口送流: 收到字节数和速率, 起播时间, 最低水位, 送空/超额/串口错误 */
+            UartStreamStats_t st;
+            uart_stream_get_stats(&st);
+            snprintf(buf, size, "UART: %s %luKB %lu KB/s ttf %lu ms min %lu u%lu o%lu e%lu",
+                     st.active ? "on" : "off", st.received / 1024U,
+                     st.elapsed_ms ? (uint32_t)((uint64_t)st.received * 1000U / 1024U / st.elapsed_ms) : 0,
+                     st.first_feed_ms, st.min_fill, st.underruns, st.overruns, st.rx_errors);
+            break;
+        }
+
+        case TELEM_LINE_SDIO: {
+            /* SDIO总线: 调整选定的位宽/时钟和测试读速率, 运行中CRC/超时错误和降档次数 */
+            SdBusConfig_t bus;
+            sd_bus_get_config(&bus);
+            snprintf(buf, size, "SDIO: %u-bit %lu kHz test %lu KB/s crc %lu to %lu fb %lu",
+                     bus.bus_width, bus.clock_khz, bus.tune_kbps,
+                     bus.crc_errors, bus.timeouts, bus.fallbacks);
+            break;
+        }
+
+        case TELEM_LINE_CACHE: {
+            /* 扇区缓存: 单扇区读命中/未命中, 预读次数/预读命中, 多扇区直接读, 读卡命令数 */
+            SdCacheStats_t st;
+            sd_cache_get_stats(&st);
+            snprintf(buf, size, "Cache: hit %lu miss %lu pf %lu/%lu byp %lu cmd %lu",
+                     st.hits, st.misses, st.prefetch_hits, st.prefetches,
+                     st.bypass, st.card_reads);
+            break;
+        }
+
+        case TELEM_LINE_FIRST: {
+            const uint8_t *b = g_telemetry.first;
+            snprintf(buf, size, "1st: %02X %02X %02X %02X %02X %02X %02X %02X (%s)",
+                     b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7],
+                     (b[0] == 0xFF && (b[1] & 0xE0) == 0xE0) ? "MP3 frame" : "no MP3 frame");
+            break;
+        }
+
+        case TELEM_LINE_REGS: {
+            /* 影子中有的寄存器不占用总线, 其余由送数器在突发之间读 */
+            uint16_t regs[16];
+            vs1053_read_regs((1U << SPI_MODE) | (1U << SPI_STATUS) | (1U << SPI_VOL) |
+                             (1U << SPI_AUDATA) | (1U << SPI_HDAT0) | (1U << SPI_HDAT1), regs);
+            snprintf(buf, size, "Regs: M %04X S %04X V %04X A %04X H %04X %04X",
+                     regs[SPI_MODE], regs[SPI_STATUS], regs[SPI_VOL],
+                     regs[SPI_AUDATA], regs[SPI_HDAT0], regs[SPI_HDAT1]);
+            break;
+        }
+
+        case TELEM_LINE_TTFS:
+            snprintf(buf, size, "TTFS ms: L%lu O%lu D%lu B%lu F%lu S%lu",
+                     audio_player_bench_get(AUDIO_PHASE_LIST) / 1000,
+                     audio_player_bench_get(AUDIO_PHASE_OPEN) / 1000,
+                     audio_player_bench_get(AUDIO_PHASE_DECODER) / 1000,
+                     audio_player_bench_get(AUDIO_PHASE_PREBUFFER) / 1000,
+                     audio_player_bench_get(AUDIO_PHASE_FEED) / 1000,
+                     audio_player_bench_get(AUDIO_PHASE_SOUND) / 1000);
+            break;
+
+        default: {
+            TelemHistId_t id;
+
+            if (line - TELEM_LINE_HIST >= TELEM_HISTS) {
+                return false;
+            }
+            id = (TelemHistId_t)(line - TELEM_LINE_HIST);
+            snprintf(buf, size, "%s: n %lu p50 %lu p90 %lu p99 %lu max %lu us",
+                     s_hist_names[id], g_telemetry.hist[id].count,
+                     audio_telemetry_hist_us(id, 50), audio_telemetry_hist_us(id, 90),
+                     audio_telemetry_hist_us(id, 99), perf_cycles_to_us(g_telemetry.hist[id].max));
+            break;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief       开始通过USART1输出报告, 由audio_telemetry_task逐行中断发送
+ * @param       无
+ * @retval      无
+ */
+void audio_telemetry_report(void)
+{
+    audio_telemetry_print(audio_telemetry_format);
+}
+
+/**
+ * @brief       通过USART1逐行输出其他模块的报告, 由audio_telemetry_task逐行中断发送
+ * @note        正在输出的报告被打断, 从新报告的第0行开始
+ * @param       format: 报告格式化函数
+ * @retval      无
+ */
+void audio_telemetry_print(TelemFormat_t format)
+{
+    s_report_format = format;
+    s_report_line = 0;
+}
+
+/**
+ * @brief       上一行发送完成后发送下一行
+ * @param       无
+ * @retval      无
+ */
+static void telem_report_step(void)
+{
+    uint16_t n;
+
+    if (s_report_line < 0 || huart1.gState != HAL_UART_STATE_READY) {
+        return;
+    }
+
+    if (!s_report_format((uint8_t)s_report_line, s_tx, TELEM_LINE_LEN)) {
+        s_report_line = -1;
+        return;
+    }
+    s_report_line++;
+
+    n = (uint16_t)strlen(s_tx);
+    s_tx[n++] = '\r';
+    s_tx[n++] = '\n';
+    HAL_UART_Transmit_IT(&huart1, (uint8_t *)s_tx, n);
+}
+
+/**
+ * @brief       处理USART1收到的命令 (查询接收标志, 不占用接收中断)
+ * @param       无
+ * @retval      无
+ */
+static void telem_uart_poll(void)
+{
+    uint8_t cmd;
+
+    /* 串口送流期间接收由DMA占用 */
+    if (uart_stream_busy() || __HAL_UART_GET_FLAG(&huart1, UART_FLAG_RXNE) == RESET) {
+        return;
+    }
+    cmd = (uint8_t)(huart1.Instance->DR & 0xFF);
+
+    switch (cmd) {
+        case '?':
+            audio_telemetry_report();
+            break;
+        case 'r':
+            audio_telemetry_reset();
+            break;
+        case 'p':
+            audio_telemetry_page(!s_page);
+            break;
+        case 'b':
+            stream_bench_start();
+            break;
+        case 'e':
+            audio_eq_enable(!audio_eq_enabled());
+            break;
+        case 'R':
+            if (audio_recorder_busy()) {
+                audio_recorder_stop();
+            } else {
+                audio_recorder_start();
+            }
+            break;
+        case 'S':
+            uart_stream_start();
+            break;
+        default:
+            break;
+    }
+}
+
+/* ============================================================================
+ * LCD状态页
+ * ============================================================================ */
+
+/**
+ * @brief       刷新状态页的一行
+ * @param       无
+ * @retval      无
+ */
+static void telem_page_step(void)
+{
+    uint32_t tick = HAL_GetTick();
+    char str[TELEM_LINE_LEN];
+    uint16_t n;
+
+    if (!s_page || tick - s_page_tick < TELEM_PAGE_INTERVAL_MS) {
+        return;
+    }
+    s_page_tick = tick;
+
+    audio_telemetry_format(s_page_line, str, sizeof(str));
+    for (n = (uint16_t)strlen(str); n < 50; n++) {
+        str[n] = ' ';   /* 覆盖上次较长的内容 */
+    }
+    str[n] = '\0';
+    lcd_show_string(10, TELEM_PAGE_Y + s_page_line * 20, 300, 16, 12, str, BLUE);
+
+    s_page_line = (s_page_line + 1) % TELEM_PAGE_LINES;
+}
+
+/**
+ * @brief       打开/关闭LCD状态页
+ * @param       enable: true打开
+ * @retval      无
+ */
+void audio_telemetry_page(bool enable)
+{
+    if (s_page && !enable) {
+        lcd_fill(10, TELEM_PAGE_Y, 310, TELEM_PAGE_Y + TELEM_PAGE_LINES * 20 - 1, WHITE);
+    }
+    s_page = enable;
+    s_page_line = 0;
+}
+
+/**
+ * @brief       LCD状态页是否打开
+ * @param       无
+ * @retval      true: 已打开
+ */
+bool audio_telemetry_page_enabled(void)
+{
+    return s_page;
+}
+
+/* ============================================================================
+ * 接口
+ * ============================================================================ */
+
+/**
+ * @brief       初始化遥测
+ * @param       无
+ * @retval      无
+ */
+void audio_telemetry_init(void)
+{
+    audio_telemetry_reset();
+    s_page = AUDIO_TELEMETRY_PAGE;
+}
+
+/**
+ * @brief       清零统计 (保留当前曲目的前8个字节)
+ * @param       无
+ * @retval      无
+ */
+void audio_telemetry_reset(void)
+{
+    uint8_t first[8];
+
+    memcpy(first, g_telemetry.first, sizeof(first));
+
+    __disable_irq();
+    memset(&g_telemetry, 0, sizeof(g_telemetry));
+    __enable_irq();
+    sd_cache_reset_stats();
+
+    memcpy(g_telemetry.first, first, sizeof(first));
+    g_telemetry.fill_min = 0xFFFFFFFF;
+    g_telemetry.start_tick = HAL_GetTick();
+}
+
+/**
+ * @brief       记录新曲目开始送数
+ * @param       buf: 送出的第一段数据
+ * @param       len: 字节数
+ * @retval      无
+ */
+void audio_telemetry_track(const uint8_t *buf, uint32_t len)
+{
+    memset(g_telemetry.first, 0, sizeof(g_telemetry.first));
+    memcpy(g_telemetry.first, buf, (len < sizeof(g_telemetry.first)) ? len : sizeof(g_telemetry.first));
+    g_telemetry.counters[TELEM_TRACKS]++;
+}
+
+/**
+ * @brief       遥测任务 (主循环调用)
+ * @param       无
+ * @retval      无
+ */
+void audio_telemetry_task(void)
+{
+    g_telemetry.counters[TELEM_MAIN_LOOPS]++;
+
+    telem_uart_poll();
+    telem_report_step();
+    telem_page_step();
+}
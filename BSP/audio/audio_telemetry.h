@@ -0,0 +1,172 @@
+#ifndef AUDIO_TELEMETRY_H
+#define AUDIO_TELEMETRY_H
+
+#include "main.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 播放遥测
+ * 热路径(读卡/送数中断/播放任务)只做计数和直方图累加, 不格式化也不画屏;
+ * 需要时再读出: USART1收到命令时逐行输出完整报告, 或打开低速状态页,
+ * 在LCD上每次只刷新一行。播放流程中原来的调试显示都改为在这里读出。
+ *
+ * USART1命令(单字节):
+ *   '?'  输出报告     'r'  清零统计     'p'  打开/关闭LCD状态页
+ *   'b'  送数吞吐量测试(stream_bench), 完成后输出结果
+ *   'e'  打开/关闭WAV均衡器
+ *   'R'  开始/停止录音(audio_recorder)
+ *   'S'  串口送流(uart_stream), 之后接收由DMA占用, 会话结束前不再响应命令
+ */
+
+#ifndef AUDIO_TELEMETRY_PAGE
+#define AUDIO_TELEMETRY_PAGE        0       /* 1: 上电即显示LCD状态页 */
+#endif
+
+#define TELEM_PAGE_INTERVAL_MS      500     /* 状态页每次刷新一行的间隔 */
+#define TELEM_PAGE_Y                400     /* 状态页第一行位置 */
+#define TELEM_PAGE_LINES            4       /* 状态页显示报告的前几行 */
+#define TELEM_LINE_LEN              64      /* 报告每行最长字符数 */
+
+#define TELEM_HIST_BINS             16      /* 直方图档数, 最后一档不封顶 */
+#define TELEM_HIST_SHIFT            10      /* 第0档 < 1024周期(72MHz下约14us), 之后每档翻倍 */
+
+/* 计数器 */
+typedef enum {
+    TELEM_UNDERRUN = 0,         /* 播放中缓冲区被送空(文件未读完) */
+    TELEM_SD_READS,             /* 预读f_read次数 */
+    TELEM_SD_BYTES,             /* 预读字节数 */
+    TELEM_SD_ERRORS,            /* 预读出错次数 */
+    TELEM_SD_DIRECT,            /* 预读中按扇区直接读卡(连续文件)的次数 */
+    TELEM_FEED_BYTES,           /* 送入VS1053的字节数 */
+    TELEM_TRACKS,               /* 开始送数的曲目数 */
+    TELEM_MAIN_LOOPS,           /* 主循环次数 */
+    TELEM_COUNTERS
+} TelemCounter_t;
+
+/* 直方图 (按CPU周期分档) */
+typedef enum {
+    TELEM_HIST_SD_READ = 0,     /* 一次预读f_read */
+    TELEM_HIST_DREQ_WAIT,       /* 有数据要送但DREQ为低 -> DREQ上升沿 */
+    TELEM_HIST_TASK,            /* 一次audio_player_task */
+    TELEM_HIST_SEEK,            /* 一次定位 */
+    TELEM_HIST_SWITCH,          /* 换曲: 请求/上一首送完 -> 新曲目开始送数 */
+    TELEM_HIST_EQ,              /* WAV均衡器处理一块(AUDIO_EQ_BLOCK个采样) */
+    TELEM_HIST_REC_WRITE,       /* 录音写卡一次(不含卡内编程) */
+    TELEM_HISTS
+} TelemHistId_t;
+
+typedef struct {
+    uint32_t bins[TELEM_HIST_BINS];
+    uint32_t count;
+    uint32_t max;               /* 最长(周期) */
+    uint64_t sum;               /* 合计(周期) */
+} TelemHist_t;
+
+/* 遥测数据 (中断和主循环各自只写自己的字段) */
+typedef struct {
+    volatile uint32_t counters[TELEM_COUNTERS];
+    TelemHist_t hist[TELEM_HISTS];
+    uint32_t fill_min;          /* 缓冲区最低水位(字节) */
+    uint32_t fill_samples;      /* 水位采样次数 */
+    uint64_t fill_sum;
+    bool starved;               /* 上次采样时已送空, 一次送空只计一次 */
+    uint8_t first[8];           /* 当前曲目送出的前8个字节 */
+    uint32_t start_tick;        /* 统计起点(HAL_GetTick) */
+} Telemetry_t;
+
+/* 报告格式化函数: 格式化第line行, 没有该行返回false */
+typedef bool (*TelemFormat_t)(uint8_t line, char *buf, uint16_t size);
+
+extern Telemetry_t g_telemetry;
+
+/* 初始化和读出 */
+void audio_telemetry_init(void);
+void audio_telemetry_reset(void);                               /* 清零统计 */
+void audio_telemetry_task(void);                                /* 主循环调用: 处理串口命令, 输出报告, 刷新状态页 */
+void audio_telemetry_report(void);                              /* 开始通过USART1输出报告 */
+void audio_telemetry_print(TelemFormat_t format);               /* 通过USART1逐行输出其他模块的报告 */
+void audio_telemetry_page(bool enable);                         /* 打开/关闭LCD状态页 */
+bool audio_telemetry_page_enabled(void);
+bool audio_telemetry_format(uint8_t line, char *buf, uint16_t size);   /* 格式化报告第line行, 没有该行返回false */
+uint32_t audio_telemetry_hist_us(TelemHistId_t id, uint8_t percent);   /* 直方图百分位(档上限, 微秒) */
+void audio_telemetry_track(const uint8_t *buf, uint32_t len);   /* 新曲目开始送数 */
+
+/* ============================================================================
+ * 热路径更新 (几条指令)
+ * ============================================================================ */
+
+/**
+ * @brief       计数器加1
+ * @param       id: 计数器
+ * @retval      无
+ */
+static inline void audio_telemetry_inc(TelemCounter_t id)
+{
+    g_telemetry.counters[id]++;
+}
+
+/**
+ * @brief       计数器加n
+ * @param       id: 计数器
+ * @param       n: 增量
+ * @retval      无
+ */
+static inline void audio_telemetry_add(TelemCounter_t id, uint32_t n)
+{
+    g_telemetry.counters[id] += n;
+}
+
+/**
+ * @brief       记录一次耗时到直方图
+ * @param       id: 直方图
+ * @param       cycles: 耗时(CPU周期)
+ * @retval      无
+ */
+static inline void audio_telemetry_hist(TelemHistId_t id, uint32_t cycles)
+{
+    TelemHist_t *h = &g_telemetry.hist[id];
+    uint32_t v = cycles >> TELEM_HIST_SHIFT;
+    uint32_t bin = (v != 0) ? (32U - __CLZ(v)) : 0;
+
+    if (bin >= TELEM_HIST_BINS) {
+        bin = TELEM_HIST_BINS - 1;
+    }
+    h->bins[bin]++;
+    h->count++;
+    h->sum += cycles;
+    if (cycles > h->max) {
+        h->max = cycles;
+    }
+}
+
+/**
+ * @brief       缓冲区水位采样, 同时检测送空
+ * @param       fill: 当前填充量(字节)
+ * @param       expect: true: 此时应该有数据(播放中且文件未读完)
+ * @retval      无
+ */
+static inline void audio_telemetry_fill(uint32_t fill, bool expect)
+{
+    if (fill < g_telemetry.fill_min) {
+        g_telemetry.fill_min = fill;
+    }
+    g_telemetry.fill_sum += fill;
+    g_telemetry.fill_samples++;
+
+    if (fill != 0 || !expect) {
+        g_telemetry.starved = false;
+    } else if (!g_telemetry.starved) {
+        g_telemetry.starved = true;
+        g_telemetry.counters[TELEM_UNDERRUN]++;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_TELEMETRY_H
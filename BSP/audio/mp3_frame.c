@@ -0,0 +1,377 @@
+#include "mp3_frame.h"
+#include <string.h>
+
+/* 码率表 (kbps): [MPEG1/MPEG2(2.5)][层1-3][码率索引] */
+static const uint16_t s_bitrate[2][3][16] = {
+    {
+        {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0},
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 0},
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0}
+    },
+    {
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0}
+    }
+};
+
+/* MPEG1采样率, MPEG2减半, MPEG2.5减为1/4 */
+static const uint16_t s_sample_rate[3] = {44100, 48000, 32000};
+
+/* ============================================================================
+ * 帧头解析
+ * ============================================================================ */
+
+/**
+ * @brief       解析MPEG音频帧头
+ * @note        不支持自由码率(码率索引0), 这种帧无法从帧头算出长度
+ * @param       header: 帧头(大端拼成的32位)
+ * @param       info: 输出, 可为NULL
+ * @retval      true: 有效帧头
+ */
+bool mp3_frame_parse(uint32_t header, Mp3FrameInfo_t *info)
+{
+    uint8_t version = (header >> 19) & 3;
+    uint8_t layer = 4 - ((header >> 17) & 3);
+    uint8_t br_idx = (header >> 12) & 0xF;
+    uint8_t sr_idx = (header >> 10) & 3;
+    uint8_t padding = (header >> 9) & 1;
+    uint32_t bitrate;
+    uint32_t sample_rate;
+    uint32_t size;
+
+    if ((header & 0xFFE00000U) != 0xFFE00000U || version == 1 || layer == 4 ||
+        br_idx == 0 || br_idx == 0xF || sr_idx == 3) {
+        return false;
+    }
+
+    bitrate = s_bitrate[(version == MP3_VERSION_1) ? 0 : 1][layer - 1][br_idx];
+    sample_rate = s_sample_rate[sr_idx];
+    if (version == MP3_VERSION_2) {
+        sample_rate /= 2;
+    } else if (version == MP3_VERSION_25) {
+        sample_rate /= 4;
+    }
+
+    if (info == NULL) {
+        return true;
+    }
+
+    if (layer == 1) {
+        size = (12 * bitrate * 1000 / sample_rate + padding) * 4;
+        info->samples = 384;
+    } else if (layer == 2 || version == MP3_VERSION_1) {
+        size = 144 * bitrate * 1000 / sample_rate + padding;
+        info->samples = 1152;
+    } else {
+        size = 72 * bitrate * 1000 / sample_rate + padding;     /* MPEG2/2.5 Layer III */
+        info->samples = 576;
+    }
+
+    info->header = header;
+    info->version = version;
+    info->layer = layer;
+    info->channels = (((header >> 6) & 3) == 3) ? 1 : 2;
+    info->bitrate = (uint16_t)bitrate;
+    info->sample_rate = (uint16_t)sample_rate;
+    info->frame_size = (uint16_t)size;
+
+    return true;
+}
+
+/**
+ * @brief       在数据中查找帧边界
+ * @note        数据足够时要求下一帧头也有效且版本/层/采样率相同, 避免把音频数据中
+ *              偶然出现的0xFFE当成同步字; 数据不够判断下一帧时只看本帧头
+ * @param       buf: 数据
+ * @param       len: 字节数
+ * @param       info: 输出, 找到的帧, 可为NULL
+ * @retval      帧头在buf中的偏移, -1表示没有找到
+ */
+int32_t mp3_frame_find(const uint8_t *buf, uint32_t len, Mp3FrameInfo_t *info)
+{
+    Mp3FrameInfo_t cur;
+    uint32_t i;
+    uint32_t hdr;
+    uint32_t next;
+    const uint8_t *p;
+
+    for (i = 0; i + MP3_FRAME_HEADER_SIZE <= len; i++) {
+        if (buf[i] != 0xFF || (buf[i + 1] & 0xE0) != 0xE0) {
+            continue;
+        }
+
+        hdr = ((uint32_t)buf[i] << 24) | ((uint32_t)buf[i + 1] << 16) |
+              ((uint32_t)buf[i + 2] << 8) | buf[i + 3];
+        if (!mp3_frame_parse(hdr, &cur)) {
+            continue;
+        }
+
+        if (i + cur.frame_size + MP3_FRAME_HEADER_SIZE <= len) {
+            p = buf + i + cur.frame_size;
+            next = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+            if (!mp3_frame_parse(next, NULL) || mp3_frame_compat(next) != mp3_frame_compat(hdr)) {
+                continue;
+            }
+        }
+
+        if (info != NULL) {
+            *info = cur;
+        }
+        return (int32_t)i;
+    }
+
+    return -1;
+}
+
+/* ============================================================================
+ * VBR信息头
+ * ============================================================================ */
+
+#define MP3_XING_FRAMES         0x0001
+#define MP3_XING_BYTES          0x0002
+#define MP3_XING_TOC            0x0004
+#define MP3_XING_QUALITY        0x0008
+
+#define MP3_LAME_OFFSET         120     /* LAME扩展在完整Xing头(4+4+4+4+100+4)之后 */
+#define MP3_LAME_DELAY_OFFSET   21      /* 版本(9) 方式(1) 低通(1) 回放增益(8) 标志(1) 码率(1) */
+#define MP3_VBRI_OFFSET         36      /* 帧头(4) + 固定32字节 */
+#define MP3_VBRI_TOC_OFFSET     26
+
+static uint32_t mp3_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint16_t mp3_be16(const uint8_t *p)
+{
+    return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+/**
+ * @brief       Xing/Info头之后的LAME扩展: 编码延迟和尾部填充
+ * @param       p: Xing头起始
+ * @param       avail: p之后的可用字节数
+ * @param       vbr: 输出
+ * @retval      无
+ */
+static void mp3_lame_parse(const uint8_t *p, uint32_t avail, Mp3VbrInfo_t *vbr)
+{
+    const uint8_t *lame = p + MP3_LAME_OFFSET;
+
+    if (avail < MP3_LAME_OFFSET + MP3_LAME_DELAY_OFFSET + 3) {
+        return;
+    }
+    if (lame[0] != 'L' || lame[1] != 'A' || lame[2] != 'M' || lame[3] != 'E') {
+        return;
+    }
+
+    lame += MP3_LAME_DELAY_OFFSET;
+    vbr->enc_delay = (uint16_t)(((uint16_t)lame[0] << 4) | (lame[1] >> 4));
+    vbr->enc_padding = (uint16_t)(((uint16_t)(lame[1] & 0x0F) << 8) | lame[2]);
+}
+
+/**
+ * @brief       解析Xing/Info头
+ * @param       p: Xing头起始
+ * @param       avail: p之后的可用字节数
+ * @param       vbr: 输出
+ * @retval      true: 找到
+ */
+static bool mp3_xing_parse(const uint8_t *p, uint32_t avail, Mp3VbrInfo_t *vbr)
+{
+    uint32_t flags;
+    uint32_t off = 8;
+
+    if (avail < 8) {
+        return false;
+    }
+    if (p[0] == 'X' && p[1] == 'i' && p[2] == 'n' && p[3] == 'g') {
+        vbr->type = MP3_VBR_XING;
+    } else if (p[0] == 'I' && p[1] == 'n' && p[2] == 'f' && p[3] == 'o') {
+        vbr->type = MP3_VBR_INFO;
+    } else {
+        return false;
+    }
+
+    flags = mp3_be32(p + 4);
+    if ((flags & MP3_XING_FRAMES) && off + 4 <= avail) {
+        vbr->frames = mp3_be32(p + off);
+        off += 4;
+    }
+    if ((flags & MP3_XING_BYTES) && off + 4 <= avail) {
+        vbr->bytes = mp3_be32(p + off);
+        off += 4;
+    }
+    if ((flags & MP3_XING_TOC) && off + MP3_TOC_SIZE <= avail) {
+        memcpy(vbr->toc, p + off, MP3_TOC_SIZE);
+        vbr->has_toc = (vbr->bytes != 0);
+    }
+
+    mp3_lame_parse(p, avail, vbr);
+    return true;
+}
+
+/**
+ * @brief       解析VBRI头, 并把它的分段表换算成Xing格式的100项TOC
+ * @note        VBRI表的每一项是一段(帧数相同)的字节数, 累加到第i%段即得位置
+ * @param       p: VBRI头起始
+ * @param       avail: p之后的可用字节数
+ * @param       vbr: 输出
+ * @retval      true: 找到
+ */
+static bool mp3_vbri_parse(const uint8_t *p, uint32_t avail, Mp3VbrInfo_t *vbr)
+{
+    uint32_t entries;
+    uint32_t scale;
+    uint32_t entry_size;
+    uint32_t target;
+    uint32_t pos = 0;
+    uint32_t k = 0;
+    uint32_t i;
+    uint32_t j;
+    uint32_t val;
+    const uint8_t *tbl = p + MP3_VBRI_TOC_OFFSET;
+
+    if (avail < MP3_VBRI_TOC_OFFSET) {
+        return false;
+    }
+    if (p[0] != 'V' || p[1] != 'B' || p[2] != 'R' || p[3] != 'I') {
+        return false;
+    }
+
+    vbr->type = MP3_VBR_VBRI;
+    vbr->enc_delay = mp3_be16(p + 6);
+    vbr->bytes = mp3_be32(p + 10);
+    vbr->frames = mp3_be32(p + 14);
+    entries = mp3_be16(p + 18);
+    scale = mp3_be16(p + 20);
+    entry_size = mp3_be16(p + 22);
+
+    if (entries == 0 || entry_size == 0 || entry_size > 4 || vbr->bytes == 0 ||
+        MP3_VBRI_TOC_OFFSET + entries * entry_size > avail) {
+        return true;    /* 表不完整, 只用总帧数和总字节数 */
+    }
+
+    for (i = 0; i < MP3_TOC_SIZE; i++) {
+        target = i * entries / MP3_TOC_SIZE;
+        while (k < target) {
+            val = 0;
+            for (j = 0; j < entry_size; j++) {
+                val = (val << 8) | tbl[k * entry_size + j];
+            }
+            pos += val * scale;
+            k++;
+        }
+        val = (uint32_t)((uint64_t)pos * 256 / vbr->bytes);
+        vbr->toc[i] = (uint8_t)((val > 255) ? 255 : val);
+    }
+    vbr->has_toc = true;
+
+    return true;
+}
+
+/**
+ * @brief       解析第一帧中的VBR信息头
+ * @note        没有信息头时type为MP3_VBR_NONE, 仍填写码率/采样率供估算时长
+ * @param       buf: 数据, 从第一帧帧头开始
+ * @param       len: 字节数
+ * @param       vbr: 输出
+ * @retval      true: buf开头是有效帧头
+ */
+bool mp3_vbr_parse(const uint8_t *buf, uint32_t len, Mp3VbrInfo_t *vbr)
+{
+    Mp3FrameInfo_t frame;
+    uint32_t side;
+
+    memset(vbr, 0, sizeof(*vbr));
+
+    if (len < MP3_FRAME_HEADER_SIZE || !mp3_frame_parse(mp3_be32(buf), &frame)) {
+        return false;
+    }
+
+    vbr->samples = frame.samples;
+    vbr->sample_rate = frame.sample_rate;
+    vbr->bitrate = frame.bitrate;
+
+    if (len > frame.frame_size) {
+        len = frame.frame_size;     /* 信息头只在第一帧内 */
+    }
+
+    /* Xing头在Layer III边信息之后 */
+    if (frame.version == MP3_VERSION_1) {
+        side = (frame.channels == 1) ? 17 : 32;
+    } else {
+        side = (frame.channels == 1) ? 9 : 17;
+    }
+    if (MP3_FRAME_HEADER_SIZE + side < len &&
+        mp3_xing_parse(buf + MP3_FRAME_HEADER_SIZE + side, len - MP3_FRAME_HEADER_SIZE - side, vbr)) {
+        return true;
+    }
+
+    if (MP3_VBRI_OFFSET < len) {
+        mp3_vbri_parse(buf + MP3_VBRI_OFFSET, len - MP3_VBRI_OFFSET, vbr);
+    }
+    return true;
+}
+
+/**
+ * @brief       计算曲目时长
+ * @note        有总帧数时按帧数计算(扣除LAME延迟和填充), 否则按第一帧码率估算
+ * @param       vbr: mp3_vbr_parse的结果
+ * @param       data_bytes: 从第一帧到文件尾的字节数
+ * @retval      毫秒, 0表示未知
+ */
+uint32_t mp3_vbr_duration_ms(const Mp3VbrInfo_t *vbr, uint32_t data_bytes)
+{
+    uint64_t samples;
+
+    if (vbr->frames != 0 && vbr->sample_rate != 0) {
+        samples = (uint64_t)vbr->frames * vbr->samples;
+        if (samples > (uint32_t)vbr->enc_delay + vbr->enc_padding) {
+            samples -= (uint32_t)vbr->enc_delay + vbr->enc_padding;
+        }
+        return (uint32_t)(samples * 1000 / vbr->sample_rate);
+    }
+
+    if (vbr->bitrate != 0) {
+        return (uint32_t)((uint64_t)data_bytes * 8 / vbr->bitrate);     /* kbps即bit/ms */
+    }
+
+    return 0;
+}
+
+/**
+ * @brief       按TOC查找时间对应的位置
+ * @note        调用前确认has_toc; 相邻两项之间线性插值
+ * @param       vbr: mp3_vbr_parse的结果
+ * @param       ms: 目标时间
+ * @param       duration_ms: 曲目时长
+ * @retval      相对第一帧的字节偏移
+ */
+uint32_t mp3_vbr_seek_offset(const Mp3VbrInfo_t *vbr, uint32_t ms, uint32_t duration_ms)
+{
+    uint32_t permille;
+    uint32_t a;
+    uint32_t fa;
+    uint32_t fb;
+    uint32_t pos;
+
+    if (!vbr->has_toc || duration_ms == 0) {
+        return 0;
+    }
+    if (ms >= duration_ms) {
+        ms = duration_ms - 1;
+    }
+
+    permille = (uint32_t)((uint64_t)ms * 1000 / duration_ms);
+    a = permille / 10;
+    fa = vbr->toc[a];
+    fb = (a < MP3_TOC_SIZE - 1) ? vbr->toc[a + 1] : 256;
+    if (fb < fa) {
+        fb = fa;
+    }
+    pos = fa * 10 + (fb - fa) * (permille % 10);
+
+    return (uint32_t)((uint64_t)pos * vbr->bytes / 2560);
+}
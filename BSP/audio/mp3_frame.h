@@ -0,0 +1,83 @@
+#ifndef MP3_FRAME_H
+#define MP3_FRAME_H
+
+#include "main.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * MPEG音频帧头解析
+ * 帧头32位: 同步字(11) 版本(2) 层(2) 无CRC(1) 码率(4) 采样率(2) 填充(1)
+ *           私有(1) 声道模式(2) 模式扩展(2) 版权(1) 原始(1) 加重(2)
+ */
+
+#define MP3_FRAME_HEADER_SIZE   4
+#define MP3_FRAME_COMPAT_MASK   0xFFFE0C00U     /* 同步字+版本+层+采样率 */
+
+/* 版本 (帧头原始编码) */
+#define MP3_VERSION_25          0       /* MPEG 2.5 */
+#define MP3_VERSION_2           2       /* MPEG 2 */
+#define MP3_VERSION_1           3       /* MPEG 1 */
+
+/* 帧信息 */
+typedef struct {
+    uint32_t header;            /* 原始帧头 */
+    uint8_t version;            /* MP3_VERSION_x */
+    uint8_t layer;              /* 1-3 */
+    uint8_t channels;           /* 1或2 */
+    uint16_t bitrate;           /* kbps */
+    uint16_t sample_rate;       /* Hz */
+    uint16_t frame_size;        /* 整帧字节数(含帧头) */
+    uint16_t samples;           /* 每帧采样数 */
+} Mp3FrameInfo_t;
+
+/* 第一帧中的VBR信息头 */
+typedef enum {
+    MP3_VBR_NONE = 0,           /* 没有信息头 (按CBR估算) */
+    MP3_VBR_XING,               /* Xing (VBR) */
+    MP3_VBR_INFO,               /* Info (LAME写的CBR, 格式同Xing) */
+    MP3_VBR_VBRI                /* Fraunhofer VBRI */
+} Mp3VbrType_t;
+
+#define MP3_TOC_SIZE            100
+
+/* 从第一帧解析出的曲目信息 */
+typedef struct {
+    uint8_t type;               /* Mp3VbrType_t */
+    bool has_toc;               /* toc有效 */
+    uint16_t samples;           /* 每帧采样数 */
+    uint16_t sample_rate;       /* Hz */
+    uint16_t bitrate;           /* 第一帧码率(kbps), 没有帧数时按它估算时长 */
+    uint32_t frames;            /* 总帧数, 0表示未知 */
+    uint32_t bytes;             /* 从第一帧起的总字节数, 0表示未知 */
+    uint16_t enc_delay;         /* LAME编码延迟(采样) */
+    uint16_t enc_padding;       /* LAME尾部填充(采样) */
+    uint8_t toc[MP3_TOC_SIZE];  /* 第i%时间处的位置 = toc[i]/256 * bytes */
+} Mp3VbrInfo_t;
+
+bool mp3_frame_parse(uint32_t header, Mp3FrameInfo_t *info);                /* 解析帧头, 保留值返回false */
+int32_t mp3_frame_find(const uint8_t *buf, uint32_t len, Mp3FrameInfo_t *info);  /* 查找帧边界, -1表示没有 */
+
+/* VBR信息头 (Xing/Info + LAME, VBRI) */
+bool mp3_vbr_parse(const uint8_t *buf, uint32_t len, Mp3VbrInfo_t *vbr);   /* buf从第一帧帧头开始 */
+uint32_t mp3_vbr_duration_ms(const Mp3VbrInfo_t *vbr, uint32_t data_bytes);  /* 总时长, 0表示未知 */
+uint32_t mp3_vbr_seek_offset(const Mp3VbrInfo_t *vbr, uint32_t ms, uint32_t duration_ms);  /* 按TOC查时间对应的偏移 */
+
+/**
+ * @brief       帧头中决定能否连续解码的部分 (版本/层/采样率)
+ * @param       header: 原始帧头
+ * @retval      比较用的键值
+ */
+static inline uint32_t mp3_frame_compat(uint32_t header)
+{
+    return header & MP3_FRAME_COMPAT_MASK;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MP3_FRAME_H
@@ -0,0 +1,451 @@
+#include "seek_index.h"
+#include "mp3_frame.h"
+#include "filesystem.h"
+#include "perf_counter.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SEEK_INDEX_BUF_ENTRIES      64      /* 偏移先攒在内存里, 满了再写一次索引文件 */
+#define SEEK_INDEX_SYNC_LEN         256     /* 重新同步时每次读入的字节数 */
+#define SEEK_INDEX_NAME_LEN         24      /* "0:/IDX/XXXXXXXX.SK" */
+
+/* 单帧扫描结果 */
+typedef enum {
+    SEEK_SCAN_FRAME = 0,        /* 扫过一帧(或一段垃圾数据) */
+    SEEK_SCAN_FLUSH,            /* 偏移缓冲区已满 */
+    SEEK_SCAN_END,              /* 到文件尾 */
+    SEEK_SCAN_ERROR             /* 读卡错误 */
+} SeekIndexScan_t;
+
+/* 正在建立的索引 */
+typedef struct {
+    bool active;
+    bool src_open;              /* idx_fp当前打开的是音频文件 */
+    char path[FS_MAX_PATH_LEN]; /* 音频文件 */
+    char name[SEEK_INDEX_NAME_LEN];  /* 索引文件 */
+    uint32_t size;              /* 音频文件大小 */
+    uint32_t pos;               /* 下一帧的文件偏移 */
+    uint32_t compat;            /* 第一帧的版本/层/采样率(mp3_frame_compat) */
+    uint32_t sample_rate;
+    uint32_t samples;           /* 已扫描的采样数 */
+    uint16_t count;             /* 已记录的偏移数 */
+    uint16_t buffered;          /* entries中还没写入文件的个数 */
+} SeekIndexJob_t;
+
+/* 私有变量 */
+static FIL *idx_fp = NULL;                  /* 音频文件和索引文件轮流使用, 只占文件池的一个FIL */
+static SeekIndexJob_t job;
+static uint32_t entries[SEEK_INDEX_BUF_ENTRIES];
+static uint8_t sync_buf[SEEK_INDEX_SYNC_LEN];
+static char queue[SEEK_INDEX_QUEUE_SIZE][FS_MAX_PATH_LEN];
+static uint8_t queue_count = 0;
+static SeekIndexStats_t stats;
+
+/* ============================================================================
+ * 索引文件
+ * ============================================================================ */
+
+/**
+ * @brief       由音频文件路径和大小得到索引文件名 (FNV-1a哈希, 8.3格式)
+ * @param       path: 音频文件路径
+ * @param       size: 音频文件大小
+ * @param       name: 输出, SEEK_INDEX_NAME_LEN字节
+ * @retval      无
+ */
+static void seek_index_name(const char *path, uint32_t size, char *name)
+{
+    uint32_t hash = 2166136261U;
+    uint8_t i;
+
+    while (*path) {
+        hash = (hash ^ (uint8_t)*path++) * 16777619U;
+    }
+    for (i = 0; i < 4; i++) {
+        hash = (hash ^ (uint8_t)(size >> (i * 8))) * 16777619U;
+    }
+
+    snprintf(name, SEEK_INDEX_NAME_LEN, SEEK_INDEX_DIR "/%08lX.SK", (unsigned long)hash);
+}
+
+/**
+ * @brief       关闭正在扫描的音频文件, 腾出idx_fp (下次任务时重新打开)
+ * @param       无
+ * @retval      无
+ */
+static void seek_index_release_src(void)
+{
+    if (job.src_open) {
+        fs_close_file(&idx_fp);
+        job.src_open = false;
+    }
+}
+
+/**
+ * @brief       打开已完成的索引文件并检查文件头
+ * @note        成功时idx_fp保持打开, 由调用者关闭
+ * @param       name: 索引文件名
+ * @param       size: 音频文件大小
+ * @param       hdr: 输出, 文件头
+ * @retval      true: 索引完整且与音频文件匹配
+ */
+static bool seek_index_open_valid(const char *name, uint32_t size, SeekIndexHeader_t *hdr)
+{
+    UINT br;
+
+    seek_index_release_src();
+
+    if (fs_open_file(name, FA_READ, &idx_fp) != FS_STATUS_OK) {
+        return false;
+    }
+    if (f_read(idx_fp, hdr, sizeof(*hdr), &br) != FR_OK || br != sizeof(*hdr) ||
+        hdr->magic != SEEK_INDEX_MAGIC || hdr->file_size != size ||
+        hdr->step_s == 0 || hdr->count == 0) {
+        fs_close_file(&idx_fp);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief       把缓冲的偏移追加到索引文件, 完成时写入文件头
+ * @param       finish: true: 扫描已完成
+ * @retval      FR_OK: 成功, 其他: FatFs错误
+ */
+static FRESULT seek_index_flush(bool finish)
+{
+    FRESULT res;
+    UINT bw;
+    SeekIndexHeader_t hdr;
+
+    seek_index_release_src();
+
+    if (fs_open_file(job.name, FA_WRITE | FA_OPEN_EXISTING, &idx_fp) != FS_STATUS_OK) {
+        return FR_NO_FILE;
+    }
+
+    res = f_lseek(idx_fp, f_size(idx_fp));
+    if (res == FR_OK && job.buffered != 0) {
+        res = f_write(idx_fp, entries, job.buffered * sizeof(uint32_t), &bw);
+        if (res == FR_OK && bw != job.buffered * sizeof(uint32_t)) {
+            res = FR_DENIED;    /* 卡满 */
+        }
+    }
+    job.buffered = 0;
+
+    if (res == FR_OK && finish) {
+        hdr.magic = SEEK_INDEX_MAGIC;
+        hdr.file_size = job.size;
+        hdr.step_s = SEEK_INDEX_STEP_S;
+        hdr.count = job.count;
+        hdr.sample_rate = job.sample_rate;
+        res = f_lseek(idx_fp, 0);
+        if (res == FR_OK) {
+            res = f_write(idx_fp, &hdr, sizeof(hdr), &bw);
+        }
+    }
+
+    fs_close_file(&idx_fp);
+    return res;
+}
+
+/* ============================================================================
+ * 扫描
+ * ============================================================================ */
+
+/**
+ * @brief       开始为队首文件建立索引: 创建空索引文件, 打开音频文件并跳过ID3
+ * @param       无
+ * @retval      true: 已开始, false: 已有索引或失败
+ */
+static bool seek_index_start(void)
+{
+    FILINFO fno;
+    SeekIndexHeader_t hdr;
+    uint8_t id3[10];
+    UINT br;
+
+    memset(&job, 0, sizeof(job));
+    strcpy(job.path, queue[0]);
+    queue_count--;
+    memmove(queue[0], queue[1], queue_count * FS_MAX_PATH_LEN);
+
+    if (f_stat(job.path, &fno) != FR_OK) {
+        stats.failed++;
+        return false;
+    }
+    job.size = fno.fsize;
+    seek_index_name(job.path, job.size, job.name);
+
+    if (seek_index_open_valid(job.name, job.size, &hdr)) {
+        fs_close_file(&idx_fp);
+        return false;   /* 已有完整索引 */
+    }
+
+    /* 头部全0, 扫描完成后再写入 */
+    f_mkdir(SEEK_INDEX_DIR);
+    memset(&hdr, 0, sizeof(hdr));
+    if (fs_open_file(job.name, FA_WRITE | FA_CREATE_ALWAYS, &idx_fp) != FS_STATUS_OK) {
+        stats.failed++;
+        return false;
+    }
+    if (f_write(idx_fp, &hdr, sizeof(hdr), &br) != FR_OK || br != sizeof(hdr)) {
+        fs_close_file(&idx_fp);
+        f_unlink(job.name);
+        stats.failed++;
+        return false;
+    }
+    fs_close_file(&idx_fp);
+
+    if (fs_open_file(job.path, FA_READ, &idx_fp) != FS_STATUS_OK) {
+        f_unlink(job.name);
+        stats.failed++;
+        return false;
+    }
+    job.src_open = true;
+    job.active = true;
+
+    /* ID3v2标签可能很大(封面), 直接跳过而不是逐字节重新同步 */
+    if (f_read(idx_fp, id3, sizeof(id3), &br) == FR_OK && br == sizeof(id3) &&
+        id3[0] == 'I' && id3[1] == 'D' && id3[2] == '3') {
+        job.pos = (((uint32_t)id3[6] << 21) | ((uint32_t)id3[7] << 14) |
+                   ((uint32_t)id3[8] << 7) | id3[9]) + 10;
+    }
+
+    return true;
+}
+
+/**
+ * @brief       结束当前索引
+ * @param       ok: true: 扫描到文件尾, false: 读写失败
+ * @retval      无
+ */
+static void seek_index_finish(bool ok)
+{
+    if (ok && job.count != 0 && seek_index_flush(true) == FR_OK) {
+        stats.built++;
+    } else {
+        seek_index_release_src();
+        f_unlink(job.name);     /* 不留下不完整的索引文件 */
+        stats.failed++;
+    }
+    job.active = false;
+}
+
+/**
+ * @brief       在垃圾数据(标签/损坏的帧)中查找下一个帧头
+ * @param       无
+ * @retval      扫描结果
+ */
+static SeekIndexScan_t seek_index_resync(void)
+{
+    UINT br;
+    int32_t found;
+
+    job.pos++;
+    if (f_lseek(idx_fp, job.pos) != FR_OK ||
+        f_read(idx_fp, sync_buf, SEEK_INDEX_SYNC_LEN, &br) != FR_OK) {
+        return SEEK_SCAN_ERROR;
+    }
+    if (br < MP3_FRAME_HEADER_SIZE) {
+        return SEEK_SCAN_END;
+    }
+
+    found = mp3_frame_find(sync_buf, br, NULL);
+    if (found >= 0) {
+        job.pos += (uint32_t)found;
+    } else {
+        job.pos += br - (MP3_FRAME_HEADER_SIZE - 1);    /* 帧头可能跨在两次读取之间 */
+    }
+
+    return SEEK_SCAN_FRAME;
+}
+
+/**
+ * @brief       扫描一帧, 到了下一个索引时间点时记录帧起点
+ * @note        只读4字节帧头, 按帧长直接跳到下一帧
+ * @param       无
+ * @retval      扫描结果
+ */
+static SeekIndexScan_t seek_index_scan(void)
+{
+    uint8_t b[MP3_FRAME_HEADER_SIZE];
+    uint32_t header;
+    uint32_t due;
+    Mp3FrameInfo_t info;
+    UINT br;
+
+    if (f_lseek(idx_fp, job.pos) != FR_OK || f_read(idx_fp, b, sizeof(b), &br) != FR_OK) {
+        return SEEK_SCAN_ERROR;
+    }
+    if (br < sizeof(b)) {
+        return SEEK_SCAN_END;
+    }
+
+    header = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+    if (!mp3_frame_parse(header, &info) ||
+        (job.compat != 0 && mp3_frame_compat(header) != job.compat)) {
+        return seek_index_resync();
+    }
+
+    if (job.compat == 0) {
+        job.compat = mp3_frame_compat(header);
+        job.sample_rate = info.sample_rate;
+    }
+    stats.frames++;
+
+    due = (uint32_t)job.count * SEEK_INDEX_STEP_S * job.sample_rate;
+    if (job.samples >= due && job.count < SEEK_INDEX_MAX_ENTRIES) {
+        entries[job.buffered++] = job.pos;
+        job.count++;
+    }
+    job.samples += info.samples;
+    job.pos += info.frame_size;
+
+    return (job.buffered == SEEK_INDEX_BUF_ENTRIES) ? SEEK_SCAN_FLUSH : SEEK_SCAN_FRAME;
+}
+
+/* ============================================================================
+ * 接口
+ * ============================================================================ */
+
+/**
+ * @brief       请求为文件建立索引
+ * @note        只加入队列不读卡, 可以在起播路径上调用; 新请求排在队首
+ * @param       path: 音频文件路径
+ * @retval      true: 已加入或已在队列中
+ */
+bool seek_index_request(const char *path)
+{
+    uint8_t i;
+
+    if (strlen(path) >= FS_MAX_PATH_LEN) {
+        return false;
+    }
+    if (job.active && strcmp(job.path, path) == 0) {
+        return true;
+    }
+    for (i = 0; i < queue_count; i++) {
+        if (strcmp(queue[i], path) == 0) {
+            return true;
+        }
+    }
+
+    if (queue_count == SEEK_INDEX_QUEUE_SIZE) {
+        queue_count--;  /* 丢弃最早的请求 */
+    }
+    memmove(queue[1], queue[0], queue_count * FS_MAX_PATH_LEN);
+    strcpy(queue[0], path);
+    queue_count++;
+
+    return true;
+}
+
+/**
+ * @brief       索引任务, 每次最多扫描SEEK_INDEX_TICK_FRAMES帧或SEEK_INDEX_TICK_US微秒
+ * @note        打开/写入索引文件单独占用一次任务
+ * @param       无
+ * @retval      无
+ */
+void seek_index_task(void)
+{
+    uint32_t t0 = perf_counter_now();
+    uint32_t budget = SEEK_INDEX_TICK_US * (SystemCoreClock / 1000000U);
+    uint32_t us;
+    uint16_t n;
+    SeekIndexScan_t r = SEEK_SCAN_FRAME;
+
+    if (!job.active) {
+        if (queue_count == 0) {
+            return;
+        }
+        seek_index_start();
+    } else if (!job.src_open) {
+        /* 写索引文件或查找时关闭过 */
+        if (fs_open_file(job.path, FA_READ, &idx_fp) != FS_STATUS_OK) {
+            r = SEEK_SCAN_ERROR;
+        } else {
+            job.src_open = true;
+        }
+    } else {
+        for (n = 0; n < SEEK_INDEX_TICK_FRAMES && r == SEEK_SCAN_FRAME; n++) {
+            if (perf_counter_now() - t0 > budget) {
+                break;
+            }
+            r = seek_index_scan();
+        }
+        if (r == SEEK_SCAN_FLUSH && seek_index_flush(false) != FR_OK) {
+            r = SEEK_SCAN_ERROR;
+        }
+    }
+
+    if (r == SEEK_SCAN_END) {
+        seek_index_finish(true);
+    } else if (r == SEEK_SCAN_ERROR) {
+        seek_index_finish(false);
+    }
+
+    stats.ticks++;
+    us = perf_cycles_to_us(perf_counter_now() - t0);
+    if (us > stats.max_tick_us) {
+        stats.max_tick_us = us;
+    }
+}
+
+/**
+ * @brief       是否还有索引工作
+ * @param       无
+ * @retval      true: 正在建立或队列非空
+ */
+bool seek_index_busy(void)
+{
+    return job.active || queue_count != 0;
+}
+
+/**
+ * @brief       查找时间对应的帧起点
+ * @param       path: 音频文件路径
+ * @param       file_size: 音频文件大小
+ * @param       sec: 目标时间(秒)
+ * @param       offset: 输出, 帧起点的文件偏移
+ * @param       entry_sec: 输出, 该帧对应的时间(按索引间隔取整)
+ * @retval      true: 找到, false: 没有完整索引或超出曲目长度
+ */
+bool seek_index_lookup(const char *path, uint32_t file_size, uint32_t sec,
+                       uint32_t *offset, uint32_t *entry_sec)
+{
+    char name[SEEK_INDEX_NAME_LEN];
+    SeekIndexHeader_t hdr;
+    uint32_t idx;
+    UINT br;
+    bool ok = false;
+
+    seek_index_name(path, file_size, name);
+    if (job.active && strcmp(job.name, name) == 0) {
+        return false;   /* 还没建完 */
+    }
+    if (!seek_index_open_valid(name, file_size, &hdr)) {
+        return false;
+    }
+
+    idx = sec / hdr.step_s;
+    if (idx < hdr.count &&
+        f_lseek(idx_fp, sizeof(hdr) + idx * sizeof(uint32_t)) == FR_OK &&
+        f_read(idx_fp, offset, sizeof(uint32_t), &br) == FR_OK && br == sizeof(uint32_t)) {
+        *entry_sec = idx * hdr.step_s;
+        ok = true;
+    }
+
+    fs_close_file(&idx_fp);
+    return ok;
+}
+
+/**
+ * @brief       获取索引统计
+ * @param       stats_out: 输出
+ * @retval      无
+ */
+void seek_index_get_stats(SeekIndexStats_t *stats_out)
+{
+    *stats_out = stats;
+}
@@ -0,0 +1,60 @@
+#ifndef SEEK_INDEX_H
+#define SEEK_INDEX_H
+
+#include "main.h"
+#include "ff.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * MP3定位索引 (没有Xing/VBRI TOC的文件)
+ * 主循环空闲时逐帧扫描MPEG帧头, 每SEEK_INDEX_STEP_S秒记录一个帧起点的文件偏移,
+ * 写入SD卡上的索引文件 SEEK_INDEX_DIR/<路径和大小的哈希>.SK。
+ * 之后定位直接读出对应的帧边界, 不再按字节率估算。
+ * 每次seek_index_task只做有限的工作, 播放器需要读卡时主循环不调用它。
+ *
+ * 索引文件: SeekIndexHeader_t + count个uint32_t偏移(小端)
+ * 头部在扫描完成后才写入magic, 未完成的索引文件不会被使用
+ */
+
+#define SEEK_INDEX_DIR              "0:/IDX"    /* 未开长文件名, 目录名不能以'.'开头 */
+#define SEEK_INDEX_STEP_S           1           /* 索引间隔(秒) */
+#define SEEK_INDEX_MAX_ENTRIES      7200        /* 最多索引2小时 */
+#define SEEK_INDEX_QUEUE_SIZE       4           /* 等待建立索引的文件数 */
+#define SEEK_INDEX_TICK_FRAMES      32          /* 每次任务最多扫描的帧数 */
+#define SEEK_INDEX_TICK_US          1000        /* 每次任务最长耗时(微秒) */
+#define SEEK_INDEX_MAGIC            0x31494B53U /* "SKI1" */
+
+/* 索引文件头 */
+typedef struct {
+    uint32_t magic;             /* SEEK_INDEX_MAGIC, 扫描完成后写入 */
+    uint32_t file_size;         /* 建立索引时的音频文件大小 */
+    uint16_t step_s;            /* 索引间隔(秒) */
+    uint16_t count;             /* 偏移个数 */
+    uint32_t sample_rate;       /* 采样率 */
+} SeekIndexHeader_t;
+
+/* 统计 */
+typedef struct {
+    uint32_t built;             /* 已完成的索引数 */
+    uint32_t failed;            /* 失败(读写错误/不是MP3)数 */
+    uint32_t frames;            /* 已扫描的帧数 */
+    uint32_t ticks;             /* 执行过工作的任务次数 */
+    uint32_t max_tick_us;       /* 单次任务最长耗时 */
+} SeekIndexStats_t;
+
+bool seek_index_request(const char *path);     /* 加入建立队列, 已有完整索引时不重复建立 */
+void seek_index_task(void);                    /* 主循环调用, 播放器需要读卡时不要调用 */
+bool seek_index_busy(void);                    /* 正在建立或队列非空 */
+bool seek_index_lookup(const char *path, uint32_t file_size, uint32_t sec,
+                       uint32_t *offset, uint32_t *entry_sec);   /* 查找时间对应的帧起点 */
+void seek_index_get_stats(SeekIndexStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SEEK_INDEX_H
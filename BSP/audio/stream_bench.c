@@ -0,0 +1,499 @@
+#include "stream_bench.h"
+#include "audio_player.h"
+#include "audio_ringbuf.h"
+#include "audio_telemetry.h"
+#include "vs1053_feeder.h"
+#include "mp3_frame.h"
+#include "nt35310_alientek.h"
+#include "filesystem.h"
+#include <stdio.h>
+#include <string.h>
+
+#define STREAM_BENCH_SECTOR         512     /* 生成文件时的写入单位 */
+#define STREAM_BENCH_NAME_LEN       24      /* "0:/BENCH/B1411.WAV" */
+#define STREAM_BENCH_WARMUP_MS      3000    /* 提交播放 -> 开始送数的最长等待 */
+#define STREAM_BENCH_WAV_HEADER     44
+#define STREAM_BENCH_SAMPLE_RATE    44100U
+
+/* 测试流程 */
+typedef enum {
+    BENCH_IDLE = 0,
+    BENCH_PREPARE,              /* 检查当前码率的文件, 不存在或大小不对时重新生成 */
+    BENCH_WRITE,                /* 分步写入合成码流 */
+    BENCH_START,                /* 提交播放 */
+    BENCH_WARMUP,               /* 等待预读完成开始送数 */
+    BENCH_MEASURE,              /* 测量中 */
+    BENCH_SKIP,                 /* 当前码率失败, 转到下一个码率 */
+    BENCH_STOP                  /* 全部完成: 停止播放, 恢复音量, 输出结果 */
+} StreamBenchState_t;
+
+/* 码率表 */
+typedef struct {
+    uint16_t kbps;
+    uint8_t index;              /* MPEG-1 Layer III码率索引, 0表示PCM WAV */
+} StreamBenchRate_t;
+
+/* 合成码流生成器 */
+typedef struct {
+    uint32_t size;              /* 文件总字节数 */
+    uint32_t written;           /* 已写入字节数 */
+    uint32_t frame_pos;         /* MP3: 当前帧已生成的字节数 */
+    uint32_t frame_size;        /* MP3: 当前帧字节数, 与frame_pos相等时开始新的一帧 */
+    uint8_t header[MP3_FRAME_HEADER_SIZE];  /* MP3: 当前帧帧头 */
+    uint32_t pad_acc;           /* MP3: 填充位累加, 保证平均码率准确 */
+    uint32_t seed;              /* 负载字节的伪随机数 */
+} StreamBenchGen_t;
+
+/* 私有变量 */
+static const StreamBenchRate_t s_rates[STREAM_BENCH_RATES] = {
+    {32, 1}, {64, 5}, {128, 9}, {192, 11}, {256, 13}, {320, 14}, {1411, 0}
+};
+static StreamBenchState_t s_state = BENCH_IDLE;
+static StreamBenchResult_t s_results[STREAM_BENCH_RATES];
+static uint8_t s_idx = 0;                   /* 当前码率 */
+static char s_path[STREAM_BENCH_NAME_LEN];
+static FIL *s_fp = NULL;                    /* 测试文件(文件池) */
+static StreamBenchGen_t s_gen;
+static uint8_t s_sector[STREAM_BENCH_SECTOR] __attribute__((aligned(4)));
+static uint32_t s_tick = 0;                 /* 当前阶段的起点 */
+static uint8_t s_volume = 0;                /* 测试前的VS1053音量 */
+
+/* ============================================================================
+ * 合成码流
+ * ============================================================================ */
+
+/**
+ * @brief       当前码率的文件大小
+ * @note        MP3按CBR逐帧累加填充位, 第f帧之前共有floor(f*r/44100)个填充字节
+ * @param       rate: 码率
+ * @retval      字节数
+ */
+static uint32_t stream_bench_file_size(const StreamBenchRate_t *rate)
+{
+    /* 测量结束时环形缓冲区里还有一整个缓冲区没送出, 低码率时这部分时长要加上 */
+    uint32_t seconds = STREAM_BENCH_SECONDS + STREAM_BENCH_MARGIN_S +
+                       (AUDIO_RINGBUF_SIZE * 8U + rate->kbps * 1000U - 1U) / (rate->kbps * 1000U);
+    uint32_t frames = seconds * STREAM_BENCH_SAMPLE_RATE / 1152U;
+    uint32_t num = 144000U * rate->kbps;
+
+    if (rate->index == 0) {
+        return STREAM_BENCH_WAV_HEADER + seconds * STREAM_BENCH_SAMPLE_RATE * 4U;
+    }
+    return frames * (num / STREAM_BENCH_SAMPLE_RATE) +
+           (uint32_t)((uint64_t)frames * (num % STREAM_BENCH_SAMPLE_RATE) / STREAM_BENCH_SAMPLE_RATE);
+}
+
+/**
+ * @brief       负载字节 (不出现0, 避免被当作endFillByte)
+ * @param       无
+ * @retval      伪随机字节
+ */
+static uint8_t stream_bench_payload(void)
+{
+    s_gen.seed = s_gen.seed * 1103515245U + 12345U;
+    return (uint8_t)((s_gen.seed >> 16) | 1U);
+}
+
+/**
+ * @brief       写入小端整数
+ * @param       p: 目标
+ * @param       v: 数值
+ * @param       n: 字节数
+ * @retval      无
+ */
+static void stream_bench_put_le(uint8_t *p, uint32_t v, uint8_t n)
+{
+    while (n--) {
+        *p++ = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+/**
+ * @brief       44.1kHz 16位立体声WAV文件头
+ * @param       p: 输出, STREAM_BENCH_WAV_HEADER字节
+ * @param       size: 文件总字节数
+ * @retval      无
+ */
+static void stream_bench_wav_header(uint8_t *p, uint32_t size)
+{
+    memcpy(p, "RIFF", 4);
+    stream_bench_put_le(p + 4, size - 8, 4);
+    memcpy(p + 8, "WAVEfmt ", 8);
+    stream_bench_put_le(p + 16, 16, 4);                             /* fmt块长度 */
+    stream_bench_put_le(p + 20, 1, 2);                              /* PCM */
+    stream_bench_put_le(p + 22, 2, 2);                              /* 声道数 */
+    stream_bench_put_le(p + 24, STREAM_BENCH_SAMPLE_RATE, 4);
+    stream_bench_put_le(p + 28, STREAM_BENCH_SAMPLE_RATE * 4U, 4);  /* 字节率 */
+    stream_bench_put_le(p + 32, 4, 2);                              /* 块对齐 */
+    stream_bench_put_le(p + 34, 16, 2);                             /* 位深 */
+    memcpy(p + 36, "data", 4);
+    stream_bench_put_le(p + 40, size - STREAM_BENCH_WAV_HEADER, 4);
+}
+
+/**
+ * @brief       MP3: 开始新的一帧 (MPEG-1 Layer III, 无CRC, 44.1kHz, 立体声)
+ * @param       rate: 码率
+ * @retval      无
+ */
+static void stream_bench_next_frame(const StreamBenchRate_t *rate)
+{
+    uint32_t num = 144000U * rate->kbps;
+    uint8_t pad = 0;
+
+    s_gen.pad_acc += num % STREAM_BENCH_SAMPLE_RATE;
+    if (s_gen.pad_acc >= STREAM_BENCH_SAMPLE_RATE) {
+        s_gen.pad_acc -= STREAM_BENCH_SAMPLE_RATE;
+        pad = 1;
+    }
+
+    s_gen.header[0] = 0xFF;
+    s_gen.header[1] = 0xFB;
+    s_gen.header[2] = (uint8_t)((rate->index << 4) | (pad << 1));
+    s_gen.header[3] = 0x00;
+    s_gen.frame_size = num / STREAM_BENCH_SAMPLE_RATE + pad;
+    s_gen.frame_pos = 0;
+}
+
+/**
+ * @brief       生成下一段码流
+ * @param       rate: 码率
+ * @param       buf: 输出
+ * @param       len: 字节数
+ * @retval      无
+ */
+static void stream_bench_generate(const StreamBenchRate_t *rate, uint8_t *buf, uint32_t len)
+{
+    uint32_t i = 0;
+
+    if (rate->index == 0) {
+        if (s_gen.written == 0) {
+            stream_bench_wav_header(buf, s_gen.size);
+            i = STREAM_BENCH_WAV_HEADER;
+        }
+        for (; i < len; i++) {
+            buf[i] = stream_bench_payload();
+        }
+        return;
+    }
+
+    for (; i < len; i++) {
+        if (s_gen.frame_pos == s_gen.frame_size) {
+            stream_bench_next_frame(rate);
+        }
+        buf[i] = (s_gen.frame_pos < MP3_FRAME_HEADER_SIZE) ? s_gen.header[s_gen.frame_pos] : stream_bench_payload();
+        s_gen.frame_pos++;
+    }
+}
+
+/* ============================================================================
+ * 测试流程
+ * ============================================================================ */
+
+/**
+ * @brief       检查当前码率的文件, 已存在且大小正确时直接使用
+ * @param       无
+ * @retval      下一状态
+ */
+static StreamBenchState_t stream_bench_prepare(void)
+{
+    const StreamBenchRate_t *rate = &s_rates[s_idx];
+    FILINFO fno;
+    char str[40];
+
+    snprintf(s_path, sizeof(s_path), STREAM_BENCH_DIR "/B%03u.%s",
+             rate->kbps, (rate->index == 0) ? "WAV" : "MP3");
+    s_results[s_idx].kbps = rate->kbps;
+    s_results[s_idx].wav = (rate->index == 0);
+
+    snprintf(str, sizeof(str), "Bench: %ukbps %s    ", rate->kbps, (rate->index == 0) ? "WAV" : "MP3");
+    lcd_show_string(10, 360, 300, 16, 12, str, BLUE);
+
+    memset(&s_gen, 0, sizeof(s_gen));
+    s_gen.size = stream_bench_file_size(rate);
+    s_gen.seed = rate->kbps;
+
+    if (f_stat(s_path, &fno) == FR_OK && fno.fsize == s_gen.size) {
+        return BENCH_START;
+    }
+
+    f_mkdir(STREAM_BENCH_DIR);
+    if (fs_open_file(s_path, FA_WRITE | FA_CREATE_ALWAYS, &s_fp) != FS_STATUS_OK) {
+        s_results[s_idx].failed = true;
+        return BENCH_SKIP;
+    }
+    fs_invalidate_file_cache();
+    return BENCH_WRITE;
+}
+
+/**
+ * @brief       写入最多STREAM_BENCH_WRITE_SECTORS个扇区的码流
+ * @param       无
+ * @retval      下一状态
+ */
+static StreamBenchState_t stream_bench_write(void)
+{
+    uint32_t len;
+    UINT bw;
+    uint8_t n;
+
+    for (n = 0; n < STREAM_BENCH_WRITE_SECTORS && s_gen.written < s_gen.size; n++) {
+        len = s_gen.size - s_gen.written;
+        if (len > STREAM_BENCH_SECTOR) {
+            len = STREAM_BENCH_SECTOR;
+        }
+        stream_bench_generate(&s_rates[s_idx], s_sector, len);
+        if (f_write(s_fp, s_sector, len, &bw) != FR_OK || bw != len) {
+            fs_close_file(&s_fp);
+            f_unlink(s_path);
+            s_results[s_idx].failed = true;
+            return BENCH_SKIP;
+        }
+        s_gen.written += len;
+    }
+
+    if (s_gen.written < s_gen.size) {
+        return BENCH_WRITE;
+    }
+    if (fs_close_file(&s_fp) != FS_STATUS_OK) {
+        s_results[s_idx].failed = true;
+        return BENCH_SKIP;
+    }
+    return BENCH_START;
+}
+
+/**
+ * @brief       测量结束, 由遥测和送数统计计算结果
+ * @param       result: 输出
+ * @retval      无
+ */
+static void stream_bench_collect(StreamBenchResult_t *result)
+{
+    VS1053_FeederStats_t dma;
+    VS1053_FeederStats_t polled;
+    uint32_t ms = HAL_GetTick() - s_tick;
+    uint32_t feed = g_telemetry.counters[TELEM_FEED_BYTES];
+    uint64_t need;
+    uint64_t total;
+
+    if (ms == 0) {
+        ms = 1;
+    }
+    total = (uint64_t)ms * (SystemCoreClock / 1000U);
+
+    vs1053_feeder_get_stats(VS1053_FEED_DMA, &dma);
+    vs1053_feeder_get_stats(VS1053_FEED_POLLED, &polled);
+
+    result->elapsed_ms = ms;
+    result->sd_kbps = (uint32_t)((uint64_t)g_telemetry.counters[TELEM_SD_BYTES] * 1000U / 1024U / ms);
+    result->sd_busy_permille = (uint16_t)(g_telemetry.hist[TELEM_HIST_SD_READ].sum * 1000U / total);
+    result->feed_kbps = (uint32_t)((uint64_t)feed * 1000U / 1024U / ms);
+    result->feed_cpu_permille = (uint16_t)(((uint64_t)dma.cycles + polled.cycles) * 1000U / total);
+    result->underruns = g_telemetry.counters[TELEM_UNDERRUN];
+    result->done = true;
+
+    /* 码率对应的字节数 (kbps * 1000 / 8 * ms / 1000) */
+    need = (uint64_t)result->kbps * 125U * ms / 1000U * STREAM_BENCH_MIN_PERCENT / 100U;
+    result->sustained = !result->failed && result->underruns == 0 &&
+                        (uint64_t)feed + STREAM_BENCH_FIFO_SLACK >= need;
+}
+
+/**
+ * @brief       当前码率结束, 转到下一个码率
+ * @param       无
+ * @retval      下一状态
+ */
+static StreamBenchState_t stream_bench_next(void)
+{
+    s_idx++;
+    return (s_idx < STREAM_BENCH_RATES) ? BENCH_PREPARE : BENCH_STOP;
+}
+
+/**
+ * @brief       全部完成: 停止播放, 恢复音量, 通过遥测串口输出结果
+ * @param       无
+ * @retval      无
+ */
+static void stream_bench_stop(void)
+{
+    audio_player_stop();
+    vs1053_set_volume(s_volume);
+    lcd_show_string(10, 360, 300, 16, 12, "Bench done          ", BLUE);
+    audio_telemetry_print(stream_bench_format);
+}
+
+/* ============================================================================
+ * 接口
+ * ============================================================================ */
+
+/**
+ * @brief       开始码率扫描, 正在测试时忽略
+ * @param       无
+ * @retval      无
+ */
+void stream_bench_start(void)
+{
+    if (s_state != BENCH_IDLE) {
+        return;
+    }
+
+    memset(s_results, 0, sizeof(s_results));
+    s_idx = 0;
+    s_volume = g_vs1053_config.volume;
+
+    if (!audio_player_is_ready()) {
+        /* 直接输出全部未测试的结果 */
+        s_state = BENCH_STOP;
+        return;
+    }
+
+    /* 合成码流是噪声, 测试期间音量调到最小 */
+    vs1053_set_volume(0);
+    s_state = BENCH_PREPARE;
+}
+
+/**
+ * @brief       测试任务 (主循环调用), 每次只推进一步
+ * @param       无
+ * @retval      无
+ */
+void stream_bench_task(void)
+{
+    StreamBenchResult_t *result = &s_results[(s_idx < STREAM_BENCH_RATES) ? s_idx : 0];
+    AudioState_t state;
+
+    switch (s_state) {
+        case BENCH_PREPARE:
+            s_state = stream_bench_prepare();
+            break;
+
+        case BENCH_WRITE:
+            s_state = stream_bench_write();
+            break;
+
+        case BENCH_START:
+            if (audio_player_play_file(s_path)) {
+                s_tick = HAL_GetTick();
+                s_state = BENCH_WARMUP;
+            } else {
+                result->failed = true;
+                s_state = BENCH_SKIP;
+            }
+            break;
+
+        case BENCH_WARMUP:
+            state = audio_player_get_state();
+            if (state == AUDIO_STATE_PLAYING) {
+                /* 开始送数之后才计时, 不包含取消/起播/预读 */
+                audio_telemetry_reset();
+                vs1053_feeder_reset_stats();
+                s_tick = HAL_GetTick();
+                s_state = BENCH_MEASURE;
+            } else if (state == AUDIO_STATE_IDLE || HAL_GetTick() - s_tick > STREAM_BENCH_WARMUP_MS) {
+                result->failed = true;
+                s_state = BENCH_SKIP;
+            }
+            break;
+
+        case BENCH_MEASURE:
+            state = audio_player_get_state();
+            if (state != AUDIO_STATE_PLAYING) {
+                result->failed = true;      /* 文件提前读完或出错 */
+            } else if (HAL_GetTick() - s_tick < STREAM_BENCH_SECONDS * 1000U) {
+                break;
+            }
+            stream_bench_collect(result);
+            s_state = stream_bench_next();
+            break;
+
+        case BENCH_SKIP:
+            s_state = stream_bench_next();
+            break;
+
+        case BENCH_STOP:
+            stream_bench_stop();
+            s_state = BENCH_IDLE;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief       是否正在测试
+ * @param       无
+ * @retval      true: 正在测试
+ */
+bool stream_bench_busy(void)
+{
+    return s_state != BENCH_IDLE;
+}
+
+/**
+ * @brief       读取第idx个码率的结果
+ * @param       idx: 码率序号 (由低到高)
+ * @param       result: 输出
+ * @retval      true: 成功, false: 序号超出范围
+ */
+bool stream_bench_get(uint8_t idx, StreamBenchResult_t *result)
+{
+    if (idx >= STREAM_BENCH_RATES) {
+        return false;
+    }
+    *result = s_results[idx];
+    return true;
+}
+
+/**
+ * @brief       无送空的最高码率 (由低到高, 遇到第一个未通过的码率为止)
+ * @param       无
+ * @retval      kbps, 0表示都未通过
+ */
+uint16_t stream_bench_max_kbps(void)
+{
+    uint16_t kbps = 0;
+    uint8_t i;
+
+    for (i = 0; i < STREAM_BENCH_RATES; i++) {
+        if (!s_results[i].done || !s_results[i].sustained) {
+            break;
+        }
+        kbps = s_results[i].kbps;
+    }
+    return kbps;
+}
+
+/**
+ * @brief       格式化结果的第line行 (第0行为汇总, 之后每个码率一行)
+ * @param       line: 行号
+ * @param       buf: 输出缓冲区
+ * @param       size: 缓冲区大小
+ * @retval      true: 成功, false: 没有该行
+ */
+bool stream_bench_format(uint8_t line, char *buf, uint16_t size)
+{
+    const StreamBenchResult_t *r;
+
+    if (line == 0) {
+        snprintf(buf, size, "Bench: %us/rate, max %ukbps without underrun",
+                 STREAM_BENCH_SECONDS, stream_bench_max_kbps());
+        return true;
+    }
+    if (line > STREAM_BENCH_RATES) {
+        return false;
+    }
+
+    r = &s_results[line - 1];
+    if (!r->done) {
+        snprintf(buf, size, "%4uk %s %s", s_rates[line - 1].kbps,
+                 (s_rates[line - 1].index == 0) ? "WAV" : "MP3", r->failed ? "failed" : "not run");
+        return true;
+    }
+    snprintf(buf, size, "%4uk %s SD%4luKB/s %2u.%u%% feed%4luKB/s cpu%2u.%u%% ur%lu%s",
+             r->kbps, r->wav ? "WAV" : "MP3",
+             (unsigned long)r->sd_kbps, r->sd_busy_permille / 10, r->sd_busy_permille % 10,
+             (unsigned long)r->feed_kbps, r->feed_cpu_permille / 10, r->feed_cpu_permille % 10,
+             (unsigned long)r->underruns, r->sustained ? "" : " !");
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef STREAM_BENCH_H
+#define STREAM_BENCH_H
+
+#include "main.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 送数吞吐量测试 (码率扫描)
+ * 在SD卡STREAM_BENCH_DIR下生成从32kbps MP3到1411kbps PCM WAV的合成码流,
+ * 逐个经audio_player_play_file正常播放(读卡->环形缓冲区->DREQ/DMA送数),
+ * 开始送数后清零遥测和送数统计, 测量STREAM_BENCH_SECONDS秒:
+ * 平均读卡速率、f_read占用时间、SPI送数速率、送数路径CPU占用和缓冲区送空次数,
+ * 最后得出无送空的最高码率。读卡跟不上时主循环一直阻塞在f_read里, 水位采样
+ * 看不到缓冲区为空, 因此送数量低于码率(扣除VS1053 FIFO的余量)也算送空。
+ *
+ * 由USART1命令'b'启动, 结果通过遥测串口逐行输出; 主机仿真(tools/host_sim)
+ * 用同一模块对SD卡和VS1053替身运行, 下载前即可发现性能回退。
+ * 测试期间VS1053音量调到最小, 结束后恢复; 遥测统计会被清零。
+ */
+
+#define STREAM_BENCH_DIR            "0:/BENCH"
+#define STREAM_BENCH_SECONDS        5       /* 每个码率的测量时长 */
+#define STREAM_BENCH_MARGIN_S       3       /* 文件比测量时长多出的秒数(起播/预读) */
+#define STREAM_BENCH_WRITE_SECTORS  8       /* 生成文件时每次任务最多写入的扇区数 */
+#define STREAM_BENCH_RATES          7       /* 测试的码率个数 */
+#define STREAM_BENCH_MIN_PERCENT    98      /* 送数量至少为码率的百分比 */
+#define STREAM_BENCH_FIFO_SLACK     2048    /* VS1053 FIFO水位变化造成的送数量误差(字节) */
+
+/* 单个码率的测试结果 */
+typedef struct {
+    uint16_t kbps;              /* 码率 */
+    bool wav;                   /* true: PCM WAV, false: MP3 */
+    bool done;                  /* 已完成测量 */
+    bool failed;                /* 生成文件/起播失败或提前结束 */
+    uint32_t elapsed_ms;        /* 实际测量时长 */
+    uint32_t sd_kbps;           /* 平均读卡速率(KB/s) */
+    uint16_t sd_busy_permille;  /* f_read占用的时间(千分比) */
+    uint32_t feed_kbps;         /* SPI送数速率(KB/s) */
+    uint16_t feed_cpu_permille; /* 送数路径(中断+轮询)占用的CPU时间(千分比) */
+    uint32_t underruns;         /* 缓冲区送空次数 */
+    bool sustained;             /* 无送空且送数量跟上码率 */
+} StreamBenchResult_t;
+
+void stream_bench_start(void);                                  /* 开始扫描, 正在测试时忽略 */
+void stream_bench_task(void);                                   /* 主循环调用, 每次只推进一步 */
+bool stream_bench_busy(void);
+bool stream_bench_get(uint8_t idx, StreamBenchResult_t *result);   /* 第idx个码率的结果 */
+uint16_t stream_bench_max_kbps(void);                           /* 无送空的最高码率, 0表示都未通过 */
+bool stream_bench_format(uint8_t line, char *buf, uint16_t size);  /* 格式化结果第line行, 没有该行返回false */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STREAM_BENCH_H
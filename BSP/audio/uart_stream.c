@@ -0,0 +1,445 @@
+#include "uart_stream.h"
+#include "audio_player.h"
+#include "audio_ringbuf.h"
+#include "audio_recorder.h"
+#include "audio_telemetry.h"
+#include "stream_bench.h"
+#include "vs1053_driver.h"
+#include "vs1053_feeder.h"
+#include "usart.h"
+#include <stdio.h>
+#include <string.h>
+
+#if (UART_STREAM_BUF_SIZE < 4096) || (UART_STREAM_BUF_SIZE > 16384) || (UART_STREAM_BUF_SIZE & (UART_STREAM_BUF_SIZE - 1))
+#error "UART_STREAM_BUF_SIZE must be a power of 2 from 4KB to 16KB"
+#endif
+
+#define STREAM_WINDOW           (UART_STREAM_BUF_SIZE - 1)  /* 满和空要能区分 */
+#define STREAM_HELLO_TIMEOUT_MS 5000    /* 等待主机发头的最长时间 */
+
+/* 会话流程 */
+typedef enum {
+    STREAM_IDLE = 0,
+    STREAM_HELLO,               /* 以原波特率回复窗口, 发完后切换波特率并开始接收 */
+    STREAM_HEADER,              /* 等待8字节头 */
+    STREAM_PREBUFFER,           /* 预存 */
+    STREAM_FEEDING,             /* 边收边送 */
+    STREAM_DRAIN,               /* 已收完, 等缓冲区送完 */
+    STREAM_CANCEL,              /* 取消流程结束解码 */
+    STREAM_BYE                  /* 回复结果, 发完后恢复波特率 */
+} UartStreamState_t;
+
+/* 私有变量 */
+static UartStreamState_t s_state = STREAM_IDLE;
+static uint8_t s_buf[UART_STREAM_BUF_SIZE] __attribute__((aligned(4)));
+static AudioRingBuf_t s_ring;
+static DMA_HandleTypeDef s_dma;
+static bool s_dma_ready = false;
+static char s_line[UART_STREAM_LINE_LEN];   /* 发送缓冲区, 中断发送期间保持有效 */
+static bool s_line_sent = false;            /* BYE: 结果已提交发送 */
+static uint32_t s_baud = 0;                 /* 会话前的波特率 */
+static uint32_t s_rx_pos = 0;               /* 上次看到的DMA写入位置 */
+static uint32_t s_credit = 0;               /* 已告诉主机的额度 */
+static uint32_t s_start_tick = 0;           /* 收到头(或会话开始)的时刻 */
+static uint32_t s_rx_tick = 0;              /* 最近一次收到数据的时刻 */
+static bool s_rx_done = false;
+static bool s_feeding = false;              /* 已挂接送数器 */
+static bool s_starved = false;
+static UartStreamStats_t s_stats;
+
+/* ============================================================================
+ * 串口和DMA
+ * ============================================================================ */
+
+/**
+ * @brief       初始化USART1_RX的DMA (DMA1通道5, 循环模式, 不开中断)
+ * @param       无
+ * @retval      无
+ */
+static void stream_dma_init(void)
+{
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    s_dma.Instance = DMA1_Channel5;
+    s_dma.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    s_dma.Init.PeriphInc = DMA_PINC_DISABLE;
+    s_dma.Init.MemInc = DMA_MINC_ENABLE;
+    s_dma.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    s_dma.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    s_dma.Init.Mode = DMA_CIRCULAR;
+    s_dma.Init.Priority = DMA_PRIORITY_MEDIUM;
+    if (HAL_DMA_Init(&s_dma) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    s_dma_ready = true;
+}
+
+/**
+ * @brief       修改USART1波特率 (发送空闲时调用)
+ * @param       baud: 波特率
+ * @retval      无
+ */
+static void stream_set_baud(uint32_t baud)
+{
+    huart1.Init.BaudRate = baud;
+    huart1.Instance->BRR = UART_BRR_SAMPLING16(HAL_RCC_GetPCLK2Freq(), baud);
+}
+
+/**
+ * @brief       开始DMA循环接收
+ * @note        不用HAL_UART_Receive_DMA: 它会打开错误中断, 一次帧错误就中止接收
+ * @param       无
+ * @retval      无
+ */
+static void stream_rx_start(void)
+{
+    if (!s_dma_ready) {
+        stream_dma_init();
+    }
+
+    __HAL_UART_CLEAR_OREFLAG(&huart1);      /* 清掉命令阶段残留的数据和错误 */
+    audio_ringbuf_init(&s_ring, s_buf, sizeof(s_buf));
+    s_rx_pos = 0;
+    HAL_DMA_Start(&s_dma, (uint32_t)&huart1.Instance->DR, (uint32_t)s_buf, UART_STREAM_BUF_SIZE);
+    SET_BIT(huart1.Instance->CR3, USART_CR3_DMAR);
+}
+
+/**
+ * @brief       停止DMA接收, 已收到的数据留在缓冲区
+ * @param       无
+ * @retval      无
+ */
+static void stream_rx_stop(void)
+{
+    CLEAR_BIT(huart1.Instance->CR3, USART_CR3_DMAR);
+    HAL_DMA_Abort(&s_dma);
+}
+
+/**
+ * @brief       按DMA剩余计数推进环形缓冲区的写指针
+ * @note        主机不超额度时两次调用之间的新数据少于缓冲区大小, 位置差就是新字节数;
+ *              头之外的部分不超过码流长度
+ * @param       无
+ * @retval      无
+ */
+static void stream_rx_update(void)
+{
+    uint32_t pos = UART_STREAM_BUF_SIZE - __HAL_DMA_GET_COUNTER(&s_dma);
+    uint32_t n = (pos + UART_STREAM_BUF_SIZE - s_rx_pos) % UART_STREAM_BUF_SIZE;
+
+    if (huart1.Instance->SR & (USART_SR_ORE | USART_SR_FE | USART_SR_NE)) {
+        s_stats.rx_errors++;    /* 读SR后DMA读DR即清除 */
+    }
+
+    if (n == 0) {
+        return;
+    }
+    s_rx_pos = pos;
+    s_rx_tick = HAL_GetTick();
+
+    if (s_state != STREAM_HEADER && s_stats.length != 0 && s_stats.received + n > s_stats.length) {
+        n = s_stats.length - s_stats.received;
+    }
+    audio_ringbuf_commit(&s_ring, n);
+    if (s_state != STREAM_HEADER) {
+        s_stats.received += n;
+    }
+
+    if (s_ring.head > s_credit) {
+        s_stats.overruns++;     /* 主机超出额度, 未送出的数据可能已被覆盖 */
+        s_credit = s_ring.head;
+    }
+    if (s_feeding) {
+        vs1053_feeder_notify();
+    }
+}
+
+/**
+ * @brief       以中断方式发送一行
+ * @param       无
+ * @retval      true: 已提交, false: 串口正忙(遥测报告还在发送)
+ */
+static bool stream_send_line(void)
+{
+    uint16_t n;
+
+    if (huart1.gState != HAL_UART_STATE_READY) {
+        return false;
+    }
+    n = (uint16_t)strlen(s_line);
+    HAL_UART_Transmit_IT(&huart1, (uint8_t *)s_line, n);
+    return true;
+}
+
+/**
+ * @brief       送出的数据够多时给主机新的额度
+ * @param       无
+ * @retval      无
+ */
+static void stream_credit(void)
+{
+    uint32_t credit = s_ring.tail + STREAM_WINDOW;
+
+    if (s_rx_done || credit - s_credit < UART_STREAM_CREDIT_STEP) {
+        return;
+    }
+    snprintf(s_line, sizeof(s_line), "C %lu\r\n", credit);
+    if (stream_send_line()) {
+        s_credit = credit;
+    }
+}
+
+/* ============================================================================
+ * 会话
+ * ============================================================================ */
+
+/**
+ * @brief       解析头, 启动解码器
+ * @param       无
+ * @retval      true: 成功, false: 头错误或解码器启动失败
+ */
+static bool stream_open(void)
+{
+    uint32_t len;
+    const uint8_t *h = audio_ringbuf_read_ptr(&s_ring, &len);
+
+    if (memcmp(h, "VSTR", 4) != 0) {
+        return false;
+    }
+    s_stats.length = (uint32_t)h[4] | ((uint32_t)h[5] << 8) | ((uint32_t)h[6] << 16) | ((uint32_t)h[7] << 24);
+
+    /* 头之后已到的数据 */
+    s_stats.received = audio_ringbuf_fill(&s_ring) - UART_STREAM_HEADER;
+    if (s_stats.length != 0 && s_stats.received > s_stats.length) {
+        s_ring.head -= s_stats.received - s_stats.length;
+        s_stats.received = s_stats.length;
+    }
+    audio_ringbuf_consume(&s_ring, UART_STREAM_HEADER);
+    s_start_tick = HAL_GetTick();
+
+    if (!vs1053_decoder_idle()) {
+        vs1053_restart_play();
+    }
+    vs1053_set_all();
+    return vs1053_play_start();
+}
+
+/**
+ * @brief       开始送数
+ * @param       无
+ * @retval      无
+ */
+static void stream_start_feed(void)
+{
+    uint32_t len;
+    const uint8_t *buf = audio_ringbuf_read_ptr(&s_ring, &len);
+
+    vs1053_feeder_reset_stats();
+    vs1053_feeder_attach(&s_ring);
+    s_feeding = true;
+    s_starved = false;
+    s_stats.first_feed_ms = HAL_GetTick() - s_start_tick;
+    s_stats.min_fill = audio_ringbuf_fill(&s_ring);
+    audio_telemetry_track(buf, len);
+}
+
+/**
+ * @brief       结束会话: 回复结果, 之后恢复波特率
+ * @param       无
+ * @retval      无
+ */
+static void stream_finish(void)
+{
+    if (!s_rx_done) {
+        stream_rx_stop();
+        s_rx_done = true;
+    }
+    if (s_feeding) {
+        vs1053_feeder_attach(NULL);
+        s_feeding = false;
+    }
+    snprintf(s_line, sizeof(s_line), "END %lu %lu %lu\r\n", s_stats.received, s_stats.underruns,
+             s_stats.overruns + s_stats.rx_errors);
+    s_line_sent = false;
+    s_state = STREAM_BYE;
+}
+
+/**
+ * @brief       检查是否收完: 收满长度, 或超时没有新数据
+ * @param       无
+ * @retval      无
+ */
+static void stream_check_done(void)
+{
+    if (s_rx_done) {
+        return;
+    }
+    if ((s_stats.length != 0 && s_stats.received >= s_stats.length) ||
+        HAL_GetTick() - s_rx_tick >= UART_STREAM_IDLE_MS) {
+        stream_rx_stop();
+        s_rx_done = true;
+        s_stats.elapsed_ms = s_rx_tick - s_start_tick;
+    }
+}
+
+/* ============================================================================
+ * 接口
+ * ============================================================================ */
+
+/**
+ * @brief       开始串口送流会话 (串口命令'S')
+ * @note        停止当前播放; 以原波特率回复窗口大小后切换波特率
+ * @param       无
+ * @retval      true: 已开始, false: 正在送流/录音/测试
+ */
+bool uart_stream_start(void)
+{
+    if (s_state != STREAM_IDLE || audio_recorder_busy() || stream_bench_busy()) {
+        return false;
+    }
+
+    audio_player_stop();
+
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.active = true;
+    s_baud = huart1.Init.BaudRate;
+    s_credit = STREAM_WINDOW;
+    s_rx_done = false;
+    s_feeding = false;
+    snprintf(s_line, sizeof(s_line), "STREAM %lu %lu\r\n", (uint32_t)STREAM_WINDOW,
+             (uint32_t)(UART_STREAM_BAUD ? UART_STREAM_BAUD : s_baud));
+    s_line_sent = false;
+    s_state = STREAM_HELLO;
+
+    return true;
+}
+
+/**
+ * @brief       串口送流任务, 主循环调用
+ * @param       无
+ * @retval      无
+ */
+void uart_stream_task(void)
+{
+    uint32_t fill;
+
+    switch (s_state) {
+        case STREAM_IDLE:
+            return;
+
+        case STREAM_HELLO:
+            if (!s_line_sent) {
+                s_line_sent = stream_send_line();
+                return;
+            }
+            /* 最后一个字节移出后再换波特率 */
+            if (huart1.gState != HAL_UART_STATE_READY || !__HAL_UART_GET_FLAG(&huart1, UART_FLAG_TC)) {
+                return;
+            }
+            if (UART_STREAM_BAUD != 0) {
+                stream_set_baud(UART_STREAM_BAUD);
+            }
+            stream_rx_start();
+            s_start_tick = HAL_GetTick();
+            s_rx_tick = s_start_tick;
+            s_state = STREAM_HEADER;
+            break;
+
+        case STREAM_HEADER:
+            stream_rx_update();
+            if (audio_ringbuf_fill(&s_ring) < UART_STREAM_HEADER) {
+                if (HAL_GetTick() - s_start_tick >= STREAM_HELLO_TIMEOUT_MS) {
+                    stream_finish();
+                }
+                break;
+            }
+            if (!stream_open()) {
+                s_stats.rx_errors++;
+                stream_finish();
+                break;
+            }
+            s_state = STREAM_PREBUFFER;
+            break;
+
+        case STREAM_PREBUFFER:
+            stream_rx_update();
+            stream_check_done();
+            if (audio_ringbuf_fill(&s_ring) >= UART_STREAM_PREBUFFER || s_rx_done) {
+                stream_start_feed();
+                s_state = STREAM_FEEDING;
+            }
+            stream_credit();
+            break;
+
+        case STREAM_FEEDING:
+            stream_rx_update();
+            stream_check_done();
+
+            fill = audio_ringbuf_fill(&s_ring);
+            if (fill < s_stats.min_fill) {
+                s_stats.min_fill = fill;
+            }
+            if (fill != 0 || s_rx_done) {
+                s_starved = false;
+            } else if (!s_starved) {
+                s_starved = true;
+                s_stats.underruns++;
+            }
+
+            if (s_rx_done) {
+                s_state = STREAM_DRAIN;
+            }
+            stream_credit();
+            break;
+
+        case STREAM_DRAIN:
+            if (vs1053_feeder_idle()) {
+                vs1053_cancel_begin(true);      /* 送endFillByte让最后一帧解完, 再取消 */
+                s_state = STREAM_CANCEL;
+            }
+            break;
+
+        case STREAM_CANCEL:
+            if (vs1053_cancel_poll() == VS1053_CANCEL_DONE) {
+                stream_finish();
+            }
+            break;
+
+        case STREAM_BYE:
+            if (!s_line_sent) {
+                s_line_sent = stream_send_line();
+                return;
+            }
+            if (huart1.gState != HAL_UART_STATE_READY || !__HAL_UART_GET_FLAG(&huart1, UART_FLAG_TC)) {
+                return;
+            }
+            stream_set_baud(s_baud);
+            s_stats.active = false;
+            s_state = STREAM_IDLE;
+            break;
+    }
+}
+
+/**
+ * @brief       会话是否进行中
+ * @param       无
+ * @retval      true: USART1接收被占用
+ */
+bool uart_stream_busy(void)
+{
+    return (s_state != STREAM_IDLE);
+}
+
+/**
+ * @brief       读取会话统计
+ * @param       stats: 输出
+ * @retval      无
+ */
+void uart_stream_get_stats(UartStreamStats_t *stats)
+{
+    *stats = s_stats;
+    if (s_stats.active && !s_rx_done && s_state > STREAM_HEADER) {
+        stats->elapsed_ms = s_rx_tick - s_start_tick;
+    }
+}
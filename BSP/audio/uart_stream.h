@@ -0,0 +1,61 @@
+#ifndef UART_STREAM_H
+#define UART_STREAM_H
+
+#include "main.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 串口码流输入 (USART1 -> VS1053, 不经SD卡)
+ * USART1_RX由DMA1通道5循环写入环形缓冲区的存储区, 这块存储区同时挂接在VS1053
+ * 送数器上: 主循环按DMA剩余计数推进写指针, DREQ/DMA中断直接从里面取数据送SDI,
+ * 中间没有拷贝。VS1053自动识别格式(MP3/AAC/WAV/Ogg...)。
+ *
+ * 协议 (主机脚本: tools/uart_stream.py):
+ *   1. 主机以正常波特率发命令'S'; 板子停止播放, 回"STREAM <窗口> <波特率>",
+ *      发完后切到UART_STREAM_BAUD并开始DMA接收。
+ *   2. 主机切换波特率, 发8字节头: "VSTR" + 码流长度(32位小端, 0表示不定长)。
+ *   3. 主机累计发送的字节数(含头)不得超过板子给出的额度: 开始时为窗口大小,
+ *      之后板子每送出UART_STREAM_CREDIT_STEP字节回一行"C <额度>"。
+ *      额度 = 已送出字节数 + 缓冲区大小 - 1, 因此DMA永远不会覆盖未送出的数据。
+ *   4. 收满长度或UART_STREAM_IDLE_MS内没有新数据时结束: 送完缓冲区, 按取消流程
+ *      结束解码, 回"END <字节数> <送空次数> <错误>", 发完后恢复原波特率。
+ * 送流期间USART1的单字节命令不可用(接收由DMA占用)。
+ */
+
+#ifndef UART_STREAM_BAUD
+#define UART_STREAM_BAUD            2000000 /* 送流时的波特率, 0表示不切换 */
+#endif
+#define UART_STREAM_BUF_SIZE        (8 * 1024)  /* 环形缓冲区 = DMA循环缓冲区 */
+#define UART_STREAM_PREBUFFER       (4 * 1024)  /* 开始送数前的预存量 */
+#define UART_STREAM_CREDIT_STEP     1024        /* 额度每增加这么多回一行 */
+#define UART_STREAM_IDLE_MS         1000        /* 没有新数据多久算结束 */
+#define UART_STREAM_HEADER          8           /* "VSTR" + 长度 */
+#define UART_STREAM_LINE_LEN        48
+
+/* 会话统计 */
+typedef struct {
+    bool active;
+    uint32_t length;            /* 头中给出的码流长度, 0为不定长 */
+    uint32_t received;          /* 收到的码流字节数(不含头) */
+    uint32_t elapsed_ms;        /* 收到头 -> 最后一个字节 */
+    uint32_t first_feed_ms;     /* 收到头 -> 开始送数 */
+    uint32_t min_fill;          /* 开始送数后缓冲区最低水位 */
+    uint32_t underruns;         /* 送数期间缓冲区被送空的次数 */
+    uint32_t overruns;          /* 主机超出额度, 未送出的数据被覆盖 */
+    uint32_t rx_errors;         /* 串口溢出/帧错误/噪声 */
+} UartStreamStats_t;
+
+bool uart_stream_start(void);                       /* 串口命令'S': 开始会话, 录音/测试时返回false */
+void uart_stream_task(void);                        /* 主循环调用 */
+bool uart_stream_busy(void);                        /* 会话进行中, USART1接收被占用 */
+void uart_stream_get_stats(UartStreamStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UART_STREAM_H
@@ -1,5 +1,7 @@
 #include "vs1053_driver.h"
-#include "fatfs.h"
+#include "vs1053_feeder.h"
+#include "perf_counter.h"
+#include "filesystem.h"
 #include "nt35310_alientek.h"
 #include <string.h>
 
@@ -8,9 +10,43 @@ VS1053_Config_t g_vs1053_config;
 VS1053_PlayInfo_t g_vs1053_play_info;
 
 /* 私有变量 */
-static FIL audio_file;
+static FIL *audio_file = NULL;       /* 文件池 */
 static bool file_opened = false;
 
+/* SCI寄存器影子: 只缓存内容完全由主机写入决定的寄存器 */
+#define VS1053_SHADOW_MASK  ((1U << SPI_MODE) | (1U << SPI_BASS) | (1U << SPI_CLOCKF) | \
+                             (1U << SPI_AIADDR) | (1U << SPI_VOL))
+#define VS1053_MODE_VOLATILE (SM_RESET | SM_OUTOFWAV | SM_CANCEL)   /* 芯片会自行清零的位, 不进影子 */
+
+static uint16_t s_shadow[16];       /* 寄存器影子 */
+static uint16_t s_shadow_valid;     /* 影子有效位图 */
+static uint16_t s_shadow_dirty;     /* 已修改未写入的位图 */
+
+/* SCI命令队列 (单生产者: 主循环; 单消费者: 送数器中断) */
+
+typedef struct {
+    uint8_t read;                   /* 1: 读, 0: 写 */
+    uint8_t addr;                   /* 寄存器地址 */
+    uint16_t data;                  /* 写入值 */
+    VS1053_SciCallback_t cb;        /* 读完成回调 */
+} VS1053_SciCmd_t;
+
+static VS1053_SciCmd_t s_sci_queue[VS1053_SCI_QUEUE_SIZE];
+static volatile uint8_t s_sci_head;     /* 生产者写 */
+static volatile uint8_t s_sci_tail;     /* 消费者写 */
+
+static void vs1053_sci_queue_drain(void);
+
+/* 换曲取消流程 (只在主循环中访问) */
+static VS1053_CancelState_t s_cancel_state = VS1053_CANCEL_IDLE;
+static uint8_t s_cancel_fill;           /* 当前格式的endFillByte */
+static bool s_cancel_eof;               /* 文件已送完, 取消后不再补送 */
+static uint32_t s_cancel_tick;          /* 流程开始时刻, 用于超时 */
+static uint16_t s_cancel_resets;        /* 取消失败改用软复位的次数 */
+static bool s_decoder_idle = false;     /* 复位或取消流程结束后没有送过数据 */
+static VS1053_ResetHook_t s_reset_hook;  /* 软复位结束时调用 */
+static bool s_in_reset_hook = false;    /* 防止钩子中再次软复位时递归 */
+
 /* ============================================================================
  * 基础操作函数
  * ============================================================================ */
@@ -28,6 +64,8 @@ bool vs1053_init(void)
     vs1053_port_init();
     
     /* 硬件复位 - 按照正点原子的方式 */
+    vs1053_port_set_clockf(0);    /* 复位后CLKI=XTALI, SPI降到安全速度 */
+    vs1053_shadow_invalidate();
     VS_RST_L();
     HAL_Delay(20);
     VS_XDCS_H();  /* 取消数据传输 */
@@ -67,6 +105,9 @@ bool vs1053_init(void)
     memset(&g_vs1053_play_info, 0, sizeof(VS1053_PlayInfo_t));
     g_vs1053_play_info.state = VS1053_STATE_IDLE;
     
+    /* 启动DREQ中断 + DMA送数器 */
+    vs1053_feeder_init();
+    
     return true;
 }
 
@@ -77,6 +118,9 @@ bool vs1053_init(void)
  */
 bool vs1053_reset(void)
 {
+    vs1053_port_set_clockf(0);    /* 复位后CLKI=XTALI, SPI降到安全速度 */
+    vs1053_shadow_invalidate();
+    s_decoder_idle = false;     /* 硬复位后还要软复位 */
     VS_RST_L();
     HAL_Delay(20);
     
@@ -90,6 +134,8 @@ bool vs1053_reset(void)
 
 /**
  * @brief       软件复位VS1053
+ * @note        整个复位序列占用总线: 复位产生的DREQ上升沿不会让送数器中断
+ *              插入排队的SCI命令
  * @param       无
  * @retval      无
  */
@@ -97,6 +143,9 @@ void vs1053_soft_reset(void)
 {
     uint8_t retry = 0;
     
+    vs1053_feeder_hold();
+    vs1053_sci_queue_drain(); /* 排队的命令在复位前执行完 */
+    
     while (!VS_DREQ_READ()) {}  /* 等待软件复位结束 */
     
     /* 启动传输 - 这一步很重要 */
@@ -107,7 +156,9 @@ void vs1053_soft_reset(void)
     
     retry = 0;
     
-    /* 软件复位，新模式 */
+    /* 软件复位，新模式 (复位期间按CLOCKF=0的速度访问) */
+    vs1053_port_set_clockf(0);
+    vs1053_shadow_invalidate();
     while (vs1053_read_cmd(SPI_MODE) != 0x0800) {
         vs1053_write_cmd(SPI_MODE, 0x0804);  /* 软件复位，新模式 */
         HAL_Delay(2);  /* 等待至少1.35ms */
@@ -130,11 +181,36 @@ void vs1053_soft_reset(void)
         }
     }
     
+    /* CLOCKF没有被改写时(软复位前已是0x9800)也要按实际倍频更新SPI速度 */
+    vs1053_port_set_clockf(vs1053_read_cmd(SPI_CLOCKF));
+    
     HAL_Delay(20);
+    
+    vs1053_feeder_release();
+    
+    /* 软复位清空了指令RAM, 重新加载插件 */
+    if (s_reset_hook != NULL && !s_in_reset_hook) {
+        s_in_reset_hook = true;
+        s_reset_hook();
+        s_in_reset_hook = false;
+    }
+    
+    s_decoder_idle = true;
+}
+
+/**
+ * @brief       设置软复位结束时的回调
+ * @param       hook: 回调, NULL取消
+ * @retval      无
+ */
+void vs1053_set_reset_hook(VS1053_ResetHook_t hook)
+{
+    s_reset_hook = hook;
 }
 
 /**
  * @brief       测试VS1053通信 - 先简单测试再做RAM测试
+ * @note        XDCS为低期间送数器中断不能执行排队的SCI命令, 整个测试占用总线
  * @param       无
  * @retval      true: 通信正常, false: 通信异常
  */
@@ -142,10 +218,14 @@ bool vs1053_test(void)
 {
     uint16_t temp;
     
+    vs1053_feeder_hold();
+    vs1053_sci_queue_drain();
+    
     /* 先做简单的寄存器读取测试 */
     temp = vs1053_read_cmd(SPI_MODE);
     if (temp == 0xFFFF || temp == 0x0000) {
         /* SPI通信可能有问题 */
+        vs1053_feeder_release();
         return false;
     }
     
@@ -170,6 +250,7 @@ bool vs1053_test(void)
     temp = vs1053_read_cmd(SPI_HDAT0);  /* VS1003如果得到的值为0x807F，则表明完好; VS1053为0X83FF */
     
     vs1053_port_speed_high();
+    vs1053_feeder_release();
     
     if (temp == 0x83FF || temp == 0x807F) {  /* VS1053或VS1003测试通过 */
         return true;
@@ -190,9 +271,12 @@ bool vs1053_test(void)
  */
 void vs1053_write_cmd(uint8_t addr, uint16_t data)
 {
+    vs1053_feeder_hold();     /* 等待DMA突发结束, 独占SPI */
+    vs1053_sci_queue_drain(); /* 先执行排队的命令, 保证顺序 */
+    
     while (!VS_DREQ_READ()) {}  /* 等待空闲 */
     
-    vs1053_port_speed_low();  /* 低速模式 */
+    vs1053_port_sci_begin(false); /* SCI写速度 (只在速度变化时改CR1) */
     VS_XDCS_H();              /* 确保数据接口禁用 */
     VS_XCS_L();               /* 使能命令接口 */
     vs1053_port_rw(VS_WRITE_COMMAND);
@@ -200,7 +284,65 @@ void vs1053_write_cmd(uint8_t addr, uint16_t data)
     vs1053_port_rw(data >> 8);
     vs1053_port_rw(data & 0xFF);
     VS_XCS_H();               /* 禁用命令接口 */
-    vs1053_port_speed_high(); /* 恢复高速模式 */
+    vs1053_port_sci_end();
+    
+    vs1053_shadow_store(addr, data);
+    
+    if (addr == SPI_CLOCKF) {
+        /* 时钟切换期间DREQ为低, 切换完成后按新的CLKI选择SPI速度 */
+        while (!VS_DREQ_READ()) {}
+        vs1053_port_set_clockf(data);
+    }
+    
+    vs1053_feeder_release();
+}
+
+/**
+ * @brief       同一寄存器连续写 (插件加载: SCI_WRAMADDR设好地址后连续写SCI_WRAM)
+ * @note        整段只占用一次总线, 每个字之间只等DREQ, 以SCI写的最高速度发送
+ * @param       addr: 寄存器地址
+ * @param       data: 数据
+ * @param       count: 字数
+ * @param       repeat: true: data[0]重复写count次 (插件的RLE段)
+ * @retval      无
+ */
+void vs1053_write_cmd_block(uint8_t addr, const uint16_t *data, uint16_t count, bool repeat)
+{
+    uint8_t frame[4];
+    uint16_t value = 0;
+    uint16_t i;
+    
+    if (count == 0) {
+        return;
+    }
+    
+    vs1053_feeder_hold();
+    vs1053_sci_queue_drain();
+    
+    vs1053_port_sci_begin(false);
+    VS_XDCS_H();
+    frame[0] = VS_WRITE_COMMAND;
+    frame[1] = addr;
+    for (i = 0; i < count; i++) {
+        value = repeat ? data[0] : data[i];
+        frame[2] = value >> 8;
+        frame[3] = value & 0xFF;
+        
+        while (!VS_DREQ_READ()) {}
+        VS_XCS_L();
+        vs1053_port_write(frame, sizeof(frame));
+        VS_XCS_H();
+    }
+    vs1053_port_sci_end();
+    
+    vs1053_shadow_store(addr, value);
+    
+    if (addr == SPI_CLOCKF) {
+        while (!VS_DREQ_READ()) {}
+        vs1053_port_set_clockf(value);
+    }
+    
+    vs1053_feeder_release();
 }
 
 /**
@@ -212,9 +354,12 @@ uint16_t vs1053_read_cmd(uint8_t addr)
 {
     uint16_t temp;
     
+    vs1053_feeder_hold();     /* 等待DMA突发结束, 独占SPI */
+    vs1053_sci_queue_drain(); /* 先执行排队的命令, 保证顺序 */
+    
     while (!VS_DREQ_READ()) {}  /* 等待空闲 */
     
-    vs1053_port_speed_low();  /* 低速模式 */
+    vs1053_port_sci_begin(true); /* SCI读速度 (只在速度变化时改CR1) */
     VS_XDCS_H();              /* 确保数据接口禁用 */
     VS_XCS_L();               /* 使能命令接口 */
     vs1053_port_rw(VS_READ_COMMAND);
@@ -222,11 +367,431 @@ uint16_t vs1053_read_cmd(uint8_t addr)
     temp = vs1053_port_rw(0xFF) << 8;
     temp |= vs1053_port_rw(0xFF);
     VS_XCS_H();               /* 禁用命令接口 */
-    vs1053_port_speed_high(); /* 恢复高速模式 */
+    vs1053_port_sci_end();
+    
+    vs1053_feeder_release();
+    
+    if ((s_shadow_dirty & (1U << (addr & 0x0F))) == 0) {
+        vs1053_shadow_store(addr, temp);    /* 已修改未写入的值不被读回的旧值覆盖 */
+    }
     
     return temp;
 }
 
+/**
+ * @brief       批量读SCI寄存器
+ * @note        整批只占用一次总线、切换一次SPI速度、等待一次DREQ;
+ *              SCI协议要求每条命令后拉高XCS, 命令之间XCS仍会翻转.
+ *              影子有效的寄存器直接返回影子值, 不占总线
+ * @param       mask: 要读的寄存器位图 (bit n对应寄存器n)
+ * @param       out: 输出, 按寄存器地址存放, 至少16个元素
+ * @retval      实际在总线上读取的寄存器个数
+ */
+uint8_t vs1053_read_regs(uint16_t mask, uint16_t out[])
+{
+    uint8_t addr;
+    uint8_t n = 0;
+    uint16_t temp;
+    
+    /* 影子中有的直接给出 */
+    for (addr = 0; addr < 16; addr++) {
+        if ((mask & (1U << addr)) && (s_shadow_valid & (1U << addr))) {
+            out[addr] = s_shadow[addr];
+            mask &= ~(1U << addr);
+        }
+    }
+    
+    if (mask == 0) {
+        return 0;
+    }
+    
+    vs1053_feeder_hold();     /* 整批只等一次DMA突发结束 */
+    vs1053_sci_queue_drain();
+    
+    while (!VS_DREQ_READ()) {}  /* 等待空闲 */
+    
+    vs1053_port_sci_begin(true);
+    VS_XDCS_H();
+    
+    for (addr = 0; addr < 16; addr++) {
+        if ((mask & (1U << addr)) == 0) {
+            continue;
+        }
+        
+        VS_XCS_L();
+        vs1053_port_rw(VS_READ_COMMAND);
+        vs1053_port_rw(addr);
+        temp = vs1053_port_rw(0xFF) << 8;
+        temp |= vs1053_port_rw(0xFF);
+        VS_XCS_H();
+        
+        out[addr] = temp;
+        n++;
+    }
+    
+    vs1053_port_sci_end();
+    vs1053_feeder_release();
+    
+    for (addr = 0; addr < 16; addr++) {
+        if ((mask & (1U << addr)) && (s_shadow_dirty & (1U << addr)) == 0) {
+            vs1053_shadow_store(addr, out[addr]);
+        }
+    }
+    
+    return n;
+}
+
+/**
+ * @brief       同一寄存器连续读 (ADPCM录音: 连续读SCI_HDAT0取编码数据)
+ * @note        整段只占用一次总线、等待一次DREQ; 每个字按高字节在前存入buf,
+ *              即编码器输出的字节顺序. 不更新影子
+ * @param       addr: 寄存器地址
+ * @param       buf: 输出, 至少2*count字节
+ * @param       count: 字数
+ * @retval      无
+ */
+void vs1053_read_cmd_block(uint8_t addr, uint8_t *buf, uint16_t count)
+{
+    uint16_t i;
+    
+    if (count == 0) {
+        return;
+    }
+    
+    vs1053_feeder_hold();
+    vs1053_sci_queue_drain();
+    
+    while (!VS_DREQ_READ()) {}  /* 等待空闲 */
+    
+    vs1053_port_sci_begin(true);
+    VS_XDCS_H();
+    for (i = 0; i < count; i++) {
+        VS_XCS_L();
+        vs1053_port_rw(VS_READ_COMMAND);
+        vs1053_port_rw(addr);
+        *buf++ = vs1053_port_rw(0xFF);
+        *buf++ = vs1053_port_rw(0xFF);
+        VS_XCS_H();
+    }
+    vs1053_port_sci_end();
+    
+    vs1053_feeder_release();
+}
+
+/**
+ * @brief       读VS1053 RAM (X/Y/I存储区, 参考正点原子vs10xx_read_ram)
+ * @param       addr: RAM地址, 如0x1E06(endFillByte)、0x1E05(byteRate)
+ * @retval      16位值
+ */
+uint16_t vs1053_read_ram(uint16_t addr)
+{
+    vs1053_write_cmd(SPI_WRAMADDR, addr);
+    return vs1053_read_cmd(SPI_WRAM);
+}
+
+/**
+ * @brief       写VS1053 RAM
+ * @param       addr: RAM地址
+ * @param       data: 16位值
+ * @retval      无
+ */
+void vs1053_write_ram(uint16_t addr, uint16_t data)
+{
+    vs1053_write_cmd(SPI_WRAMADDR, addr);
+    vs1053_write_cmd(SPI_WRAM, data);
+}
+
+/**
+ * @brief       读取当前格式的结束填充字节 (参数endFillByte, X:0x1E06低8位)
+ * @note        取消或结束解码后必须用这个字节而不是0填充, 否则FLAC/Ogg等格式可能出杂音
+ * @param       无
+ * @retval      填充字节
+ */
+uint8_t vs1053_get_fill_byte(void)
+{
+    return (uint8_t)(vs1053_read_ram(VS1053_PARA_END_FILL_BYTE) & 0xFF);
+}
+
+/* ============================================================================
+ * 寄存器影子缓存
+ * ============================================================================ */
+
+/**
+ * @brief       记录寄存器的当前值 (总线写后调用; 读后只在寄存器不脏时调用)
+ * @param       addr: 寄存器地址
+ * @param       data: 寄存器值
+ * @retval      无
+ */
+void vs1053_shadow_store(uint8_t addr, uint16_t data)
+{
+    uint16_t bit = 1U << (addr & 0x0F);
+    
+    if ((VS1053_SHADOW_MASK & bit) == 0) {
+        return;
+    }
+    
+    if (addr == SPI_MODE) {
+        data &= ~VS1053_MODE_VOLATILE;
+    }
+    
+    s_shadow[addr & 0x0F] = data;
+    s_shadow_valid |= bit;
+    s_shadow_dirty &= ~bit;
+}
+
+/**
+ * @brief       作废全部影子 (复位后调用)
+ * @param       无
+ * @retval      无
+ */
+void vs1053_shadow_invalidate(void)
+{
+    s_shadow_valid = 0;
+    s_shadow_dirty = 0;
+}
+
+/**
+ * @brief       获取寄存器值, 影子有效时不访问总线
+ * @param       addr: 寄存器地址
+ * @retval      寄存器值 (包含尚未写入的修改)
+ */
+uint16_t vs1053_reg_get(uint8_t addr)
+{
+    if (s_shadow_valid & (1U << (addr & 0x0F))) {
+        return s_shadow[addr & 0x0F];
+    }
+    
+    return vs1053_read_cmd(addr);
+}
+
+/**
+ * @brief       修改寄存器值 (只改影子并标记为脏, vs1053_reg_flush时写入)
+ * @note        不在影子中的寄存器直接写入
+ * @param       addr: 寄存器地址
+ * @param       data: 新值
+ * @retval      无
+ */
+void vs1053_reg_set(uint8_t addr, uint16_t data)
+{
+    uint16_t bit = 1U << (addr & 0x0F);
+    
+    if ((VS1053_SHADOW_MASK & bit) == 0) {
+        vs1053_write_cmd(addr, data);
+        return;
+    }
+    
+    /* 值没有变化则不需要写 */
+    if ((s_shadow_valid & bit) && s_shadow[addr & 0x0F] == data) {
+        return;
+    }
+    
+    s_shadow[addr & 0x0F] = data;
+    s_shadow_valid |= bit;
+    s_shadow_dirty |= bit;
+}
+
+/**
+ * @brief       读-改-写寄存器, 读取使用影子
+ * @param       addr: 寄存器地址
+ * @param       clear: 要清零的位
+ * @param       set: 要置位的位
+ * @retval      无
+ */
+void vs1053_reg_modify(uint8_t addr, uint16_t clear, uint16_t set)
+{
+    vs1053_reg_set(addr, (vs1053_reg_get(addr) & ~clear) | set);
+}
+
+/**
+ * @brief       把所有脏寄存器写入VS1053
+ * @param       无
+ * @retval      写入的寄存器个数
+ */
+uint8_t vs1053_reg_flush(void)
+{
+    uint8_t addr;
+    uint8_t n = 0;
+    
+    for (addr = 0; s_shadow_dirty != 0 && addr < 16; addr++) {
+        if (s_shadow_dirty & (1U << addr)) {
+            vs1053_write_cmd(addr, s_shadow[addr]);     /* 写入后清除脏位 */
+            n++;
+        }
+    }
+    
+    return n;
+}
+
+/**
+ * @brief       把所有脏寄存器放入SCI命令队列, 不等待
+ * @note        队列满时剩余的寄存器改为同步写入
+ * @param       无
+ * @retval      无
+ */
+void vs1053_reg_flush_async(void)
+{
+    uint8_t addr;
+    
+    for (addr = 0; s_shadow_dirty != 0 && addr < 16; addr++) {
+        if (s_shadow_dirty & (1U << addr)) {
+            if (!vs1053_sci_post_write(addr, s_shadow[addr])) {
+                vs1053_write_cmd(addr, s_shadow[addr]);
+            }
+        }
+    }
+}
+
+/* ============================================================================
+ * SCI命令队列
+ * ============================================================================ */
+
+/**
+ * @brief       执行一次SCI读写 (调用者保证总线空闲)
+ * @param       read: true读, false写
+ * @param       addr: 寄存器地址
+ * @param       data: 写入值
+ * @retval      读到的值, 写操作返回0
+ */
+static uint16_t vs1053_sci_xfer(bool read, uint8_t addr, uint16_t data)
+{
+    uint16_t value = 0;
+    
+    vs1053_port_sci_begin(read);
+    VS_XDCS_H();
+    VS_XCS_L();
+    if (read) {
+        vs1053_port_rw(VS_READ_COMMAND);
+        vs1053_port_rw(addr);
+        value = vs1053_port_rw(0xFF) << 8;
+        value |= vs1053_port_rw(0xFF);
+    } else {
+        vs1053_port_rw(VS_WRITE_COMMAND);
+        vs1053_port_rw(addr);
+        vs1053_port_rw(data >> 8);
+        vs1053_port_rw(data & 0xFF);
+    }
+    VS_XCS_H();
+    vs1053_port_sci_end();
+    
+    return value;
+}
+
+/**
+ * @brief       命令入队
+ * @param       cmd: 命令
+ * @retval      true: 成功, false: 队列满或送数器未启动
+ */
+static bool vs1053_sci_post(const VS1053_SciCmd_t *cmd)
+{
+    uint8_t head = s_sci_head;
+    
+    if ((uint8_t)(head - s_sci_tail) >= VS1053_SCI_QUEUE_SIZE) {
+        return false;
+    }
+    
+    s_sci_queue[head & (VS1053_SCI_QUEUE_SIZE - 1)] = *cmd;
+    __DMB();                        /* 命令内容先于head可见 */
+    s_sci_head = head + 1;
+    
+    vs1053_feeder_notify();
+    return true;
+}
+
+/**
+ * @brief       排队写SCI寄存器, 由送数器在两次SDI突发之间执行
+ * @note        不支持SPI_CLOCKF (写入后需要等待时钟切换), 影子立即更新
+ * @param       addr: 寄存器地址
+ * @param       data: 写入值
+ * @retval      true: 已入队, false: 队列满, 调用者可改用vs1053_write_cmd
+ */
+bool vs1053_sci_post_write(uint8_t addr, uint16_t data)
+{
+    VS1053_SciCmd_t cmd = {0, addr, data, NULL};
+    
+    if (addr == SPI_CLOCKF || !vs1053_sci_post(&cmd)) {
+        return false;
+    }
+    
+    vs1053_shadow_store(addr, data);
+    return true;
+}
+
+/**
+ * @brief       排队读SCI寄存器, 结果通过回调返回
+ * @note        回调可能在DREQ/DMA中断中执行, 应尽量简短且不能再访问VS1053
+ * @param       addr: 寄存器地址
+ * @param       cb: 读完成回调
+ * @retval      true: 已入队, false: 队列满
+ */
+bool vs1053_sci_post_read(uint8_t addr, VS1053_SciCallback_t cb)
+{
+    VS1053_SciCmd_t cmd = {1, addr, 0, cb};
+    
+    return vs1053_sci_post(&cmd);
+}
+
+/**
+ * @brief       排队中的命令数
+ * @param       无
+ * @retval      命令数
+ */
+uint8_t vs1053_sci_queue_pending(void)
+{
+    return (uint8_t)(s_sci_head - s_sci_tail);
+}
+
+/**
+ * @brief       执行一条排队的SCI命令
+ * @note        由送数器在SPI空闲(无DMA突发、未被占用)时调用; DREQ为低时不执行
+ * @param       无
+ * @retval      true: 执行了一条命令
+ */
+bool vs1053_sci_queue_service(void)
+{
+    VS1053_SciCmd_t *cmd;
+    uint16_t value;
+    uint8_t tail = s_sci_tail;
+    
+    if (tail == s_sci_head || !VS_DREQ_READ()) {
+        return false;
+    }
+    
+    cmd = &s_sci_queue[tail & (VS1053_SCI_QUEUE_SIZE - 1)];
+    value = vs1053_sci_xfer(cmd->read != 0, cmd->addr, cmd->data);
+    
+    s_sci_tail = tail + 1;
+    
+    if (cmd->read && cmd->cb != NULL) {
+        cmd->cb(cmd->addr, value);
+    }
+    
+    return true;
+}
+
+/**
+ * @brief       直接读一个SCI寄存器, 不占用总线也不等DREQ
+ * @note        只在送数器中断中两次突发之间调用(此时总线空闲且DREQ为高)
+ * @param       addr: 寄存器地址
+ * @retval      寄存器值
+ */
+uint16_t vs1053_sci_read_direct(uint8_t addr)
+{
+    return vs1053_sci_xfer(true, addr, 0);
+}
+
+/**
+ * @brief       在调用者上下文中执行完所有排队命令 (同步访问前调用, 需已占用总线)
+ * @param       无
+ * @retval      无
+ */
+static void vs1053_sci_queue_drain(void)
+{
+    while (vs1053_sci_queue_pending() != 0) {
+        while (!VS_DREQ_READ()) {}
+        vs1053_sci_queue_service();
+    }
+}
+
 /* ============================================================================
  * 音频控制函数
  * ============================================================================ */
@@ -244,7 +809,8 @@ void vs1053_set_volume(uint8_t volume)
     if (vs_vol > 254) vs_vol = 254;  /* 限制最小音量 */
     
     uint16_t vol_reg = (vs_vol << 8) | vs_vol;  /* 左右声道相同 */
-    vs1053_write_cmd(SPI_VOL, vol_reg);
+    vs1053_reg_set(SPI_VOL, vol_reg);
+    vs1053_reg_flush_async();   /* 排队写入, 不等DREQ; 与当前值相同时不访问总线 */
     g_vs1053_config.volume = volume;
 }
 
@@ -257,7 +823,8 @@ void vs1053_set_volume(uint8_t volume)
 void vs1053_set_bass(uint8_t freq, uint8_t amp)
 {
     uint16_t bass_reg = (amp << 4) | freq;
-    vs1053_write_cmd(SPI_BASS, bass_reg);
+    vs1053_reg_modify(SPI_BASS, 0x00FF, bass_reg & 0x00FF);   /* 保留高音设置 */
+    vs1053_reg_flush_async();
     g_vs1053_config.bass_freq = freq;
     g_vs1053_config.bass_amp = amp;
 }
@@ -271,8 +838,8 @@ void vs1053_set_bass(uint8_t freq, uint8_t amp)
 void vs1053_set_treble(uint8_t freq, uint8_t amp)
 {
     uint16_t treble_reg = (amp << 12) | (freq << 8);
-    uint16_t bass_reg = vs1053_read_cmd(SPI_BASS);
-    vs1053_write_cmd(SPI_BASS, (bass_reg & 0x00FF) | treble_reg);
+    vs1053_reg_modify(SPI_BASS, 0xFF00, treble_reg);   /* 低音部分取自影子, 不读总线 */
+    vs1053_reg_flush_async();
     g_vs1053_config.treble_freq = freq;
     g_vs1053_config.treble_amp = amp;
 }
@@ -304,35 +871,24 @@ bool vs1053_play_start(void)
         return false;
     }
     
-    /* 软复位VS1053 - 参考正点原子方法 */
-    vs1053_soft_reset();
+    /* 解码器已由取消流程(或上电复位)置为空闲, 这里不再软复位, 也不用送空数据启动 */
     
     /* 重置解码时间 */
     vs1053_write_cmd(SPI_DECODE_TIME, 0x0000);
     vs1053_write_cmd(SPI_DECODE_TIME, 0x0000);
+    g_vs1053_play_info.decode_time = 0;
     
     /* 设置播放模式 - 清除SM_TESTS位，确保正常播放模式 */
-    uint16_t mode = vs1053_read_cmd(SPI_MODE);
-    mode &= ~SM_TESTS;  /* 清除测试模式 */
-    mode &= ~SM_RESET;  /* 清除复位位 */
-    vs1053_write_cmd(SPI_MODE, mode);
+    vs1053_reg_modify(SPI_MODE, SM_TESTS | SM_RESET, 0);  /* 清除测试模式和复位位 */
+    vs1053_reg_flush();
     
     /* 等待准备就绪 */
     if (!vs1053_wait_ready(1000)) {
         return false;
     }
     
-    /* 发送一些空数据来启动解码器 - 参考正点原子方法 */
-    uint8_t init_data[32];
-    memset(init_data, 0, sizeof(init_data));
-    
-    for (int i = 0; i < 4; i++) {  /* 发送4次32字节的空数据 */
-        while (!VS_DREQ_READ()) {  /* 等待准备就绪 */
-            HAL_Delay(1);
-        }
-        vs1053_write_data(init_data, 32);
-    }
-    
+    s_cancel_state = VS1053_CANCEL_IDLE;
+    s_decoder_idle = false;     /* 接下来要送数据了 */
     g_vs1053_play_info.state = VS1053_STATE_PLAYING;
     return true;
 }
@@ -344,17 +900,14 @@ bool vs1053_play_start(void)
  */
 void vs1053_test_sine_wave(void)
 {
-    uint16_t mode;
-    
     /* 确保VS1053准备就绪 */
     while (!VS_DREQ_READ()) {
         HAL_Delay(1);
     }
     
     /* 设置VS1053为测试模式 */
-    mode = vs1053_read_cmd(SPI_MODE);
-    mode |= SM_TESTS;  /* 设置测试模式位 */
-    vs1053_write_cmd(SPI_MODE, mode);
+    vs1053_reg_modify(SPI_MODE, 0, SM_TESTS);  /* 设置测试模式位 */
+    vs1053_reg_flush();
     
     /* 等待模式设置生效 */
     HAL_Delay(10);
@@ -363,6 +916,7 @@ void vs1053_test_sine_wave(void)
     }
     
     /* 发送正弦波测试命令 (1KHz正弦波) */
+    vs1053_feeder_hold();
     vs1053_port_speed_low();  /* 使用低速SPI进行测试 */
     
     VS_XDCS_L();  /* 选择数据接口 */
@@ -392,11 +946,11 @@ void vs1053_test_sine_wave(void)
     VS_XDCS_H();
     
     vs1053_port_speed_high();  /* 恢复高速SPI */
+    vs1053_feeder_release();
     
     /* 退出测试模式 */
-    mode = vs1053_read_cmd(SPI_MODE);
-    mode &= ~SM_TESTS;  /* 清除测试模式位 */
-    vs1053_write_cmd(SPI_MODE, mode);
+    vs1053_reg_modify(SPI_MODE, SM_TESTS, 0);  /* 清除测试模式位 */
+    vs1053_reg_flush();
     
     /* 等待退出测试模式 */
     HAL_Delay(10);
@@ -435,14 +989,20 @@ void vs1053_play_stop(void)
 {
     g_vs1053_play_info.state = VS1053_STATE_STOPPED;
     
+    /* 丢弃送数器中尚未发出的数据 */
+    vs1053_feeder_stop();
+    
     /* 关闭文件 */
     if (file_opened) {
-        f_close(&audio_file);
+        fs_close_file(&audio_file);
         file_opened = false;
     }
     
-    /* 软复位清除缓冲区 */
-    vs1053_soft_reset();
+    /* 已按取消流程结束或还没送过数据时解码器是空闲的, 不必再软复位 */
+    if (s_cancel_state != VS1053_CANCEL_DONE && !s_decoder_idle) {
+        vs1053_soft_reset();    /* 中途停止, 软复位清除缓冲区 */
+    }
+    s_cancel_state = VS1053_CANCEL_IDLE;
     
     g_vs1053_play_info.state = VS1053_STATE_IDLE;
 }
@@ -457,6 +1017,143 @@ bool vs1053_is_playing(void)
     return (g_vs1053_play_info.state == VS1053_STATE_PLAYING);
 }
 
+/* ============================================================================
+ * 换曲取消流程
+ * ============================================================================ */
+
+/**
+ * @brief       置SM_CANCEL, 由送数器在每32字节之间检查该位
+ * @param       无
+ * @retval      无
+ */
+static void vs1053_cancel_set(void)
+{
+    vs1053_write_cmd(SPI_MODE, vs1053_reg_get(SPI_MODE) | SM_CANCEL);
+    vs1053_feeder_cancel(s_cancel_fill, VS1053_CANCEL_LIMIT);
+    s_cancel_state = VS1053_CANCEL_WAITING;
+}
+
+/**
+ * @brief       取消失败时的兜底: 丢弃数据并软复位
+ * @param       无
+ * @retval      无
+ */
+static void vs1053_cancel_fallback(void)
+{
+    vs1053_feeder_stop();
+    vs1053_soft_reset();
+    vs1053_set_all();           /* 软复位后恢复音量/音调和喇叭 */
+    s_cancel_resets++;
+    s_cancel_state = VS1053_CANCEL_DONE;
+}
+
+/**
+ * @brief       开始结束当前解码 (非阻塞)
+ * @note        中途换曲: 置SM_CANCEL, 送数器继续送缓冲区剩余数据(送完后用endFillByte),
+ *              每32字节读一次MODE, 该位清零后补送2052个endFillByte.
+ *              文件尾: 先送2052个endFillByte, 再按上面的方式置SM_CANCEL.
+ *              整个过程不复位芯片, 音量等设置保持不变.
+ * @param       at_eof: true表示当前文件已全部送入VS1053
+ * @retval      无
+ */
+void vs1053_cancel_begin(bool at_eof)
+{
+    s_cancel_fill = vs1053_get_fill_byte();
+    s_cancel_eof = at_eof;
+    s_cancel_tick = HAL_GetTick();
+    
+    if (at_eof) {
+        vs1053_feeder_fill(s_cancel_fill, VS1053_CANCEL_FILL);
+        s_cancel_state = VS1053_CANCEL_FILLING;
+    } else {
+        vs1053_cancel_set();
+    }
+}
+
+/**
+ * @brief       推进取消流程, 每次只检查一次状态
+ * @param       无
+ * @retval      当前状态, VS1053_CANCEL_DONE表示可以送下一首
+ */
+VS1053_CancelState_t vs1053_cancel_poll(void)
+{
+    uint16_t regs[16];
+    
+    if (s_cancel_state == VS1053_CANCEL_IDLE || s_cancel_state == VS1053_CANCEL_DONE) {
+        return s_cancel_state;
+    }
+    
+    if (HAL_GetTick() - s_cancel_tick > VS1053_CANCEL_TIMEOUT_MS) {
+        vs1053_cancel_fallback();   /* DREQ一直不来, 芯片可能已挂死 */
+        return s_cancel_state;
+    }
+    
+    switch (s_cancel_state) {
+        case VS1053_CANCEL_FILLING:
+            if (vs1053_feeder_idle()) {
+                vs1053_cancel_set();
+            }
+            break;
+        
+        case VS1053_CANCEL_WAITING:
+            switch (vs1053_feeder_cancel_state()) {
+                case VS1053_FEED_CANCEL_DONE:
+                    if (!s_cancel_eof) {
+                        vs1053_feeder_fill(s_cancel_fill, VS1053_CANCEL_FILL);  /* 文件尾已在前面送过 */
+                    }
+                    s_cancel_state = VS1053_CANCEL_PADDING;
+                    break;
+                
+                case VS1053_FEED_CANCEL_FAILED:
+                    vs1053_cancel_fallback();   /* 送了2048字节SM_CANCEL仍未清零 */
+                    break;
+                
+                default:
+                    break;
+            }
+            break;
+        
+        case VS1053_CANCEL_PADDING:
+            if (vs1053_feeder_idle()) {
+                /* HDAT0/HDAT1都为0表示已没有格式在解码 */
+                vs1053_read_regs((1U << SPI_HDAT0) | (1U << SPI_HDAT1), regs);
+                if (regs[SPI_HDAT0] != 0 || regs[SPI_HDAT1] != 0) {
+                    vs1053_cancel_fallback();
+                } else {
+                    s_cancel_state = VS1053_CANCEL_DONE;
+                    s_decoder_idle = true;
+                }
+            }
+            break;
+        
+        default:
+            break;
+    }
+    
+    return s_cancel_state;
+}
+
+/**
+ * @brief       解码器是否空闲 (复位或取消流程结束后还没有开始送新数据)
+ * @note        空闲时开始播放不需要再做取消/复位
+ * @param       无
+ * @retval      true: 空闲
+ */
+bool vs1053_decoder_idle(void)
+{
+    return s_decoder_idle;
+}
+
+/**
+ * @brief       取消失败改用软复位的次数
+ * @param       无
+ * @retval      次数
+ */
+uint16_t vs1053_cancel_resets(void)
+{
+    return s_cancel_resets;
+}
+
 /* ============================================================================
  * 文件播放函数
  * ============================================================================ */
@@ -468,14 +1165,11 @@ bool vs1053_is_playing(void)
  */
 bool vs1053_play_file(const char* filename)
 {
-    FRESULT res;
-    
     /* 停止当前播放 */
     vs1053_play_stop();
     
     /* 打开文件 */
-    res = f_open(&audio_file, filename, FA_READ);
-    if (res != FR_OK) {
+    if (fs_open_file(filename, FA_READ, &audio_file) != FS_STATUS_OK) {
         g_vs1053_play_info.state = VS1053_STATE_ERROR;
         return false;
     }
@@ -510,7 +1204,9 @@ void vs1053_play_buffer(const uint8_t* buffer, uint32_t size)
         }
         
         /* 发送数据 */
+        vs1053_feeder_hold();
         vs1053_write_data(&buffer[i], chunk_size);
+        vs1053_feeder_release();
     }
 }
 
@@ -625,9 +1321,9 @@ void vs1053_restart_play(void)
         vsbuf[n] = 0;
     }
     
-    temp = vs1053_read_cmd(SPI_MODE);   /* 读取SPI_MODE的内容 */
-    temp |= 1 << 3;                     /* 设置SM_CANCEL位 */
-    temp |= 1 << 2;                     /* 设置SM_LAYER12位,允许播放MP1,MP2 */
+    temp = vs1053_reg_get(SPI_MODE);    /* 取影子中的SPI_MODE, 不读总线 */
+    temp |= SM_CANCEL;                  /* 设置SM_CANCEL位 */
+    temp |= SM_LAYER12;                 /* 设置SM_LAYER12位,允许播放MP1,MP2 (bit2是SM_RESET, 不能置) */
     vs1053_write_cmd(SPI_MODE, temp);   /* 设置取消当前解码指令 */
     
     /* 发送2048个0,期间读取SM_CANCEL位.如果为0,则表示已经取消了当前解码 */
@@ -636,15 +1332,14 @@ void vs1053_restart_play(void)
             i += 32;                                /* 发送了32个字节 */
             temp = vs1053_read_cmd(SPI_MODE);       /* 读取SPI_MODE的内容 */
             
-            if ((temp & (1 << 3)) == 0) {
+            if ((temp & SM_CANCEL) == 0) {
                 break;  /* 成功取消了 */
             }
         }
     }
     
     if (i < 2048) { /* SM_CANCEL正常 */
-        /* 这里应该读取填充字节，但我们简化为直接使用0 */
-        temp = 0;   /* 简化：直接使用0作为填充字节 */
+        temp = vs1053_get_fill_byte();  /* 读取填充字节 */
         
         for (n = 0; n < 32; n++) {
             vsbuf[n] = temp;    /* 填充字节放入数组 */
@@ -669,6 +1364,7 @@ void vs1053_restart_play(void)
     
     /* 设置状态 */
     g_vs1053_play_info.state = VS1053_STATE_IDLE;
+    s_decoder_idle = true;
     
     /* 重新启用板载喇叭 (复位后需要重新设置) */
     vs1053_set_speaker(1);
@@ -687,7 +1383,7 @@ void vs1053_set_all(void)
     uint16_t volt = 254 - 220;  /* 取反一下,得到最大值表示 */
     volt <<= 8;
     volt += 254 - 220;          /* 得到音量设置后大小 */
-    vs1053_write_cmd(SPI_VOL, volt);  /* 设置音量 */
+    vs1053_reg_set(SPI_VOL, volt);    /* 设置音量 */
     
     /* 设置高低音(音调) - 正点原子的默认参数 */
     uint8_t bfreq = 6;      /* 低频上限频率 60Hz */
@@ -705,13 +1401,13 @@ void vs1053_set_all(void)
     bass_set += bass & 0xf;     /* 低音设定 */
     bass_set <<= 4;
     bass_set += bfreq & 0xf;    /* 低音上限 */
-    vs1053_write_cmd(SPI_BASS, bass_set);   /* BASS */
+    vs1053_reg_set(SPI_BASS, bass_set);     /* BASS */
     
     /* 设置空间效果 - 正点原子默认关闭 */
-    uint16_t mode_reg = vs1053_read_cmd(SPI_MODE);
-    mode_reg &= ~(1 << 4);  /* 取消 LO */
-    mode_reg &= ~(1 << 7);  /* 取消 HI */
-    vs1053_write_cmd(SPI_MODE, mode_reg);   /* 设定模式 */
+    vs1053_reg_modify(SPI_MODE, (1 << 4) | (1 << 7), 0);  /* 取消 LO 和 HI */
+    
+    /* 只写入与当前值不同的寄存器 */
+    vs1053_reg_flush();
     
     /* 设置板载喇叭 - 正点原子默认开启 */
     vs1053_set_speaker(1);  /* 开启板载喇叭 */
@@ -730,9 +1426,6 @@ void vs1053_reset_decode_time(void)
     
     /* 重置播放信息中的时间 */
     g_vs1053_play_info.decode_time = 0;
-    
-    /* 等待重置生效 */
-    HAL_Delay(5);
 }
 
 /**
@@ -743,8 +1436,11 @@ void vs1053_reset_decode_time(void)
 uint8_t vs1053_send_music_data(uint8_t* buf)
 {
     uint8_t n;
+    uint32_t t0 = perf_counter_now();
     
     if (VS_DREQ_READ() != 0) {      /* 是否需要发送数据给VS1053? */
+        vs1053_feeder_hold();       /* 与排队的SCI命令互斥 */
+        vs1053_port_speed_high();   /* SDI速度 */
         VS_XDCS_L();                /* 选中数据传输 */
         
         for (n = 0; n < 32; n++) {  /* 发送32字节音频数据 */
@@ -752,6 +1448,10 @@ uint8_t vs1053_send_music_data(uint8_t* buf)
         }
         
         VS_XDCS_H();                /* 取消数据传输 */
+        vs1053_feeder_release();
+        
+        /* 轮询送数的开销, 与DMA送数器对比用 */
+        vs1053_feeder_account(VS1053_FEED_POLLED, perf_counter_now() - t0, 32);
     }
     else {
         return 1;  /* VS1053忙碌，返回1 */
@@ -812,23 +1512,8 @@ void vs1053_debug_registers(void)
 {
     uint16_t regs[16];
     
-    /* 读取所有SCI寄存器 */
-    regs[0] = vs1053_read_cmd(SPI_MODE);      /* 0x00 */
-    regs[1] = vs1053_read_cmd(SPI_STATUS);    /* 0x01 */
-    regs[2] = vs1053_read_cmd(SPI_BASS);      /* 0x02 */
-    regs[3] = vs1053_read_cmd(SPI_CLOCKF);    /* 0x03 */
-    regs[4] = vs1053_read_cmd(SPI_DECODE_TIME); /* 0x04 */
-    regs[5] = vs1053_read_cmd(SPI_AUDATA);    /* 0x05 */
-    regs[6] = vs1053_read_cmd(SPI_WRAM);      /* 0x06 */
-    regs[7] = vs1053_read_cmd(SPI_WRAMADDR);  /* 0x07 */
-    regs[8] = vs1053_read_cmd(SPI_HDAT0);     /* 0x08 */
-    regs[9] = vs1053_read_cmd(SPI_HDAT1);     /* 0x09 */
-    regs[10] = vs1053_read_cmd(SPI_AIADDR);   /* 0x0A */
-    regs[11] = vs1053_read_cmd(SPI_VOL);      /* 0x0B */
-    regs[12] = vs1053_read_cmd(SPI_AICTRL0);  /* 0x0C */
-    regs[13] = vs1053_read_cmd(SPI_AICTRL1);  /* 0x0D */
-    regs[14] = vs1053_read_cmd(SPI_AICTRL2);  /* 0x0E */
-    regs[15] = vs1053_read_cmd(SPI_AICTRL3);  /* 0x0F */
+    /* 批量读取所有SCI寄存器, 影子中有的不再占用总线 */
+    vs1053_read_regs(0xFFFF, regs);
     
     /* 显示关键寄存器 - AUDATA很重要，显示采样率和声道 */
     char audata_str[80];
@@ -843,6 +1528,42 @@ void vs1053_debug_registers(void)
     lcd_show_string(10, 460, 300, 16, 12, bass_str, YELLOW);
 }
 
+/**
+ * @brief       SCI读寄存器速度测试
+ * @note        连续读SPI_STATUS count次, 用DWT周期计数器计时;
+ *              legacy=true时按旧方式每次读写都HAL_SPI_Init切换速度(固定64/8分频)
+ * @param       count: 读取次数
+ * @param       legacy: true测旧方式, false测新方式
+ * @retval      每秒可完成的SCI读次数
+ */
+uint32_t vs1053_bench_sci_reads(uint16_t count, bool legacy)
+{
+    uint32_t t0;
+    uint32_t cycles;
+    uint16_t i;
+    
+    if (count == 0) {
+        return 0;
+    }
+    
+    vs1053_port_set_legacy(legacy);
+    
+    t0 = perf_counter_now();
+    for (i = 0; i < count; i++) {
+        (void)vs1053_read_cmd(SPI_STATUS);
+    }
+    cycles = perf_counter_now() - t0;
+    
+    vs1053_port_set_legacy(false);
+    vs1053_port_speed_high();
+    
+    if (cycles == 0) {
+        return 0;
+    }
+    
+    return (uint32_t)(((uint64_t)SystemCoreClock * count) / cycles);
+}
+
 /**
  * @brief       板载喇叭开/关设置函数 (完全按照正点原子实现)
  *   @note      战舰开发板 板载了HT6872功放, 通过VS1053的GPIO4(36脚), 控制其工作/关闭
@@ -854,14 +1575,7 @@ void vs1053_debug_registers(void)
  */
 void vs1053_set_speaker(uint8_t sw)
 {
-    /* 需要实现vs1053_write_ram函数来写VS1053的RAM */
     /* GPIO_DDR = 0xC017, GPIO_ODATA = 0xC019 */
-    
-    /* VS1053的GPIO4设置成输出 */
-    vs1053_write_cmd(SPI_WRAMADDR, 0xC017);  /* 设置RAM地址 */
-    vs1053_write_cmd(SPI_WRAM, 1 << 4);      /* GPIO4设为输出 */
-    
-    /* 控制VS1053的GPIO4输出值(0/1) */
-    vs1053_write_cmd(SPI_WRAMADDR, 0xC019);  /* 设置RAM地址 */
-    vs1053_write_cmd(SPI_WRAM, sw << 4);     /* GPIO4输出值 */
+    vs1053_write_ram(0xC017, 1 << 4);       /* GPIO4设为输出 */
+    vs1053_write_ram(0xC019, sw << 4);      /* GPIO4输出值(0/1) */
 } 
\ No newline at end of file
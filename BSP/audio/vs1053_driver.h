@@ -49,6 +49,19 @@ extern "C" {
 #define SM_LINE1            0x4000  /* MIC/LINE1选择 */
 #define SM_CLK_RANGE        0x8000  /* 输入时钟范围 */
 
+/* VS1053b数据手册中的位名 (与上面旧名同一位) */
+#define SM_LAYER12          SM_JUMP     /* 允许MPEG Layer I/II */
+#define SM_CANCEL           SM_OUTOFWAV /* 取消当前解码 */
+
+/* 参数区 (X存储区) */
+#define VS1053_PARA_BYTE_RATE       0x1E05  /* 平均字节率 */
+#define VS1053_PARA_END_FILL_BYTE   0x1E06  /* 结束填充字节(低8位) */
+
+/* 换曲取消流程 (数据手册"Cancelling Playback") */
+#define VS1053_CANCEL_LIMIT         2048    /* 置SM_CANCEL后最多再送的字节数, 超过则软复位 */
+#define VS1053_CANCEL_FILL          2052    /* 取消后补送的endFillByte字节数 */
+#define VS1053_CANCEL_TIMEOUT_MS    1000    /* 整个流程的超时 */
+
 /* 播放状态 */
 typedef enum {
     VS1053_STATE_IDLE = 0,      /* 空闲 */
@@ -58,6 +71,23 @@ typedef enum {
     VS1053_STATE_ERROR          /* 错误 */
 } VS1053_State_t;
 
+/* 换曲取消流程状态 */
+typedef enum {
+    VS1053_CANCEL_IDLE = 0,     /* 未进行 */
+    VS1053_CANCEL_FILLING,      /* 文件尾: 先送endFillByte让最后一帧解完 */
+    VS1053_CANCEL_WAITING,      /* 已置SM_CANCEL, 继续送数直到芯片清零该位 */
+    VS1053_CANCEL_PADDING,      /* 取消成功, 补送endFillByte */
+    VS1053_CANCEL_DONE          /* 解码器已空闲, 可以直接送下一首 */
+} VS1053_CancelState_t;
+
+#define VS1053_SCI_QUEUE_SIZE   16      /* SCI命令队列长度, 必须是2的幂 */
+
+/* 排队读SCI寄存器的完成回调 (可能在中断中执行) */
+typedef void (*VS1053_SciCallback_t)(uint8_t addr, uint16_t value);
+
+/* 软复位结束时的回调 (重新加载插件等) */
+typedef void (*VS1053_ResetHook_t)(void);
+
 /* VS1053 配置结构体 */
 typedef struct {
     uint8_t volume;             /* 音量 (0-254) */
@@ -89,11 +119,34 @@ bool vs1053_init(void);
 bool vs1053_reset(void);
 bool vs1053_test(void);
 void vs1053_soft_reset(void);
+void vs1053_set_reset_hook(VS1053_ResetHook_t hook);  /* 软复位结束时调用 */
 void vs1053_test_sine_wave(void);
 
 /* 寄存器操作 */
 void vs1053_write_cmd(uint8_t addr, uint16_t data);
 uint16_t vs1053_read_cmd(uint8_t addr);
+uint8_t vs1053_read_regs(uint16_t mask, uint16_t out[]);   /* 批量读, out按地址存放(16个) */
+void vs1053_read_cmd_block(uint8_t addr, uint8_t *buf, uint16_t count);     /* 同一寄存器连续读, 高字节在前 */
+uint16_t vs1053_read_ram(uint16_t addr);
+void vs1053_write_cmd_block(uint8_t addr, const uint16_t *data, uint16_t count, bool repeat);  /* 同一寄存器连续写 */
+void vs1053_write_ram(uint16_t addr, uint16_t data);
+uint8_t vs1053_get_fill_byte(void);                         /* 读endFillByte */
+
+/* 寄存器影子缓存: 写入寄存器不需要先读 */
+void vs1053_shadow_store(uint8_t addr, uint16_t data);
+void vs1053_shadow_invalidate(void);
+uint16_t vs1053_reg_get(uint8_t addr);                      /* 影子有效时不访问总线 */
+void vs1053_reg_set(uint8_t addr, uint16_t data);           /* 只改影子, 标记为脏 */
+void vs1053_reg_modify(uint8_t addr, uint16_t clear, uint16_t set);
+uint8_t vs1053_reg_flush(void);                             /* 写入所有脏寄存器 */
+void vs1053_reg_flush_async(void);                          /* 脏寄存器放入命令队列 */
+
+/* SCI命令队列: 由送数器在SDI突发之间执行, 调用者不等待DREQ */
+bool vs1053_sci_post_write(uint8_t addr, uint16_t data);
+bool vs1053_sci_post_read(uint8_t addr, VS1053_SciCallback_t cb);
+uint8_t vs1053_sci_queue_pending(void);
+bool vs1053_sci_queue_service(void);                        /* 送数器中断中调用 */
+uint16_t vs1053_sci_read_direct(uint8_t addr);              /* 送数器中断中调用, 总线须空闲 */
 void vs1053_write_data(const uint8_t *buf, uint16_t len);
 
 /* 音频控制 */
@@ -109,6 +162,12 @@ void vs1053_play_resume(void);
 void vs1053_play_stop(void);
 bool vs1053_is_playing(void);
 
+/* 换曲: 按SM_CANCEL流程结束当前解码, 填充数据由送数器送出, 不复位芯片 */
+void vs1053_cancel_begin(bool at_eof);                      /* at_eof: 当前文件已全部送完 */
+VS1053_CancelState_t vs1053_cancel_poll(void);              /* 主循环中调用, 推进流程 */
+uint16_t vs1053_cancel_resets(void);                        /* 取消失败改用软复位的次数 */
+bool vs1053_decoder_idle(void);                             /* 复位/取消后还没送过数据 */
+
 /* 正点原子兼容函数 */
 void vs1053_restart_play(void);      /* 重启播放 */
 void vs1053_set_all(void);           /* 设置所有参数 */
@@ -116,6 +175,7 @@ void vs1053_reset_decode_time(void); /* 重置解码时间 */
 uint8_t vs1053_send_music_data(uint8_t* buf); /* 发送音乐数据(32字节) */
 void vs1053_simple_test(void);              /* 简单的VS1053功能测试 */
 void vs1053_debug_registers(void);          /* 调试所有寄存器状态 */
+uint32_t vs1053_bench_sci_reads(uint16_t count, bool legacy);  /* SCI读寄存器次数/秒 */
 void vs1053_set_speaker(uint8_t sw);        /* 设置板载喇叭开关 */
 
 /* 文件播放 */
@@ -0,0 +1,501 @@
+#include "vs1053_feeder.h"
+#include "vs1053_driver.h"
+#include "perf_counter.h"
+#include "audio_telemetry.h"
+#include <string.h>
+
+/* 送数器状态 (中断与主循环共享) */
+typedef struct {
+    const uint8_t *ptr;             /* 下一个待发送字节 */
+    volatile uint32_t remaining;    /* 尚未发送的字节数 */
+    volatile uint16_t burst;        /* 正在DMA中的字节数, 0表示总线空闲 */
+    volatile uint8_t hold;          /* >0时禁止启动新的突发(SCI访问中) */
+    volatile bool paused;           /* 暂停送数, SCI命令队列照常处理 */
+    AudioRingBuf_t *volatile rb;    /* 环形缓冲区数据源, NULL表示固定缓冲区 */
+    volatile uint32_t fill_left;    /* 尚未发送的填充字节数 */
+    volatile bool from_fill;        /* 当前数据段来自填充缓冲区, 不从环形缓冲区释放 */
+    volatile uint8_t cancel;        /* SM_CANCEL检查状态(VS1053_FeedCancel_t) */
+    uint32_t cancel_sent;           /* 开始检查后已送出的字节数 */
+    uint32_t cancel_limit;          /* 字节数上限, 超过判为失败 */
+    bool ready;                     /* DMA和DREQ中断已初始化 */
+    volatile bool waiting;          /* 有数据要送, 在等DREQ上升沿 */
+    uint32_t wait_start;            /* 开始等待的时刻(周期计数) */
+} VS1053_Feeder_t;
+
+static VS1053_Feeder_t s_feeder;
+static uint8_t s_fill_buf[VS1053_FEED_BURST] __attribute__((aligned(4)));  /* 填充字节 */
+static VS1053_FeederStats_t s_stats[VS1053_FEED_MODES];
+
+/* ============================================================================
+ * 内部函数
+ * ============================================================================ */
+
+/**
+ * @brief       是否有需要中断处理的工作 (待送数据或排队的SCI命令)
+ * @param       无
+ * @retval      true: 有
+ */
+static bool feeder_has_work(void)
+{
+    AudioRingBuf_t *rb = s_feeder.rb;
+
+    if (vs1053_sci_queue_pending() != 0) {
+        return true;
+    }
+
+    if (s_feeder.paused) {
+        return false;
+    }
+
+    return (s_feeder.remaining != 0) || (s_feeder.fill_left != 0) ||
+           (rb != NULL && audio_ringbuf_fill(rb) != 0);
+}
+
+/**
+ * @brief       检查SM_CANCEL (两次突发之间, 总线空闲且DREQ为高)
+ * @note        清零或送满限额后丢弃剩余数据, 之后由主循环决定补送什么
+ * @param       无
+ * @retval      true: 可以继续送数
+ */
+static bool feeder_cancel_check(void)
+{
+    if ((vs1053_sci_read_direct(SPI_MODE) & SM_CANCEL) == 0) {
+        s_feeder.cancel = VS1053_FEED_CANCEL_DONE;
+    } else if (s_feeder.cancel_sent >= s_feeder.cancel_limit) {
+        s_feeder.cancel = VS1053_FEED_CANCEL_FAILED;
+    } else {
+        return true;
+    }
+
+    s_feeder.remaining = 0;
+    s_feeder.fill_left = 0;
+    s_feeder.rb = NULL;
+    return false;
+}
+
+/**
+ * @brief       DREQ为低且有工作要做时记下开始等待的时刻
+ * @param       无
+ * @retval      无
+ */
+static void feeder_wait_begin(void)
+{
+    if (!s_feeder.waiting && feeder_has_work()) {
+        s_feeder.wait_start = perf_counter_now();
+        s_feeder.waiting = true;
+    }
+}
+
+/**
+ * @brief       尝试启动下一次32字节突发
+ * @note        只在中断上下文(DREQ/DMA中断)中调用, 两个中断同优先级, 不会互相嵌套
+ * @param       无
+ * @retval      无
+ */
+static void feeder_kick(void)
+{
+    uint16_t n;
+
+    if (s_feeder.burst != 0 || s_feeder.hold != 0) {
+        return;
+    }
+
+    /* 两次突发之间先执行一条排队的SCI命令 */
+    if (vs1053_sci_queue_service()) {
+        if (!VS_DREQ_READ()) {
+            feeder_wait_begin();
+            return;     /* SCI写使DREQ变低, 等上升沿再继续 */
+        }
+        if (vs1053_sci_queue_pending() != 0) {
+            HAL_NVIC_SetPendingIRQ(EXTI15_10_IRQn);     /* 剩余命令下次中断再处理 */
+        }
+    }
+
+    if (s_feeder.paused) {
+        return;
+    }
+
+    if (!VS_DREQ_READ()) {
+        feeder_wait_begin();
+        return;     /* FIFO满, 等DREQ上升沿再来 */
+    }
+
+    if (s_feeder.cancel == VS1053_FEED_CANCEL_WAIT && !feeder_cancel_check()) {
+        return;
+    }
+
+    if (s_feeder.remaining == 0 && s_feeder.rb != NULL) {
+        /* 从环形缓冲区取下一段连续数据, 数据在每次突发完成后才释放 */
+        uint32_t len;
+        s_feeder.ptr = audio_ringbuf_read_ptr(s_feeder.rb, &len);
+        s_feeder.remaining = len;
+        s_feeder.from_fill = false;
+    }
+
+    if (s_feeder.remaining == 0 && s_feeder.fill_left != 0) {
+        /* 其他数据都已送完, 送填充字节 */
+        s_feeder.ptr = s_fill_buf;
+        s_feeder.remaining = (s_feeder.fill_left > VS1053_FEED_BURST) ? VS1053_FEED_BURST : s_feeder.fill_left;
+        s_feeder.fill_left -= s_feeder.remaining;
+        s_feeder.from_fill = true;
+    }
+
+    if (s_feeder.remaining == 0) {
+        return;
+    }
+
+    n = (s_feeder.remaining > VS1053_FEED_BURST) ? VS1053_FEED_BURST : (uint16_t)s_feeder.remaining;
+
+    vs1053_port_speed_high();
+    VS_XDCS_L();
+    if (!vs1053_port_dma_write(s_feeder.ptr, n)) {
+        VS_XDCS_H();
+        return;
+    }
+
+    s_feeder.burst = n;
+    s_stats[VS1053_FEED_DMA].bursts++;
+}
+
+/* ============================================================================
+ * 初始化和控制
+ * ============================================================================ */
+
+/**
+ * @brief       初始化送数器 (DMA通道 + DREQ外部中断)
+ * @param       无
+ * @retval      无
+ */
+void vs1053_feeder_init(void)
+{
+    memset(&s_feeder, 0, sizeof(s_feeder));
+    vs1053_feeder_reset_stats();
+
+    vs1053_port_dma_init();
+    vs1053_port_dreq_irq_init();
+
+    s_feeder.ready = true;
+    vs1053_feeder_notify();     /* 初始化前已排队的SCI命令 */
+}
+
+/**
+ * @brief       提交一段音频数据, 由DREQ/DMA中断异步送出
+ * @param       buf: 数据缓冲区, 送完之前必须保持有效
+ * @param       len: 字节数
+ * @retval      true: 已提交, false: 上一段尚未送完或未初始化
+ */
+bool vs1053_feeder_start(const uint8_t *buf, uint32_t len)
+{
+    if (!s_feeder.ready || s_feeder.rb != NULL || !vs1053_feeder_idle()) {
+        return false;
+    }
+
+    if (len == 0) {
+        return true;
+    }
+
+    s_feeder.ptr = buf;
+    s_feeder.remaining = len;
+
+    /* DREQ可能已经是高电平, 不会再有上升沿, 手动触发一次 */
+    HAL_NVIC_SetPendingIRQ(EXTI15_10_IRQn);
+    return true;
+}
+
+/**
+ * @brief       停止送数, 丢弃未发送的数据并解除环形缓冲区
+ * @param       无
+ * @retval      无
+ */
+void vs1053_feeder_stop(void)
+{
+    vs1053_feeder_hold();
+    s_feeder.remaining = 0;
+    s_feeder.rb = NULL;
+    s_feeder.paused = false;
+    s_feeder.fill_left = 0;
+    s_feeder.cancel = VS1053_FEED_CANCEL_OFF;
+    s_feeder.waiting = false;
+    vs1053_feeder_release();
+}
+
+/**
+ * @brief       挂接环形缓冲区作为数据源
+ * @param       rb: 环形缓冲区, NULL表示解除挂接(未送出的数据留在缓冲区中)
+ * @retval      无
+ */
+void vs1053_feeder_attach(AudioRingBuf_t *rb)
+{
+    vs1053_feeder_hold();
+    s_feeder.remaining = 0;
+    s_feeder.rb = rb;
+    vs1053_feeder_release();
+
+    vs1053_feeder_notify();
+}
+
+/**
+ * @brief       暂停/恢复送数
+ * @note        暂停时数据保留在缓冲区中, 排队的SCI命令(如调音量)仍会执行
+ * @param       pause: true暂停, false恢复
+ * @retval      无
+ */
+void vs1053_feeder_pause(bool pause)
+{
+    vs1053_feeder_hold();
+    s_feeder.paused = pause;
+    vs1053_feeder_release();
+}
+
+/**
+ * @brief       在已提交的数据之后送一段填充字节
+ * @note        用于结束解码时送endFillByte, 不占用调用者的缓冲区
+ * @param       fill_byte: 填充字节
+ * @param       count: 字节数
+ * @retval      无
+ */
+void vs1053_feeder_fill(uint8_t fill_byte, uint32_t count)
+{
+    vs1053_feeder_hold();
+    memset(s_fill_buf, fill_byte, sizeof(s_fill_buf));
+    s_feeder.fill_left = count;
+    vs1053_feeder_release();
+}
+
+/**
+ * @brief       开始检查SM_CANCEL (调用前已置位)
+ * @note        之后每次32字节突发前读一次MODE; 缓冲区数据送完时用填充字节代替
+ * @param       fill_byte: 填充字节
+ * @param       limit: 最多再送的字节数
+ * @retval      无
+ */
+void vs1053_feeder_cancel(uint8_t fill_byte, uint32_t limit)
+{
+    vs1053_feeder_hold();
+    memset(s_fill_buf, fill_byte, sizeof(s_fill_buf));
+    s_feeder.fill_left = limit;
+    s_feeder.cancel_sent = 0;
+    s_feeder.cancel_limit = limit;
+    s_feeder.cancel = VS1053_FEED_CANCEL_WAIT;
+    s_feeder.paused = false;
+    vs1053_feeder_release();
+}
+
+/**
+ * @brief       获取SM_CANCEL检查状态
+ * @param       无
+ * @retval      状态
+ */
+VS1053_FeedCancel_t vs1053_feeder_cancel_state(void)
+{
+    return (VS1053_FeedCancel_t)s_feeder.cancel;
+}
+
+/**
+ * @brief       通知送数器有新数据 (环形缓冲区写入后调用)
+ * @note        DREQ一直为高时不会再有上升沿, 需要手动触发一次
+ * @param       无
+ * @retval      无
+ */
+void vs1053_feeder_notify(void)
+{
+    if (s_feeder.ready && s_feeder.burst == 0) {
+        HAL_NVIC_SetPendingIRQ(EXTI15_10_IRQn);
+    }
+}
+
+/**
+ * @brief       已提交的数据是否全部送完
+ * @param       无
+ * @retval      true: 空闲
+ */
+bool vs1053_feeder_idle(void)
+{
+    AudioRingBuf_t *rb = s_feeder.rb;
+
+    if (rb != NULL && audio_ringbuf_fill(rb) != 0) {
+        return false;
+    }
+
+    return (s_feeder.remaining == 0) && (s_feeder.fill_left == 0) && (s_feeder.burst == 0);
+}
+
+/**
+ * @brief       获取尚未送出的字节数
+ * @param       无
+ * @retval      字节数
+ */
+uint32_t vs1053_feeder_pending(void)
+{
+    AudioRingBuf_t *rb = s_feeder.rb;
+
+    return ((rb != NULL) ? audio_ringbuf_fill(rb) : s_feeder.remaining) + s_feeder.fill_left;
+}
+
+/**
+ * @brief       占用SPI总线 (SCI读写前调用)
+ * @note        等待当前突发结束, 最长一个32字节突发(9MHz下约30us)
+ * @param       无
+ * @retval      无
+ */
+void vs1053_feeder_hold(void)
+{
+    s_feeder.hold++;
+
+    while (s_feeder.burst != 0) {
+        __NOP();
+    }
+}
+
+/**
+ * @brief       释放SPI总线, 有待发数据时重新触发送数
+ * @param       无
+ * @retval      无
+ */
+void vs1053_feeder_release(void)
+{
+    if (s_feeder.hold > 0) {
+        s_feeder.hold--;
+    }
+
+    if (s_feeder.ready && s_feeder.hold == 0 && feeder_has_work()) {
+        HAL_NVIC_SetPendingIRQ(EXTI15_10_IRQn);
+    }
+}
+
+/* ============================================================================
+ * 中断处理
+ * ============================================================================ */
+
+/**
+ * @brief       DREQ(PC13)上升沿中断
+ * @param       无
+ * @retval      无
+ */
+void vs1053_feeder_dreq_irq_handler(void)
+{
+    uint32_t t0 = perf_counter_now();
+
+    if (__HAL_GPIO_EXTI_GET_IT(VS_DREQ_Pin) != RESET) {
+        __HAL_GPIO_EXTI_CLEAR_IT(VS_DREQ_Pin);
+        s_stats[VS1053_FEED_DMA].dreq_irqs++;
+        if (s_feeder.waiting) {
+            s_feeder.waiting = false;
+            audio_telemetry_hist(TELEM_HIST_DREQ_WAIT, t0 - s_feeder.wait_start);
+        }
+    }
+
+    feeder_kick();
+
+    s_stats[VS1053_FEED_DMA].cycles += perf_counter_now() - t0;
+}
+
+/**
+ * @brief       SPI1_TX DMA中断
+ * @param       无
+ * @retval      无
+ */
+void vs1053_feeder_dma_irq_handler(void)
+{
+    uint32_t t0 = perf_counter_now();
+
+    HAL_DMA_IRQHandler(&hdma_spi1_tx);
+
+    s_stats[VS1053_FEED_DMA].cycles += perf_counter_now() - t0;
+}
+
+/**
+ * @brief       SPI发送完成回调: 结束本次突发并尝试下一次
+ * @param       hspi: SPI句柄
+ * @retval      无
+ */
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+    uint16_t n;
+
+    if (hspi->Instance != SPI1) {
+        return;
+    }
+
+    VS_XDCS_H();    /* HAL已等待BSY清零, 最后一个字节已移出 */
+
+    n = s_feeder.burst;
+    s_feeder.ptr += n;
+    s_feeder.remaining -= n;
+    s_feeder.burst = 0;
+    s_stats[VS1053_FEED_DMA].bytes += n;
+    audio_telemetry_add(TELEM_FEED_BYTES, n);
+
+    if (s_feeder.rb != NULL && !s_feeder.from_fill) {
+        audio_ringbuf_consume(s_feeder.rb, n);
+    }
+
+    if (s_feeder.cancel == VS1053_FEED_CANCEL_WAIT) {
+        s_feeder.cancel_sent += n;
+    }
+
+    feeder_kick();
+}
+
+/* ============================================================================
+ * 统计
+ * ============================================================================ */
+
+/**
+ * @brief       记录一次送数开销 (轮询路径使用)
+ * @param       mode: 送数方式
+ * @param       cycles: 消耗的CPU周期
+ * @param       bytes: 送出的字节数
+ * @retval      无
+ */
+void vs1053_feeder_account(VS1053_FeedMode_t mode, uint32_t cycles, uint32_t bytes)
+{
+    s_stats[mode].cycles += cycles;
+    s_stats[mode].bytes += bytes;
+    s_stats[mode].bursts++;
+    audio_telemetry_add(TELEM_FEED_BYTES, bytes);
+}
+
+/**
+ * @brief       获取送数统计
+ * @param       mode: 送数方式
+ * @param       stats: 输出
+ * @retval      无
+ */
+void vs1053_feeder_get_stats(VS1053_FeedMode_t mode, VS1053_FeederStats_t *stats)
+{
+    if (stats != NULL) {
+        __disable_irq();
+        *stats = s_stats[mode];
+        __enable_irq();
+    }
+}
+
+/**
+ * @brief       每送出1KB数据消耗的CPU周期数
+ * @param       mode: 送数方式
+ * @retval      周期数/KB, 尚无数据时返回0
+ */
+uint32_t vs1053_feeder_cycles_per_kb(VS1053_FeedMode_t mode)
+{
+    VS1053_FeederStats_t st;
+
+    vs1053_feeder_get_stats(mode, &st);
+    if (st.bytes == 0) {
+        return 0;
+    }
+
+    return (uint32_t)(((uint64_t)st.cycles * 1024U) / st.bytes);
+}
+
+/**
+ * @brief       清零统计
+ * @param       无
+ * @retval      无
+ */
+void vs1053_feeder_reset_stats(void)
+{
+    __disable_irq();
+    memset(s_stats, 0, sizeof(s_stats));
+    __enable_irq();
+}
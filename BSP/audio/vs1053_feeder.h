@@ -0,0 +1,88 @@
+#ifndef VS1053_FEEDER_H
+#define VS1053_FEEDER_H
+
+#include "main.h"
+#include "vs1053_port.h"
+#include "audio_ringbuf.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * VS1053 SDI送数器
+ * DREQ上升沿(EXTI)触发, 每次以DMA突发发送32字节, DMA完成中断里
+ * 若DREQ仍为高则继续下一次突发, 直到数据送完或DREQ变低。
+ * 主循环只负责提交数据, 不再轮询DREQ。
+ * 数据来源可以是一段固定缓冲区(vs1053_feeder_start), 也可以挂接预读环形
+ * 缓冲区(vs1053_feeder_attach), 后者由中断直接从环形缓冲区取数据。
+ * 以上数据送完后若还有填充字节(vs1053_feeder_fill), 则送填充字节。
+ */
+
+/* 1: 播放走DMA送数器; 0: 保留原来的轮询送数(用于对比测试) */
+#ifndef VS1053_FEED_USE_DMA
+#define VS1053_FEED_USE_DMA     1
+#endif
+
+#define VS1053_FEED_BURST       32      /* DREQ为高时VS1053至少能接收32字节 */
+
+/* 送数方式 */
+typedef enum {
+    VS1053_FEED_POLLED = 0,     /* vs1053_send_music_data轮询送数 */
+    VS1053_FEED_DMA,            /* DREQ中断 + DMA送数 */
+    VS1053_FEED_MODES
+} VS1053_FeedMode_t;
+
+/* SM_CANCEL检查状态 */
+typedef enum {
+    VS1053_FEED_CANCEL_OFF = 0,     /* 未检查 */
+    VS1053_FEED_CANCEL_WAIT,        /* 每次突发前读MODE, 等SM_CANCEL清零 */
+    VS1053_FEED_CANCEL_DONE,        /* 已清零, 剩余数据已丢弃 */
+    VS1053_FEED_CANCEL_FAILED       /* 送满限额仍未清零 */
+} VS1053_FeedCancel_t;
+
+/* 送数统计 */
+typedef struct {
+    uint32_t bytes;             /* 已送出的字节数 */
+    uint32_t bursts;            /* 32字节突发次数 */
+    uint32_t cycles;            /* 送数路径消耗的CPU周期 */
+    uint32_t dreq_irqs;         /* DREQ中断次数(仅DMA方式) */
+} VS1053_FeederStats_t;
+
+/* 初始化和控制 */
+void vs1053_feeder_init(void);
+bool vs1053_feeder_start(const uint8_t *buf, uint32_t len);    /* 提交一段数据, 异步送出 */
+void vs1053_feeder_stop(void);                                 /* 丢弃未送出的数据 */
+void vs1053_feeder_pause(bool pause);                          /* 暂停/恢复送数 */
+bool vs1053_feeder_idle(void);                                 /* 已提交的数据是否全部送完 */
+uint32_t vs1053_feeder_pending(void);                          /* 尚未送出的字节数 */
+
+/* 环形缓冲区数据源 */
+void vs1053_feeder_attach(AudioRingBuf_t *rb);                 /* 挂接/解除(NULL)环形缓冲区 */
+void vs1053_feeder_notify(void);                               /* 生产者写入新数据后调用 */
+
+/* 填充字节和SM_CANCEL检查 (换曲流程使用) */
+void vs1053_feeder_fill(uint8_t fill_byte, uint32_t count);    /* 在现有数据之后再送count个填充字节 */
+void vs1053_feeder_cancel(uint8_t fill_byte, uint32_t limit);  /* 开始检查SM_CANCEL, 最多再送limit字节 */
+VS1053_FeedCancel_t vs1053_feeder_cancel_state(void);
+
+/* SPI总线互斥: SCI访问前后调用, 保证不与DMA突发和排队的SCI命令冲突 */
+void vs1053_feeder_hold(void);
+void vs1053_feeder_release(void);
+
+/* 中断入口 (stm32f1xx_it.c中调用) */
+void vs1053_feeder_dreq_irq_handler(void);
+void vs1053_feeder_dma_irq_handler(void);
+
+/* 统计 */
+void vs1053_feeder_account(VS1053_FeedMode_t mode, uint32_t cycles, uint32_t bytes);
+void vs1053_feeder_get_stats(VS1053_FeedMode_t mode, VS1053_FeederStats_t *stats);
+uint32_t vs1053_feeder_cycles_per_kb(VS1053_FeedMode_t mode);
+void vs1053_feeder_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VS1053_FEEDER_H
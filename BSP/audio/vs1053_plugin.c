@@ -0,0 +1,225 @@
+#include "vs1053_plugin.h"
+#include "vs1053_driver.h"
+#include "perf_counter.h"
+#include "fatfs.h"
+#include <string.h>
+
+/* 解析状态 */
+typedef enum {
+    PLUGIN_ADDR = 0,            /* 等寄存器地址 */
+    PLUGIN_COUNT,               /* 等个数 */
+    PLUGIN_RLE,                 /* 等RLE的重复值 */
+    PLUGIN_COPY                 /* 复制n个数据 */
+} PluginState_t;
+
+/* 私有变量 */
+static VS1053_Plugin_t s_plugins[VS1053_PLUGIN_MAX];
+static uint8_t s_plugin_count = 0;
+static uint16_t s_buf[VS1053_PLUGIN_BUF_WORDS];
+
+/* ============================================================================
+ * 加载
+ * ============================================================================ */
+
+/**
+ * @brief       从SD卡流式加载一个插件
+ * @note        文件对象从文件池中取, 不另占一个FIL;
+ *              复制段一次读多少就连续写多少, RLE段不经过缓冲区
+ * @param       path: 插件文件
+ * @param       words: 输出, 写入VS1053的字数, 可为NULL
+ * @retval      true: 成功, false: 打不开/读错误/格式错误
+ */
+bool vs1053_plugin_load(const char *path, uint32_t *words)
+{
+    PluginState_t state = PLUGIN_ADDR;
+    uint8_t addr = 0;
+    uint16_t left = 0;
+    uint32_t written = 0;
+    uint16_t n;
+    uint16_t i;
+    UINT br;
+    bool ok = true;
+    FIL *fp = NULL;
+
+    if (fs_open_file(path, FA_READ, &fp) != FS_STATUS_OK) {
+        return false;
+    }
+
+    while (ok) {
+        if (f_read(fp, s_buf, sizeof(s_buf), &br) != FR_OK || (br & 1)) {
+            ok = false;
+            break;
+        }
+        n = (uint16_t)(br / 2);
+        if (n == 0) {
+            break;
+        }
+
+        i = 0;
+        while (i < n) {
+            switch (state) {
+                case PLUGIN_ADDR:
+                    if (s_buf[i] > SPI_AICTRL3) {
+                        ok = false;     /* 不是SCI寄存器, 文件格式不对 */
+                        i = n;
+                        break;
+                    }
+                    addr = (uint8_t)s_buf[i++];
+                    state = PLUGIN_COUNT;
+                    break;
+
+                case PLUGIN_COUNT:
+                    left = s_buf[i] & 0x7FFF;
+                    state = (s_buf[i] & 0x8000) ? PLUGIN_RLE : PLUGIN_COPY;
+                    i++;
+                    if (left == 0) {
+                        state = PLUGIN_ADDR;
+                    }
+                    break;
+
+                case PLUGIN_RLE:
+                    vs1053_write_cmd_block(addr, &s_buf[i++], left, true);
+                    written += left;
+                    state = PLUGIN_ADDR;
+                    break;
+
+                case PLUGIN_COPY: {
+                    uint16_t m = (uint16_t)(n - i);
+                    if (m > left) {
+                        m = left;
+                    }
+                    vs1053_write_cmd_block(addr, &s_buf[i], m, false);
+                    written += m;
+                    left -= m;
+                    i += m;
+                    if (left == 0) {
+                        state = PLUGIN_ADDR;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    fs_close_file(&fp);
+
+    if (state != PLUGIN_ADDR) {
+        ok = false;     /* 文件在一段中间结束 */
+    }
+    if (words != NULL) {
+        *words = written;
+    }
+    return ok;
+}
+
+/**
+ * @brief       加载一个已注册的插件并记录耗时
+ * @param       plugin: 插件
+ * @retval      true: 成功
+ */
+static bool vs1053_plugin_apply(VS1053_Plugin_t *plugin)
+{
+    uint32_t t0 = perf_counter_now();
+
+    plugin->loaded = vs1053_plugin_load(plugin->path, &plugin->words);
+    plugin->load_us = perf_cycles_to_us(perf_counter_now() - t0);
+    plugin->loads++;
+
+    return plugin->loaded;
+}
+
+/**
+ * @brief       重新加载全部已注册插件 (软复位钩子)
+ * @param       无
+ * @retval      无
+ */
+void vs1053_plugin_reload(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < s_plugin_count; i++) {
+        vs1053_plugin_apply(&s_plugins[i]);
+    }
+}
+
+/* ============================================================================
+ * 注册
+ * ============================================================================ */
+
+/**
+ * @brief       注册插件并立即加载, 之后每次软复位自动重新加载
+ * @param       path: 插件文件
+ * @retval      true: 加载成功, false: 加载失败(不注册)或已满
+ */
+bool vs1053_plugin_add(const char *path)
+{
+    VS1053_Plugin_t *plugin;
+
+    if (vs1053_plugin_find(path) != NULL) {
+        return true;
+    }
+    if (s_plugin_count >= VS1053_PLUGIN_MAX || strlen(path) >= FS_MAX_PATH_LEN) {
+        return false;
+    }
+
+    plugin = &s_plugins[s_plugin_count];
+    memset(plugin, 0, sizeof(*plugin));
+    strcpy(plugin->path, path);
+    if (!vs1053_plugin_apply(plugin)) {
+        return false;
+    }
+
+    s_plugin_count++;
+    vs1053_set_reset_hook(vs1053_plugin_reload);
+    return true;
+}
+
+/**
+ * @brief       加载SD卡上已有的默认插件 (FLAC, 频谱)
+ * @note        在vs1053_init之后调用: 初始化时的RAM测试会清掉已加载的插件
+ * @param       无
+ * @retval      加载成功的插件数
+ */
+uint8_t vs1053_plugin_init(void)
+{
+    static const char *const defaults[] = {
+        VS1053_PLUGIN_FLAC,
+        VS1053_PLUGIN_SPECTRUM,
+    };
+    uint8_t count = 0;
+    uint8_t i;
+
+    for (i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++) {
+        if (vs1053_plugin_add(defaults[i])) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* ============================================================================
+ * 查询
+ * ============================================================================ */
+
+uint8_t vs1053_plugin_count(void)
+{
+    return s_plugin_count;
+}
+
+const VS1053_Plugin_t *vs1053_plugin_get(uint8_t index)
+{
+    return (index < s_plugin_count) ? &s_plugins[index] : NULL;
+}
+
+const VS1053_Plugin_t *vs1053_plugin_find(const char *path)
+{
+    uint8_t i;
+
+    for (i = 0; i < s_plugin_count; i++) {
+        if (strcmp(s_plugins[i].path, path) == 0) {
+            return &s_plugins[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,48 @@
+#ifndef VS1053_PLUGIN_H
+#define VS1053_PLUGIN_H
+
+#include "main.h"
+#include "filesystem.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * VS1053插件加载 (从SD卡流式读取, 不占用Flash)
+ * 文件内容是VLSI插件的压缩格式(.plg中的uint16_t数组, 按小端存成二进制):
+ *   寄存器地址, 个数n, 数据...
+ *   n的最高位为1时是RLE段: 一个数据重复写(n & 0x7FFF)次, 否则后面跟n个数据
+ * 寄存器地址通常是SCI_WRAMADDR/SCI_WRAM, 最后写SCI_AIADDR启动插件。
+ * 注册过的插件在每次软复位后按注册顺序自动重新加载。
+ */
+
+#define VS1053_PLUGIN_DIR           "0:/PLUGIN"
+#define VS1053_PLUGIN_FLAC          VS1053_PLUGIN_DIR "/FLAC.BIN"       /* VS1053b补丁 + FLAC解码 */
+#define VS1053_PLUGIN_SPECTRUM      VS1053_PLUGIN_DIR "/SPECTRUM.BIN"   /* 频谱分析 */
+#define VS1053_PLUGIN_MAX           4       /* 最多注册的插件数 */
+#define VS1053_PLUGIN_BUF_WORDS     64      /* 读卡缓冲区(字) */
+
+/* 插件信息 */
+typedef struct {
+    char path[FS_MAX_PATH_LEN]; /* 插件文件 */
+    bool loaded;                /* 最近一次加载成功 */
+    uint32_t words;             /* 写入的字数 */
+    uint32_t load_us;           /* 最近一次加载耗时 */
+    uint16_t loads;             /* 加载次数(含复位后重新加载) */
+} VS1053_Plugin_t;
+
+uint8_t vs1053_plugin_init(void);                              /* 加载SD卡上已有的默认插件, 返回加载数 */
+bool vs1053_plugin_add(const char *path);                      /* 注册并加载 */
+bool vs1053_plugin_load(const char *path, uint32_t *words);    /* 只加载一次, 不注册 */
+void vs1053_plugin_reload(void);                               /* 重新加载全部已注册插件 */
+uint8_t vs1053_plugin_count(void);
+const VS1053_Plugin_t *vs1053_plugin_get(uint8_t index);
+const VS1053_Plugin_t *vs1053_plugin_find(const char *path);   /* 按路径查找, 没有返回NULL */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VS1053_PLUGIN_H
@@ -1,8 +1,77 @@
 #include "vs1053_port.h"
 
+/* VS1053晶振频率 */
+#define VS_XTALI_HZ         12288000U
+
+/* SCI读最高CLKI/7, SCI写和SDI最高CLKI/4 */
+#define VS_SCI_READ_DIV     7U
+#define VS_SCI_WRITE_DIV    4U
+
+/* STM32F1的SPI最高18MHz, APB2为72MHz时最小4分频 */
+#define VS_SPI_MAX_HZ       18000000U
+
+/* 预先算好的CR1波特率位(BR[2:0]), 切换时只改这三位 */
+static uint32_t s_br_sci_read = SPI_BAUDRATEPRESCALER_64;
+static uint32_t s_br_sci_write = SPI_BAUDRATEPRESCALER_64;
+static uint32_t s_br_sdi = SPI_BAUDRATEPRESCALER_8;
+static uint32_t s_br_cur;
+static bool s_legacy = false;
+
+/**
+ * @brief       选出不超过max_hz的最快SPI分频
+ * @param       max_hz: 允许的最高SPI时钟
+ * @retval      CR1的BR位
+ */
+static uint32_t port_pick_br(uint32_t max_hz)
+{
+    uint32_t pclk = HAL_RCC_GetPCLK2Freq();
+    uint32_t i;
+
+    if (max_hz > VS_SPI_MAX_HZ) {
+        max_hz = VS_SPI_MAX_HZ;
+    }
+
+    /* 分频系数 = 2^(i+1), i=0..7 */
+    for (i = 0; i < 7; i++) {
+        if ((pclk >> (i + 1)) <= max_hz) {
+            break;
+        }
+    }
+
+    return i << SPI_CR1_BR_Pos;
+}
+
+/**
+ * @brief       切换SPI1波特率, 与当前相同则不做任何操作
+ * @note        只在SPI空闲时调用(所有阻塞传输返回时BSY已清零, DMA突发由送数器互斥)
+ * @param       br: CR1的BR位
+ * @retval      无
+ */
+static void port_set_br(uint32_t br)
+{
+    if (s_legacy) {
+        /* 旧方式: 每次都完整重新初始化SPI, 仅用于对比测试 */
+        hspi1.Init.BaudRatePrescaler = br;
+        HAL_SPI_Init(&hspi1);
+        s_br_cur = br;
+        return;
+    }
+
+    if (br == s_br_cur) {
+        return;
+    }
+
+    MODIFY_REG(hspi1.Instance->CR1, SPI_CR1_BR, br);
+    hspi1.Init.BaudRatePrescaler = br;
+    s_br_cur = br;
+}
+
 void vs1053_port_init(void)
 {
     /* SPI1已经在main.c中初始化，这里不需要重复初始化 */
+    s_br_cur = hspi1.Init.BaudRatePrescaler;
+    vs1053_port_set_clockf(0);      /* 复位后CLKI=XTALI */
+
     /* 设置初始状态 */
     VS_RST_L();     /* 复位状态 */
     VS_XCS_H();     /* 禁用命令接口 */
@@ -10,18 +79,77 @@ void vs1053_port_init(void)
     HAL_Delay(10);
 }
 
+/**
+ * @brief       根据SCI_CLOCKF的值重新计算SCI/SDI可用的最快SPI时钟
+ * @note        写CLOCKF(或复位)之后调用, CLKI = XTALI * 倍频 (SC_MULT)
+ * @param       clockf: SCI_CLOCKF寄存器值
+ * @retval      无
+ */
+void vs1053_port_set_clockf(uint16_t clockf)
+{
+    /* SC_MULT: 0->1.0x, 1->2.0x, 2->2.5x ... 7->5.0x, 以0.5x为单位 */
+    static const uint8_t mult_x2[8] = {2, 4, 5, 6, 7, 8, 9, 10};
+    uint32_t xtali = VS_XTALI_HZ;
+    uint32_t clki;
+
+    if ((clockf & 0x07FF) != 0) {
+        xtali = (uint32_t)(clockf & 0x07FF) * 4000U + 8000000U;     /* SC_FREQ */
+    }
+    clki = xtali / 2U * mult_x2[clockf >> 13];
+
+    s_br_sci_read = port_pick_br(clki / VS_SCI_READ_DIV);
+    s_br_sci_write = port_pick_br(clki / VS_SCI_WRITE_DIV);
+    s_br_sdi = port_pick_br(clki / VS_SCI_WRITE_DIV);
+}
+
+/**
+ * @brief       旧的SPI切换方式(每次HAL_SPI_Init, 固定64/8分频), 用于前后对比
+ * @param       enable: true使用旧方式
+ * @retval      无
+ */
+void vs1053_port_set_legacy(bool enable)
+{
+    s_legacy = enable;
+    s_br_cur = 0xFFFFFFFFU;     /* 强制下次切换 */
+}
+
+/**
+ * @brief       SCI访问开始, 切换到SCI可用的最快速度
+ * @param       read: true为读寄存器(CLKI/7), false为写寄存器(CLKI/4)
+ * @retval      无
+ */
+void vs1053_port_sci_begin(bool read)
+{
+    if (s_legacy) {
+        port_set_br(SPI_BAUDRATEPRESCALER_64);
+    } else {
+        port_set_br(read ? s_br_sci_read : s_br_sci_write);
+    }
+}
+
+/**
+ * @brief       SCI访问结束
+ * @note        SDI发送前会自行切回高速, 这里不再切换; 旧方式下照旧恢复高速
+ * @param       无
+ * @retval      无
+ */
+void vs1053_port_sci_end(void)
+{
+    if (s_legacy) {
+        vs1053_port_speed_high();
+    }
+}
+
 void vs1053_port_speed_low(void)
 {
-    /* 低速模式：预分频器64，约1.125MHz (72MHz/64) */
-    hspi1.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_64;
-    HAL_SPI_Init(&hspi1);
+    /* 低速模式：SCI读的速度, 对SCI/SDI都安全 (复位后约1.125MHz) */
+    port_set_br(s_legacy ? SPI_BAUDRATEPRESCALER_64 : s_br_sci_read);
 }
 
 void vs1053_port_speed_high(void)
 {
-    /* 高速模式：预分频器8，约9MHz (72MHz/8) */
-    hspi1.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_8;
-    HAL_SPI_Init(&hspi1);
+    /* 高速模式：SDI的速度, CLOCKF=0x9800时约9MHz (72MHz/8) */
+    port_set_br(s_legacy ? SPI_BAUDRATEPRESCALER_8 : s_br_sdi);
 }
 
 uint8_t vs1053_port_rw(uint8_t data)
@@ -31,10 +159,89 @@ uint8_t vs1053_port_rw(uint8_t data)
     return rx;
 }
 
+/**
+ * @brief       阻塞发送一段数据 (调用者负责片选和速度)
+ * @param       buf: 数据
+ * @param       len: 字节数
+ * @retval      无
+ */
+void vs1053_port_write(const uint8_t *buf, uint16_t len)
+{
+    HAL_SPI_Transmit(&hspi1, (uint8_t*)buf, len, HAL_MAX_DELAY);
+}
+
 void vs1053_write_data(const uint8_t *buf, uint16_t len)
 {
     while (!VS_DREQ_READ()) {}
+    vs1053_port_speed_high();
     VS_XDCS_L();
     HAL_SPI_Transmit(&hspi1, (uint8_t*)buf, len, HAL_MAX_DELAY);
     VS_XDCS_H();
-} 
\ No newline at end of file
+} 
+
+/* SPI1_TX固定映射在DMA1通道3 */
+DMA_HandleTypeDef hdma_spi1_tx;
+
+/**
+ * @brief       初始化SPI1发送DMA (DMA1通道3)
+ * @param       无
+ * @retval      无
+ */
+void vs1053_port_dma_init(void)
+{
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    hdma_spi1_tx.Instance = DMA1_Channel3;
+    hdma_spi1_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_spi1_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_spi1_tx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_spi1_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_spi1_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_spi1_tx.Init.Mode = DMA_NORMAL;
+    hdma_spi1_tx.Init.Priority = DMA_PRIORITY_HIGH;
+    if (HAL_DMA_Init(&hdma_spi1_tx) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    __HAL_LINKDMA(&hspi1, hdmatx, hdma_spi1_tx);
+
+    /* 送数中断优先级高于SysTick, 低于USART1 */
+    HAL_NVIC_SetPriority(DMA1_Channel3_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel3_IRQn);
+}
+
+/**
+ * @brief       把DREQ(PC13)配置为上升沿外部中断
+ * @note        引脚仍可用VS_DREQ_READ()读取电平
+ * @param       无
+ * @retval      无
+ */
+void vs1053_port_dreq_irq_init(void)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    GPIO_InitStruct.Pin = VS_DREQ_Pin;
+    GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(VS_DREQ_GPIO_Port, &GPIO_InitStruct);
+
+    HAL_NVIC_SetPriority(EXTI15_10_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
+}
+
+/**
+ * @brief       启动一次SDI的DMA发送 (调用者负责XDCS和DREQ)
+ * @param       buf: 数据缓冲区 (DMA期间必须保持有效)
+ * @param       len: 字节数
+ * @retval      true: 已启动, false: SPI忙
+ */
+bool vs1053_port_dma_write(const uint8_t *buf, uint16_t len)
+{
+    if (HAL_SPI_Transmit_DMA(&hspi1, buf, len) != HAL_OK) {
+        return false;
+    }
+
+    /* 32字节的突发不需要半传输中断，关掉可省一半的中断次数 */
+    __HAL_DMA_DISABLE_IT(&hdma_spi1_tx, DMA_IT_HT);
+    return true;
+}
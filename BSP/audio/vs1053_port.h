@@ -3,6 +3,7 @@
 
 #include "main.h"
 #include "spi.h"
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,11 +19,20 @@ extern "C" {
 #define VS_DREQ_READ()  (HAL_GPIO_ReadPin(GPIOC, GPIO_PIN_13) == GPIO_PIN_SET)
 
 extern SPI_HandleTypeDef hspi1; // SPI1 for VS1053
+extern DMA_HandleTypeDef hdma_spi1_tx; // DMA1 Channel3 -> SPI1_TX
 
 void vs1053_port_init(void);
+void vs1053_port_dma_init(void);
+void vs1053_port_dreq_irq_init(void);
+bool vs1053_port_dma_write(const uint8_t *buf, uint16_t len);
+void vs1053_port_set_clockf(uint16_t clockf);   /* CLOCKF变化后重新计算SPI速度 */
+void vs1053_port_set_legacy(bool enable);       /* 对比测试: 使用旧的HAL_SPI_Init切换方式 */
+void vs1053_port_sci_begin(bool read);
+void vs1053_port_sci_end(void);
 void vs1053_port_speed_low(void);
 void vs1053_port_speed_high(void);
 uint8_t vs1053_port_rw(uint8_t data);
+void vs1053_port_write(const uint8_t *buf, uint16_t len);
 void vs1053_write_data(const uint8_t *buf, uint16_t len);
 
 #ifdef __cplusplus
@@ -31,6 +31,16 @@ extern char SDPath[4];   /* SD logical drive path */
 FileList_t g_file_list;
 static bool fs_mounted = false;
 
+/* 目录扫描缓存: 记录最近一次扫描的请求路径和结果所在的列表 */
+static FileList_t* fs_cache_list = NULL;
+static char fs_cache_path[FS_MAX_PATH_LEN];
+
+/* 文件对象池 */
+static FIL fs_file_pool[FS_FILE_POOL_SIZE];
+static bool fs_file_used[FS_FILE_POOL_SIZE];
+static uint8_t fs_file_count = 0;
+static uint8_t fs_file_peak = 0;
+
 /* ============================================================================
  * 文件系统基础操作
  * ============================================================================ */
@@ -59,10 +69,15 @@ FS_Status_t fs_mount(void)
 {
     FRESULT res;
     
-    /* 初始化FatFS */
-    MX_FATFS_Init();
+    /* 初始化FatFS: main中已链接过驱动时不再重复链接, 否则SDPath会变成"2:/"并越界写驱动表 */
+    if (FATFS_GetAttachedDriversNbr() == 0)
+    {
+        MX_FATFS_Init();
+    }
     
     /* 挂载SD卡文件系统 */
+    fs_invalidate_file_cache();
+    
     res = f_mount(&SDFatFS, SDPath, 1);
     if (res == FR_OK)
     {
@@ -93,6 +108,7 @@ FS_Status_t fs_unmount(void)
 {
     f_mount(NULL, SDPath, 1);
     fs_mounted = false;
+    fs_invalidate_file_cache();
     return FS_STATUS_OK;
 }
 
@@ -212,9 +228,169 @@ FS_Status_t fs_get_audio_files(const char* path, FileList_t* file_list)
     f_closedir(&dir);
     file_list->current_index = 0;
     
+    /* 记录到缓存 */
+    fs_cache_list = file_list;
+    strncpy(fs_cache_path, path, FS_MAX_PATH_LEN - 1);
+    fs_cache_path[FS_MAX_PATH_LEN - 1] = '\0';
+    
+    return FS_STATUS_OK;
+}
+
+/**
+ * @brief       获取音频文件列表, 同一目录已扫描过时直接使用上次的结果
+ * @note        播放/切歌时使用, 避免每次按键都重新遍历目录;
+ *              重新挂载或调用fs_invalidate_file_cache后会重新扫描
+ * @param       path: 目录路径
+ * @param       file_list: 文件列表
+ * @retval      FS_Status_t 状态码
+ */
+FS_Status_t fs_get_audio_files_cached(const char* path, FileList_t* file_list)
+{
+    if (fs_mounted && fs_cache_list == file_list && file_list->count > 0 &&
+        strcmp(fs_cache_path, path) == 0)
+    {
+        return FS_STATUS_OK;
+    }
+    
+    return fs_get_audio_files(path, file_list);
+}
+
+/**
+ * @brief       使目录扫描缓存失效 (目录内容改变后调用)
+ * @param       无
+ * @retval      无
+ */
+void fs_invalidate_file_cache(void)
+{
+    fs_cache_list = NULL;
+    fs_cache_path[0] = '\0';
+}
+
+/* ============================================================================
+ * 文件读写操作 (文件对象池)
+ * ============================================================================ */
+
+/**
+ * @brief       从文件对象池取一个FIL并打开文件
+ * @note        池中FIL用完时返回错误, 不会静默占用别人的文件对象
+ * @param       path: 文件路径
+ * @param       mode: FatFs打开方式(FA_READ等)
+ * @param       file: 输出, 文件对象, 失败时为NULL
+ * @retval      FS_Status_t 状态码
+ */
+FS_Status_t fs_open_file(const char* path, uint8_t mode, FIL** file)
+{
+    FRESULT res;
+    uint8_t i;
+    
+    *file = NULL;
+    for (i = 0; i < FS_FILE_POOL_SIZE; i++)
+    {
+        if (!fs_file_used[i])
+        {
+            break;
+        }
+    }
+    if (i == FS_FILE_POOL_SIZE)
+    {
+        return FS_STATUS_ERROR;     /* 池已用完 */
+    }
+    
+    res = f_open(&fs_file_pool[i], path, mode);
+    switch (res)
+    {
+        case FR_OK:
+            break;
+        case FR_NO_FILE:
+        case FR_NO_PATH:
+            return FS_STATUS_FILE_NOT_FOUND;
+        case FR_DISK_ERR:
+            return FS_STATUS_READ_ERROR;
+        case FR_NOT_READY:
+        case FR_NOT_ENABLED:
+            return FS_STATUS_NOT_MOUNTED;
+        default:
+            return FS_STATUS_ERROR;
+    }
+    
+    fs_file_used[i] = true;
+    if (++fs_file_count > fs_file_peak)
+    {
+        fs_file_peak = fs_file_count;
+    }
+    *file = &fs_file_pool[i];
     return FS_STATUS_OK;
 }
 
+/**
+ * @brief       关闭文件并还回文件对象池
+ * @param       file: 文件对象, 关闭后置NULL; 为NULL时什么也不做
+ * @retval      FS_Status_t 状态码 (写入的文件关闭时要写回目录项)
+ */
+FS_Status_t fs_close_file(FIL** file)
+{
+    FRESULT res;
+    uint8_t i;
+    
+    if (*file == NULL)
+    {
+        return FS_STATUS_OK;
+    }
+    
+    res = f_close(*file);
+    i = (uint8_t)(*file - fs_file_pool);
+    if (i < FS_FILE_POOL_SIZE && fs_file_used[i])
+    {
+        fs_file_used[i] = false;
+        fs_file_count--;
+    }
+    *file = NULL;
+    
+    return (res == FR_OK) ? FS_STATUS_OK : FS_STATUS_WRITE_ERROR;
+}
+
+/**
+ * @brief       读取文件
+ * @param       file: 文件对象
+ * @param       buffer: 目标缓冲区
+ * @param       size: 字节数
+ * @param       bytes_read: 输出, 读到的字节数
+ * @retval      FS_Status_t 状态码
+ */
+FS_Status_t fs_read_file(FIL* file, uint8_t* buffer, uint32_t size, uint32_t* bytes_read)
+{
+    UINT br = 0;
+    FRESULT res = f_read(file, buffer, size, &br);
+    
+    *bytes_read = br;
+    return (res == FR_OK) ? FS_STATUS_OK : FS_STATUS_READ_ERROR;
+}
+
+/**
+ * @brief       文件定位
+ * @param       file: 文件对象
+ * @param       offset: 文件偏移
+ * @retval      FS_Status_t 状态码
+ */
+FS_Status_t fs_seek_file(FIL* file, uint32_t offset)
+{
+    return (f_lseek(file, offset) == FR_OK) ? FS_STATUS_OK : FS_STATUS_READ_ERROR;
+}
+
+/**
+ * @brief       文件对象池使用情况
+ * @param       peak: 输出, 最多同时打开的文件数, 可为NULL
+ * @retval      当前打开的文件数
+ */
+uint8_t fs_get_open_files(uint8_t* peak)
+{
+    if (peak != NULL)
+    {
+        *peak = fs_file_peak;
+    }
+    return fs_file_count;
+}
+
 /* ============================================================================
  * 工具函数
  * ============================================================================ */
@@ -31,11 +31,16 @@
 /******************************************************************************************/
 /* 文件系统配置 - 与CubeMX FatFS配置协调 */
 /* 注意：这些配置用于应用层文件管理，与CubeMX的FatFS配置互补 */
-/* CubeMX FatFS配置：_USE_LFN=0, _MAX_LFN=64, _VOLUMES=2, _FS_LOCK=0 */
+/* CubeMX FatFS配置：_USE_LFN=0, _MAX_LFN=64, _VOLUMES=2, _FS_LOCK=0, _MAX_SS=512 */
 #define FS_MAX_FILENAME_LEN     32      /* 最大文件名长度 - 适配音乐文件名 */
 #define FS_MAX_PATH_LEN         64      /* 最大路径长度 - 适配目录结构 */
 #define FS_MAX_FILES_PER_DIR    10      /* 每个目录最大文件数 - 优化RAM使用 */
 
+/* 文件对象池: 各模块打开文件时取一个FIL, 关闭时还回, 每个FIL带一个扇区缓冲区(_MAX_SS) */
+#ifndef FS_FILE_POOL_SIZE
+#define FS_FILE_POOL_SIZE       4       /* 同时打开的文件数: 当前/下一曲目, 定位索引, 录音/测试/插件 */
+#endif
+
 /* 支持的音频文件格式 */
 #define AUDIO_EXT_MP3           ".mp3"
 #define AUDIO_EXT_WAV           ".wav"
@@ -91,13 +96,16 @@ FS_Status_t fs_get_file_info(const char* path, FileInfo_t* file_info);   /* 获
 /* 音频文件相关 */
 bool fs_is_audio_file(const char* filename);                 /* 判断是否为音频文件 */
 FS_Status_t fs_get_audio_files(const char* path, FileList_t* file_list); /* 获取音频文件列表 */
+FS_Status_t fs_get_audio_files_cached(const char* path, FileList_t* file_list); /* 同上, 目录已扫描过时不再遍历 */
+void fs_invalidate_file_cache(void);                         /* 目录内容改变后调用 */
 uint16_t fs_count_audio_files(const char* path);             /* 统计音频文件数量 */
 
-/* 文件读写操作 */
-FS_Status_t fs_open_file(const char* path, void** file_handle);          /* 打开文件 */
-FS_Status_t fs_close_file(void* file_handle);                            /* 关闭文件 */
-FS_Status_t fs_read_file(void* file_handle, uint8_t* buffer, uint32_t size, uint32_t* bytes_read); /* 读取文件 */
-FS_Status_t fs_seek_file(void* file_handle, uint32_t offset);            /* 文件定位 */
+/* 文件读写操作 (文件对象池) */
+FS_Status_t fs_open_file(const char* path, uint8_t mode, FIL** file);    /* 从池中取FIL打开文件, 失败时*file为NULL */
+FS_Status_t fs_close_file(FIL** file);                                   /* 关闭文件并还回池中, *file置NULL */
+FS_Status_t fs_read_file(FIL* file, uint8_t* buffer, uint32_t size, uint32_t* bytes_read); /* 读取文件 */
+FS_Status_t fs_seek_file(FIL* file, uint32_t offset);                    /* 文件定位 */
+uint8_t fs_get_open_files(uint8_t* peak);                                /* 池中已打开的文件数, peak输出最高值 */
 
 /* 工具函数 */
 const char* fs_get_file_extension(const char* filename);     /* 获取文件扩展名 */
@@ -19,6 +19,8 @@
 #include "sdio_sdcard.h"
 #include "vs1053_driver.h"
 #include "audio_player.h"
+#include "vs1053_plugin.h"
+#include "audio_spectrum.h"
 #include "filesystem.h"
 
 /* ============================================================================
@@ -301,6 +303,51 @@ void lcd_fill(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, uint32_t color
     }
 }
 
+/**
+ * @brief       设置GRAM写入窗口
+ * @param       (sx,sy),(ex,ey): 窗口对角坐标
+ * @retval      无
+ * @note        写GRAM时在窗口内自动换行; 用完后需恢复全屏窗口, lcd_set_cursor只设起点
+ */
+void lcd_set_window(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey)
+{
+    lcd_wr_regno(lcddev.setxcmd);   /* Column Address Set */
+    lcd_wr_data(sx >> 8);
+    lcd_wr_data(sx & 0XFF);
+    lcd_wr_data(ex >> 8);
+    lcd_wr_data(ex & 0XFF);
+
+    lcd_wr_regno(lcddev.setycmd);   /* Page Address Set */
+    lcd_wr_data(sy >> 8);
+    lcd_wr_data(sy & 0XFF);
+    lcd_wr_data(ey >> 8);
+    lcd_wr_data(ey & 0XFF);
+}
+
+/**
+ * @brief       按窗口填充矩形
+ * @param       (sx,sy),(ex,ey): 填充矩形对角坐标
+ * @param       color: 要填充的颜色
+ * @retval      无
+ * @note        只设置一次地址, 之后连续写像素; lcd_fill每行都要重设光标,
+ *              窄而高的矩形(频谱柱)用这个快得多
+ */
+void lcd_fill_window(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, uint32_t color)
+{
+    uint32_t i;
+    uint32_t total = (uint32_t)(ex - sx + 1) * (ey - sy + 1);
+
+    lcd_set_window(sx, sy, ex, ey);
+    lcd_write_ram_prepare();        /* 开始写入GRAM */
+
+    for (i = 0; i < total; i++)
+    {
+        LCD->LCD_RAM = color;
+    }
+
+    lcd_set_window(0, 0, lcddev.width - 1, lcddev.height - 1);  /* 恢复全屏窗口 */
+}
+
 /**
  * @brief       画线
  * @param       x1,y1: 起点坐标
@@ -1371,6 +1418,23 @@ uint8_t device_init_audio(void)
     sprintf(test_str, "HDAT0: 0x%04X", test_val);
     lcd_show_string(10, 150, 300, 16, 12, test_str, YELLOW);
     
+    /* SCI读寄存器速度: 旧的HAL_SPI_Init切换 vs 直接改CR1 */
+    char bench_str[60];
+    sprintf(bench_str, "SCI rd/s: old %lu new %lu",
+            vs1053_bench_sci_reads(200, true), vs1053_bench_sci_reads(200, false));
+    lcd_show_string(10, 190, 300, 16, 12, bench_str, CYAN);
+    
+    /* 从SD卡加载插件(FLAC/频谱), 之后每次软复位自动重新加载 */
+    vs1053_plugin_init();
+    const VS1053_Plugin_t *flac = vs1053_plugin_find(VS1053_PLUGIN_FLAC);
+    if (flac != NULL) {
+      sprintf(bench_str, "FLAC plugin: %lu words %lu us", flac->words, flac->load_us);
+      lcd_show_string(10, 210, 300, 16, 12, bench_str, CYAN);
+    } else {
+      lcd_show_string(10, 210, 300, 16, 12, "FLAC plugin: not found", RED);
+    }
+    audio_spectrum_init();    /* 频谱插件已加载时启用频谱显示 */
+    
     /* 初始化音频播放器 */
     if (audio_player_init()) {
       lcd_show_string(10, 170, 300, 16, 12, "Audio Player: OK", GREEN);
@@ -115,6 +115,8 @@ void lcd_draw_point(uint16_t x, uint16_t y, uint32_t color);/* 画点(32位颜
 
 void lcd_clear(uint16_t color);     /* LCD清屏 */
 void lcd_fill(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, uint32_t color);          /* 纯色填充矩形 */
+void lcd_set_window(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey);                   /* 设置GRAM写入窗口 */
+void lcd_fill_window(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, uint32_t color);   /* 按窗口填充矩形 */
 void lcd_draw_line(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color);     /* 画直线 */
 void lcd_draw_rectangle(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color);/* 画矩形 */
 
@@ -0,0 +1,23 @@
+/**
+ ****************************************************************************************************
+ * @file        perf_counter.c
+ * @author      Music Player Project
+ * @version     V1.0
+ * @date        2025-09-20
+ * @brief       性能计数模块 - 基于Cortex-M3 DWT周期计数器
+ ****************************************************************************************************
+ */
+
+#include "perf_counter.h"
+
+/**
+ * @brief       初始化DWT周期计数器
+ * @param       无
+ * @retval      无
+ */
+void perf_counter_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;    /* 使能DWT/ITM跟踪单元 */
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;               /* 启动周期计数 */
+}
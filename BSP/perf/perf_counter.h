@@ -0,0 +1,47 @@
+/**
+ ****************************************************************************************************
+ * @file        perf_counter.h
+ * @author      Music Player Project
+ * @version     V1.0
+ * @date        2025-09-20
+ * @brief       性能计数模块 - 基于Cortex-M3 DWT周期计数器
+ ****************************************************************************************************
+ * @attention
+ *
+ * 功能说明:
+ * 1. 使能DWT->CYCCNT, 提供CPU周期级时间戳
+ * 2. 用于统计送数、读卡等热路径的CPU开销
+ * 3. 72MHz下CYCCNT约59.6秒回绕一次, 差值计算使用无符号减法即可
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __PERF_COUNTER_H
+#define __PERF_COUNTER_H
+
+#include "main.h"
+
+/* 函数声明 */
+void perf_counter_init(void);                           /* 使能周期计数器 */
+
+/**
+ * @brief       读取当前CPU周期计数
+ * @param       无
+ * @retval      当前周期数
+ */
+static inline uint32_t perf_counter_now(void)
+{
+    return DWT->CYCCNT;
+}
+
+/**
+ * @brief       周期数转换为微秒
+ * @param       cycles: 周期数
+ * @retval      微秒数
+ */
+static inline uint32_t perf_cycles_to_us(uint32_t cycles)
+{
+    return cycles / (SystemCoreClock / 1000000U);
+}
+
+#endif
@@ -20,6 +20,8 @@
 #include "sdio_sdcard.h"
 #include "nt35310_alientek.h"
 #include "sdio.h"  /* 包含CubeMX生成的SDIO配置 */
+#include "bsp_driver_sd.h"  /* DMA读写及完成等待 */
+#include "sd_cache.h"  /* 直接写扇区后丢弃缓存的旧内容 */
 #include "filesystem.h"  /* 包含文件系统管理 */
 
 /* 使用CubeMX生成的外部句柄，而不是我们自己的 */
@@ -28,6 +30,29 @@ extern SD_HandleTypeDef hsd;
 /* 我们的SD卡信息结构体 */
 HAL_SD_CardInfoTypeDef g_sd_card_info_handle;
 
+/* 总线档位, 从快到慢. SDIOCLK = HCLK(72MHz), 默认速度模式的卡最高25MHz */
+typedef struct {
+    uint32_t bus_wide;
+    uint8_t clock_div;
+} SdBusLevel_t;
+
+static const SdBusLevel_t s_bus_levels[SD_BUS_LEVELS] = {
+    { SDIO_BUS_WIDE_4B, 1 },                            /* 4位 24MHz */
+    { SDIO_BUS_WIDE_4B, 2 },                            /* 4位 18MHz */
+    { SDIO_BUS_WIDE_4B, 4 },                            /* 4位 12MHz */
+    { SDIO_BUS_WIDE_4B, 7 },                            /* 4位 8MHz */
+    { SDIO_BUS_WIDE_1B, SDIO_TRANSFER_CLK_DIV_MY },     /* 1位, 与MX_SDIO_SD_Init相同 */
+};
+
+/* 需要降档的错误(信号质量), 地址越界/卡状态之类的错误降档没有用 */
+#define SD_BUS_CRC_ERRORS   (HAL_SD_ERROR_DATA_CRC_FAIL | HAL_SD_ERROR_CMD_CRC_FAIL)
+#define SD_BUS_TIMEOUTS     (HAL_SD_ERROR_DATA_TIMEOUT | HAL_SD_ERROR_CMD_RSP_TIMEOUT | HAL_SD_ERROR_TIMEOUT)
+#define SD_BUS_ERRORS       (SD_BUS_CRC_ERRORS | SD_BUS_TIMEOUTS | HAL_SD_ERROR_RX_OVERRUN | HAL_SD_ERROR_TX_UNDERRUN)
+#define SD_READY_MS         250     /* 出错后等卡回到传输状态 */
+
+static SdBusConfig_t s_bus;
+static uint8_t s_sd_buf[SD_TUNE_BLOCKS * 512] __attribute__((aligned(4)));  /* 测试读缓冲区(DMA要求4字节对齐) */
+
 /**
  * @brief       初始化SD卡 - 兼容CubeMX方式，增强调试
  * @param       无
@@ -76,10 +101,10 @@ void show_sd_debug_info(void)
     char debug_str[60];
     
     /* 显示SDIO配置信息 */
-    sprintf(debug_str, "SDIO ClkDiv:%d FlowCtrl:%d", hsd.Init.ClockDiv, hsd.Init.HardwareFlowControl);
+    sprintf(debug_str, "SDIO ClkDiv:%d %lukHz FlowCtrl:%d", s_bus.clock_div, s_bus.clock_khz, hsd.Init.HardwareFlowControl);
     lcd_show_string(10, 360, 300, 16, 12, debug_str, BLACK);
     
-    sprintf(debug_str, "Bus Width:%s", (hsd.Init.BusWide == SDIO_BUS_WIDE_4B) ? "4bit" : "1bit");
+    sprintf(debug_str, "Bus Width:%dbit Level:%d Test:%luKB/s", s_bus.bus_width, s_bus.level, s_bus.tune_kbps);
     lcd_show_string(10, 380, 300, 16, 12, debug_str, BLACK);
     
     /* 显示SD卡状态 */
@@ -125,9 +150,67 @@ uint8_t get_sd_card_state(void)
     return ((HAL_SD_GetCardState(&hsd) == HAL_SD_CARD_TRANSFER) ? SD_TRANSFER_OK : SD_TRANSFER_BUSY);
 }
 
+/**
+ * @brief       等待SD卡回到传输状态
+ * @param       ms : 超时(ms)
+ * @retval      0, 已回到传输状态; 1, 超时
+ */
+static uint8_t sd_wait_ready(uint32_t ms)
+{
+    uint32_t tickstart = HAL_GetTick();
+    
+    while (get_sd_card_state() != SD_TRANSFER_OK)
+    {
+        if (HAL_GetTick() - tickstart >= ms)
+        {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * @brief       DMA读扇区, 等待数据全部搬完
+ * @param       pbuf  : 数据缓存区(4字节对齐)
+ * @param       saddr : 扇区地址
+ * @param       cnt   : 扇区个数
+ * @retval      HAL_OK, 正常; HAL_ERROR, 出错(原因见hsd.ErrorCode)
+ */
+static uint8_t sd_dma_read(uint8_t *pbuf, uint32_t saddr, uint32_t cnt)
+{
+    /* DMA2通道4搬数据, 等待期间中断照常响应(VS1053送数/按键/串口不停顿) */
+    if (BSP_SD_ReadBlocks_DMA((uint32_t *)pbuf, saddr, cnt) != MSD_OK ||
+        BSP_SD_WaitTransfer(SD_DMA_TIMEOUT) != MSD_OK)
+    {
+        return HAL_ERROR;
+    }
+    
+    return HAL_OK;
+}
+
+/**
+ * @brief       DMA写扇区, 等到数据全部发出(DATAEND), 不等卡编程结束
+ * @param       pbuf  : 数据缓存区(4字节对齐)
+ * @param       saddr : 扇区地址
+ * @param       cnt   : 扇区个数
+ * @retval      HAL_OK, 正常; HAL_ERROR, 出错(原因见hsd.ErrorCode)
+ */
+static uint8_t sd_dma_write(uint8_t *pbuf, uint32_t saddr, uint32_t cnt)
+{
+    if (BSP_SD_WriteBlocks_DMA((uint32_t *)pbuf, saddr, cnt) != MSD_OK ||
+        BSP_SD_WaitTransfer(SD_DMA_TIMEOUT) != MSD_OK)
+    {
+        return HAL_ERROR;
+    }
+    
+    return HAL_OK;
+}
+
 /**
  * @brief       读SD卡(fatfs/usb调用)
- * @param       pbuf  : 数据缓存区
+ * @note        CRC/超时错误时降一档总线配置(sd_bus_fallback)重试一次
+ * @param       pbuf  : 数据缓存区(4字节对齐)
  * @param       saddr : 扇区地址
  * @param       cnt   : 扇区个数
  * @retval      0, 正常;  其他, 错误代码(详见SD_Error定义);
@@ -136,11 +219,17 @@ uint8_t sd_read_disk(uint8_t *pbuf, uint32_t saddr, uint32_t cnt)
 {
     uint8_t sta = HAL_OK;
     uint32_t timeout = SD_TIMEOUT;
-    long long lsector = saddr;
     
-    __disable_irq();    /* 关闭总中断(POLLING模式,严禁中断打断SDIO读写操作!!!) */
+    if ((uint32_t)pbuf & 3U)
+    {
+        return HAL_ERROR;   /* DMA按字传输, 缓冲区须4字节对齐 */
+    }
     
-    sta = HAL_SD_ReadBlocks(&hsd, (uint8_t *)pbuf, lsector, cnt, SD_TIMEOUT);
+    if (sd_dma_read(pbuf, saddr, cnt) != HAL_OK &&
+        (sd_bus_fallback() != 0 || sd_dma_read(pbuf, saddr, cnt) != HAL_OK))
+    {
+        return HAL_ERROR;
+    }
     
     /* 等待SD卡读完 */
     while (get_sd_card_state() != SD_TRANSFER_OK)
@@ -152,13 +241,41 @@ uint8_t sd_read_disk(uint8_t *pbuf, uint32_t saddr, uint32_t cnt)
         }
     }
     
-    __enable_irq(); /* 开启总中断 */
     return sta;
 }
 
+/**
+ * @brief       开始写SD卡, 数据发送完即返回, 不等卡编程结束
+ * @note        卡内编程(忙)期间可以继续做别的事, 下一次读写前用get_sd_card_state
+ *              确认已回到传输状态. 录音用它把写卡的忙等时间让给读编码器.
+ *              CRC/超时错误时降一档重试一次(同sd_read_disk)
+ * @param       pbuf  : 数据缓存区(4字节对齐)
+ * @param       saddr : 扇区地址
+ * @param       cnt   : 扇区个数
+ * @retval      0, 正常;  其他, 错误代码(详见SD_Error定义);
+ */
+uint8_t sd_write_start(uint8_t *pbuf, uint32_t saddr, uint32_t cnt)
+{
+    if ((uint32_t)pbuf & 3U)
+    {
+        return HAL_ERROR;   /* DMA按字传输, 缓冲区须4字节对齐 */
+    }
+    
+    sd_cache_invalidate(saddr, cnt);    /* 不经FatFs写入(录音), 扇区缓存里的旧内容作废 */
+    
+    /* 等到数据全部发出(DATAEND)即返回, 之后pbuf可以改写 */
+    if (sd_dma_write(pbuf, saddr, cnt) != HAL_OK &&
+        (sd_bus_fallback() != 0 || sd_dma_write(pbuf, saddr, cnt) != HAL_OK))
+    {
+        return HAL_ERROR;
+    }
+    
+    return HAL_OK;
+}
+
 /**
  * @brief       写SD卡(fatfs/usb调用)
- * @param       pbuf  : 数据缓存区
+ * @param       pbuf  : 数据缓存区(4字节对齐)
  * @param       saddr : 扇区地址
  * @param       cnt   : 扇区个数
  * @retval      0, 正常;  其他, 错误代码(详见SD_Error定义);
@@ -167,11 +284,8 @@ uint8_t sd_write_disk(uint8_t *pbuf, uint32_t saddr, uint32_t cnt)
 {
     uint8_t sta = HAL_OK;
     uint32_t timeout = SD_TIMEOUT;
-    long long lsector = saddr;
-    
-    __disable_irq();    /* 关闭总中断(POLLING模式,严禁中断打断SDIO读写操作!!!) */
     
-    sta = HAL_SD_WriteBlocks(&hsd, (uint8_t *)pbuf, lsector, cnt, SD_TIMEOUT);
+    sta = sd_write_start(pbuf, saddr, cnt);
     
     /* 等待SD卡写完 */
     while (get_sd_card_state() != SD_TRANSFER_OK)
@@ -183,10 +297,213 @@ uint8_t sd_write_disk(uint8_t *pbuf, uint32_t saddr, uint32_t cnt)
         }
     }
     
-    __enable_irq(); /* 开启总中断 */
     return sta;
 }
 
+/* ============================================================================
+ * 总线位宽和时钟自动调整
+ * ============================================================================ */
+
+/**
+ * @brief       切换到指定档位
+ * @note        卡的位宽要用ACMD6改(HAL_SD_ConfigWideBusOperation), 先把主机时钟降回
+ *              原配置再发命令, 以免在出错的档位上命令也收不对. hsd.Init保持1位原配置,
+ *              重新挂载(HAL_SD_Init)时从1位开始.
+ *              硬件流控始终关闭: F103大容量产品勘误表中流控会使SDIO_CK出现毛刺,
+ *              导致CRC错误和写入数据出错; 收发都走DMA, FIFO不会溢出
+ * @param       level : 档位(s_bus_levels下标)
+ * @retval      0, 成功; 1, 卡不接受位宽切换
+ */
+static uint8_t sd_bus_set(uint8_t level)
+{
+    const SdBusLevel_t *l = &s_bus_levels[level];
+    SDIO_InitTypeDef init = hsd.Init;
+    uint8_t width = (l->bus_wide == SDIO_BUS_WIDE_4B) ? 4 : 1;
+    
+    init.HardwareFlowControl = SDIO_HARDWARE_FLOW_CONTROL_DISABLE;
+    
+    if (width != s_bus.bus_width)
+    {
+        init.BusWide = (s_bus.bus_width == 4) ? SDIO_BUS_WIDE_4B : SDIO_BUS_WIDE_1B;
+        SDIO_Init(hsd.Instance, init);
+        if (HAL_SD_ConfigWideBusOperation(&hsd, l->bus_wide) != HAL_OK)
+        {
+            return 1;
+        }
+        s_bus.bus_width = width;
+    }
+    
+    init.BusWide = l->bus_wide;
+    init.ClockDiv = l->clock_div;
+    SDIO_Init(hsd.Instance, init);
+    
+    s_bus.level = level;
+    s_bus.clock_div = l->clock_div;
+    s_bus.clock_khz = HAL_RCC_GetHCLKFreq() / 1000U / (l->clock_div + 2U);
+    return 0;
+}
+
+/**
+ * @brief       测试读一遍: 记录或比较每条读命令的校验和
+ * @param       ref    : 校验和, 每SD_TUNE_BLOCKS个扇区一个
+ * @param       record : true, 记录为参考; false, 与参考比较
+ * @retval      出错次数(传输错误 + 数据不符)
+ */
+static uint16_t sd_tune_pass(uint32_t *ref, bool record)
+{
+    const uint32_t *w = (const uint32_t *)s_sd_buf;
+    uint16_t errors = 0;
+    uint32_t i, j, sum;
+    
+    for (i = 0; i < SD_TUNE_SECTORS / SD_TUNE_BLOCKS; i++)
+    {
+        if (sd_dma_read(s_sd_buf, SD_TUNE_START + i * SD_TUNE_BLOCKS, SD_TUNE_BLOCKS) != HAL_OK)
+        {
+            errors++;
+        }
+        else
+        {
+            for (j = 0, sum = 0; j < sizeof(s_sd_buf) / 4; j++)
+            {
+                sum = ((sum << 1) | (sum >> 31)) ^ w[j];
+            }
+            if (record)
+            {
+                ref[i] = sum;
+            }
+            else if (sum != ref[i])
+            {
+                errors++;
+            }
+        }
+        
+        if (sd_wait_ready(SD_READY_MS) != 0)
+        {
+            return errors + 1;  /* 卡回不到传输状态, 这一档不用再测 */
+        }
+    }
+    
+    return errors;
+}
+
+/**
+ * @brief       计算测试读速率
+ * @param       sectors : 读的扇区数
+ * @param       ms      : 用时
+ * @retval      KB/s
+ */
+static uint32_t sd_tune_kbps(uint32_t sectors, uint32_t ms)
+{
+    return ms ? sectors * 512U / 1024U * 1000U / ms : 0;
+}
+
+/**
+ * @brief       识别后选择总线位宽和时钟(BSP_SD_Init调用)
+ * @note        先用识别后的1位原配置读测试区作参考, 再切到4位从最快的分频开始,
+ *              每档读SD_TUNE_PASSES遍, CRC/超时/溢出或数据与参考不符就降一档.
+ *              4位都不稳定(或卡不支持4位)时回到1位原配置. 结果由sd_bus_get_config读出
+ * @param       无
+ * @retval      选定的档位, 0最快
+ */
+uint8_t sd_bus_tune(void)
+{
+    uint32_t ref[SD_TUNE_SECTORS / SD_TUNE_BLOCKS];
+    uint8_t base = SD_BUS_LEVELS - 1;
+    uint8_t level, pass;
+    uint16_t errors;
+    uint32_t tick;
+    
+    memset(&s_bus, 0, sizeof(s_bus));
+    for (level = 0; level < SD_BUS_LEVELS; level++)
+    {
+        s_bus.tune_errors[level] = SD_TUNE_UNTESTED;
+    }
+    s_bus.bus_width = 1;        /* HAL_SD_Init之后卡和主机都是1位 */
+    sd_bus_set(base);
+    
+    /* 参考数据: 1位原配置一直在用, 认为可靠 */
+    tick = HAL_GetTick();
+    s_bus.tune_errors[base] = sd_tune_pass(ref, true);
+    s_bus.tune_kbps = sd_tune_kbps(SD_TUNE_SECTORS, HAL_GetTick() - tick);
+    if (s_bus.tune_errors[base] != 0)
+    {
+        return base;            /* 原配置都读不对, 不再尝试更快的 */
+    }
+    
+    for (level = 0; level < base; level++)
+    {
+        if (sd_bus_set(level) != 0)
+        {
+            break;              /* 卡不接受4位 */
+        }
+        
+        tick = HAL_GetTick();
+        for (pass = 0, errors = 0; pass < SD_TUNE_PASSES && errors == 0; pass++)
+        {
+            errors += sd_tune_pass(ref, false);
+        }
+        tick = HAL_GetTick() - tick;
+        
+        s_bus.tune_errors[level] = errors;
+        if (errors == 0)
+        {
+            s_bus.tune_kbps = sd_tune_kbps(SD_TUNE_SECTORS * SD_TUNE_PASSES, tick);
+            return level;
+        }
+        sd_wait_ready(SD_READY_MS);
+    }
+    
+    /* 4位都不稳定: 回到1位原配置 */
+    if (sd_bus_set(base) != 0)
+    {
+        sd_bus_set(base - 1);   /* 卡不肯回1位, 留在最慢的4位档 */
+    }
+    return s_bus.level;
+}
+
+/**
+ * @brief       传输出错后降一档
+ * @note        只对CRC/超时/FIFO溢出这类信号质量错误降档(错误原因取自hsd.ErrorCode),
+ *              调用者随后可以重试一次
+ * @param       无
+ * @retval      0, 已降档; 1, 不是总线错误或已是最慢档
+ */
+uint8_t sd_bus_fallback(void)
+{
+    uint32_t err = hsd.ErrorCode;
+    
+    if (err & SD_BUS_CRC_ERRORS)
+    {
+        s_bus.crc_errors++;
+    }
+    if (err & SD_BUS_TIMEOUTS)
+    {
+        s_bus.timeouts++;
+    }
+    if (!(err & SD_BUS_ERRORS) || s_bus.level >= SD_BUS_LEVELS - 1)
+    {
+        return 1;
+    }
+    
+    sd_wait_ready(SD_READY_MS);
+    if (sd_bus_set(s_bus.level + 1) != 0)
+    {
+        return 1;
+    }
+    s_bus.fallbacks++;
+    return 0;
+}
+
+/**
+ * @brief       读出当前总线配置和调整/降档记录
+ * @param       config : 输出
+ * @retval      无
+ */
+void sd_bus_get_config(SdBusConfig_t *config)
+{
+    *config = s_bus;
+}
+
 /**
  * @brief       通过LCD显示SD卡相关信息
  * @param       无
@@ -257,11 +574,9 @@ uint8_t sd_test_read(uint32_t secaddr, uint32_t seccnt)
     uint8_t sta = 0;
     char result_str[50];
 
-    /* 简单的内存分配，避免复杂的内存管理 */
-    static uint8_t test_buf[512];   /* 静态缓冲区，测试1个扇区 */
-    
+    /* 借用总线测试读的缓冲区，避免复杂的内存管理 */
     if (seccnt > 1) seccnt = 1;     /* 限制为1个扇区，避免内存不足 */
-    buf = test_buf;
+    buf = s_sd_buf;
 
     lcd_show_string(10, 300, 300, 16, 16, "Reading SD card...", BLUE);
     
@@ -38,6 +38,15 @@
                                                 /* STM32F103 SDIO_CLK = 72MHz / 2 = 36MHz */
                                                 /* 传输时钟 = 36MHz / (2+2) = 9MHz < 25MHz(最大值) */
 
+/* 总线自动调整(sd_bus_tune): 识别后切到4位, 从最快的分频开始测试读, 出错就降一档,
+ * 4位全部不稳定时回到1位原配置. 运行中读写出现CRC/超时错误时再降一档并重试 */
+#define SD_BUS_LEVELS          5       /* 档位数, 见sdio_sdcard.c s_bus_levels */
+#define SD_TUNE_START          0       /* 测试读的起始扇区 */
+#define SD_TUNE_SECTORS        64      /* 每遍读的扇区数 */
+#define SD_TUNE_BLOCKS         2       /* 每条读命令的扇区数(多块读) */
+#define SD_TUNE_PASSES         4       /* 每档读几遍, 全部无错且与参考一致才选用 */
+#define SD_TUNE_UNTESTED       0xFFFF  /* tune_errors: 该档未测试 */
+
 #define SD_TIMEOUT             ((uint32_t)100000000)      /* 超时时间 */
 #define SD_TRANSFER_OK         ((uint8_t)0x00)            /* 传输完成 */
 #define SD_TRANSFER_BUSY       ((uint8_t)0x01)            /* SD卡忙 */ 
@@ -48,6 +57,19 @@
 #define SD_TOTAL_SIZE_MB(__Handle__)    (((uint64_t)((__Handle__)->SdCard.LogBlockNbr)*((__Handle__)->SdCard.LogBlockSize))>>20)
 #define SD_TOTAL_SIZE_GB(__Handle__)    (((uint64_t)((__Handle__)->SdCard.LogBlockNbr)*((__Handle__)->SdCard.LogBlockSize))>>30)
 
+/* 总线配置记录 */
+typedef struct {
+    uint8_t bus_width;                      /* 1或4 */
+    uint8_t clock_div;                      /* SDIO_CK = HCLK / (clock_div + 2) */
+    uint8_t level;                          /* 当前档位, 0最快 */
+    uint32_t clock_khz;
+    uint32_t tune_kbps;                     /* 选定档位测试读的速率 */
+    uint16_t tune_errors[SD_BUS_LEVELS];    /* 调整时各档出错次数(CRC/超时/溢出/数据不符) */
+    uint32_t crc_errors;                    /* 运行中CRC错误次数 */
+    uint32_t timeouts;                      /* 运行中超时次数 */
+    uint32_t fallbacks;                     /* 运行中降档次数 */
+} SdBusConfig_t;
+
 /******************************************************************************************/
 /* 外部变量声明 */
 extern HAL_SD_CardInfoTypeDef  g_sd_card_info_handle;      /* SD卡信息结构体 */
@@ -58,6 +80,10 @@ uint8_t get_sd_card_info(HAL_SD_CardInfoTypeDef *cardinfo);
 uint8_t get_sd_card_state(void);
 uint8_t sd_read_disk(uint8_t *pbuf, uint32_t saddr, uint32_t cnt);
 uint8_t sd_write_disk(uint8_t *pbuf, uint32_t saddr, uint32_t cnt);
+uint8_t sd_write_start(uint8_t *pbuf, uint32_t saddr, uint32_t cnt);    /* 不等卡编程结束 */
+uint8_t sd_bus_tune(void);                  /* 识别后选择总线位宽和时钟, 返回选定档位 */
+uint8_t sd_bus_fallback(void);              /* 传输出错后降一档, 0: 已降档可重试 */
+void sd_bus_get_config(SdBusConfig_t *config);
 void show_sdcard_info(void);
 uint8_t sd_test_read(uint32_t secaddr, uint32_t seccnt);
 void show_sd_debug_info(void);
@@ -36,6 +36,13 @@
 #include "lcdfont.h"
 #include "sdio_sdcard.h"
 #include "audio_player.h"
+#include "seek_index.h"
+#include "audio_spectrum.h"
+#include "audio_telemetry.h"
+#include "stream_bench.h"
+#include "audio_recorder.h"
+#include "uart_stream.h"
+#include "perf_counter.h"
 
 
 /* USER CODE END Includes */
@@ -47,6 +54,7 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define KEY_DEBOUNCE_MS     30      /* 按键松开消抖时间 */
 
 /* USER CODE END PD */
 
@@ -111,6 +119,9 @@ int main(void)
   MX_USART1_UART_Init();
   MX_FATFS_Init();
   /* USER CODE BEGIN 2 */
+  /* 使能DWT周期计数器, 用于性能统计 */
+  perf_counter_init();
+  
   /* 初始化LCD - 使用正点原子的方式 */
   lcd_init();
   
@@ -137,6 +148,9 @@ int main(void)
     lcd_show_string(10, 450, 300, 16, 12, status_str, RED);
   }
 
+  /* 播放遥测: USART1发'?'读出报告, 'p'打开LCD状态页, 'b'送数吞吐量测试, 'e'开关WAV均衡器, 'R'开始/停止录音, 'S'串口送流 */
+  audio_telemetry_init();
+
   /*debug info*/
   // sd_show_complete_info();
 
@@ -146,23 +160,37 @@ int main(void)
   /* USER CODE BEGIN WHILE */
   while (1)
   {
-    /* 主循环运行指示器 */
-    static uint32_t loop_counter = 0;
-    loop_counter++;
-    if (loop_counter % 200000 == 0) {  /* 每20万次循环更新一次状态 */
-        char status_str[40];
-        sprintf(status_str, "Music Player Ready [%lu]", loop_counter / 200000);
-        lcd_show_string(10, 10, 300, 16, 12, status_str, BLUE);
+    /* 音频播放器按键控制 (录音或串口送流时VS1053被占用, 不响应) */
+    if (!audio_recorder_busy() && !uart_stream_busy())
+    {
+      audio_handle_key0_prev();       /* KEY0: 上一首 */
+      audio_handle_key1_play();       /* KEY1: 播放/暂停 */
+      audio_handle_key2_next();       /* KEY2: 下一首 */
     }
-
-    /* 音频播放器按键控制 */
-    audio_handle_key0_prev();         /* KEY0: 上一首 */
-    audio_handle_key1_play();         /* KEY1: 播放/暂停 */
-    audio_handle_key2_next();         /* KEY2: 下一首 */
     
     /* 音频播放任务 */
     audio_player_task();
     
+    /* 频谱显示 (电平由送数器中断读取, 这里只排队和重画) */
+    audio_spectrum_task();
+    
+    /* 空闲时建立定位索引, 播放器要读卡或正在录音时让出SD卡 */
+    if (!audio_player_io_busy() && !audio_recorder_busy()) {
+        seek_index_task();
+    }
+    
+    /* 遥测: 主循环计数, 串口命令和报告, 状态页 */
+    audio_telemetry_task();
+    
+    /* 送数吞吐量测试 (串口命令'b'启动) */
+    stream_bench_task();
+    
+    /* 录音: 读编码器, 写卡 (串口命令'R'开始/停止) */
+    audio_recorder_task();
+    
+    /* 串口送流: USART1 DMA接收 -> VS1053 (串口命令'S'开始) */
+    uart_stream_task();
+    
     /* 处理触摸屏输入 */
     tp_handle_main_loop();
 
@@ -220,22 +248,32 @@ void SystemClock_Config(void)
 void audio_handle_key1_play(void)
 {
     static uint8_t key1_pressed = 0;
+    static uint32_t key1_tick = 0;
     
     if (HAL_GPIO_ReadPin(GPIOE, GPIO_PIN_3) == GPIO_PIN_RESET)  /* KEY1按下 */
     {
+        key1_tick = HAL_GetTick();
         if (!key1_pressed)
         {
-            key1_pressed = 1;
-            HAL_Delay(50);  /* 消抖 */
+            key1_pressed = 1;  /* 按下沿立即响应, 不再HAL_Delay阻塞主循环 */
             
-            if (HAL_GPIO_ReadPin(GPIOE, GPIO_PIN_3) == GPIO_PIN_RESET)  /* 确认按下 */
+            /* 播放中切换暂停/恢复, 空闲时播放当前歌曲 */
+            if (audio_player_is_paused())
             {
-                /* 播放当前歌曲 */
+                audio_player_resume();
+            }
+            else if (audio_player_is_playing())
+            {
+                audio_player_pause();
+            }
+            else
+            {
+                audio_player_bench_start();  /* 记录按键时刻, 出声后显示起播各阶段耗时 */
                 audio_player_test_play();
             }
         }
     }
-    else
+    else if (HAL_GetTick() - key1_tick > KEY_DEBOUNCE_MS)  /* 松开稳定后才允许下一次按下 */
     {
         key1_pressed = 0;
     }
@@ -247,38 +285,36 @@ void audio_handle_key1_play(void)
 void audio_handle_key2_next(void)
 {
     static uint8_t key2_pressed = 0;
+    static uint32_t key2_tick = 0;
     
     if (HAL_GPIO_ReadPin(GPIOE, GPIO_PIN_2) == GPIO_PIN_RESET)  /* KEY2按下 */
     {
+        key2_tick = HAL_GetTick();
         if (!key2_pressed)
         {
-            key2_pressed = 1;
-            HAL_Delay(50);  /* 消抖 */
+            key2_pressed = 1;  /* 按下沿立即响应, 不再HAL_Delay阻塞主循环 */
             
-            if (HAL_GPIO_ReadPin(GPIOE, GPIO_PIN_2) == GPIO_PIN_RESET)  /* 确认按下 */
+            if (audio_player_next())
             {
-                if (audio_player_next())
+                /* 清理显示区域 */
+                lcd_fill(10, 320, 310, 400, WHITE);
+                
+                /* 显示当前文件名 */
+                const char* filename = audio_player_get_current_file();
+                if (filename && strlen(filename) > 0)
                 {
-                    /* 清理显示区域 */
-                    lcd_fill(10, 320, 310, 400, WHITE);
-                    
-                    /* 显示当前文件名 */
-                    const char* filename = audio_player_get_current_file();
-                    if (filename && strlen(filename) > 0)
-                    {
-                        char display_name[50];
-                        snprintf(display_name, sizeof(display_name), "Next: %.35s", filename);
-                        lcd_show_string(10, 320, 300, 16, 12, display_name, BLACK);
-                    }
-                }
-                else
-                {
-                    lcd_show_string(10, 320, 300, 16, 12, "No next song available", RED);
+                    char display_name[50];
+                    snprintf(display_name, sizeof(display_name), "Next: %.35s", filename);
+                    lcd_show_string(10, 320, 300, 16, 12, display_name, BLACK);
                 }
             }
+            else
+            {
+                lcd_show_string(10, 320, 300, 16, 12, "No next song available", RED);
+            }
         }
     }
-    else
+    else if (HAL_GetTick() - key2_tick > KEY_DEBOUNCE_MS)  /* 松开稳定后才允许下一次按下 */
     {
         key2_pressed = 0;
     }
@@ -290,38 +326,36 @@ void audio_handle_key2_next(void)
 void audio_handle_key0_prev(void)
 {
     static uint8_t key0_pressed = 0;
+    static uint32_t key0_tick = 0;
     
     if (HAL_GPIO_ReadPin(GPIOE, GPIO_PIN_4) == GPIO_PIN_RESET)  /* KEY0按下 */
     {
+        key0_tick = HAL_GetTick();
         if (!key0_pressed)
         {
-            key0_pressed = 1;
-            HAL_Delay(50);  /* 消抖 */
+            key0_pressed = 1;  /* 按下沿立即响应, 不再HAL_Delay阻塞主循环 */
             
-            if (HAL_GPIO_ReadPin(GPIOE, GPIO_PIN_4) == GPIO_PIN_RESET)  /* 确认按下 */
+            if (audio_player_prev())
             {
-                if (audio_player_prev())
-                {
-                    /* 清理显示区域 */
-                    lcd_fill(10, 320, 310, 400, WHITE);
-                    
-                    /* 显示当前文件名 */
-                    const char* filename = audio_player_get_current_file();
-                    if (filename && strlen(filename) > 0)
-                    {
-                        char display_name[50];
-                        snprintf(display_name, sizeof(display_name), "Prev: %.35s", filename);
-                        lcd_show_string(10, 320, 300, 16, 12, display_name, BLACK);
-                    }
-                }
-                else
+                /* 清理显示区域 */
+                lcd_fill(10, 320, 310, 400, WHITE);
+                
+                /* 显示当前文件名 */
+                const char* filename = audio_player_get_current_file();
+                if (filename && strlen(filename) > 0)
                 {
-                    lcd_show_string(10, 320, 300, 16, 12, "No previous song available", RED);
+                    char display_name[50];
+                    snprintf(display_name, sizeof(display_name), "Prev: %.35s", filename);
+                    lcd_show_string(10, 320, 300, 16, 12, display_name, BLACK);
                 }
             }
+            else
+            {
+                lcd_show_string(10, 320, 300, 16, 12, "No previous song available", RED);
+            }
         }
     }
-    else
+    else if (HAL_GetTick() - key0_tick > KEY_DEBOUNCE_MS)  /* 松开稳定后才允许下一次按下 */
     {
         key0_pressed = 0;
     }
@@ -21,7 +21,7 @@
 #include "sdio.h"
 
 /* USER CODE BEGIN 0 */
-
+DMA_HandleTypeDef hdma_sdio;    /* DMA2通道4, SDIO收发共用 */
 /* USER CODE END 0 */
 
 SD_HandleTypeDef hsd;
@@ -43,7 +43,7 @@ void MX_SDIO_SD_Init(void)
   hsd.Init.ClockBypass = SDIO_CLOCK_BYPASS_DISABLE;
   hsd.Init.ClockPowerSave = SDIO_CLOCK_POWER_SAVE_DISABLE;
   hsd.Init.BusWide = SDIO_BUS_WIDE_1B;
-  hsd.Init.HardwareFlowControl = SDIO_HARDWARE_FLOW_CONTROL_ENABLE;
+  hsd.Init.HardwareFlowControl = SDIO_HARDWARE_FLOW_CONTROL_DISABLE;
   hsd.Init.ClockDiv = 2;
   /* USER CODE BEGIN SDIO_Init 2 */
 
@@ -67,10 +67,14 @@ void HAL_SD_MspInit(SD_HandleTypeDef* sdHandle)
     __HAL_RCC_GPIOD_CLK_ENABLE();
     /**SDIO GPIO Configuration
     PC8     ------> SDIO_D0
+    PC9     ------> SDIO_D1
+    PC10     ------> SDIO_D2
+    PC11     ------> SDIO_D3
     PC12     ------> SDIO_CK
     PD2     ------> SDIO_CMD
     */
-    GPIO_InitStruct.Pin = GPIO_PIN_8|GPIO_PIN_12;
+    GPIO_InitStruct.Pin = GPIO_PIN_8|GPIO_PIN_9|GPIO_PIN_10|GPIO_PIN_11
+                          |GPIO_PIN_12;
     GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
     GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
     HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
@@ -81,7 +85,31 @@ void HAL_SD_MspInit(SD_HandleTypeDef* sdHandle)
     HAL_GPIO_Init(GPIOD, &GPIO_InitStruct);
 
   /* USER CODE BEGIN SDIO_MspInit 1 */
-
+    /* SDIO DMA: F1上收发都只能用DMA2通道4, 一个句柄同时挂到hdmarx/hdmatx,
+     * 方向由HAL_SD_ReadBlocks_DMA/HAL_SD_WriteBlocks_DMA每次启动时改写 */
+    __HAL_RCC_DMA2_CLK_ENABLE();
+
+    hdma_sdio.Instance = DMA2_Channel4;
+    hdma_sdio.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_sdio.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_sdio.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_sdio.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+    hdma_sdio.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+    hdma_sdio.Init.Mode = DMA_NORMAL;
+    hdma_sdio.Init.Priority = DMA_PRIORITY_HIGH;
+    if (HAL_DMA_Init(&hdma_sdio) != HAL_OK)
+    {
+      Error_Handler();
+    }
+    __HAL_LINKDMA(sdHandle, hdmarx, hdma_sdio);
+    __HAL_LINKDMA(sdHandle, hdmatx, hdma_sdio);
+
+    /* 完成/错误中断优先级低于VS1053送数(DREQ/DMA1通道3为1)和USART1(0):
+     * 主循环在等传输结束, 晚几微秒处理无妨, 送数不能被它推迟 */
+    HAL_NVIC_SetPriority(SDIO_IRQn, 2, 0);
+    HAL_NVIC_EnableIRQ(SDIO_IRQn);
+    HAL_NVIC_SetPriority(DMA2_Channel4_5_IRQn, 2, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Channel4_5_IRQn);
   /* USER CODE END SDIO_MspInit 1 */
   }
 }
@@ -99,15 +127,21 @@ void HAL_SD_MspDeInit(SD_HandleTypeDef* sdHandle)
 
     /**SDIO GPIO Configuration
     PC8     ------> SDIO_D0
+    PC9     ------> SDIO_D1
+    PC10     ------> SDIO_D2
+    PC11     ------> SDIO_D3
     PC12     ------> SDIO_CK
     PD2     ------> SDIO_CMD
     */
-    HAL_GPIO_DeInit(GPIOC, GPIO_PIN_8|GPIO_PIN_12);
+    HAL_GPIO_DeInit(GPIOC, GPIO_PIN_8|GPIO_PIN_9|GPIO_PIN_10|GPIO_PIN_11
+                          |GPIO_PIN_12);
 
     HAL_GPIO_DeInit(GPIOD, GPIO_PIN_2);
 
   /* USER CODE BEGIN SDIO_MspDeInit 1 */
-
+    HAL_NVIC_DisableIRQ(SDIO_IRQn);
+    HAL_NVIC_DisableIRQ(DMA2_Channel4_5_IRQn);
+    HAL_DMA_DeInit(sdHandle->hdmarx);
   /* USER CODE END SDIO_MspDeInit 1 */
   }
 }
@@ -22,6 +22,7 @@
 #include "stm32f1xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "vs1053_feeder.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -57,7 +58,8 @@
 /* External variables --------------------------------------------------------*/
 extern UART_HandleTypeDef huart1;
 /* USER CODE BEGIN EV */
-
+extern SD_HandleTypeDef hsd;
+extern DMA_HandleTypeDef hdma_sdio;
 /* USER CODE END EV */
 
 /******************************************************************************/
@@ -214,4 +216,36 @@ void USART1_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles DMA1 channel3 global interrupt (SPI1_TX -> VS1053 SDI).
+  */
+void DMA1_Channel3_IRQHandler(void)
+{
+  vs1053_feeder_dma_irq_handler();
+}
+
+/**
+  * @brief This function handles EXTI line[15:10] interrupts (PC13 VS1053 DREQ).
+  */
+void EXTI15_10_IRQHandler(void)
+{
+  vs1053_feeder_dreq_irq_handler();
+}
+
+/**
+  * @brief This function handles SDIO global interrupt (DATAEND / data errors).
+  */
+void SDIO_IRQHandler(void)
+{
+  HAL_SD_IRQHandler(&hsd);
+}
+
+/**
+  * @brief This function handles DMA2 channel4 and channel5 global interrupts (SDIO RX/TX).
+  */
+void DMA2_Channel4_5_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_sdio);
+}
+
 /* USER CODE END 1 */
@@ -33,6 +33,7 @@
 /* USER CODE END FirstSection */
 /* Includes ------------------------------------------------------------------*/
 #include "bsp_driver_sd.h"
+#include "sdio_sdcard.h"
 
 /* Extern variables ---------------------------------------------------------*/
 
@@ -40,6 +41,13 @@ extern SD_HandleTypeDef hsd;
 
 /* USER CODE BEGIN BeforeInitSection */
 /* can be used to modify / undefine following code or add code */
+/* DMA传输状态: 启动时置忙, SDIO/DMA2通道4中断里的完成/错误回调改写, 主循环在BSP_SD_WaitTransfer里等 */
+#define SD_XFER_IDLE    0U
+#define SD_XFER_BUSY    1U
+#define SD_XFER_DONE    2U
+#define SD_XFER_ERROR   3U
+
+static volatile uint8_t s_sd_xfer = SD_XFER_IDLE;
 /* USER CODE END BeforeInitSection */
 /**
   * @brief  Initializes the SD card device.
@@ -55,6 +63,12 @@ __weak uint8_t BSP_SD_Init(void)
   }
   /* HAL SD initialization */
   sd_state = HAL_SD_Init(&hsd);
+  /* Configure SD Bus width (4 bits mode selected) */
+  if (sd_state == MSD_OK)
+  {
+    /* 4位总线和时钟分频由测试读选出, 都不稳定时留在1位原配置(sdio_sdcard.c) */
+    sd_bus_tune();
+  }
 
   return sd_state;
 }
@@ -143,8 +157,10 @@ __weak uint8_t BSP_SD_ReadBlocks_DMA(uint32_t *pData, uint32_t ReadAddr, uint32_
   uint8_t sd_state = MSD_OK;
 
   /* Read block(s) in DMA transfer mode */
+  s_sd_xfer = SD_XFER_BUSY;
   if (HAL_SD_ReadBlocks_DMA(&hsd, (uint8_t *)pData, ReadAddr, NumOfBlocks) != HAL_OK)
   {
+    s_sd_xfer = SD_XFER_IDLE;
     sd_state = MSD_ERROR;
   }
 
@@ -166,8 +182,10 @@ __weak uint8_t BSP_SD_WriteBlocks_DMA(uint32_t *pData, uint32_t WriteAddr, uint3
   uint8_t sd_state = MSD_OK;
 
   /* Write block(s) in DMA transfer mode */
+  s_sd_xfer = SD_XFER_BUSY;
   if (HAL_SD_WriteBlocks_DMA(&hsd, (uint8_t *)pData, WriteAddr, NumOfBlocks) != HAL_OK)
   {
+    s_sd_xfer = SD_XFER_IDLE;
     sd_state = MSD_ERROR;
   }
 
@@ -256,31 +274,66 @@ void HAL_SD_RxCpltCallback(SD_HandleTypeDef *hsd)
 /**
   * @brief BSP SD Abort callback
   * @retval None
-  * @note empty (up to the user to fill it in or to remove it if useless)
+  * @note 传输出错时HAL终止DMA后进入这里
   */
-__weak void BSP_SD_AbortCallback(void)
+void BSP_SD_AbortCallback(void)
 {
-
+  s_sd_xfer = SD_XFER_ERROR;
 }
 
 /**
   * @brief BSP Tx Transfer completed callback
   * @retval None
-  * @note empty (up to the user to fill it in or to remove it if useless)
+  * @note 数据已全部发出(DATAEND), 卡内编程可能还没结束
   */
-__weak void BSP_SD_WriteCpltCallback(void)
+void BSP_SD_WriteCpltCallback(void)
 {
-
+  s_sd_xfer = SD_XFER_DONE;
 }
 
 /**
   * @brief BSP Rx Transfer completed callback
   * @retval None
-  * @note empty (up to the user to fill it in or to remove it if useless)
+  * @note DMA已把数据全部搬进缓冲区
   */
-__weak void BSP_SD_ReadCpltCallback(void)
+void BSP_SD_ReadCpltCallback(void)
 {
+  s_sd_xfer = SD_XFER_DONE;
+}
 
+/**
+  * @brief SD error callback (CRC/超时/FIFO上溢下溢/DMA错误)
+  * @param hsd: SD handle
+  * @retval None
+  */
+void HAL_SD_ErrorCallback(SD_HandleTypeDef *hsd)
+{
+  s_sd_xfer = SD_XFER_ERROR;
+}
+
+/**
+  * @brief  等待BSP_SD_ReadBlocks_DMA/BSP_SD_WriteBlocks_DMA启动的传输结束
+  * @note   等待期间中断照常响应(VS1053送数/串口), 只有主循环停在这里;
+  *         超时则终止传输
+  * @param  Timeout: 超时(ms)
+  * @retval SD status
+  */
+uint8_t BSP_SD_WaitTransfer(uint32_t Timeout)
+{
+  uint32_t tickstart = HAL_GetTick();
+
+  while (s_sd_xfer == SD_XFER_BUSY)
+  {
+    if ((HAL_GetTick() - tickstart) >= Timeout)
+    {
+      HAL_SD_Abort(&hsd);
+      hsd.ErrorCode |= HAL_SD_ERROR_TIMEOUT;
+      s_sd_xfer = SD_XFER_ERROR;
+      break;
+    }
+  }
+
+  return (s_sd_xfer == SD_XFER_DONE) ? MSD_OK : MSD_ERROR;
 }
 /* USER CODE END CallBacksSection_C */
 #endif
@@ -303,4 +356,12 @@ __weak uint8_t BSP_SD_IsDetected(void)
 
 /* USER CODE BEGIN AdditionalCode */
 /* user code can be inserted here */
+/**
+  * @brief  传输出错后把SDIO总线降一档(sd_bus_fallback), 调用者可以重试一次
+  * @retval MSD_OK: 已降档; MSD_ERROR: 不是CRC/超时错误或已是最慢档
+  */
+uint8_t BSP_SD_BusFallback(void)
+{
+  return (sd_bus_fallback() == 0) ? MSD_OK : MSD_ERROR;
+}
 /* USER CODE END AdditionalCode */
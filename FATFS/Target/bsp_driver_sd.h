@@ -58,6 +58,8 @@
 /* USER CODE END 0 */
 #else
 /* USER CODE BEGIN BSP_H_CODE */
+#define SD_DMA_TIMEOUT           ((uint32_t)2000)    /* BSP_SD_WaitTransfer超时(ms) */
+
 /* Exported functions --------------------------------------------------------*/
 uint8_t BSP_SD_Init(void);
 uint8_t BSP_SD_ITConfig(void);
@@ -67,6 +69,8 @@ uint8_t BSP_SD_ReadBlocks(uint32_t *pData, uint32_t ReadAddr, uint32_t NumOfBloc
 uint8_t BSP_SD_WriteBlocks(uint32_t *pData, uint32_t WriteAddr, uint32_t NumOfBlocks, uint32_t Timeout);
 uint8_t BSP_SD_ReadBlocks_DMA(uint32_t *pData, uint32_t ReadAddr, uint32_t NumOfBlocks);
 uint8_t BSP_SD_WriteBlocks_DMA(uint32_t *pData, uint32_t WriteAddr, uint32_t NumOfBlocks);
+uint8_t BSP_SD_WaitTransfer(uint32_t Timeout);
+uint8_t BSP_SD_BusFallback(void);
 uint8_t BSP_SD_Erase(uint32_t StartAddr, uint32_t EndAddr);
 void BSP_SD_IRQHandler(void);
 void BSP_SD_DMA_Tx_IRQHandler(void);
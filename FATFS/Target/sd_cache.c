@@ -0,0 +1,237 @@
+#include "sd_cache.h"
+#include <string.h>
+
+#define SD_CACHE_INVALID    0xFFFFFFFFU
+
+/* 缓存行 */
+typedef struct {
+    uint32_t sector;            /* SD_CACHE_INVALID为空行 */
+    uint32_t stamp;             /* 最近一次使用的时刻, 越小越久未用 */
+    bool prefetched;            /* 预读进来后还没被读过 */
+} SdCacheLine_t;
+
+/* 私有变量 */
+static uint8_t s_data[SD_CACHE_LINES][SD_CACHE_SECTOR] __attribute__((aligned(4)));  /* 相邻行地址连续, 预读直接DMA进去 */
+static SdCacheLine_t s_lines[SD_CACHE_LINES];
+static uint32_t s_clock;                    /* 使用计数 */
+static uint32_t s_next = SD_CACHE_INVALID;  /* 上一次读的下一个扇区, 用于判断顺序访问 */
+static uint32_t s_sectors;                  /* 卡的扇区数, 预读不越界 */
+static SdCacheRead_t s_read;
+static SdCacheWrite_t s_write;
+static SdCacheStats_t s_stats;
+
+/* ============================================================================
+ * 缓存行管理
+ * ============================================================================ */
+
+/**
+ * @brief       查找缓存了指定扇区的行
+ * @param       sector: 扇区号
+ * @retval      行号, -1为未缓存
+ */
+static int sd_cache_find(uint32_t sector)
+{
+    int i;
+
+    for (i = 0; i < SD_CACHE_LINES; i++) {
+        if (s_lines[i].sector == sector) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief       选出最久未用的n个相邻行
+ * @note        比较每个窗口里最近使用的那一行, 它越旧整个窗口越适合替换;
+ *              n为1时就是普通的LRU
+ * @param       n: 行数
+ * @retval      窗口第一行
+ */
+static int sd_cache_victim(uint32_t n)
+{
+    uint32_t best_stamp = 0xFFFFFFFFU;
+    int best = 0;
+    int i;
+    uint32_t j, newest;
+
+    for (i = 0; i + (int)n <= SD_CACHE_LINES; i++) {
+        newest = 0;
+        for (j = 0; j < n; j++) {
+            if (s_lines[i + j].sector != SD_CACHE_INVALID && s_lines[i + j].stamp > newest) {
+                newest = s_lines[i + j].stamp;
+            }
+        }
+        if (newest < best_stamp) {
+            best_stamp = newest;
+            best = i;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief       读卡填充相邻几行
+ * @note        同一扇区不会留在两行里: 先清掉窗口内的旧内容和窗口外的重复副本
+ * @param       line: 第一行
+ * @param       sector: 第一个扇区
+ * @param       n: 扇区数
+ * @retval      0: 成功, 其他: 读卡失败(这几行为空)
+ */
+static uint8_t sd_cache_fill(int line, uint32_t sector, uint32_t n)
+{
+    uint32_t j;
+    int i;
+
+    for (i = 0; i < SD_CACHE_LINES; i++) {
+        if ((i >= line && i < line + (int)n) || s_lines[i].sector - sector < n) {
+            s_lines[i].sector = SD_CACHE_INVALID;
+        }
+    }
+
+    s_stats.card_reads++;
+    if (s_read(s_data[line], sector, n) != 0) {
+        return 1;
+    }
+
+    for (j = 0; j < n; j++) {
+        s_lines[line + j].sector = sector + j;
+        s_lines[line + j].stamp = s_clock;
+        s_lines[line + j].prefetched = (j != 0);
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 接口
+ * ============================================================================ */
+
+/**
+ * @brief       设置卡读写函数并清空缓存 (卡初始化/重新挂载后调用)
+ * @param       read: 读卡
+ * @param       write: 写卡
+ * @param       sectors: 卡的扇区数
+ * @retval      无
+ */
+void sd_cache_init(SdCacheRead_t read, SdCacheWrite_t write, uint32_t sectors)
+{
+    s_read = read;
+    s_write = write;
+    s_sectors = sectors;
+    s_next = SD_CACHE_INVALID;
+    sd_cache_invalidate(0, SD_CACHE_INVALID);
+}
+
+/**
+ * @brief       读扇区
+ * @param       buf: 目标缓冲区 (不要求对齐)
+ * @param       sector: 起始扇区
+ * @param       count: 扇区数
+ * @retval      0: 成功, 其他: 读卡失败
+ */
+uint8_t sd_cache_read(uint8_t *buf, uint32_t sector, uint32_t count)
+{
+    bool sequential = (sector == s_next);
+    uint32_t n;
+    int line;
+
+    if (s_read == NULL) {
+        return 1;
+    }
+    s_next = sector + count;
+
+    /* 多扇区读是文件数据, 直接读卡, 不挤掉FAT/目录扇区 */
+    if (count != 1) {
+        s_stats.bypass++;
+        s_stats.card_reads++;
+        return s_read(buf, sector, count);
+    }
+
+    s_clock++;
+    line = sd_cache_find(sector);
+    if (line >= 0) {
+        s_stats.hits++;
+        if (s_lines[line].prefetched) {
+            s_lines[line].prefetched = false;
+            s_stats.prefetch_hits++;
+        }
+    } else {
+        s_stats.misses++;
+        n = 1;
+        if (sequential && SD_CACHE_PREFETCH > 1) {
+            n = (s_sectors - sector < SD_CACHE_PREFETCH) ? s_sectors - sector : SD_CACHE_PREFETCH;
+            if (n > 1) {
+                s_stats.prefetches++;
+            } else {
+                n = 1;
+            }
+        }
+        line = sd_cache_victim(n);
+        if (sd_cache_fill(line, sector, n) != 0) {
+            return 1;
+        }
+    }
+
+    s_lines[line].stamp = s_clock;
+    memcpy(buf, s_data[line], SD_CACHE_SECTOR);
+    return 0;
+}
+
+/**
+ * @brief       写扇区 (写直通)
+ * @note        写卡成功后更新已缓存的副本; 失败时卡上内容不确定, 丢弃副本
+ * @param       buf: 数据
+ * @param       sector: 起始扇区
+ * @param       count: 扇区数
+ * @retval      0: 成功, 其他: 写卡失败
+ */
+uint8_t sd_cache_write(const uint8_t *buf, uint32_t sector, uint32_t count)
+{
+    uint8_t res;
+    int i;
+
+    if (s_write == NULL) {
+        return 1;
+    }
+
+    res = s_write(buf, sector, count);
+    s_stats.writes += count;
+
+    for (i = 0; i < SD_CACHE_LINES; i++) {
+        if (s_lines[i].sector - sector < count) {
+            if (res == 0) {
+                memcpy(s_data[i], buf + (s_lines[i].sector - sector) * SD_CACHE_SECTOR, SD_CACHE_SECTOR);
+            } else {
+                s_lines[i].sector = SD_CACHE_INVALID;
+            }
+        }
+    }
+    return res;
+}
+
+/**
+ * @brief       丢弃指定扇区的缓存 (扇区被绕过缓存改写时调用)
+ * @param       sector: 起始扇区
+ * @param       count: 扇区数
+ * @retval      无
+ */
+void sd_cache_invalidate(uint32_t sector, uint32_t count)
+{
+    int i;
+
+    for (i = 0; i < SD_CACHE_LINES; i++) {
+        if (s_lines[i].sector - sector < count) {
+            s_lines[i].sector = SD_CACHE_INVALID;
+        }
+    }
+}
+
+void sd_cache_get_stats(SdCacheStats_t *stats)
+{
+    *stats = s_stats;
+}
+
+void sd_cache_reset_stats(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+}
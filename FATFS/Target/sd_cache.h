@@ -0,0 +1,59 @@
+#ifndef SD_CACHE_H
+#define SD_CACHE_H
+
+#include "main.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * SD卡扇区缓存 (sd_diskio.c与卡驱动之间)
+ * FatFs的FAT/目录扇区和FIL缓冲区都是单扇区读, 目录扫描会反复读同一批FAT扇区。
+ * 单扇区读先查缓存(SD_CACHE_LINES行, 每行一个扇区, LRU替换); 未命中且紧接上一次
+ * 读的扇区(顺序访问)时, 用一条多块读命令预读SD_CACHE_PREFETCH个扇区, 放进最久未用
+ * 的相邻几行。多扇区读(FatFs直接读进用户缓冲区的文件数据)不经缓存, 直接读卡。
+ * 写直通: 先写卡, 成功后更新已缓存的副本, 不为写分配新行。
+ * 绕过FatFs直接写扇区(录音)的代码要调用sd_cache_invalidate。
+ */
+
+#define SD_CACHE_SECTOR         512
+#ifndef SD_CACHE_LINES
+#define SD_CACHE_LINES          8       /* 缓存行数(每行一个扇区) */
+#endif
+#ifndef SD_CACHE_PREFETCH
+#define SD_CACHE_PREFETCH       4       /* 顺序访问时一次读入的扇区数, 1为不预读 */
+#endif
+
+#if (SD_CACHE_LINES < 2) || (SD_CACHE_PREFETCH < 1) || (SD_CACHE_PREFETCH > SD_CACHE_LINES / 2)
+#error "SD_CACHE_PREFETCH must be 1..SD_CACHE_LINES/2"
+#endif
+
+/* 卡读写函数, 返回0(MSD_OK)为成功 */
+typedef uint8_t (*SdCacheRead_t)(uint8_t *buf, uint32_t sector, uint32_t count);
+typedef uint8_t (*SdCacheWrite_t)(const uint8_t *buf, uint32_t sector, uint32_t count);
+
+/* 缓存统计 */
+typedef struct {
+    uint32_t hits;              /* 单扇区读命中 */
+    uint32_t misses;            /* 单扇区读未命中 */
+    uint32_t prefetches;        /* 预读次数(每次一条多块读命令) */
+    uint32_t prefetch_hits;     /* 命中预读进来的扇区 */
+    uint32_t bypass;            /* 多扇区读直接读卡次数 */
+    uint32_t writes;            /* 写扇区数 */
+    uint32_t card_reads;        /* 读卡命令数(未命中 + 预读 + 直接读) */
+} SdCacheStats_t;
+
+void sd_cache_init(SdCacheRead_t read, SdCacheWrite_t write, uint32_t sectors);  /* 卡初始化后调用, 清空缓存 */
+uint8_t sd_cache_read(uint8_t *buf, uint32_t sector, uint32_t count);
+uint8_t sd_cache_write(const uint8_t *buf, uint32_t sector, uint32_t count);
+void sd_cache_invalidate(uint32_t sector, uint32_t count);  /* 扇区被绕过缓存改写 */
+void sd_cache_get_stats(SdCacheStats_t *stats);
+void sd_cache_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SD_CACHE_H
@@ -47,14 +47,33 @@
 /* Includes ------------------------------------------------------------------*/
 #include <string.h>
 #include "ff_gen_drv.h"
+#include "sd_cache.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+/* Time allowed for the card to leave the programming state (ms) */
+#define SD_READY_TIMEOUT   SD_DMA_TIMEOUT
+
 /* Private variables ---------------------------------------------------------*/
 /* Disk status */
 static volatile DSTATUS Stat = STA_NOINIT;
 
+/* SDIO DMA moves whole words: buffers that are not 4-byte aligned go through
+   this sector-sized scratch buffer */
+static uint32_t scratch[BLOCKSIZE / 4];
+
 /* Private function prototypes -----------------------------------------------*/
+static DRESULT SD_WaitReady(void);
+static DRESULT SD_ReadBlocks(BYTE *buff, DWORD sector, UINT count);
+#if _USE_WRITE == 1
+static DRESULT SD_WriteBlocks(const BYTE *buff, DWORD sector, UINT count);
+#endif /* _USE_WRITE == 1 */
+static uint8_t SD_CardRead(uint8_t *buff, uint32_t sector, uint32_t count);
+#if _USE_WRITE == 1
+static uint8_t SD_CardWrite(const uint8_t *buff, uint32_t sector, uint32_t count);
+#else
+#define SD_CardWrite  NULL
+#endif /* _USE_WRITE == 1 */
 DSTATUS SD_initialize (BYTE);
 DSTATUS SD_status (BYTE);
 DRESULT SD_read (BYTE, BYTE*, DWORD, UINT);
@@ -81,6 +100,25 @@ const Diskio_drvTypeDef  SD_Driver =
 
 /* Private functions ---------------------------------------------------------*/
 
+/**
+  * @brief  Waits until the card is back in the transfer state
+  * @retval DRESULT: RES_OK, or RES_ERROR on timeout
+  */
+static DRESULT SD_WaitReady(void)
+{
+  uint32_t tickstart = HAL_GetTick();
+
+  while(BSP_SD_GetCardState() != MSD_OK)
+  {
+    if ((HAL_GetTick() - tickstart) >= SD_READY_TIMEOUT)
+    {
+      return RES_ERROR;
+    }
+  }
+
+  return RES_OK;
+}
+
 /**
   * @brief  Initializes a Drive
   * @param  lun : not used 
@@ -88,11 +126,16 @@ const Diskio_drvTypeDef  SD_Driver =
   */
 DSTATUS SD_initialize(BYTE lun)
 {
+  BSP_SD_CardInfo CardInfo;
+
   Stat = STA_NOINIT;
   
   /* Configure the uSD device */
   if(BSP_SD_Init() == MSD_OK)
   {
+    /* New card (or re-mount): start with an empty sector cache */
+    BSP_SD_GetCardInfo(&CardInfo);
+    sd_cache_init(SD_CardRead, SD_CardWrite, CardInfo.LogBlockNbr);
     Stat &= ~STA_NOINIT;
   }
 
@@ -116,6 +159,63 @@ DSTATUS SD_status(BYTE lun)
   return Stat;
 }
 
+/**
+  * @brief  Reads sectors by DMA, through the scratch buffer if unaligned
+  * @param  *buff: Data buffer to store read data
+  * @param  sector: Sector address (LBA)
+  * @param  count: Number of sectors to read
+  * @retval DRESULT: Operation result
+  */
+static DRESULT SD_ReadBlocks(BYTE *buff, DWORD sector, UINT count)
+{
+  UINT i;
+
+  if (((uint32_t)buff & 3U) == 0U)
+  {
+    /* DMA straight into the caller's buffer, interrupts stay enabled */
+    if ((BSP_SD_ReadBlocks_DMA((uint32_t*)buff, (uint32_t)sector, count) != MSD_OK) ||
+        (BSP_SD_WaitTransfer(SD_DMA_TIMEOUT) != MSD_OK))
+    {
+      return RES_ERROR;
+    }
+    return SD_WaitReady();
+  }
+
+  /* Unaligned buffer: one sector at a time through the scratch buffer */
+  for (i = 0; i < count; i++)
+  {
+    if ((BSP_SD_ReadBlocks_DMA(scratch, (uint32_t)(sector + i), 1) != MSD_OK) ||
+        (BSP_SD_WaitTransfer(SD_DMA_TIMEOUT) != MSD_OK) ||
+        (SD_WaitReady() != RES_OK))
+    {
+      return RES_ERROR;
+    }
+    memcpy(buff + i * BLOCKSIZE, scratch, BLOCKSIZE);
+  }
+
+  return RES_OK;
+}
+
+/**
+  * @brief  Reads sectors from the card for the sector cache
+  * @param  *buff: Data buffer to store read data
+  * @param  sector: Sector address (LBA)
+  * @param  count: Number of sectors to read
+  * @retval MSD_OK or MSD_ERROR
+  */
+static uint8_t SD_CardRead(uint8_t *buff, uint32_t sector, uint32_t count)
+{
+  DRESULT res = SD_ReadBlocks(buff, sector, count);
+
+  /* CRC/timeout errors: step the bus down one level and retry once */
+  if ((res != RES_OK) && (BSP_SD_BusFallback() == MSD_OK))
+  {
+    res = SD_ReadBlocks(buff, sector, count);
+  }
+
+  return (res == RES_OK) ? MSD_OK : MSD_ERROR;
+}
+
 /**
   * @brief  Reads Sector(s)
   * @param  lun : not used
@@ -126,24 +226,66 @@ DSTATUS SD_status(BYTE lun)
   */
 DRESULT SD_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
 {
-  DRESULT res = RES_ERROR;
-  uint32_t timeout = 100000;
+  /* Single sectors are served from the cache, multi-sector reads go to the card */
+  return (sd_cache_read(buff, sector, count) == MSD_OK) ? RES_OK : RES_ERROR;
+}
+
+#if _USE_WRITE == 1
+/**
+  * @brief  Writes sectors by DMA, through the scratch buffer if unaligned
+  * @param  *buff: Data to be written
+  * @param  sector: Sector address (LBA)
+  * @param  count: Number of sectors to write
+  * @retval DRESULT: Operation result
+  */
+static DRESULT SD_WriteBlocks(const BYTE *buff, DWORD sector, UINT count)
+{
+  UINT i;
 
-  if(BSP_SD_ReadBlocks((uint32_t*)buff, 
-                       (uint32_t) (sector), 
-                       count, SD_DATATIMEOUT) == MSD_OK)
+  if (((uint32_t)buff & 3U) == 0U)
   {
-    while(BSP_SD_GetCardState()!= MSD_OK)
+    /* DMA straight from the caller's buffer, then wait for card programming */
+    if ((BSP_SD_WriteBlocks_DMA((uint32_t*)buff, (uint32_t)sector, count) != MSD_OK) ||
+        (BSP_SD_WaitTransfer(SD_DMA_TIMEOUT) != MSD_OK))
     {
-      if (timeout-- == 0)
-      {
-        return RES_ERROR;
-      }
+      return RES_ERROR;
     }
-    res = RES_OK;
+    return SD_WaitReady();
   }
-  
-  return res;
+
+  /* Unaligned buffer: one sector at a time through the scratch buffer */
+  for (i = 0; i < count; i++)
+  {
+    memcpy(scratch, buff + i * BLOCKSIZE, BLOCKSIZE);
+    if ((BSP_SD_WriteBlocks_DMA(scratch, (uint32_t)(sector + i), 1) != MSD_OK) ||
+        (BSP_SD_WaitTransfer(SD_DMA_TIMEOUT) != MSD_OK) ||
+        (SD_WaitReady() != RES_OK))
+    {
+      return RES_ERROR;
+    }
+  }
+
+  return RES_OK;
+}
+
+/**
+  * @brief  Writes sectors to the card for the sector cache
+  * @param  *buff: Data to be written
+  * @param  sector: Sector address (LBA)
+  * @param  count: Number of sectors to write
+  * @retval MSD_OK or MSD_ERROR
+  */
+static uint8_t SD_CardWrite(const uint8_t *buff, uint32_t sector, uint32_t count)
+{
+  DRESULT res = SD_WriteBlocks(buff, sector, count);
+
+  /* CRC/timeout errors: step the bus down one level and retry once */
+  if ((res != RES_OK) && (BSP_SD_BusFallback() == MSD_OK))
+  {
+    res = SD_WriteBlocks(buff, sector, count);
+  }
+
+  return (res == RES_OK) ? MSD_OK : MSD_ERROR;
 }
 
 /**
@@ -154,27 +296,10 @@ DRESULT SD_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
   * @param  count: Number of sectors to write (1..128)
   * @retval DRESULT: Operation result
   */
-#if _USE_WRITE == 1
 DRESULT SD_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
 {
-  DRESULT res = RES_ERROR;
-  uint32_t timeout = 100000;
-
-  if(BSP_SD_WriteBlocks((uint32_t*)buff, 
-                        (uint32_t)(sector), 
-                        count, SD_DATATIMEOUT) == MSD_OK)
-  {
-    while(BSP_SD_GetCardState()!= MSD_OK)
-    {
-      if (timeout-- == 0)
-      {
-        return RES_ERROR;
-      }
-    }    
-    res = RES_OK;
-  }
-  
-  return res;
+  /* Write-through: the card first, then any cached copies */
+  return (sd_cache_write(buff, sector, count) == MSD_OK) ? RES_OK : RES_ERROR;
 }
 #endif /* _USE_WRITE == 1 */
 
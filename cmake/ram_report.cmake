@@ -0,0 +1,90 @@
+# RAM usage report from the linker map file, run after every link:
+#   cmake -DMAP=<music.map> -DOUT=<music_ram.txt> [-DTOP=20] -P ram_report.cmake
+#
+# Every .data/.bss input section (one per variable with -fdata-sections) is
+# attributed to its object file. The report lists the totals per source file and
+# the largest variables, so RAM regressions show up in the build log rather than
+# as a stack overflow on the board. Linker totals come from --print-memory-usage.
+
+if(NOT DEFINED TOP)
+    set(TOP 20)
+endif()
+
+if(NOT EXISTS "${MAP}")
+    message(STATUS "RAM report: ${MAP} not found, skipped")
+    return()
+endif()
+
+file(READ "${MAP}" map)
+
+# Skip the discarded input sections listed before the memory map
+string(FIND "${map}" "Linker script and memory map" start)
+if(start GREATER -1)
+    string(SUBSTRING "${map}" ${start} -1 map)
+endif()
+
+# " .bss.name  0xADDR  0xSIZE file", long section names wrap onto the next line
+string(REGEX MATCHALL "\n (\\.bss|\\.data|COMMON)[^ \n]*[ \n]+0x[0-9a-fA-F]+[ ]+0x[0-9a-fA-F]+ [^\n]+" entries "${map}")
+
+set(total 0)
+set(files "")
+set(vars "")
+foreach(entry IN LISTS entries)
+    string(REGEX REPLACE "\n ([^ \n]+)[ \n]+0x[0-9a-fA-F]+[ ]+(0x[0-9a-fA-F]+) ([^\n]+)" "\\1;\\2;\\3" fields "${entry}")
+    list(GET fields 0 section)
+    list(GET fields 1 size)
+    list(GET fields 2 object)
+    math(EXPR size "${size}")
+    if(size EQUAL 0)
+        continue()
+    endif()
+
+    # CMakeFiles/music.dir/BSP/audio/audio_player.c.obj -> BSP/audio/audio_player.c
+    string(STRIP "${object}" object)
+    string(REGEX REPLACE "^.*CMakeFiles/[^/]+\\.dir/" "" object "${object}")
+    string(REGEX REPLACE "\\.(obj|o)$" "" object "${object}")
+    string(REGEX REPLACE "^\\.(bss|data)\\." "" name "${section}")
+
+    math(EXPR total "${total} + ${size}")
+    string(MAKE_C_IDENTIFIER "${object}" key)
+    if(NOT DEFINED file_${key})
+        set(file_${key} 0)
+        list(APPEND files "${object}")
+    endif()
+    math(EXPR file_${key} "${file_${key}} + ${size}")
+
+    # Right-aligned sizes sort numerically as strings
+    string(LENGTH "${size}" len)
+    math(EXPR pad "8 - ${len}")
+    string(REPEAT " " ${pad} spaces)
+    list(APPEND vars "${spaces}${size}  ${name} (${object})")
+endforeach()
+
+set(report "RAM used by variables (.data + .bss): ${total} bytes\n\nPer source file:\n")
+set(rows "")
+foreach(object IN LISTS files)
+    string(MAKE_C_IDENTIFIER "${object}" key)
+    string(LENGTH "${file_${key}}" len)
+    math(EXPR pad "8 - ${len}")
+    string(REPEAT " " ${pad} spaces)
+    list(APPEND rows "${spaces}${file_${key}}  ${object}")
+endforeach()
+list(SORT rows ORDER DESCENDING)
+foreach(row IN LISTS rows)
+    string(APPEND report "${row}\n")
+endforeach()
+
+string(APPEND report "\nLargest ${TOP} variables:\n")
+list(SORT vars ORDER DESCENDING)
+list(LENGTH vars count)
+if(count GREATER TOP)
+    list(SUBLIST vars 0 ${TOP} vars)
+endif()
+foreach(row IN LISTS vars)
+    string(APPEND report "${row}\n")
+endforeach()
+
+if(DEFINED OUT)
+    file(WRITE "${OUT}" "${report}")
+endif()
+message("${report}")
@@ -0,0 +1,33 @@
+#ifndef __CORE_CM3_H_GENERIC
+#define __CORE_CM3_H_GENERIC
+
+/*
+ * 主机仿真用的core_cm3.h
+ * CMSIS-DSP的arm_math.h在ARM_MATH_CM3下包含本文件, 这里只提供DSP库用到的
+ * 饱和指令, 其余内核部分(DWT/NVIC/__CLZ)见main.h。
+ */
+
+#include "main.h"
+
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE     static inline
+#endif
+
+/* 有符号饱和到bits位 */
+static inline int32_t __SSAT(int32_t val, uint32_t bits)
+{
+    const int32_t max = (int32_t)((1U << (bits - 1U)) - 1U);
+    const int32_t min = -1 - max;
+
+    return (val > max) ? max : (val < min) ? min : val;
+}
+
+/* 无符号饱和到bits位 */
+static inline uint32_t __USAT(int32_t val, uint32_t bits)
+{
+    const uint32_t max = (1U << bits) - 1U;
+
+    return (val < 0) ? 0U : ((uint32_t)val > max) ? max : (uint32_t)val;
+}
+
+#endif /* __CORE_CM3_H_GENERIC */
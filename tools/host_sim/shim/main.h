@@ -0,0 +1,250 @@
+#ifndef __MAIN_H
+#define __MAIN_H
+
+/*
+ * 主机仿真用的main.h
+ * 代替Core/Inc/main.h和STM32 HAL, 只给出BSP/audio用到的类型、宏和函数,
+ * 函数由sim_hal.c按虚拟时间实现。板上代码不做任何修改即可在Linux上编译。
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "sim_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * 通用
+ * ============================================================================ */
+
+typedef enum {
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum {
+    RESET = 0U,
+    SET = !RESET
+} FlagStatus, ITStatus;
+
+#define HAL_MAX_DELAY       0xFFFFFFFFU
+#define __IO                volatile
+#define __weak              __attribute__((weak))
+
+#define MODIFY_REG(REG, CLEARMASK, SETMASK)  ((REG) = (((REG) & (~(CLEARMASK))) | (SETMASK)))
+
+extern uint32_t SystemCoreClock;
+
+void Error_Handler(void);
+void HAL_Delay(uint32_t Delay);
+uint32_t HAL_GetTick(void);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+
+/* ============================================================================
+ * 内核 (NVIC/DWT/指令)
+ * ============================================================================ */
+
+typedef enum {
+    DMA1_Channel3_IRQn = 13,
+    USART1_IRQn = 37,
+    EXTI15_10_IRQn = 40
+} IRQn_Type;
+
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+
+extern DWT_Type sim_dwt;
+#define DWT                 (&sim_dwt)
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_SetPendingIRQ(IRQn_Type IRQn);
+
+void __disable_irq(void);
+void __enable_irq(void);
+#define __DMB()             __sync_synchronize()
+#define __NOP()             sim_idle()          /* 等待循环中的一次空转, 让虚拟时间前进 */
+#define __CLZ(x)            ((uint8_t)__builtin_clz(x))
+
+/* ============================================================================
+ * GPIO / EXTI
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t id;
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef sim_gpio[7];
+#define GPIOA               (&sim_gpio[0])
+#define GPIOB               (&sim_gpio[1])
+#define GPIOC               (&sim_gpio[2])
+#define GPIOD               (&sim_gpio[3])
+#define GPIOE               (&sim_gpio[4])
+#define GPIOF               (&sim_gpio[5])
+#define GPIOG               (&sim_gpio[6])
+
+typedef enum {
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+#define GPIO_PIN_0          ((uint16_t)0x0001)
+#define GPIO_PIN_1          ((uint16_t)0x0002)
+#define GPIO_PIN_2          ((uint16_t)0x0004)
+#define GPIO_PIN_3          ((uint16_t)0x0008)
+#define GPIO_PIN_4          ((uint16_t)0x0010)
+#define GPIO_PIN_5          ((uint16_t)0x0020)
+#define GPIO_PIN_6          ((uint16_t)0x0040)
+#define GPIO_PIN_7          ((uint16_t)0x0080)
+#define GPIO_PIN_8          ((uint16_t)0x0100)
+#define GPIO_PIN_9          ((uint16_t)0x0200)
+#define GPIO_PIN_10         ((uint16_t)0x0400)
+#define GPIO_PIN_11         ((uint16_t)0x0800)
+#define GPIO_PIN_12         ((uint16_t)0x1000)
+#define GPIO_PIN_13         ((uint16_t)0x2000)
+#define GPIO_PIN_14         ((uint16_t)0x4000)
+#define GPIO_PIN_15         ((uint16_t)0x8000)
+
+#define GPIO_MODE_INPUT         0x00000000U
+#define GPIO_MODE_OUTPUT_PP     0x00000001U
+#define GPIO_MODE_AF_PP         0x00000002U
+#define GPIO_MODE_IT_RISING     0x10110000U
+#define GPIO_MODE_IT_FALLING    0x10210000U
+#define GPIO_NOPULL             0x00000000U
+#define GPIO_PULLUP             0x00000001U
+#define GPIO_PULLDOWN           0x00000002U
+#define GPIO_SPEED_FREQ_LOW     0x00000002U
+#define GPIO_SPEED_FREQ_HIGH    0x00000003U
+
+typedef struct {
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+} GPIO_InitTypeDef;
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+extern volatile uint32_t sim_exti_pr;
+#define __HAL_GPIO_EXTI_GET_IT(__EXTI_LINE__)   (sim_exti_pr & (__EXTI_LINE__))
+#define __HAL_GPIO_EXTI_CLEAR_IT(__EXTI_LINE__) (sim_exti_pr &= ~(uint32_t)(__EXTI_LINE__))
+
+/* 板上引脚 (与Core/Inc/main.h一致) */
+#define VS_DREQ_Pin         GPIO_PIN_13
+#define VS_DREQ_GPIO_Port   GPIOC
+
+/* ============================================================================
+ * DMA
+ * ============================================================================ */
+
+typedef struct {
+    volatile uint32_t CCR;
+} DMA_Channel_TypeDef;
+
+extern DMA_Channel_TypeDef sim_dma1_ch3;
+#define DMA1_Channel3       (&sim_dma1_ch3)
+
+#define DMA_MEMORY_TO_PERIPH    0x00000010U
+#define DMA_PINC_DISABLE        0x00000000U
+#define DMA_MINC_ENABLE         0x00000080U
+#define DMA_PDATAALIGN_BYTE     0x00000000U
+#define DMA_MDATAALIGN_BYTE     0x00000000U
+#define DMA_NORMAL              0x00000000U
+#define DMA_PRIORITY_HIGH       0x00002000U
+#define DMA_IT_TC               0x00000002U
+#define DMA_IT_HT               0x00000004U
+#define DMA_IT_TE               0x00000008U
+
+typedef struct {
+    uint32_t Direction;
+    uint32_t PeriphInc;
+    uint32_t MemInc;
+    uint32_t PeriphDataAlignment;
+    uint32_t MemDataAlignment;
+    uint32_t Mode;
+    uint32_t Priority;
+} DMA_InitTypeDef;
+
+typedef struct __DMA_HandleTypeDef {
+    DMA_Channel_TypeDef *Instance;
+    DMA_InitTypeDef Init;
+    void *Parent;
+} DMA_HandleTypeDef;
+
+#define __HAL_RCC_DMA1_CLK_ENABLE()             ((void)0)
+#define __HAL_DMA_DISABLE_IT(__HANDLE__, __IT__) ((__HANDLE__)->Instance->CCR &= ~(__IT__))
+#define __HAL_LINKDMA(__HANDLE__, __PPP_DMA_FIELD__, __DMA_HANDLE__) \
+    do {                                                            \
+        (__HANDLE__)->__PPP_DMA_FIELD__ = &(__DMA_HANDLE__);        \
+        (__DMA_HANDLE__).Parent = (__HANDLE__);                     \
+    } while (0U)
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma);
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma);
+
+/* ============================================================================
+ * SPI
+ * ============================================================================ */
+
+typedef struct {
+    volatile uint32_t CR1;
+    volatile uint32_t CR2;
+    volatile uint32_t SR;
+    volatile uint32_t DR;
+} SPI_TypeDef;
+
+extern SPI_TypeDef sim_spi1;
+#define SPI1                (&sim_spi1)
+
+#define SPI_CR1_BR_Pos      3U
+#define SPI_CR1_BR          (0x7UL << SPI_CR1_BR_Pos)
+
+#define SPI_BAUDRATEPRESCALER_2     0x00000000U
+#define SPI_BAUDRATEPRESCALER_4     0x00000008U
+#define SPI_BAUDRATEPRESCALER_8     0x00000010U
+#define SPI_BAUDRATEPRESCALER_16    0x00000018U
+#define SPI_BAUDRATEPRESCALER_32    0x00000020U
+#define SPI_BAUDRATEPRESCALER_64    0x00000028U
+#define SPI_BAUDRATEPRESCALER_128   0x00000030U
+#define SPI_BAUDRATEPRESCALER_256   0x00000038U
+
+typedef struct {
+    uint32_t BaudRatePrescaler;
+} SPI_InitTypeDef;
+
+typedef enum {
+    HAL_SPI_STATE_RESET = 0x00U,
+    HAL_SPI_STATE_READY = 0x01U,
+    HAL_SPI_STATE_BUSY_TX = 0x03U
+} HAL_SPI_StateTypeDef;
+
+typedef struct __SPI_HandleTypeDef {
+    SPI_TypeDef *Instance;
+    SPI_InitTypeDef Init;
+    DMA_HandleTypeDef *hdmatx;
+    volatile HAL_SPI_StateTypeDef State;
+} SPI_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *hspi);
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData,
+                                          uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, const uint8_t *pData, uint16_t Size);
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MAIN_H */
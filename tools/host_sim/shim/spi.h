@@ -0,0 +1,18 @@
+#ifndef __SPI_H__
+#define __SPI_H__
+
+/* 主机仿真用的spi.h: hspi1由sim_hal.c定义 */
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern SPI_HandleTypeDef hspi1;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SPI_H__ */
@@ -0,0 +1,33 @@
+#ifndef __STM32F1xx_HAL_H
+#define __STM32F1xx_HAL_H
+
+/*
+ * 主机仿真用的stm32f1xx_hal.h
+ * FATFS/Target下的ffconf.h和bsp_driver_sd.h包含它, 这里只补充SD卡信息类型,
+ * 其余HAL定义都在shim/main.h。BSP_SD_xxx由sim_sdcard.c实现。
+ */
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLOCKSIZE   512U        /* stm32f1xx_ll_sdmmc.h */
+
+typedef struct {
+    uint32_t CardType;
+    uint32_t CardVersion;
+    uint32_t Class;
+    uint32_t RelCardAdd;
+    uint32_t BlockNbr;          /* 物理块数 */
+    uint32_t BlockSize;         /* 物理块大小 */
+    uint32_t LogBlockNbr;       /* 逻辑块数 */
+    uint32_t LogBlockSize;      /* 逻辑块大小 */
+} HAL_SD_CardInfoTypeDef;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F1xx_HAL_H */
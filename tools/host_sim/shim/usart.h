@@ -0,0 +1,44 @@
+#ifndef __USART_H__
+#define __USART_H__
+
+/*
+ * 主机仿真用的usart.h
+ * 遥测报告经HAL_UART_Transmit_IT逐行发送, 仿真中直接写到标准输出;
+ * 不模拟接收, 串口命令由仿真程序直接调用对应函数代替。
+ */
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    volatile uint32_t SR;
+    volatile uint32_t DR;
+} USART_TypeDef;
+
+typedef enum {
+    HAL_UART_STATE_RESET = 0x00U,
+    HAL_UART_STATE_READY = 0x20U,
+    HAL_UART_STATE_BUSY_TX = 0x21U
+} HAL_UART_StateTypeDef;
+
+typedef struct {
+    USART_TypeDef *Instance;
+    volatile HAL_UART_StateTypeDef gState;
+} UART_HandleTypeDef;
+
+#define UART_FLAG_RXNE      0x00000020U
+#define __HAL_UART_GET_FLAG(__HANDLE__, __FLAG__) \
+    ((((__HANDLE__)->Instance->SR) & (__FLAG__)) == (__FLAG__))
+
+extern UART_HandleTypeDef huart1;
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USART_H__ */
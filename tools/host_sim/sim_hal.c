@@ -0,0 +1,467 @@
+#include "main.h"
+#include "spi.h"
+#include "usart.h"
+#include "sim_hal.h"
+#include "sim_vs1053.h"
+#include "vs1053_feeder.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* 中断编号 -> 挂起位 */
+#define SIM_IRQ_DMA             0x01U   /* DMA1_Channel3_IRQn */
+#define SIM_IRQ_EXTI            0x02U   /* EXTI15_10_IRQn */
+
+/* 外设寄存器和句柄 */
+uint32_t SystemCoreClock = SIM_CPU_HZ;
+DWT_Type sim_dwt;
+GPIO_TypeDef sim_gpio[7];
+SPI_TypeDef sim_spi1;
+DMA_Channel_TypeDef sim_dma1_ch3;
+volatile uint32_t sim_exti_pr;
+SPI_HandleTypeDef hspi1;
+USART_TypeDef sim_usart1;
+UART_HandleTypeDef huart1;
+
+/* DMA突发 */
+typedef struct {
+    bool active;
+    uint64_t done;              /* 最后一个字节移出的时刻 */
+    const uint8_t *buf;
+    uint16_t len;
+    uint32_t spi_hz;
+} SimDma_t;
+
+/* 私有变量 */
+static uint64_t s_now;
+static uint64_t s_deadline;
+static uint16_t s_odr[7];               /* 各端口输出电平 */
+static uint16_t s_exti_rising;          /* GPIOC上配置为上升沿中断的引脚 */
+static bool s_primask;
+static bool s_in_isr;
+static uint32_t s_pending;
+static uint32_t s_enabled;
+static bool s_dreq_last;
+static SimDma_t s_dma;
+static SimHalStats_t s_stats;
+
+/* ============================================================================
+ * 虚拟时间和中断
+ * ============================================================================ */
+
+static uint32_t sim_irq_bit(IRQn_Type irq)
+{
+    switch (irq) {
+        case DMA1_Channel3_IRQn:
+            return SIM_IRQ_DMA;
+        case EXTI15_10_IRQn:
+            return SIM_IRQ_EXTI;
+        default:
+            return 0;           /* 其他中断不建模 */
+    }
+}
+
+static uint32_t sim_port_index(GPIO_TypeDef *port)
+{
+    return (uint32_t)(port - sim_gpio);
+}
+
+/**
+ * @brief       采样DREQ, 上升沿时置EXTI挂起位
+ * @note        每次模型状态可能变化之后调用, 否则一次先低后高会被漏掉
+ * @param       无
+ * @retval      无
+ */
+static void sim_dreq_sample(void)
+{
+    bool dreq = sim_vs1053_dreq();
+
+    if (dreq && !s_dreq_last) {
+        s_stats.dreq_edges++;
+        if (s_exti_rising & VS_DREQ_Pin) {
+            sim_exti_pr |= VS_DREQ_Pin;
+            s_pending |= SIM_IRQ_EXTI;
+        }
+    }
+    s_dreq_last = dreq;
+}
+
+/**
+ * @brief       把控制脚电平告诉芯片模型
+ * @param       无
+ * @retval      无
+ */
+static void sim_update_pins(void)
+{
+    bool xcs = (s_odr[sim_port_index(GPIOF)] & GPIO_PIN_7) != 0;
+    bool xdcs = (s_odr[sim_port_index(GPIOF)] & GPIO_PIN_6) != 0;
+    bool rst = (s_odr[sim_port_index(GPIOE)] & GPIO_PIN_6) != 0;
+
+    sim_vs1053_pins(xcs, xdcs, rst);
+    sim_dreq_sample();
+}
+
+/**
+ * @brief       时间走到t, 处理到期的DMA和DREQ变化
+ * @param       t: 时刻
+ * @retval      无
+ */
+static void sim_set_time(uint64_t t)
+{
+    s_now = t;
+    sim_dwt.CYCCNT = (uint32_t)t;
+    sim_vs1053_run(t);
+
+    if (s_dma.active && s_now >= s_dma.done) {
+        s_dma.active = false;
+        sim_vs1053_sdi_block(s_dma.buf, s_dma.len, s_dma.spi_hz);
+        if (sim_dma1_ch3.CCR & DMA_IT_TC) {
+            s_pending |= SIM_IRQ_DMA;
+        }
+    }
+
+    sim_dreq_sample();
+}
+
+/**
+ * @brief       执行一个挂起的中断 (编号小的先执行, 同优先级不嵌套)
+ * @param       无
+ * @retval      true: 执行了
+ */
+static bool sim_dispatch(void)
+{
+    uint32_t ready = s_pending & s_enabled;
+    uint64_t t0 = s_now;
+
+    if (s_in_isr || s_primask || ready == 0) {
+        return false;
+    }
+
+    s_in_isr = true;
+    sim_advance(SIM_CYC_ISR_ENTRY);
+    if (ready & SIM_IRQ_DMA) {
+        s_pending &= ~SIM_IRQ_DMA;
+        s_stats.dma_irqs++;
+        vs1053_feeder_dma_irq_handler();
+    } else {
+        s_pending &= ~SIM_IRQ_EXTI;
+        s_stats.exti_irqs++;
+        vs1053_feeder_dreq_irq_handler();
+    }
+    sim_advance(SIM_CYC_ISR_ENTRY);
+    s_in_isr = false;
+
+    s_stats.isr_cycles += s_now - t0;
+    return true;
+}
+
+/**
+ * @brief       推进虚拟时间
+ * @note        主循环上下文中被中断打断的时间顺延; 中断上下文中只处理事件
+ * @param       cycles: CPU周期
+ * @retval      无
+ */
+void sim_advance(uint64_t cycles)
+{
+    uint64_t target = s_now + cycles;
+    uint64_t step;
+    uint64_t ev;
+    uint64_t t0;
+
+    for (;;) {
+        t0 = s_now;
+        if (sim_dispatch()) {
+            target += s_now - t0;
+            continue;
+        }
+        if (s_now >= target) {
+            break;
+        }
+
+        step = target;
+        if (s_dma.active && s_dma.done < step) {
+            step = s_dma.done;
+        }
+        ev = sim_vs1053_next_event();
+        if (ev > s_now && ev < step) {
+            step = ev;
+        }
+        sim_set_time(step);
+    }
+
+    if (s_deadline != 0 && s_now > s_deadline) {
+        fprintf(stderr, "sim: virtual time limit %.1f s reached, driver stuck?\n",
+                (double)s_deadline / SIM_CPU_HZ);
+        exit(3);
+    }
+}
+
+void sim_idle(void)
+{
+    sim_advance(SIM_CYC_IDLE);
+}
+
+uint64_t sim_now(void)
+{
+    return s_now;
+}
+
+bool sim_in_isr(void)
+{
+    return s_in_isr;
+}
+
+void sim_set_deadline(uint64_t cycles)
+{
+    s_deadline = cycles;
+}
+
+/**
+ * @brief       回到上电状态
+ * @param       无
+ * @retval      无
+ */
+void sim_hal_init(void)
+{
+    s_now = 0;
+    s_deadline = 0;
+    memset(s_odr, 0, sizeof(s_odr));
+    s_exti_rising = 0;
+    s_primask = false;
+    s_in_isr = false;
+    s_pending = 0;
+    s_enabled = 0;
+    memset(&s_dma, 0, sizeof(s_dma));
+    memset(&s_stats, 0, sizeof(s_stats));
+    memset(&sim_dwt, 0, sizeof(sim_dwt));
+    memset(&sim_usart1, 0, sizeof(sim_usart1));
+    huart1.Instance = &sim_usart1;
+    huart1.gState = HAL_UART_STATE_READY;
+    memset(&sim_spi1, 0, sizeof(sim_spi1));
+    memset(&sim_dma1_ch3, 0, sizeof(sim_dma1_ch3));
+    sim_exti_pr = 0;
+
+    /* 与MX_SPI1_Init相同: 4分频(18MHz) */
+    memset(&hspi1, 0, sizeof(hspi1));
+    hspi1.Instance = SPI1;
+    hspi1.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_4;
+    HAL_SPI_Init(&hspi1);
+
+    sim_vs1053_init();
+    s_dreq_last = false;
+    sim_update_pins();
+}
+
+void sim_hal_get_stats(SimHalStats_t *stats)
+{
+    *stats = s_stats;
+}
+
+void sim_hal_reset_stats(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+/* ============================================================================
+ * 内核
+ * ============================================================================ */
+
+void Error_Handler(void)
+{
+    fprintf(stderr, "sim: Error_Handler\n");
+    exit(1);
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+    sim_advance((uint64_t)Delay * (SIM_CPU_HZ / 1000U));
+}
+
+uint32_t HAL_GetTick(void)
+{
+    return (uint32_t)(s_now / (SIM_CPU_HZ / 1000U));
+}
+
+uint32_t HAL_RCC_GetPCLK2Freq(void)
+{
+    return SIM_CPU_HZ;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+    (void)IRQn;
+    (void)PreemptPriority;
+    (void)SubPriority;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    s_enabled |= sim_irq_bit(IRQn);
+    sim_advance(SIM_CYC_NVIC);
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    s_enabled &= ~sim_irq_bit(IRQn);
+    sim_advance(SIM_CYC_NVIC);
+}
+
+void HAL_NVIC_SetPendingIRQ(IRQn_Type IRQn)
+{
+    s_pending |= sim_irq_bit(IRQn);
+    sim_advance(SIM_CYC_NVIC);
+}
+
+void __disable_irq(void)
+{
+    s_primask = true;
+}
+
+void __enable_irq(void)
+{
+    s_primask = false;
+    sim_advance(0);     /* 关中断期间挂起的中断立即执行 */
+}
+
+/* ============================================================================
+ * GPIO
+ * ============================================================================ */
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+    if (GPIOx == GPIOC && GPIO_Init->Mode == GPIO_MODE_IT_RISING) {
+        s_exti_rising |= (uint16_t)GPIO_Init->Pin;
+    }
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    uint32_t port = sim_port_index(GPIOx);
+
+    sim_advance(SIM_CYC_GPIO);
+    if (PinState == GPIO_PIN_SET) {
+        s_odr[port] |= GPIO_Pin;
+    } else {
+        s_odr[port] &= ~GPIO_Pin;
+    }
+
+    if (GPIOx == GPIOF || GPIOx == GPIOE) {
+        sim_update_pins();
+    }
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+    sim_advance(SIM_CYC_GPIO);
+    if (GPIOx == VS_DREQ_GPIO_Port && GPIO_Pin == VS_DREQ_Pin) {
+        return sim_vs1053_dreq() ? GPIO_PIN_SET : GPIO_PIN_RESET;
+    }
+    return (s_odr[sim_port_index(GPIOx)] & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+/* ============================================================================
+ * SPI / DMA
+ * ============================================================================ */
+
+/**
+ * @brief       当前SPI1时钟 (PCLK2 / 2^(BR+1))
+ * @param       无
+ * @retval      Hz
+ */
+uint32_t sim_spi_hz(void)
+{
+    return SIM_CPU_HZ >> (((sim_spi1.CR1 & SPI_CR1_BR) >> SPI_CR1_BR_Pos) + 1);
+}
+
+/**
+ * @brief       一个字节在SPI上的时间
+ * @param       无
+ * @retval      CPU周期
+ */
+static uint32_t sim_spi_byte_cycles(void)
+{
+    return 8U * (SIM_CPU_HZ / sim_spi_hz());
+}
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *hspi)
+{
+    MODIFY_REG(hspi->Instance->CR1, SPI_CR1_BR, hspi->Init.BaudRatePrescaler);
+    hspi->State = HAL_SPI_STATE_READY;
+    sim_advance(400);   /* 完整的HAL初始化 */
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData,
+                                          uint16_t Size, uint32_t Timeout)
+{
+    uint16_t i;
+    uint8_t rx;
+
+    (void)Timeout;
+    if (s_dma.active || hspi->State != HAL_SPI_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    sim_advance(SIM_CYC_SPI_CALL);
+    for (i = 0; i < Size; i++) {
+        sim_advance(sim_spi_byte_cycles() + SIM_CYC_SPI_GAP);
+        rx = sim_vs1053_spi(pTxData[i], sim_spi_hz());
+        if (pRxData != NULL) {
+            pRxData[i] = rx;
+        }
+        sim_dreq_sample();
+    }
+    s_stats.spi_bytes += Size;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+    return HAL_SPI_TransmitReceive(hspi, pData, NULL, Size, Timeout);
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, const uint8_t *pData, uint16_t Size)
+{
+    if (s_dma.active || hspi->State != HAL_SPI_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    sim_advance(SIM_CYC_DMA_START);
+    hspi->State = HAL_SPI_STATE_BUSY_TX;
+    sim_dma1_ch3.CCR |= DMA_IT_TC | DMA_IT_HT | DMA_IT_TE;
+
+    s_dma.active = true;
+    s_dma.buf = pData;
+    s_dma.len = Size;
+    s_dma.spi_hz = sim_spi_hz();
+    s_dma.done = s_now + (uint64_t)Size * sim_spi_byte_cycles();
+    s_stats.dma_bursts++;
+    s_stats.dma_bytes += Size;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma)
+{
+    (void)hdma;
+    return HAL_OK;
+}
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma)
+{
+    SPI_HandleTypeDef *hspi = (SPI_HandleTypeDef *)hdma->Parent;
+
+    sim_advance(SIM_CYC_DMA_IRQ);
+    hspi->State = HAL_SPI_STATE_READY;
+    HAL_SPI_TxCpltCallback(hspi);
+}
+
+/* ============================================================================
+ * USART
+ * ============================================================================ */
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size)
+{
+    (void)huart;
+    sim_advance(SIM_CYC_DMA_START);
+    fwrite(pData, 1, Size, stdout);     /* 立即发完, 句柄保持READY */
+    return HAL_OK;
+}
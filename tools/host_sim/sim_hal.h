@@ -0,0 +1,56 @@
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 主机仿真: 虚拟时间和HAL替身
+ * 所有时间以72MHz CPU周期为单位。每个HAL调用按估算的开销推进虚拟时间,
+ * 时间推进时处理DMA完成、DREQ上升沿, 并在主循环上下文中"打断"执行中断服务
+ * (DMA1通道3和EXTI15_10, 同优先级, 不嵌套, 编号小的先执行)。
+ * 忙等循环里的GPIO读或__NOP()都会推进时间, 因此驱动中的等待不会死循环。
+ */
+
+#define SIM_CPU_HZ              72000000U
+
+/* 估算开销(CPU周期) */
+#define SIM_CYC_GPIO            10      /* 一次HAL_GPIO_WritePin/ReadPin */
+#define SIM_CYC_SPI_CALL        60      /* 阻塞SPI调用的固定开销 */
+#define SIM_CYC_SPI_GAP         16      /* 阻塞传输相邻字节之间的间隙 */
+#define SIM_CYC_DMA_START       250     /* HAL_SPI_Transmit_DMA */
+#define SIM_CYC_DMA_IRQ         150     /* HAL_DMA_IRQHandler + SPI完成处理 */
+#define SIM_CYC_ISR_ENTRY       12      /* 进入/退出中断各一次 */
+#define SIM_CYC_NVIC            8       /* 一次NVIC操作 */
+#define SIM_CYC_IDLE            4       /* 忙等循环中的一次__NOP() */
+
+/* 中断统计 */
+typedef struct {
+    uint64_t isr_cycles;        /* 中断上下文中消耗的周期(含进出) */
+    uint32_t dma_irqs;
+    uint32_t exti_irqs;
+    uint32_t dreq_edges;        /* DREQ上升沿次数 */
+    uint32_t dma_bursts;        /* DMA传输次数 */
+    uint64_t dma_bytes;
+    uint64_t spi_bytes;         /* 阻塞传输的字节数 */
+} SimHalStats_t;
+
+void sim_hal_init(void);                        /* 回到上电状态 (hspi1按MX_SPI1_Init设置) */
+uint64_t sim_now(void);                         /* 当前虚拟时间(周期) */
+void sim_advance(uint64_t cycles);              /* 推进时间, 期间处理事件和中断 */
+void sim_idle(void);                            /* 忙等循环的一次空转 */
+bool sim_in_isr(void);
+void sim_set_deadline(uint64_t cycles);         /* 虚拟时间超过该值即退出(防止驱动挂死), 0不限 */
+void sim_hal_get_stats(SimHalStats_t *stats);
+void sim_hal_reset_stats(void);
+uint32_t sim_spi_hz(void);                      /* 当前SPI1时钟 */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_HAL_H
@@ -0,0 +1,184 @@
+#include "main.h"
+#include "bsp_driver_sd.h"
+#include "sim_sdcard.h"
+#include "sdio_sdcard.h"
+#include "sd_cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* 私有变量 */
+static uint8_t *s_image;                /* 卡镜像 */
+static uint32_t s_blocks;
+static SimSdTiming_t s_timing;
+static SimSdStats_t s_stats;
+static uint8_t s_xfer_state = MSD_OK;   /* 上一次"DMA"传输的结果, BSP_SD_WaitTransfer返回 */
+
+/* ============================================================================
+ * 时序
+ * ============================================================================ */
+
+static uint64_t sim_sd_cycles(uint32_t access_us, uint32_t blocks)
+{
+    /* 每个数据块另有CRC16(每条数据线2字节)和起止位 */
+    uint64_t bits = (uint64_t)blocks * ((SIM_SD_BLOCK_SIZE + 2U) * 8U + 2U) / s_timing.bus_width;
+
+    return (uint64_t)access_us * (SIM_CPU_HZ / 1000000U) + bits * SIM_CPU_HZ / s_timing.clock_hz;
+}
+
+static void sim_sd_busy(uint64_t cycles)
+{
+    s_stats.busy_cycles += cycles;
+    sim_advance(cycles);
+}
+
+/* ============================================================================
+ * 接口
+ * ============================================================================ */
+
+bool sim_sdcard_init(uint32_t blocks)
+{
+    free(s_image);
+    s_image = calloc(blocks, SIM_SD_BLOCK_SIZE);
+    s_blocks = (s_image != NULL) ? blocks : 0;
+
+    s_timing.read_us = SIM_SD_DEFAULT_READ_US;
+    s_timing.write_us = SIM_SD_DEFAULT_WRITE_US;
+    s_timing.clock_hz = SIM_SD_DEFAULT_CLOCK_HZ;
+    s_timing.bus_width = SIM_SD_DEFAULT_BUS_WIDTH;
+    memset(&s_stats, 0, sizeof(s_stats));
+    return s_image != NULL;
+}
+
+void sim_sdcard_set_timing(const SimSdTiming_t *timing)
+{
+    s_timing = *timing;
+    if (s_timing.bus_width != 4) {
+        s_timing.bus_width = 1;
+    }
+    if (s_timing.clock_hz == 0) {
+        s_timing.clock_hz = SIM_SD_DEFAULT_CLOCK_HZ;
+    }
+}
+
+void sim_sdcard_get_timing(SimSdTiming_t *timing)
+{
+    *timing = s_timing;
+}
+
+void sim_sdcard_get_stats(SimSdStats_t *stats)
+{
+    *stats = s_stats;
+}
+
+void sim_sdcard_reset_stats(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+/* ============================================================================
+ * BSP_SD (代替FATFS/Target/bsp_driver_sd.c)
+ * ============================================================================ */
+
+uint8_t BSP_SD_Init(void)
+{
+    return (s_image != NULL) ? MSD_OK : MSD_ERROR;
+}
+
+/* DMA读写在仿真里同步完成: 启动时就拷贝并计时, BSP_SD_WaitTransfer立即返回结果 */
+uint8_t BSP_SD_ReadBlocks_DMA(uint32_t *pData, uint32_t ReadAddr, uint32_t NumOfBlocks)
+{
+    s_xfer_state = MSD_ERROR;
+    if (s_image == NULL || ReadAddr + NumOfBlocks > s_blocks || ((uintptr_t)pData & 3U) != 0) {
+        return MSD_ERROR;
+    }
+    sim_sd_busy(sim_sd_cycles(s_timing.read_us, NumOfBlocks));
+    memcpy(pData, s_image + (size_t)ReadAddr * SIM_SD_BLOCK_SIZE, (size_t)NumOfBlocks * SIM_SD_BLOCK_SIZE);
+    s_stats.reads++;
+    s_stats.read_blocks += NumOfBlocks;
+    s_xfer_state = MSD_OK;
+    return MSD_OK;
+}
+
+uint8_t BSP_SD_WriteBlocks_DMA(uint32_t *pData, uint32_t WriteAddr, uint32_t NumOfBlocks)
+{
+    s_xfer_state = MSD_ERROR;
+    if (s_image == NULL || WriteAddr + NumOfBlocks > s_blocks || ((uintptr_t)pData & 3U) != 0) {
+        return MSD_ERROR;
+    }
+    sim_sd_busy(sim_sd_cycles(s_timing.write_us, NumOfBlocks));
+    memcpy(s_image + (size_t)WriteAddr * SIM_SD_BLOCK_SIZE, pData, (size_t)NumOfBlocks * SIM_SD_BLOCK_SIZE);
+    s_stats.writes++;
+    s_stats.write_blocks += NumOfBlocks;
+    s_xfer_state = MSD_OK;
+    return MSD_OK;
+}
+
+uint8_t BSP_SD_WaitTransfer(uint32_t Timeout)
+{
+    (void)Timeout;
+    return s_xfer_state;
+}
+
+uint8_t BSP_SD_BusFallback(void)
+{
+    return MSD_ERROR;           /* 仿真的卡不出CRC/超时错误 */
+}
+
+uint8_t BSP_SD_GetCardState(void)
+{
+    return SD_TRANSFER_OK;
+}
+
+void BSP_SD_GetCardInfo(HAL_SD_CardInfoTypeDef *CardInfo)
+{
+    memset(CardInfo, 0, sizeof(*CardInfo));
+    CardInfo->BlockNbr = s_blocks;
+    CardInfo->BlockSize = SIM_SD_BLOCK_SIZE;
+    CardInfo->LogBlockNbr = s_blocks;
+    CardInfo->LogBlockSize = SIM_SD_BLOCK_SIZE;
+}
+
+uint8_t BSP_SD_IsDetected(void)
+{
+    return SD_PRESENT;
+}
+
+/* ============================================================================
+ * sdio_sdcard.c的直接扇区接口 (录音/连续文件播放绕过FatFs读写数据扇区)
+ * ============================================================================ */
+
+uint8_t get_sd_card_state(void)
+{
+    return (BSP_SD_GetCardState() == MSD_OK) ? SD_TRANSFER_OK : SD_TRANSFER_BUSY;
+}
+
+uint8_t sd_read_disk(uint8_t *pbuf, uint32_t saddr, uint32_t cnt)
+{
+    if (BSP_SD_ReadBlocks_DMA((uint32_t *)pbuf, saddr, cnt) != MSD_OK) {
+        return MSD_ERROR;
+    }
+    return BSP_SD_WaitTransfer(SD_DMA_TIMEOUT);
+}
+
+uint8_t sd_write_start(uint8_t *pbuf, uint32_t saddr, uint32_t cnt)
+{
+    sd_cache_invalidate(saddr, cnt);
+    if (BSP_SD_WriteBlocks_DMA((uint32_t *)pbuf, saddr, cnt) != MSD_OK) {
+        return MSD_ERROR;
+    }
+    return BSP_SD_WaitTransfer(SD_DMA_TIMEOUT);
+}
+
+uint8_t sd_write_disk(uint8_t *pbuf, uint32_t saddr, uint32_t cnt)
+{
+    return sd_write_start(pbuf, saddr, cnt);
+}
+
+void sd_bus_get_config(SdBusConfig_t *config)
+{
+    /* 总线按sim_sdcard_set_timing固定, 不做调整 */
+    memset(config, 0, sizeof(*config));
+    config->bus_width = (uint8_t)s_timing.bus_width;
+    config->clock_khz = s_timing.clock_hz / 1000U;
+    config->level = (s_timing.bus_width == 4) ? 0 : SD_BUS_LEVELS - 1;
+}
@@ -0,0 +1,54 @@
+#ifndef SIM_SDCARD_H
+#define SIM_SDCARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 主机仿真: SD卡替身
+ * 代替FATFS/Target/bsp_driver_sd.c实现BSP_SD_xxx, 数据存放在内存中的卡镜像,
+ * 上面是真实的sd_diskio.c和FatFs。每次读写按"命令访问时间 + 数据在总线上的
+ * 传输时间"推进虚拟时间, 传输期间CPU被占用(与板上轮询方式的HAL_SD_ReadBlocks
+ * 相同), 期间照常处理DREQ/DMA中断。
+ * 默认时序与Core/Src/sdio.c一致: SDIO_CK = 72MHz/(ClockDiv+2) = 18MHz, 1位总线。
+ */
+
+#define SIM_SD_BLOCK_SIZE           512
+#define SIM_SD_DEFAULT_BLOCKS       (64UL * 1024 * 1024 / SIM_SD_BLOCK_SIZE)   /* 64MB */
+#define SIM_SD_DEFAULT_READ_US      250     /* 读命令到第一个数据块的时间 */
+#define SIM_SD_DEFAULT_WRITE_US     1000    /* 写命令的编程忙时间 */
+#define SIM_SD_DEFAULT_CLOCK_HZ     18000000U
+#define SIM_SD_DEFAULT_BUS_WIDTH    1
+
+/* 时序 */
+typedef struct {
+    uint32_t read_us;           /* 每次读命令的访问时间 */
+    uint32_t write_us;          /* 每次写命令的忙时间 */
+    uint32_t clock_hz;          /* SDIO_CK */
+    uint8_t bus_width;          /* 1或4 */
+} SimSdTiming_t;
+
+/* 统计 */
+typedef struct {
+    uint32_t reads;             /* 读命令次数 */
+    uint32_t writes;            /* 写命令次数 */
+    uint64_t read_blocks;
+    uint64_t write_blocks;
+    uint64_t busy_cycles;       /* 读写占用的CPU周期 */
+} SimSdStats_t;
+
+bool sim_sdcard_init(uint32_t blocks);                  /* 空白卡(未格式化), 时序恢复默认 */
+void sim_sdcard_set_timing(const SimSdTiming_t *timing);
+void sim_sdcard_get_timing(SimSdTiming_t *timing);
+void sim_sdcard_get_stats(SimSdStats_t *stats);
+void sim_sdcard_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_SDCARD_H
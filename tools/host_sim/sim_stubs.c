@@ -0,0 +1,57 @@
+#include "main.h"
+#include "nt35310_alientek.h"
+#include "uart_stream.h"
+#include <string.h>
+
+/*
+ * 播放器链接到但仿真中不需要的外部函数: LCD绘制不建模, 不占虚拟时间;
+ * 仿真不模拟USART接收(usart.h), 串口送流会话永远不会开始
+ */
+
+void lcd_show_string(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t size, char *p, uint16_t color)
+{
+    (void)x;
+    (void)y;
+    (void)width;
+    (void)height;
+    (void)size;
+    (void)p;
+    (void)color;
+}
+
+void lcd_fill(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, uint32_t color)
+{
+    (void)sx;
+    (void)sy;
+    (void)ex;
+    (void)ey;
+    (void)color;
+}
+
+void lcd_fill_window(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, uint32_t color)
+{
+    (void)sx;
+    (void)sy;
+    (void)ex;
+    (void)ey;
+    (void)color;
+}
+
+bool uart_stream_start(void)
+{
+    return false;
+}
+
+void uart_stream_task(void)
+{
+}
+
+bool uart_stream_busy(void)
+{
+    return false;
+}
+
+void uart_stream_get_stats(UartStreamStats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
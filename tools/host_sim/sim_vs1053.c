@@ -0,0 +1,838 @@
+#include "sim_vs1053.h"
+#include "sim_hal.h"
+#include "vs1053_driver.h"
+#include "mp3_frame.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/* 时序 (数据手册给出的量级) */
+#define VS_SCI_WRITE_CLKI       80          /* 普通SCI写后DREQ为低的时间 */
+#define VS_CLOCKF_XTALI         1200        /* 写CLOCKF后时钟切换 */
+#define VS_RESET_XTALI          22000       /* 硬/软复位 */
+#define VS_MEMTEST_CLKI         1100000     /* SDI存储器测试 */
+#define VS_IDLE_BYTE_RATE       1000000U    /* 空闲或取消中丢弃数据的速度(字节/秒) */
+#define VS_UNKNOWN_BYTE_RATE    16000U      /* 没识别出格式时按128kbps消耗 */
+#define VS_DETECT_LIMIT         4096        /* 超过这么多字节仍未识别则放弃 */
+#define VS_FILL_REQUIRED        2052        /* 新码流之前至少要有的endFillByte数 */
+#define VS_CANCEL_TAIL          32          /* 清零SM_CANCEL后到主机读MODE之前, 最多还会送一个突发的旧数据 */
+#define VS_WAV_HEADER           36          /* 读到fmt块的码率和采样率所需字节数 */
+#define VS_DREQ_FREE            32          /* DREQ为高时FIFO至少空闲的字节数 */
+
+/* 芯片状态 */
+typedef struct {
+    uint64_t t;                 /* 模型时间(CPU周期) */
+    bool xcs;
+    bool xdcs;
+    bool rst;
+    uint64_t busy_until;        /* 此前DREQ为低 */
+    uint64_t reset_until;       /* 复位结束时刻 */
+    uint32_t clki;
+    uint16_t reg[16];
+    double fifo;                /* FIFO中的字节数 */
+
+    /* SCI帧 */
+    uint8_t frame_pos;
+    uint8_t frame_op;
+    uint8_t frame_addr;
+    uint16_t frame_data;
+
+    /* SDI测试命令 (SM_TESTS) */
+    uint8_t test_buf[8];
+    uint8_t test_n;
+    bool sine;
+
+    /* 码流 */
+    uint8_t format;             /* SimVsFormat_t */
+    uint32_t byte_rate;         /* 字节/秒 */
+    uint8_t hdr[VS_WAV_HEADER];
+    uint32_t hdr_n;
+    uint32_t rolling;           /* 最近4个字节, 找MP3帧头 */
+    double decoded;             /* 写DECODE_TIME之后已解码的字节数 */
+    uint16_t time_origin;       /* 写入的DECODE_TIME */
+    bool starving;
+    uint64_t starve_start;
+
+    /* 取消和填充 */
+    bool cancelling;
+    double cancel_drained;      /* 置SM_CANCEL后消耗的字节数 */
+    uint32_t cancel_bytes;      /* 消耗这么多字节后清零, 0永不清零 */
+    uint8_t fill_byte;
+    uint32_t trail_fill;        /* 最近连续收到的endFillByte数 */
+    bool need_fill;             /* 取消后新码流之前要检查填充 */
+    uint32_t tail_left;         /* 取消后仍允许的旧数据字节数 */
+
+    uint32_t log_max;
+    uint32_t logged;
+    SimVs1053Stats_t stats;
+} SimVs1053_t;
+
+static SimVs1053_t s_vs;
+static uint16_t s_wram[65536];
+
+static const char *const s_viol_names[SIM_VIOLATIONS] = {
+    "SCI write while busy",
+    "SCI read during reset",
+    "SDI while DREQ low",
+    "FIFO overflow",
+    "XCS and XDCS both low",
+    "access while in reset",
+    "SPI clock too fast",
+    "bad SCI frame",
+    "missing endFillBytes",
+};
+
+/* ============================================================================
+ * 内部函数
+ * ============================================================================ */
+
+/**
+ * @brief       记录一次违例, 前log_max条打印出来
+ * @param       v: 违例类型
+ * @param       fmt: 附加说明
+ * @retval      无
+ */
+static void vs_violation(SimViolation_t v, const char *fmt, ...)
+{
+    va_list ap;
+
+    s_vs.stats.violations[v]++;
+    if (s_vs.logged >= s_vs.log_max) {
+        return;
+    }
+    s_vs.logged++;
+
+    fprintf(stderr, "[%10.3f ms] VS1053 %s: ", (double)s_vs.t * 1000.0 / SIM_CPU_HZ, s_viol_names[v]);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+/**
+ * @brief       芯片时钟周期数换算为CPU周期
+ * @param       n: 时钟周期数
+ * @param       hz: 时钟频率
+ * @retval      CPU周期
+ */
+static uint64_t vs_cycles(uint32_t n, uint32_t hz)
+{
+    return ((uint64_t)n * SIM_CPU_HZ + hz - 1) / hz;
+}
+
+/**
+ * @brief       由CLOCKF计算CLKI (与vs1053_port_set_clockf相同的公式)
+ * @param       clockf: SCI_CLOCKF
+ * @retval      CLKI(Hz)
+ */
+static uint32_t vs_clki(uint16_t clockf)
+{
+    static const uint8_t mult_x2[8] = {2, 4, 5, 6, 7, 8, 9, 10};
+    uint32_t xtali = SIM_VS_XTALI_HZ;
+
+    if ((clockf & 0x07FF) != 0) {
+        xtali = (uint32_t)(clockf & 0x07FF) * 4000U + 8000000U;
+    }
+    return xtali / 2U * mult_x2[clockf >> 13];
+}
+
+static bool vs_resetting(void)
+{
+    return !s_vs.rst || s_vs.t < s_vs.reset_until;
+}
+
+static bool vs_decoding(void)
+{
+    return s_vs.format >= SIM_VS_FMT_MP3 && !s_vs.cancelling && (s_vs.reg[SPI_MODE] & SM_TESTS) == 0;
+}
+
+/**
+ * @brief       FIFO消耗速度
+ * @param       无
+ * @retval      字节/CPU周期
+ */
+static double vs_drain_rate(void)
+{
+    if (vs_resetting() || (s_vs.reg[SPI_MODE] & SM_TESTS) != 0) {
+        return 0.0;
+    }
+    if (vs_decoding()) {
+        return (double)s_vs.byte_rate / SIM_CPU_HZ;
+    }
+    return (double)VS_IDLE_BYTE_RATE / SIM_CPU_HZ;
+}
+
+/**
+ * @brief       结束一次送空
+ * @param       无
+ * @retval      无
+ */
+static void vs_starve_end(void)
+{
+    if (s_vs.starving) {
+        s_vs.starving = false;
+        s_vs.stats.underrun_cycles += s_vs.t - s_vs.starve_start;
+    }
+}
+
+/**
+ * @brief       解码器回到空闲 (HDAT清零)
+ * @param       无
+ * @retval      无
+ */
+static void vs_decoder_idle(void)
+{
+    vs_starve_end();
+    s_vs.format = SIM_VS_FMT_NONE;
+    s_vs.byte_rate = 0;
+    s_vs.reg[SPI_HDAT0] = 0;
+    s_vs.reg[SPI_HDAT1] = 0;
+    s_vs.cancelling = false;
+}
+
+/**
+ * @brief       软复位: 清空FIFO和解码器, 保留CLOCKF
+ * @param       无
+ * @retval      无
+ */
+static void vs_soft_reset(void)
+{
+    s_vs.stats.soft_resets++;
+    s_vs.reset_until = s_vs.t + vs_cycles(VS_RESET_XTALI, SIM_VS_XTALI_HZ);
+    s_vs.busy_until = s_vs.reset_until;
+    s_vs.fifo = 0;
+    vs_decoder_idle();
+    s_vs.reg[SPI_AUDATA] = 0;
+    s_vs.reg[SPI_DECODE_TIME] = 0;
+    s_vs.time_origin = 0;
+    s_vs.decoded = 0;
+    s_vs.need_fill = false;
+    s_vs.tail_left = 0;
+    s_vs.trail_fill = 0;
+    s_vs.sine = false;
+    s_wram[VS1053_PARA_BYTE_RATE] = 0;
+    s_wram[VS1053_PARA_END_FILL_BYTE] = s_vs.fill_byte;
+}
+
+/**
+ * @brief       复位脚为低: 所有寄存器回到上电值
+ * @param       无
+ * @retval      无
+ */
+static void vs_power_on(void)
+{
+    memset(s_vs.reg, 0, sizeof(s_vs.reg));
+    s_vs.reg[SPI_MODE] = SM_SDINEW | SM_LINE1;
+    s_vs.reg[SPI_STATUS] = 0x0040;      /* SS_VER=4: VS1053 */
+    s_vs.clki = SIM_VS_XTALI_HZ;
+    s_vs.fifo = 0;
+    s_vs.frame_pos = 0;
+    s_vs.test_n = 0;
+    s_vs.sine = false;
+    vs_decoder_idle();
+    s_vs.time_origin = 0;
+    s_vs.decoded = 0;
+    s_vs.need_fill = false;
+    s_vs.tail_left = 0;
+    s_vs.trail_fill = 0;
+    s_vs.fill_byte = 0;
+    s_wram[VS1053_PARA_BYTE_RATE] = 0;
+    s_wram[VS1053_PARA_END_FILL_BYTE] = 0;
+}
+
+/**
+ * @brief       识别出码流格式, 更新HDAT/AUDATA和参数区
+ * @param       format: 格式
+ * @param       byte_rate: 码率(字节/秒)
+ * @param       sample_rate: 采样率
+ * @param       channels: 声道数
+ * @param       hdat0: HDAT0
+ * @param       hdat1: HDAT1
+ * @retval      无
+ */
+static void vs_set_format(SimVsFormat_t format, uint32_t byte_rate, uint32_t sample_rate,
+                          uint8_t channels, uint16_t hdat0, uint16_t hdat1)
+{
+    s_vs.format = format;
+    s_vs.byte_rate = (byte_rate != 0) ? byte_rate : VS_UNKNOWN_BYTE_RATE;
+    s_vs.reg[SPI_HDAT0] = hdat0;
+    s_vs.reg[SPI_HDAT1] = hdat1;
+    s_vs.reg[SPI_AUDATA] = (uint16_t)((sample_rate & 0xFFFE) | (channels == 2 ? 1 : 0));
+    s_wram[VS1053_PARA_BYTE_RATE] = (uint16_t)((s_vs.byte_rate > 0xFFFF) ? 0xFFFF : s_vs.byte_rate);
+    s_wram[VS1053_PARA_END_FILL_BYTE] = s_vs.fill_byte;
+}
+
+/**
+ * @brief       从码流开头识别格式
+ * @param       b: 收到的字节
+ * @retval      无
+ */
+static void vs_detect(uint8_t b)
+{
+    Mp3FrameInfo_t info;
+    const uint8_t *h = s_vs.hdr;
+
+    if (s_vs.hdr_n < VS_WAV_HEADER) {
+        s_vs.hdr[s_vs.hdr_n] = b;
+    }
+    s_vs.hdr_n++;
+    s_vs.rolling = (s_vs.rolling << 8) | b;
+
+    if (s_vs.hdr_n >= 4 && memcmp(h, "RIFF", 4) == 0) {
+        if (s_vs.hdr_n == VS_WAV_HEADER) {
+            uint32_t channels = h[22] | (h[23] << 8);
+            uint32_t sample_rate = h[24] | (h[25] << 8) | ((uint32_t)h[26] << 16) | ((uint32_t)h[27] << 24);
+            uint32_t byte_rate = h[28] | (h[29] << 8) | ((uint32_t)h[30] << 16) | ((uint32_t)h[31] << 24);
+
+            /* WAV: HDAT1="ve", HDAT0按kbps给出 (简化) */
+            vs_set_format(SIM_VS_FMT_WAV, byte_rate, sample_rate, (uint8_t)channels,
+                          (uint16_t)(byte_rate * 8 / 1000), 0x7665);
+        }
+        return;
+    }
+
+    if (s_vs.hdr_n >= 4 && mp3_frame_parse(s_vs.rolling, &info) && info.layer == 3) {
+        vs_set_format(SIM_VS_FMT_MP3, (uint32_t)info.bitrate * 125U, info.sample_rate, info.channels,
+                      (uint16_t)(s_vs.rolling & 0xFFFF), (uint16_t)(s_vs.rolling >> 16));
+        return;
+    }
+
+    if (s_vs.hdr_n > VS_DETECT_LIMIT) {
+        vs_set_format(SIM_VS_FMT_UNKNOWN, 0, 0, 0, 0, 0);
+    }
+}
+
+/**
+ * @brief       一个数据字节进入FIFO后的码流处理
+ * @note        空闲时第一个非填充字节开始新码流; 上一个码流是取消结束的,
+ *              此前必须已经送了2052个endFillByte
+ * @param       b: 数据
+ * @retval      无
+ */
+static void vs_stream_byte(uint8_t b)
+{
+    bool fill = (b == s_vs.fill_byte);
+    uint32_t fill_before = s_vs.trail_fill;
+
+    s_vs.trail_fill = fill ? s_vs.trail_fill + 1 : 0;
+
+    if (s_vs.tail_left > 0) {
+        s_vs.tail_left--;       /* 取消清零后主机还没看到, 旧码流的最后一个突发 */
+        return;
+    }
+
+    if (s_vs.format == SIM_VS_FMT_NONE) {
+        if (fill || s_vs.cancelling) {
+            return;
+        }
+        if (s_vs.need_fill && fill_before < VS_FILL_REQUIRED) {
+            vs_violation(SIM_VIOL_FILL, "new stream after only %u endFillBytes", fill_before);
+        }
+        s_vs.need_fill = false;
+        s_vs.format = SIM_VS_FMT_DETECT;
+        s_vs.hdr_n = 0;
+        s_vs.rolling = 0;
+        s_vs.stats.streams++;
+    }
+
+    if (s_vs.format == SIM_VS_FMT_DETECT) {
+        vs_detect(b);
+    }
+}
+
+/**
+ * @brief       SDI测试命令 (SM_TESTS时每8字节一条)
+ * @param       无
+ * @retval      无
+ */
+static void vs_test_command(void)
+{
+    static const uint8_t memtest[4] = {0x4D, 0xEA, 0x6D, 0x54};
+    static const uint8_t sine_on[3] = {0x53, 0xEF, 0x6E};
+    static const uint8_t sine_off[4] = {0x45, 0x78, 0x69, 0x74};
+
+    if (memcmp(s_vs.test_buf, memtest, 4) == 0) {
+        s_vs.reg[SPI_HDAT0] = 0x83FF;       /* VS1053存储器全部正常 */
+        s_vs.busy_until = s_vs.t + vs_cycles(VS_MEMTEST_CLKI, s_vs.clki);
+    } else if (memcmp(s_vs.test_buf, sine_on, 3) == 0) {
+        s_vs.sine = true;
+    } else if (memcmp(s_vs.test_buf, sine_off, 4) == 0) {
+        s_vs.sine = false;
+    }
+}
+
+/**
+ * @brief       检查SPI时钟
+ * @param       spi_hz: SPI时钟
+ * @param       read: true为SCI读
+ * @retval      无
+ */
+static void vs_check_clock(uint32_t spi_hz, bool read)
+{
+    uint32_t max = s_vs.clki / (read ? 7U : 4U);
+
+    if (spi_hz > max) {
+        vs_violation(SIM_VIOL_SPI_CLOCK, "%s at %u Hz, limit %u Hz (CLKI %u Hz)",
+                     read ? "SCI read" : (s_vs.xcs ? "SDI" : "SCI write"), spi_hz, max, s_vs.clki);
+    }
+}
+
+/**
+ * @brief       读SCI寄存器
+ * @param       addr: 地址
+ * @retval      值
+ */
+static uint16_t vs_reg_read(uint8_t addr)
+{
+    s_vs.stats.sci_reads++;
+
+    switch (addr) {
+        case SPI_DECODE_TIME:
+            if (s_vs.byte_rate == 0) {
+                return s_vs.time_origin;
+            }
+            return (uint16_t)(s_vs.time_origin + (uint32_t)(s_vs.decoded / s_vs.byte_rate));
+
+        case SPI_WRAM:
+            return s_wram[s_vs.reg[SPI_WRAMADDR]++];
+
+        case SPI_MODE:
+            if ((s_vs.reg[SPI_MODE] & SM_CANCEL) == 0) {
+                s_vs.tail_left = 0;     /* 主机已看到取消完成, 之后的数据属于新码流 */
+            }
+            return s_vs.reg[SPI_MODE];
+
+        default:
+            return s_vs.reg[addr];
+    }
+}
+
+/**
+ * @brief       写SCI寄存器
+ * @param       addr: 地址
+ * @param       data: 值
+ * @retval      无
+ */
+static void vs_reg_write(uint8_t addr, uint16_t data)
+{
+    s_vs.stats.sci_writes++;
+    s_vs.busy_until = s_vs.t + vs_cycles(VS_SCI_WRITE_CLKI, s_vs.clki);
+
+    switch (addr) {
+        case SPI_MODE:
+            if (data & SM_RESET) {
+                s_vs.reg[SPI_MODE] = data & ~SM_RESET;
+                vs_soft_reset();
+                break;
+            }
+            if ((data & SM_CANCEL) && !(s_vs.reg[SPI_MODE] & SM_CANCEL)) {
+                s_vs.cancelling = true;
+                s_vs.cancel_drained = 0;
+                s_vs.stats.cancels++;
+            } else if (!(data & SM_CANCEL)) {
+                s_vs.cancelling = false;
+            }
+            if ((data & SM_TESTS) && !(s_vs.reg[SPI_MODE] & SM_TESTS)) {
+                s_vs.test_n = 0;
+            }
+            s_vs.reg[SPI_MODE] = data;
+            break;
+
+        case SPI_STATUS:
+            s_vs.reg[SPI_STATUS] = data;
+            break;
+
+        case SPI_CLOCKF:
+            s_vs.reg[SPI_CLOCKF] = data;
+            s_vs.busy_until = s_vs.t + vs_cycles(VS_CLOCKF_XTALI, SIM_VS_XTALI_HZ);
+            s_vs.clki = vs_clki(data);
+            break;
+
+        case SPI_DECODE_TIME:
+            s_vs.time_origin = data;
+            s_vs.decoded = 0;
+            break;
+
+        case SPI_WRAM:
+            s_wram[s_vs.reg[SPI_WRAMADDR]++] = data;
+            break;
+
+        case SPI_AUDATA:
+        case SPI_HDAT0:
+        case SPI_HDAT1:
+            break;      /* 只读 (AUDATA写采样率的用法不建模) */
+
+        default:
+            s_vs.reg[addr] = data;
+            break;
+    }
+}
+
+/**
+ * @brief       SCI接口收到一个字节
+ * @param       tx: MOSI
+ * @param       spi_hz: SPI时钟
+ * @retval      MISO
+ */
+static uint8_t vs_sci_byte(uint8_t tx, uint32_t spi_hz)
+{
+    uint8_t rx = 0;
+    bool read = (s_vs.frame_op == VS_READ_COMMAND);
+
+    switch (s_vs.frame_pos) {
+        case 0:
+            s_vs.frame_op = tx;
+            if (tx != VS_WRITE_COMMAND && tx != VS_READ_COMMAND) {
+                vs_violation(SIM_VIOL_SCI_FRAME, "opcode 0x%02X", tx);
+                break;
+            }
+            read = (tx == VS_READ_COMMAND);
+            vs_check_clock(spi_hz, read);
+            if (read && vs_resetting()) {
+                vs_violation(SIM_VIOL_SCI_READ_BUSY, "read during reset");
+            } else if (!read && s_vs.t < s_vs.busy_until) {
+                vs_violation(SIM_VIOL_SCI_WRITE_BUSY, "%.1f us before DREQ",
+                             (double)(s_vs.busy_until - s_vs.t) * 1e6 / SIM_CPU_HZ);
+            }
+            break;
+
+        case 1:
+            s_vs.frame_addr = tx & 0x0F;
+            if (read) {
+                s_vs.frame_data = vs_reg_read(s_vs.frame_addr);
+            }
+            break;
+
+        case 2:
+            if (read) {
+                rx = s_vs.frame_data >> 8;
+            } else {
+                s_vs.frame_data = (uint16_t)(tx << 8);
+            }
+            break;
+
+        case 3:
+            if (read) {
+                rx = s_vs.frame_data & 0xFF;
+            } else {
+                s_vs.frame_data |= tx;
+                vs_reg_write(s_vs.frame_addr, s_vs.frame_data);
+            }
+            break;
+
+        default:
+            if (s_vs.frame_pos == 4) {
+                vs_violation(SIM_VIOL_SCI_FRAME, "extra bytes without raising XCS");
+            }
+            break;
+    }
+
+    if (s_vs.frame_pos < 0xFF) {
+        s_vs.frame_pos++;
+    }
+    return rx;
+}
+
+/**
+ * @brief       数据进入FIFO (普通模式)
+ * @param       buf: 数据
+ * @param       len: 字节数
+ * @retval      无
+ */
+static void vs_sdi_data(const uint8_t *buf, uint32_t len)
+{
+    uint32_t i;
+
+    vs_starve_end();
+
+    s_vs.fifo += len;
+    if (s_vs.fifo > SIM_VS_FIFO_SIZE + 1e-6) {
+        vs_violation(SIM_VIOL_FIFO_OVERFLOW, "%.0f bytes lost", s_vs.fifo - SIM_VS_FIFO_SIZE);
+        s_vs.fifo = SIM_VS_FIFO_SIZE;
+    }
+    if ((uint32_t)s_vs.fifo > s_vs.stats.fifo_max) {
+        s_vs.stats.fifo_max = (uint32_t)s_vs.fifo;
+    }
+    s_vs.stats.sdi_bytes += len;
+
+    for (i = 0; i < len; i++) {
+        vs_stream_byte(buf[i]);
+    }
+}
+
+/* ============================================================================
+ * 接口
+ * ============================================================================ */
+
+/**
+ * @brief       上电, 复位脚为低
+ * @param       无
+ * @retval      无
+ */
+void sim_vs1053_init(void)
+{
+    memset(&s_vs, 0, sizeof(s_vs));
+    memset(s_wram, 0, sizeof(s_wram));
+    s_vs.cancel_bytes = SIM_VS_CANCEL_BYTES;
+    s_vs.log_max = 20;
+    s_vs.xcs = true;
+    s_vs.xdcs = true;
+    s_vs.rst = false;
+    vs_power_on();
+}
+
+void sim_vs1053_set_cancel_bytes(uint32_t bytes)
+{
+    s_vs.cancel_bytes = bytes;
+}
+
+void sim_vs1053_set_log(uint32_t max_logged)
+{
+    s_vs.log_max = max_logged;
+}
+
+/**
+ * @brief       推进模型: FIFO按码率消耗, 统计送空, 检查SM_CANCEL
+ * @param       now: 目标时刻
+ * @retval      无
+ */
+void sim_vs1053_run(uint64_t now)
+{
+    double rate;
+    double used;
+    uint64_t dt;
+
+    if (now <= s_vs.t) {
+        return;
+    }
+
+    dt = now - s_vs.t;
+    rate = vs_drain_rate();
+    used = rate * (double)dt;
+    if (used > s_vs.fifo) {
+        used = s_vs.fifo;
+    }
+
+    if (used > 0) {
+        s_vs.fifo -= used;
+        if (vs_decoding()) {
+            s_vs.decoded += used;
+        }
+        if (s_vs.cancelling) {
+            s_vs.cancel_drained += used;
+        }
+    }
+
+    /* 解码中FIFO送空, 且不是码流结尾的填充: 欠载 */
+    if (s_vs.fifo < 1e-9 && vs_decoding() && s_vs.trail_fill == 0 && !s_vs.starving) {
+        s_vs.starving = true;
+        s_vs.starve_start = s_vs.t + (uint64_t)(used / rate);
+        s_vs.stats.underruns++;
+    }
+
+    s_vs.t = now;
+
+    if (s_vs.cancelling && s_vs.cancel_bytes != 0 && s_vs.cancel_drained >= s_vs.cancel_bytes) {
+        /* 解码器丢弃到帧边界, 清零SM_CANCEL, 回到空闲 */
+        s_vs.reg[SPI_MODE] &= ~SM_CANCEL;
+        vs_decoder_idle();
+        s_vs.need_fill = true;
+        s_vs.tail_left = VS_CANCEL_TAIL;
+    }
+}
+
+/**
+ * @brief       DREQ下一次可能变高的时刻
+ * @param       无
+ * @retval      时刻, 没有返回UINT64_MAX
+ */
+uint64_t sim_vs1053_next_event(void)
+{
+    double rate;
+    double need;
+
+    if (!s_vs.rst) {
+        return UINT64_MAX;
+    }
+    if (s_vs.t < s_vs.busy_until) {
+        return s_vs.busy_until;
+    }
+
+    need = s_vs.fifo - (SIM_VS_FIFO_SIZE - VS_DREQ_FREE);
+    if (need <= 0) {
+        return UINT64_MAX;      /* 已经是高 */
+    }
+    rate = vs_drain_rate();
+    if (rate <= 0) {
+        return UINT64_MAX;
+    }
+    return s_vs.t + (uint64_t)ceil(need / rate) + 1;
+}
+
+/**
+ * @brief       DREQ: 不在复位中、不忙、FIFO至少32字节空闲
+ * @param       无
+ * @retval      电平
+ */
+bool sim_vs1053_dreq(void)
+{
+    if (!s_vs.rst || s_vs.t < s_vs.busy_until) {
+        return false;
+    }
+    return (SIM_VS_FIFO_SIZE - s_vs.fifo) >= VS_DREQ_FREE - 1e-6;
+}
+
+/**
+ * @brief       控制脚电平变化
+ * @param       xcs: XCS
+ * @param       xdcs: XDCS
+ * @param       rst: XRESET
+ * @retval      无
+ */
+void sim_vs1053_pins(bool xcs, bool xdcs, bool rst)
+{
+    if (rst != s_vs.rst) {
+        s_vs.rst = rst;
+        if (!rst) {
+            vs_power_on();
+        } else {
+            s_vs.stats.hard_resets++;
+            s_vs.reset_until = s_vs.t + vs_cycles(VS_RESET_XTALI, SIM_VS_XTALI_HZ);
+            s_vs.busy_until = s_vs.reset_until;
+        }
+    }
+
+    if (xcs != s_vs.xcs) {
+        if (xcs && s_vs.frame_pos != 0 && s_vs.frame_pos < 4) {
+            vs_violation(SIM_VIOL_SCI_FRAME, "XCS raised after %u bytes", s_vs.frame_pos);
+        }
+        s_vs.frame_pos = 0;
+        s_vs.xcs = xcs;
+    }
+
+    if (xdcs != s_vs.xdcs) {
+        if (!xdcs) {
+            if (rst && !sim_vs1053_dreq()) {
+                vs_violation(SIM_VIOL_SDI_NOT_READY, "XDCS low, FIFO %.0f bytes%s", s_vs.fifo,
+                             (s_vs.t < s_vs.busy_until) ? ", busy" : "");
+            }
+            s_vs.test_n = 0;
+        }
+        s_vs.xdcs = xdcs;
+    }
+}
+
+/**
+ * @brief       阻塞SPI传输的一个字节
+ * @param       tx: MOSI
+ * @param       spi_hz: SPI时钟
+ * @retval      MISO
+ */
+uint8_t sim_vs1053_spi(uint8_t tx, uint32_t spi_hz)
+{
+    if (s_vs.xcs && s_vs.xdcs) {
+        return 0xFF;            /* 都没选中 */
+    }
+    if (!s_vs.rst) {
+        vs_violation(SIM_VIOL_IN_RESET, "SPI byte 0x%02X", tx);
+        return 0xFF;
+    }
+    if (!s_vs.xcs && !s_vs.xdcs) {
+        vs_violation(SIM_VIOL_CS_BOTH, "SPI byte 0x%02X", tx);
+        return 0xFF;
+    }
+    if (!s_vs.xcs) {
+        return vs_sci_byte(tx, spi_hz);
+    }
+
+    vs_check_clock(spi_hz, false);
+    if (s_vs.reg[SPI_MODE] & SM_TESTS) {
+        s_vs.test_buf[s_vs.test_n++] = tx;
+        if (s_vs.test_n == sizeof(s_vs.test_buf)) {
+            vs_test_command();
+            s_vs.test_n = 0;
+        }
+        return 0xFF;
+    }
+    vs_sdi_data(&tx, 1);
+    return 0xFF;
+}
+
+/**
+ * @brief       一次DMA突发送入SDI
+ * @param       buf: 数据
+ * @param       len: 字节数
+ * @param       spi_hz: SPI时钟
+ * @retval      无
+ */
+void sim_vs1053_sdi_block(const uint8_t *buf, uint16_t len, uint32_t spi_hz)
+{
+    if (!s_vs.rst) {
+        vs_violation(SIM_VIOL_IN_RESET, "DMA burst of %u bytes", len);
+        return;
+    }
+    if (s_vs.xdcs) {
+        return;                 /* 没选中, 数据丢失 (送数器会在XDCS上报错之前拉低) */
+    }
+    if (!s_vs.xcs) {
+        vs_violation(SIM_VIOL_CS_BOTH, "DMA burst of %u bytes", len);
+        return;
+    }
+
+    vs_check_clock(spi_hz, false);
+    vs_sdi_data(buf, len);
+}
+
+void sim_vs1053_get_stats(SimVs1053Stats_t *stats)
+{
+    *stats = s_vs.stats;
+    if (s_vs.starving) {
+        stats->underrun_cycles += s_vs.t - s_vs.starve_start;
+    }
+}
+
+void sim_vs1053_reset_stats(void)
+{
+    memset(&s_vs.stats, 0, sizeof(s_vs.stats));
+    s_vs.logged = 0;
+    if (s_vs.starving) {
+        s_vs.starve_start = s_vs.t;
+    }
+}
+
+uint32_t sim_vs1053_violation_total(void)
+{
+    uint32_t n = 0;
+    uint8_t i;
+
+    for (i = 0; i < SIM_VIOLATIONS; i++) {
+        n += s_vs.stats.violations[i];
+    }
+    return n;
+}
+
+const char *sim_vs1053_violation_name(SimViolation_t v)
+{
+    return (v < SIM_VIOLATIONS) ? s_viol_names[v] : "?";
+}
+
+SimVsFormat_t sim_vs1053_format(void)
+{
+    return (SimVsFormat_t)s_vs.format;
+}
+
+uint16_t sim_vs1053_peek(uint8_t addr)
+{
+    return s_vs.reg[addr & 0x0F];
+}
+
+uint32_t sim_vs1053_fifo_level(void)
+{
+    return (uint32_t)s_vs.fifo;
+}
+
+double sim_vs1053_decoded_seconds(void)
+{
+    return (s_vs.byte_rate != 0) ? s_vs.decoded / s_vs.byte_rate : 0.0;
+}
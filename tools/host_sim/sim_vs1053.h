@@ -0,0 +1,89 @@
+#ifndef SIM_VS1053_H
+#define SIM_VS1053_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * VS1053行为模型 (主机仿真)
+ * 按数据手册建模SCI寄存器(MODE/STATUS/CLOCKF/DECODE_TIME/AUDATA/HDAT0/1/WRAM)、
+ * 2048字节SDI FIFO、DREQ规则(不忙且至少32字节空闲)、硬/软复位、SM_CANCEL取消
+ * 和endFillByte填充。FIFO按当前码流的实际码率消耗, 码流格式从收到的数据中识别
+ * (MP3帧头, WAV的RIFF头)。
+ * 模型不解码音频, 只检查时序和协议: FIFO送空记为欠载, 违反协议记为违例并打印。
+ */
+
+#define SIM_VS_FIFO_SIZE        2048
+#define SIM_VS_XTALI_HZ         12288000U
+#define SIM_VS_CANCEL_BYTES     512     /* 默认: 置SM_CANCEL后消耗这么多字节才清零(约一帧) */
+
+/* 协议违例 */
+typedef enum {
+    SIM_VIOL_SCI_WRITE_BUSY = 0,    /* DREQ为低(芯片忙)时写SCI */
+    SIM_VIOL_SCI_READ_BUSY,         /* 复位期间读SCI */
+    SIM_VIOL_SDI_NOT_READY,         /* DREQ为低时拉低XDCS开始送数 */
+    SIM_VIOL_FIFO_OVERFLOW,         /* 送入的数据超出FIFO空间 */
+    SIM_VIOL_CS_BOTH,               /* XCS和XDCS同时为低 */
+    SIM_VIOL_IN_RESET,              /* 复位脚为低时访问 */
+    SIM_VIOL_SPI_CLOCK,             /* SPI时钟超过CLKI/7(SCI读)或CLKI/4(SCI写/SDI) */
+    SIM_VIOL_SCI_FRAME,             /* SCI帧不完整或操作码错误 */
+    SIM_VIOL_FILL,                  /* 取消后没有送够2052个endFillByte就开始新码流 */
+    SIM_VIOLATIONS
+} SimViolation_t;
+
+/* 统计 */
+typedef struct {
+    uint32_t underruns;             /* 解码中FIFO被送空的次数 */
+    uint64_t underrun_cycles;       /* 送空持续的总时间(CPU周期) */
+    uint32_t sci_reads;
+    uint32_t sci_writes;
+    uint32_t hard_resets;
+    uint32_t soft_resets;
+    uint32_t cancels;               /* 置SM_CANCEL的次数 */
+    uint32_t streams;               /* 识别到的新码流数 */
+    uint64_t sdi_bytes;             /* 送入FIFO的字节数 */
+    uint32_t fifo_max;              /* FIFO最高水位 */
+    uint32_t violations[SIM_VIOLATIONS];
+} SimVs1053Stats_t;
+
+/* 码流格式 */
+typedef enum {
+    SIM_VS_FMT_NONE = 0,            /* 空闲 */
+    SIM_VS_FMT_DETECT,              /* 收到数据, 正在识别 */
+    SIM_VS_FMT_MP3,
+    SIM_VS_FMT_WAV,
+    SIM_VS_FMT_UNKNOWN              /* 没识别出来, 按默认码率消耗 */
+} SimVsFormat_t;
+
+/* 初始化和配置 */
+void sim_vs1053_init(void);                         /* 上电(复位脚为低) */
+void sim_vs1053_set_cancel_bytes(uint32_t bytes);   /* 0: SM_CANCEL永不清零 */
+void sim_vs1053_set_log(uint32_t max_logged);       /* 最多打印多少条违例 */
+
+/* 由sim_hal调用 */
+void sim_vs1053_run(uint64_t now);                  /* 推进模型到now */
+uint64_t sim_vs1053_next_event(void);               /* DREQ下一次可能变化的时刻, 没有返回UINT64_MAX */
+bool sim_vs1053_dreq(void);
+void sim_vs1053_pins(bool xcs, bool xdcs, bool rst);
+uint8_t sim_vs1053_spi(uint8_t tx, uint32_t spi_hz);
+void sim_vs1053_sdi_block(const uint8_t *buf, uint16_t len, uint32_t spi_hz);  /* 一次DMA突发 */
+
+/* 读出 */
+void sim_vs1053_get_stats(SimVs1053Stats_t *stats);
+void sim_vs1053_reset_stats(void);
+uint32_t sim_vs1053_violation_total(void);
+const char *sim_vs1053_violation_name(SimViolation_t v);
+SimVsFormat_t sim_vs1053_format(void);
+uint16_t sim_vs1053_peek(uint8_t addr);             /* 直接看寄存器, 不经过总线 */
+uint32_t sim_vs1053_fifo_level(void);
+double sim_vs1053_decoded_seconds(void);            /* 当前码流已解码的时长 */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_VS1053_H
@@ -0,0 +1,221 @@
+/*
+ * 送数吞吐量码率扫描 (主机)
+ * 在SD卡替身(sim_sdcard.c, 内存镜像 + SDIO时序)和VS1053行为模型上运行板上的
+ * stream_bench: 真实的FatFs、audio_player、DMA送数器和遥测, 主循环与main.c相同。
+ * 在空白卡上格式化后生成32kbps MP3到1411kbps WAV的合成码流, 逐个播放
+ * STREAM_BENCH_SECONDS秒, 报告读卡速率、送数速率、送数CPU占用、送空次数和
+ * 无送空的最高码率(结果行与板上串口输出相同), 另外给出解码器侧的欠载和协议违例。
+ * 最高码率低于要求、解码器欠载或有协议违例时返回非0, 供CI在下载前发现性能回退。
+ *
+ * 用法: stream_sweep [-m 要求的kbps] [-a 读访问us] [-k SD时钟kHz] [-w 总线位宽]
+ *                    [-l 主循环us] [-v]
+ */
+
+#include "main.h"
+#include "sim_hal.h"
+#include "sim_vs1053.h"
+#include "sim_sdcard.h"
+#include "audio_player.h"
+#include "audio_spectrum.h"
+#include "audio_telemetry.h"
+#include "stream_bench.h"
+#include "seek_index.h"
+#include "vs1053_plugin.h"
+#include "filesystem.h"
+#include "sd_cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SWEEP_LOOP_US           100     /* 主循环其他工作(界面/触摸) */
+#define SWEEP_REQUIRED_KBPS     1411    /* 默认要求全部码率无送空 */
+#define SWEEP_TIMEOUT_S         600     /* 虚拟时间上限 */
+
+/* 选项 */
+typedef struct {
+    uint32_t required_kbps;
+    uint32_t loop_us;
+    SimSdTiming_t sd;
+    bool verbose;
+} SweepOpts_t;
+
+static uint32_t s_failures;
+
+/* ============================================================================
+ * 工具
+ * ============================================================================ */
+
+static void sweep_check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        s_failures++;
+    }
+}
+
+/* 与main.c主循环相同的一次迭代 */
+static void sweep_loop(const SweepOpts_t *opts)
+{
+    audio_player_task();
+    audio_spectrum_task();
+    if (!audio_player_io_busy()) {
+        seek_index_task();
+    }
+    audio_telemetry_task();
+    stream_bench_task();
+    sim_advance((uint64_t)opts->loop_us * (SIM_CPU_HZ / 1000000U));
+}
+
+/* 空白卡上建立文件系统后挂载 */
+static bool sweep_mount(void)
+{
+    FS_Status_t status;
+
+    MX_FATFS_Init();            /* 与main.c相同, 在fs_init之前链接驱动 */
+    status = fs_init();
+
+    if (status == FS_STATUS_NO_FILESYSTEM) {
+        if (f_mkfs(SDPath, 0, 0) != FR_OK) {
+            return false;
+        }
+        status = fs_mount();
+    }
+    return status == FS_STATUS_OK;
+}
+
+/* ============================================================================
+ * 主程序
+ * ============================================================================ */
+
+static void sweep_usage(void)
+{
+    fprintf(stderr, "usage: stream_sweep [-m required_kbps] [-a read_access_us] [-k sd_clock_khz]"
+                    " [-w bus_width] [-l loop_us] [-v]\n");
+    exit(2);
+}
+
+static void sweep_parse(int argc, char **argv, SweepOpts_t *opts)
+{
+    int i;
+
+    opts->required_kbps = SWEEP_REQUIRED_KBPS;
+    opts->loop_us = SWEEP_LOOP_US;
+    opts->sd.read_us = SIM_SD_DEFAULT_READ_US;
+    opts->sd.write_us = SIM_SD_DEFAULT_WRITE_US;
+    opts->sd.clock_hz = SIM_SD_DEFAULT_CLOCK_HZ;
+    opts->sd.bus_width = SIM_SD_DEFAULT_BUS_WIDTH;
+    opts->verbose = false;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            opts->verbose = true;
+        } else if (i + 1 < argc && strcmp(argv[i], "-m") == 0) {
+            opts->required_kbps = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (i + 1 < argc && strcmp(argv[i], "-a") == 0) {
+            opts->sd.read_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (i + 1 < argc && strcmp(argv[i], "-k") == 0) {
+            opts->sd.clock_hz = (uint32_t)strtoul(argv[++i], NULL, 0) * 1000U;
+        } else if (i + 1 < argc && strcmp(argv[i], "-w") == 0) {
+            opts->sd.bus_width = (uint8_t)strtoul(argv[++i], NULL, 0);
+        } else if (i + 1 < argc && strcmp(argv[i], "-l") == 0) {
+            opts->loop_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else {
+            sweep_usage();
+        }
+    }
+
+    if (opts->sd.clock_hz == 0 || (opts->sd.bus_width != 1 && opts->sd.bus_width != 4)) {
+        sweep_usage();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    SweepOpts_t opts;
+    SimVs1053Stats_t vs;
+    SimSdStats_t sd;
+    SdCacheStats_t cache;
+    uint8_t files_peak;
+    StreamBenchResult_t r;
+    uint32_t chip_underruns[STREAM_BENCH_RATES] = {0};
+    uint32_t underruns_before = 0;
+    uint32_t underruns_total = 0;
+    uint8_t done = 0;
+    uint8_t i;
+
+    sweep_parse(argc, argv, &opts);
+
+    sim_hal_init();
+    sim_vs1053_set_log(opts.verbose ? 0xFFFFFFFFU : 20);
+    sim_set_deadline((uint64_t)SWEEP_TIMEOUT_S * SIM_CPU_HZ);
+    if (!sim_sdcard_init(SIM_SD_DEFAULT_BLOCKS)) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    sim_sdcard_set_timing(&opts.sd);
+
+    /* 与device_init_all相同的初始化顺序 */
+    sweep_check(sweep_mount(), "mount SD card");
+    sweep_check(vs1053_init(), "vs1053_init");
+    vs1053_plugin_init();
+    audio_spectrum_init();
+    sweep_check(audio_player_init(), "audio_player_init");
+    audio_telemetry_init();
+    if (s_failures != 0) {
+        printf("FAIL\n");
+        return 1;
+    }
+
+    printf("SD: %u-bit %u kHz, read access %u us | main loop %u us\n",
+           opts.sd.bus_width, opts.sd.clock_hz / 1000U, opts.sd.read_us, opts.loop_us);
+
+    /* 相当于串口命令'b' */
+    stream_bench_start();
+    while (stream_bench_busy()) {
+        sweep_loop(&opts);
+
+        /* 每个码率结束时记下解码器侧的欠载 (最后中途停止时FIFO送空不计) */
+        if (done < STREAM_BENCH_RATES && stream_bench_get(done, &r) && (r.done || r.failed)) {
+            sim_vs1053_get_stats(&vs);
+            chip_underruns[done] = vs.underruns - underruns_before;
+            underruns_before = vs.underruns;
+            underruns_total += chip_underruns[done];
+            done++;
+        }
+    }
+
+    /* 结果经遥测串口逐行输出, 每次主循环一行 */
+    for (i = 0; i <= STREAM_BENCH_RATES + 1; i++) {
+        sweep_loop(&opts);
+    }
+
+    sim_vs1053_get_stats(&vs);
+    sim_sdcard_get_stats(&sd);
+    printf("decoder underruns:");
+    for (i = 0; i < STREAM_BENCH_RATES; i++) {
+        stream_bench_get(i, &r);
+        printf(" %uk=%u", r.kbps, chip_underruns[i]);
+    }
+    printf("\n");
+    printf("SD card:         %u reads (%.1f KB), %u writes (%.1f KB)\n",
+           sd.reads, (double)sd.read_blocks * SIM_SD_BLOCK_SIZE / 1024.0,
+           sd.writes, (double)sd.write_blocks * SIM_SD_BLOCK_SIZE / 1024.0);
+    sd_cache_get_stats(&cache);
+    printf("sector cache:    hit %u miss %u, prefetch %u (%u hit), bypass %u\n",
+           cache.hits, cache.misses, cache.prefetches, cache.prefetch_hits, cache.bypass);
+    fs_get_open_files(&files_peak);
+    printf("file pool:       peak %u of %u\n", files_peak, FS_FILE_POOL_SIZE);
+    printf("violations:      %u\n", sim_vs1053_violation_total());
+    for (i = 0; i < SIM_VIOLATIONS; i++) {
+        if (vs.violations[i] != 0) {
+            printf("  %-24s %u\n", sim_vs1053_violation_name((SimViolation_t)i), vs.violations[i]);
+        }
+    }
+    printf("virtual time:    %.2f s\n", (double)sim_now() / SIM_CPU_HZ);
+
+    sweep_check(stream_bench_max_kbps() >= opts.required_kbps, "required bitrate sustained");
+    sweep_check(underruns_total == 0, "no decoder underruns");
+    sweep_check(sim_vs1053_violation_total() == 0, "no protocol violations");
+
+    printf("%s\n", (s_failures == 0) ? "PASS" : "FAIL");
+    return (s_failures == 0) ? 0 : 1;
+}
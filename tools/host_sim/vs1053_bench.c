@@ -0,0 +1,457 @@
+/*
+ * VS1053驱动主机基准测试
+ * 在VS1053行为模型上运行真实的驱动和DMA送数器, 送数流程与audio_player相同
+ * (预读环形缓冲区 + SD卡读延迟模型), 测量:
+ *   1. vs1053_init
+ *   2. 合成CBR MP3连续播放: 送数速度、中断CPU占用、每KB开销、欠载
+ *   3. 文件尾结束解码(先填充再SM_CANCEL)的耗时
+ *   4. 中途换曲(SM_CANCEL)的耗时, 之后接1411kbps WAV并检查HDAT1
+ *   5. SM_CANCEL一直不清零时软复位兜底
+ * 有欠载、协议违例或检查失败时返回非0, 供CI做回归。
+ *
+ * 用法: vs1053_bench [-b kbps] [-t 秒] [-c 取消字节数] [-v]
+ */
+
+#include "main.h"
+#include "sim_hal.h"
+#include "sim_vs1053.h"
+#include "vs1053_driver.h"
+#include "vs1053_feeder.h"
+#include "audio_ringbuf.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* SD卡读模型: 每次f_read固定延迟 + 传输时间 */
+#define BENCH_SD_LATENCY_US     300
+#define BENCH_SD_BYTES_PER_SEC  4000000U
+
+#define BENCH_LOOP_CYCLES       7200        /* 主循环其他工作(界面/触摸), 约100us */
+#define BENCH_SWITCH_AFTER_S    1           /* 中途换曲前先播放的时长 */
+#define BENCH_WAV_SECONDS       2
+#define BENCH_WAV_KBPS          1411
+
+/* 选项 */
+typedef struct {
+    uint32_t kbps;
+    uint32_t seconds;
+    uint32_t cancel_bytes;
+    bool verbose;
+} BenchOpts_t;
+
+/* 一个曲目 (整个文件在内存中) */
+typedef struct {
+    uint8_t *data;
+    uint32_t len;
+    uint32_t pos;               /* 已"读卡"的字节数 */
+} BenchTrack_t;
+
+static uint8_t s_ring_mem[AUDIO_RINGBUF_SIZE] __attribute__((aligned(4)));
+static AudioRingBuf_t s_ring;
+static uint32_t s_failures;
+
+/* ============================================================================
+ * 工具
+ * ============================================================================ */
+
+static double bench_ms(uint64_t cycles)
+{
+    return (double)cycles * 1000.0 / SIM_CPU_HZ;
+}
+
+static void bench_check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        s_failures++;
+    }
+}
+
+static uint32_t bench_rand(void)
+{
+    static uint32_t x = 0x12345678U;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+/**
+ * @brief       生成CBR MP3 (MPEG-1 Layer III, 44.1kHz立体声), 帧内为随机数据
+ * @param       tr: 输出
+ * @param       kbps: 码率
+ * @param       seconds: 时长
+ * @retval      true: 成功, false: 码率不在表中
+ */
+static bool bench_gen_mp3(BenchTrack_t *tr, uint32_t kbps, uint32_t seconds)
+{
+    static const uint16_t rates[15] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320};
+    uint32_t idx;
+    uint32_t frames = seconds * 44100U / 1152U;
+    uint32_t rem = 0;
+    uint32_t size;
+    uint32_t f;
+    uint32_t i;
+    uint8_t pad;
+    uint8_t *p;
+
+    for (idx = 1; idx < 15 && rates[idx] != kbps; idx++) {}
+    if (idx == 15) {
+        return false;
+    }
+
+    tr->data = malloc((size_t)(frames + 1) * (144000U * kbps / 44100U + 1));
+    tr->len = 0;
+    tr->pos = 0;
+    p = tr->data;
+
+    for (f = 0; f < frames; f++) {
+        rem += 144000U * kbps % 44100U;
+        pad = (rem >= 44100U) ? 1 : 0;
+        if (pad) {
+            rem -= 44100U;
+        }
+        size = 144000U * kbps / 44100U + pad;
+
+        p[0] = 0xFF;
+        p[1] = 0xFB;                                /* MPEG-1, Layer III, 无CRC */
+        p[2] = (uint8_t)((idx << 4) | (pad << 1));  /* 码率, 44.1kHz, 填充位 */
+        p[3] = 0x00;                                /* 立体声 */
+        for (i = 4; i < size; i++) {
+            p[i] = (uint8_t)(bench_rand() | 1);     /* 不出现0(endFillByte) */
+        }
+        p += size;
+        tr->len += size;
+    }
+    return true;
+}
+
+static void bench_put_le(uint8_t *p, uint32_t v, uint8_t n)
+{
+    while (n--) {
+        *p++ = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+/**
+ * @brief       生成16位44.1kHz立体声WAV (1411kbps)
+ * @param       tr: 输出
+ * @param       seconds: 时长
+ * @retval      无
+ */
+static void bench_gen_wav(BenchTrack_t *tr, uint32_t seconds)
+{
+    uint32_t data_len = seconds * 44100U * 4U;
+    uint32_t i;
+    uint8_t *h;
+
+    tr->data = malloc(44 + data_len);
+    tr->len = 44 + data_len;
+    tr->pos = 0;
+    h = tr->data;
+
+    memcpy(h, "RIFF", 4);
+    bench_put_le(h + 4, 36 + data_len, 4);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    bench_put_le(h + 16, 16, 4);
+    bench_put_le(h + 20, 1, 2);             /* PCM */
+    bench_put_le(h + 22, 2, 2);             /* 声道 */
+    bench_put_le(h + 24, 44100, 4);
+    bench_put_le(h + 28, 44100 * 4, 4);     /* 字节率 */
+    bench_put_le(h + 32, 4, 2);
+    bench_put_le(h + 34, 16, 2);
+    memcpy(h + 36, "data", 4);
+    bench_put_le(h + 40, data_len, 4);
+
+    for (i = 44; i < tr->len; i++) {
+        h[i] = (uint8_t)(bench_rand() | 1);
+    }
+}
+
+/* ============================================================================
+ * 播放流程 (与audio_player相同的调用顺序)
+ * ============================================================================ */
+
+/**
+ * @brief       预读: 按水位从"SD卡"读入环形缓冲区 (同audio_fill_ringbuf)
+ * @param       tr: 曲目
+ * @param       max_chunks: 最多读几次, 0不限
+ * @retval      无
+ */
+static void bench_fill(BenchTrack_t *tr, uint8_t max_chunks)
+{
+    uint32_t len;
+    uint8_t *dst;
+    uint8_t chunks = 0;
+
+    while (tr->pos < tr->len && audio_ringbuf_need_fill(&s_ring)) {
+        dst = audio_ringbuf_write_ptr(&s_ring, &len);
+        if (len > AUDIO_RINGBUF_CHUNK) {
+            len = AUDIO_RINGBUF_CHUNK;
+        }
+        len -= len % AUDIO_RINGBUF_SECTOR;
+        if (len == 0) {
+            break;
+        }
+        if (len > tr->len - tr->pos) {
+            len = tr->len - tr->pos;
+        }
+
+        /* 读卡期间主循环阻塞, 中断照常送数 */
+        sim_advance((uint64_t)BENCH_SD_LATENCY_US * (SIM_CPU_HZ / 1000000U) +
+                    (uint64_t)len * SIM_CPU_HZ / BENCH_SD_BYTES_PER_SEC);
+        memcpy(dst, tr->data + tr->pos, len);
+        tr->pos += len;
+        audio_ringbuf_commit(&s_ring, len);
+        vs1053_feeder_notify();
+
+        if (max_chunks != 0 && ++chunks >= max_chunks) {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief       开始一个曲目: 启动解码器, 预读, 挂接送数器
+ * @param       tr: 曲目
+ * @retval      true: 成功
+ */
+static bool bench_open(BenchTrack_t *tr)
+{
+    tr->pos = 0;
+    if (!vs1053_play_start()) {
+        return false;
+    }
+    audio_ringbuf_init(&s_ring, s_ring_mem, sizeof(s_ring_mem));
+    bench_fill(tr, 0);
+    vs1053_feeder_attach(&s_ring);
+    return true;
+}
+
+/**
+ * @brief       主循环: 边读卡边送数
+ * @param       tr: 曲目
+ * @param       cycles: 最长时间, 0表示到文件送完为止
+ * @retval      无
+ */
+static void bench_stream(BenchTrack_t *tr, uint64_t cycles)
+{
+    uint64_t end = sim_now() + cycles;
+
+    while (cycles == 0 || sim_now() < end) {
+        if (tr->pos >= tr->len && audio_ringbuf_fill(&s_ring) == 0 && vs1053_feeder_idle()) {
+            break;
+        }
+        bench_fill(tr, 1);
+        sim_advance(BENCH_LOOP_CYCLES);
+    }
+}
+
+/**
+ * @brief       结束当前解码, 等取消流程完成
+ * @param       at_eof: true文件尾, false中途换曲
+ * @retval      耗时(周期)
+ */
+static uint64_t bench_cancel(bool at_eof)
+{
+    uint64_t t0 = sim_now();
+
+    vs1053_cancel_begin(at_eof);
+    while (vs1053_cancel_poll() != VS1053_CANCEL_DONE) {
+        sim_advance(BENCH_LOOP_CYCLES);
+    }
+    return sim_now() - t0;
+}
+
+/* ============================================================================
+ * 场景
+ * ============================================================================ */
+
+/**
+ * @brief       连续播放, 报告吞吐量和中断开销
+ * @param       tr: 曲目
+ * @param       kbps: 码率(只用于显示)
+ * @retval      无
+ */
+static void bench_throughput(BenchTrack_t *tr, uint32_t kbps)
+{
+    SimHalStats_t hal;
+    SimVs1053Stats_t vs;
+    VS1053_FeederStats_t feed;
+    uint64_t t0;
+    uint64_t elapsed;
+    uint32_t decode_time;
+    double audio_s = (double)tr->len / (kbps * 125.0);
+
+    vs1053_feeder_reset_stats();
+    sim_hal_reset_stats();
+    t0 = sim_now();
+
+    bench_check(bench_open(tr), "play start");
+    bench_stream(tr, 0);
+
+    elapsed = sim_now() - t0;
+    decode_time = vs1053_get_decode_time();
+    sim_hal_get_stats(&hal);
+    sim_vs1053_get_stats(&vs);
+    vs1053_feeder_get_stats(VS1053_FEED_DMA, &feed);
+
+    printf("stream: %u kbps MP3, %u bytes, %.2f s audio in %.2f s\n",
+           kbps, tr->len, audio_s, bench_ms(elapsed) / 1000.0);
+    printf("  feed rate      %.1f KB/s\n", feed.bytes / 1024.0 / (bench_ms(elapsed) / 1000.0));
+    printf("  isr load       %.2f %% (%u DREQ irqs, %u DMA irqs, %u bursts)\n",
+           100.0 * (double)hal.isr_cycles / (double)elapsed, hal.exti_irqs, hal.dma_irqs, hal.dma_bursts);
+    printf("  feeder cost    %u cycles/KB\n", vs1053_feeder_cycles_per_kb(VS1053_FEED_DMA));
+    printf("  fifo max       %u bytes\n", vs.fifo_max);
+    printf("  underruns      %u (%.2f ms)\n", vs.underruns, bench_ms(vs.underrun_cycles));
+    printf("  decode time    %u s\n", decode_time);
+
+    bench_check(feed.bytes == tr->len, "all bytes fed");
+    bench_check(decode_time + 1 >= (uint32_t)audio_s - 1, "decode time follows stream");
+
+    t0 = sim_now();
+    elapsed = bench_cancel(true);
+    printf("eof finish:      %.2f ms (fill + cancel)\n", bench_ms(elapsed));
+}
+
+/**
+ * @brief       中途换曲到WAV
+ * @param       mp3: MP3曲目
+ * @param       wav: WAV曲目
+ * @retval      无
+ */
+static void bench_switch(BenchTrack_t *mp3, BenchTrack_t *wav)
+{
+    uint16_t regs[16];
+    uint64_t latency;
+    uint16_t resets = vs1053_cancel_resets();
+
+    bench_check(bench_open(mp3), "play start");
+    bench_stream(mp3, (uint64_t)BENCH_SWITCH_AFTER_S * SIM_CPU_HZ);
+
+    latency = bench_cancel(false);
+    printf("switch:          %.2f ms (SM_CANCEL + 2052 fill, %u resets)\n",
+           bench_ms(latency), vs1053_cancel_resets() - resets);
+    bench_check(vs1053_cancel_resets() == resets, "cancel without soft reset");
+
+    bench_check(bench_open(wav), "wav start");
+    bench_stream(wav, 0);
+    vs1053_read_regs((1U << SPI_HDAT0) | (1U << SPI_HDAT1) | (1U << SPI_AUDATA), regs);
+    printf("wav:             HDAT1=0x%04X HDAT0=%u AUDATA=0x%04X\n",
+           regs[SPI_HDAT1], regs[SPI_HDAT0], regs[SPI_AUDATA]);
+    bench_check(regs[SPI_HDAT1] == 0x7665, "WAV detected after switch");
+    bench_cancel(true);
+}
+
+/**
+ * @brief       SM_CANCEL不清零: 送满2048字节后软复位
+ * @param       mp3: 曲目
+ * @param       cancel_bytes: 恢复后的取消字节数
+ * @retval      无
+ */
+static void bench_stuck_cancel(BenchTrack_t *mp3, uint32_t cancel_bytes)
+{
+    uint64_t latency;
+    uint16_t resets = vs1053_cancel_resets();
+
+    bench_check(bench_open(mp3), "play start");
+    bench_stream(mp3, (uint64_t)BENCH_SWITCH_AFTER_S * SIM_CPU_HZ / 2);
+
+    sim_vs1053_set_cancel_bytes(0);
+    latency = bench_cancel(false);
+    sim_vs1053_set_cancel_bytes(cancel_bytes);
+
+    printf("stuck cancel:    %.2f ms (%u soft resets)\n", bench_ms(latency), vs1053_cancel_resets() - resets);
+    bench_check(vs1053_cancel_resets() == resets + 1, "fallback soft reset");
+}
+
+/* ============================================================================
+ * 主程序
+ * ============================================================================ */
+
+static void bench_usage(void)
+{
+    fprintf(stderr, "usage: vs1053_bench [-b kbps] [-t seconds] [-c cancel_bytes] [-v]\n");
+    exit(2);
+}
+
+static void bench_parse(int argc, char **argv, BenchOpts_t *opts)
+{
+    int i;
+
+    opts->kbps = 128;
+    opts->seconds = 10;
+    opts->cancel_bytes = SIM_VS_CANCEL_BYTES;
+    opts->verbose = false;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            opts->verbose = true;
+        } else if (i + 1 < argc && strcmp(argv[i], "-b") == 0) {
+            opts->kbps = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+            opts->seconds = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+            opts->cancel_bytes = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else {
+            bench_usage();
+        }
+    }
+
+    if (opts->seconds < 2 || opts->cancel_bytes == 0) {
+        bench_usage();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    BenchOpts_t opts;
+    BenchTrack_t mp3;
+    BenchTrack_t wav;
+    SimVs1053Stats_t vs;
+    uint64_t t0;
+    uint8_t i;
+
+    bench_parse(argc, argv, &opts);
+    if (!bench_gen_mp3(&mp3, opts.kbps, opts.seconds)) {
+        fprintf(stderr, "unsupported MP3 bitrate %u kbps\n", opts.kbps);
+        return 2;
+    }
+    bench_gen_wav(&wav, BENCH_WAV_SECONDS);
+
+    sim_hal_init();
+    sim_vs1053_set_cancel_bytes(opts.cancel_bytes);
+    sim_vs1053_set_log(opts.verbose ? 0xFFFFFFFFU : 20);
+    sim_set_deadline((uint64_t)(opts.seconds + BENCH_WAV_SECONDS + 30) * SIM_CPU_HZ);
+
+    t0 = sim_now();
+    bench_check(vs1053_init(), "vs1053_init");
+    printf("init:            %.2f ms\n", bench_ms(sim_now() - t0));
+    vs1053_set_all();
+
+    bench_throughput(&mp3, opts.kbps);
+    bench_switch(&mp3, &wav);
+    bench_stuck_cancel(&mp3, opts.cancel_bytes);
+
+    sim_vs1053_get_stats(&vs);
+    printf("vs1053:          %u streams, %u cancels, %u soft resets, %u SCI reads, %u SCI writes\n",
+           vs.streams, vs.cancels, vs.soft_resets, vs.sci_reads, vs.sci_writes);
+    printf("underruns:       %u\n", vs.underruns);
+    printf("violations:      %u\n", sim_vs1053_violation_total());
+    for (i = 0; i < SIM_VIOLATIONS; i++) {
+        if (vs.violations[i] != 0) {
+            printf("  %-24s %u\n", sim_vs1053_violation_name((SimViolation_t)i), vs.violations[i]);
+        }
+    }
+    printf("virtual time:    %.2f s\n", bench_ms(sim_now()) / 1000.0);
+
+    bench_check(vs.underruns == 0, "no underruns");
+    bench_check(sim_vs1053_violation_total() == 0, "no protocol violations");
+
+    free(mp3.data);
+    free(wav.data);
+
+    printf("%s\n", (s_failures == 0) ? "PASS" : "FAIL");
+    return (s_failures == 0) ? 0 : 1;
+}
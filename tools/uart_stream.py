@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""串口送流: 把音频文件经USART1送给板子播放 (协议见BSP/audio/uart_stream.h)
+
+    python3 tools/uart_stream.py /dev/ttyUSB0 test.mp3
+    python3 tools/uart_stream.py COM5 capture.mp3 --rate 16000   # 按16KB/s限速, 模拟电台码流
+
+1. 以命令波特率发'S', 等"STREAM <窗口> <波特率>"
+2. 切到送流波特率, 发"VSTR" + 长度(32位小端), 再发数据, 累计字节数不超过额度
+3. 板子每送出一段回"C <额度>"; 数据发完后等"END <字节数> <送空次数> <错误>"
+
+需要pyserial。退出码: 0成功, 1板子报告送空或错误, 2协议/串口失败。
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+import serial
+
+
+def read_line(ser, prefix, timeout):
+    """读到以prefix开头的一行; 其他行(遥测报告)原样打印"""
+    deadline = time.monotonic() + timeout
+    buf = b""
+    while time.monotonic() < deadline:
+        buf += ser.read(ser.in_waiting or 1)
+        while b"\n" in buf:
+            line, buf = buf.split(b"\n", 1)
+            text = line.decode("ascii", "replace").strip()
+            if text.startswith(prefix):
+                return text
+            if text and not text.startswith("C "):
+                print("  board:", text)
+    return None
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("port")
+    ap.add_argument("file")
+    ap.add_argument("--baud", type=int, default=115200, help="命令波特率(与usart.c一致)")
+    ap.add_argument("--chunk", type=int, default=1024, help="每次写串口的最大字节数")
+    ap.add_argument("--rate", type=float, default=0, help="限速(KB/s), 0为按额度全速发送")
+    ap.add_argument("--unbounded", action="store_true", help="头中长度写0, 由板子按空闲超时结束")
+    args = ap.parse_args()
+
+    with open(args.file, "rb") as f:
+        data = f.read()
+
+    ser = serial.Serial(args.port, args.baud, timeout=0.05)
+    ser.reset_input_buffer()
+    ser.write(b"S")
+    hello = read_line(ser, "STREAM", 3.0)
+    if hello is None:
+        print("no STREAM reply (recording/bench running?)", file=sys.stderr)
+        return 2
+    _, window, baud = hello.split()
+    credit = int(window)
+    ser.baudrate = int(baud)
+    time.sleep(0.02)
+
+    stream = b"VSTR" + struct.pack("<I", 0 if args.unbounded else len(data)) + data
+    sent = 0
+    pending = b""
+    start = time.monotonic()
+    stalls = 0
+
+    while sent < len(stream):
+        # 收额度
+        pending += ser.read(ser.in_waiting)
+        while b"\n" in pending:
+            line, pending = pending.split(b"\n", 1)
+            text = line.decode("ascii", "replace").strip()
+            if text.startswith("C "):
+                credit = max(credit, int(text[2:]))
+            elif text.startswith("END"):
+                print("board ended early:", text, file=sys.stderr)
+                return 2
+            elif text:
+                print("  board:", text)
+
+        n = min(args.chunk, credit - sent, len(stream) - sent)
+        if n <= 0:
+            stalls += 1
+            pending += ser.read(1)      # 等额度
+            continue
+        if args.rate > 0:
+            due = start + (sent + n) / (args.rate * 1024.0)
+            if due > time.monotonic():
+                time.sleep(due - time.monotonic())
+        ser.write(stream[sent:sent + n])
+        sent += n
+
+    ser.flush()
+    elapsed = time.monotonic() - start
+    end = read_line(ser, "END", 30.0)
+    ser.baudrate = args.baud
+    if end is None:
+        print("no END reply", file=sys.stderr)
+        return 2
+
+    _, received, underruns, errors = end.split()
+    print("sent %d bytes in %.2f s (%.1f KB/s), credit stalls %d" % (len(data), elapsed, len(data) / 1024.0 / elapsed, stalls))
+    print("board: received %s, underruns %s, errors %s" % (received, underruns, errors))
+    return 0 if int(underruns) == 0 and int(errors) == 0 and int(received) == len(data) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())